@@ -49,6 +49,7 @@
 #if DRAW_LLVM_AVAILABLE
 #include "gallivm/lp_bld_init.h"
 #include "gallivm/lp_bld_limits.h"
+#include "tessellator/p_tessellator.h"
 #include "draw_llvm.h"
 #endif
 
@@ -222,6 +223,12 @@ draw_destroy(struct draw_context *draw)
    draw_pt_destroy(draw);
    draw_vs_destroy(draw);
    draw_gs_destroy(draw);
+   if (util_queue_is_initialized(&draw->pt.queue))
+      util_queue_destroy(&draw->pt.queue);
+#if DRAW_LLVM_AVAILABLE
+   if (draw->tes.tess_pool)
+      p_tess_pool_release(draw->tes.tess_pool);
+#endif
 #if DRAW_LLVM_AVAILABLE
    if (draw->llvm)
       draw_llvm_destroy(draw->llvm);
@@ -548,6 +555,59 @@ draw_enable_point_sprites(struct draw_context *draw, bool enable)
 }
 
 
+/**
+ * Let the draw module run the vertex shader of large draws on up to this
+ * many worker threads.  Zero, the default, keeps all the work on the
+ * calling thread.
+ */
+void
+draw_set_vertex_threads(struct draw_context *draw, unsigned num_threads)
+{
+   draw_do_flush(draw, DRAW_FLUSH_STATE_CHANGE);
+
+   if (num_threads != draw->pt.num_threads &&
+       util_queue_is_initialized(&draw->pt.queue)) {
+      util_queue_destroy(&draw->pt.queue);
+      memset(&draw->pt.queue, 0, sizeof(draw->pt.queue));
+   }
+
+   draw->pt.num_threads = num_threads;
+}
+
+
+void
+draw_get_vertex_cache_stats(const struct draw_context *draw,
+                            struct draw_vertex_cache_stats *stats)
+{
+   stats->elements = draw->pt.vertex_cache.elements;
+   stats->fetches = draw->pt.vertex_cache.fetches;
+   stats->primitives = draw->pt.vertex_cache.primitives;
+}
+
+
+/**
+ * The queue of the worker threads, which the vertex shading of the middle
+ * end and the tessellator share.  It's created on first use, returns NULL
+ * if there are no worker threads.
+ */
+struct util_queue *
+draw_get_worker_queue(struct draw_context *draw)
+{
+   if (!draw->pt.num_threads)
+      return NULL;
+
+   /* Room for the segments in flight and a tessellation batch. */
+   if (!util_queue_is_initialized(&draw->pt.queue) &&
+       !util_queue_init(&draw->pt.queue, "draw", 4 * draw->pt.num_threads,
+                        draw->pt.num_threads, 0, NULL)) {
+      memset(&draw->pt.queue, 0, sizeof(draw->pt.queue));
+      return NULL;
+   }
+
+   return &draw->pt.queue;
+}
+
+
 /**
  * Allocate an extra vertex/geometry shader vertex attribute, if it doesn't
  * exist already.
@@ -144,6 +144,23 @@ void draw_enable_line_stipple(struct draw_context *draw, bool enable);
 
 void draw_enable_point_sprites(struct draw_context *draw, bool enable);
 
+void draw_set_vertex_threads(struct draw_context *draw, unsigned num_threads);
+
+/**
+ * Vertex reuse since the draw context was created.  Every index the draws
+ * reference is an element, and every vertex shader invocation a fetch, so
+ * fetches / elements is the fraction of vertices the post-transform cache
+ * missed and fetches / primitives the average cache miss ratio.
+ */
+struct draw_vertex_cache_stats {
+   uint64_t elements;
+   uint64_t fetches;
+   uint64_t primitives;
+};
+
+void draw_get_vertex_cache_stats(const struct draw_context *draw,
+                                 struct draw_vertex_cache_stats *stats);
+
 void draw_set_zs_format(struct draw_context *draw, enum pipe_format format);
 
 /* for TGSI constants are 4 * sizeof(float), but for NIR they need to be sizeof(float); */
@@ -522,7 +522,12 @@ draw_llvm_create_variant(struct draw_llvm *llvm,
 
    draw_llvm_generate(llvm, variant);
 
-   gallivm_compile_module(variant->gallivm);
+   if (!gallivm_compile_module(variant->gallivm)) {
+      gallivm_destroy(variant->gallivm);
+      FREE(variant->function_name);
+      FREE(variant);
+      return NULL;
+   }
 
    variant->jit_func = (draw_jit_vert_func)
          gallivm_jit_function(variant->gallivm, variant->function, variant->function_name);
@@ -2546,7 +2551,12 @@ draw_gs_llvm_create_variant(struct draw_llvm *llvm,
 
    draw_gs_llvm_generate(llvm, variant);
 
-   gallivm_compile_module(variant->gallivm);
+   if (!gallivm_compile_module(variant->gallivm)) {
+      gallivm_destroy(variant->gallivm);
+      FREE(variant->function_name);
+      FREE(variant);
+      return NULL;
+   }
 
    variant->jit_func = (draw_gs_jit_func)
          gallivm_jit_function(variant->gallivm, variant->function, variant->function_name);
@@ -3221,7 +3231,12 @@ draw_tcs_llvm_create_variant(struct draw_llvm *llvm,
 
    draw_tcs_llvm_generate(llvm, variant);
 
-   gallivm_compile_module(variant->gallivm);
+   if (!gallivm_compile_module(variant->gallivm)) {
+      gallivm_destroy(variant->gallivm);
+      FREE(variant->function_name);
+      FREE(variant);
+      return NULL;
+   }
 
    variant->jit_func = (draw_tcs_jit_func)
       gallivm_jit_function(variant->gallivm, variant->function, variant->function_name);
@@ -3761,7 +3776,12 @@ draw_tes_llvm_create_variant(struct draw_llvm *llvm,
 
    draw_tes_llvm_generate(llvm, variant);
 
-   gallivm_compile_module(variant->gallivm);
+   if (!gallivm_compile_module(variant->gallivm)) {
+      gallivm_destroy(variant->gallivm);
+      FREE(variant->function_name);
+      FREE(variant);
+      return NULL;
+   }
 
    variant->jit_func = (draw_tes_jit_func)
       gallivm_jit_function(variant->gallivm, variant->function, variant->function_name);
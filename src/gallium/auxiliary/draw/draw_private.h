@@ -44,6 +44,7 @@
 #include "pipe/p_state.h"
 #include "pipe/p_defines.h"
 #include "pipe/p_shader_tokens.h"
+#include "util/u_queue.h"
 
 #include "draw_vertex_header.h"
 
@@ -107,6 +108,7 @@ struct tgsi_buffer;
 struct lp_cached_code;
 struct draw_vertex_info;
 struct draw_prim_info;
+struct pipe_tessellator_pool;
 
 /**
  * Represents the mapped vertex buffer.
@@ -214,6 +216,19 @@ struct draw_context
       bool test_fse;         /* enable FSE even though its not correct (eg for softpipe) */
       bool no_fse;           /* disable FSE even when it is correct */
 
+      /** worker threads the middle end may run vertex shaders on */
+      unsigned num_threads;
+
+      /** queue of those threads, see draw_get_worker_queue() */
+      struct util_queue queue;
+
+      /** vertex reuse of the frontend, see draw_get_vertex_cache_stats() */
+      struct {
+         uint64_t elements;
+         uint64_t fetches;
+         uint64_t primitives;
+      } vertex_cache;
+
       /* user-space vertex data, buffers */
       struct {
          /** vertex element/index buffer (ex: glDrawElements) */
@@ -331,6 +346,9 @@ struct draw_context
       unsigned num_tes_outputs;  /**< convenience, from tess_eval_shader */
       unsigned position_output;
       unsigned clipvertex_output;
+
+      /** worker tessellators and cache budget of all the tess eval shaders */
+      struct pipe_tessellator_pool *tess_pool;
    } tes;
 
    /** Fragment shader state */
@@ -510,6 +528,9 @@ draw_pipeline_flush(struct draw_context *draw,
 void
 draw_do_flush(struct draw_context *draw, unsigned flags);
 
+struct util_queue *
+draw_get_worker_queue(struct draw_context *draw);
+
 void *
 draw_get_rasterizer_no_cull(struct draw_context *draw,
                              const struct pipe_rasterizer_state *rast);
@@ -132,6 +132,15 @@ draw_pt_arrays(struct draw_context *draw,
       draw->pt.rebind_parameters = false;
    }
 
+   /* Let the middle end shade large draws in parallel. */
+   bool batched = false;
+   if (middle->begin_batch) {
+      unsigned vertex_count = 0;
+      for (unsigned i = 0; i < num_draws; i++)
+         vertex_count = util_clamped_uadd(vertex_count, draw_info[i].count);
+      batched = middle->begin_batch(middle, vertex_count);
+   }
+
    for (unsigned i = 0; i < num_draws; i++) {
       /* Sanitize primitive length:
        */
@@ -164,6 +173,9 @@ draw_pt_arrays(struct draw_context *draw,
          draw->pt.user.drawid++;
    }
 
+   if (batched)
+      middle->end_batch(middle);
+
    return true;
 }
 
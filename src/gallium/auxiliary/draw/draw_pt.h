@@ -125,6 +125,16 @@ struct draw_pt_middle_end {
 
    int (*get_max_vertex_count)(struct draw_pt_middle_end *);
 
+   /**
+    * Optional.  Lets the middle end defer the work of the following run
+    * calls until end_batch(), e.g. to shade several segments at once.
+    * Returns false if the draw isn't batched.  Either way the primitives
+    * are emitted in the order of the run calls.
+    */
+   bool (*begin_batch)(struct draw_pt_middle_end *,
+                       unsigned vertex_count);
+   void (*end_batch)(struct draw_pt_middle_end *);
+
    void (*finish)(struct draw_pt_middle_end *);
    void (*destroy)(struct draw_pt_middle_end *);
 };
@@ -28,6 +28,7 @@
 #include "util/u_math.h"
 #include "util/u_memory.h"
 #include "util/u_prim.h"
+#include "util/u_queue.h"
 #include "draw/draw_context.h"
 #include "draw/draw_gs.h"
 #include "draw/draw_tess.h"
@@ -41,6 +42,42 @@
 #include "gallivm/lp_bld_debug.h"
 
 
+/* Draws with fewer vertices are always shaded on the calling thread. */
+#define LLVM_BATCH_MIN_VERTICES (4 * 4096)
+
+/* The most segments which are shaded ahead of the emission. */
+#define LLVM_BATCH_MAX_JOBS 32
+
+struct llvm_middle_end;
+
+/**
+ * Vertex shading of one segment of a batched draw.  The vertex shader and
+ * the clip test run on a worker thread, the rest of the pipeline runs on
+ * the calling thread in the order the segments were queued.
+ */
+struct llvm_vs_job {
+   struct util_queue_fence fence;
+   struct llvm_middle_end *fpme;
+
+   struct draw_fetch_info fetch_info;
+   struct draw_prim_info prim_info;
+   unsigned draw_count;
+
+   /* The draw state which changes between the segments of a batch. */
+   unsigned vertex_id_offset;
+   unsigned draw_id;
+
+   struct draw_vertex_info vert_info;
+   bool clipped;
+
+   /* Copies of the element lists, the frontend reuses its own. */
+   unsigned *fetch_elts;
+   unsigned fetch_elts_size;
+   uint16_t *draw_elts;
+   unsigned draw_elts_size;
+};
+
+
 struct llvm_middle_end {
    struct draw_pt_middle_end base;
    struct draw_context *draw;
@@ -58,6 +95,14 @@ struct llvm_middle_end {
 
    struct draw_llvm *llvm;
    struct draw_llvm_variant *current_variant;
+
+   /* Batched vertex shading, see llvm_middle_end_begin_batch(). */
+   struct util_queue *queue;
+   bool batching;
+   unsigned max_jobs;
+   unsigned first_job;
+   unsigned num_jobs;
+   struct llvm_vs_job jobs[LLVM_BATCH_MAX_JOBS];
 };
 
 
@@ -489,12 +534,75 @@ emit(struct pt_emit *emit,
 }
 
 
+static unsigned
+llvm_vertex_id_offset(const struct llvm_middle_end *fpme,
+                      const struct draw_fetch_info *fetch_info)
+{
+   const struct draw_context *draw = fpme->draw;
+
+   return fetch_info->linear ? draw->start_index : draw->pt.user.eltBias;
+}
+
+
+static bool
+llvm_alloc_vertices(const struct llvm_middle_end *fpme,
+                    unsigned count,
+                    struct draw_vertex_info *vert_info)
+{
+   vert_info->count = count;
+   vert_info->vertex_size = fpme->vertex_size;
+   vert_info->stride = fpme->vertex_size;
+   vert_info->verts = (struct vertex_header *)
+      MALLOC(fpme->vertex_size *
+             align(count, lp_native_vector_width / 32) +
+             DRAW_EXTRA_VERTICES_PADDING);
+
+   return vert_info->verts != NULL;
+}
+
+
+/**
+ * Run vertex fetch, the vertex shader and the clip test.  Returns whether
+ * any vertex was clipped or has a non-one edgeflag.
+ */
+static bool
+llvm_run_vs(const struct llvm_middle_end *fpme,
+            const struct draw_fetch_info *fetch_info,
+            unsigned vertex_id_offset,
+            unsigned draw_id,
+            struct vertex_header *verts)
+{
+   struct draw_context *draw = fpme->draw;
+   unsigned start = fetch_info->linear ? fetch_info->start :
+                                         draw->pt.user.eltMax;
+
+   return fpme->current_variant->jit_func(&fpme->llvm->vs_jit_context,
+                                          &fpme->llvm->jit_resources[PIPE_SHADER_VERTEX],
+                                          verts,
+                                          draw->pt.user.vbuffer,
+                                          fetch_info->count,
+                                          start,
+                                          fpme->vertex_size,
+                                          draw->pt.vertex_buffer,
+                                          draw->instance_id,
+                                          vertex_id_offset,
+                                          draw->start_instance,
+                                          fetch_info->linear ? NULL : fetch_info->elts,
+                                          draw_id,
+                                          draw->pt.user.viewid);
+}
+
+
+/**
+ * Everything after the vertex shader.  Takes ownership of the shaded
+ * vertices.
+ */
 static void
-llvm_pipeline_generic(struct draw_pt_middle_end *middle,
-                      const struct draw_fetch_info *fetch_info,
-                      const struct draw_prim_info *in_prim_info)
+llvm_pipeline_shaded(struct llvm_middle_end *fpme,
+                     struct draw_vertex_info *llvm_vert_info,
+                     const struct draw_prim_info *in_prim_info,
+                     bool clipped)
 {
-   struct llvm_middle_end *fpme = llvm_middle_end(middle);
    struct draw_context *draw = fpme->draw;
    struct draw_geometry_shader *gshader = draw->gs.geometry_shader;
    struct draw_tess_ctrl_shader *tcs_shader = draw->tcs.tess_ctrl_shader;
@@ -502,32 +610,16 @@ llvm_pipeline_generic(struct draw_pt_middle_end *middle,
    struct draw_prim_info tcs_prim_info;
    struct draw_prim_info tes_prim_info;
    struct draw_prim_info gs_prim_info[TGSI_MAX_VERTEX_STREAMS];
-   struct draw_vertex_info llvm_vert_info;
    struct draw_vertex_info tcs_vert_info;
    struct draw_vertex_info tes_vert_info;
-   struct draw_vertex_info *vert_info;
+   struct draw_vertex_info *vert_info = llvm_vert_info;
    struct draw_prim_info ia_prim_info;
    struct draw_vertex_info ia_vert_info;
    const struct draw_prim_info *prim_info = in_prim_info;
    bool free_prim_info = false;
    unsigned opt = fpme->opt;
-   bool clipped = 0;
    uint16_t *tes_elts_out = NULL;
 
-   assert(fetch_info->count > 0);
-
-   llvm_vert_info.count = fetch_info->count;
-   llvm_vert_info.vertex_size = fpme->vertex_size;
-   llvm_vert_info.stride = fpme->vertex_size;
-   llvm_vert_info.verts = (struct vertex_header *)
-      MALLOC(fpme->vertex_size *
-             align(fetch_info->count, lp_native_vector_width / 32) +
-             DRAW_EXTRA_VERTICES_PADDING);
-   if (!llvm_vert_info.verts) {
-      assert(0);
-      return;
-   }
-
    if (draw->collect_statistics) {
       draw->statistics.ia_vertices += prim_info->count;
       if (prim_info->prim == MESA_PRIM_PATCHES)
@@ -536,41 +628,7 @@ llvm_pipeline_generic(struct draw_pt_middle_end *middle,
       else
          draw->statistics.ia_primitives +=
             u_decomposed_prims_for_vertices(prim_info->prim, prim_info->count);
-      draw->statistics.vs_invocations += fetch_info->count;
-   }
-
-   {
-      unsigned start, vertex_id_offset;
-      const unsigned *elts;
-
-      if (fetch_info->linear) {
-         start = fetch_info->start;
-         vertex_id_offset = draw->start_index;
-         elts = NULL;
-      } else {
-         start = draw->pt.user.eltMax;
-         vertex_id_offset = draw->pt.user.eltBias;
-         elts = fetch_info->elts;
-      }
-      /* Run vertex fetch shader */
-      clipped = fpme->current_variant->jit_func(&fpme->llvm->vs_jit_context,
-                                                &fpme->llvm->jit_resources[PIPE_SHADER_VERTEX],
-                                                llvm_vert_info.verts,
-                                                draw->pt.user.vbuffer,
-                                                fetch_info->count,
-                                                start,
-                                                fpme->vertex_size,
-                                                draw->pt.vertex_buffer,
-                                                draw->instance_id,
-                                                vertex_id_offset,
-                                                draw->start_instance,
-                                                elts,
-                                                draw->pt.user.drawid,
-                                                draw->pt.user.viewid);
-
-      /* Finished with fetch and vs */
-      fetch_info = NULL;
-      vert_info = &llvm_vert_info;
+      draw->statistics.vs_invocations += vert_info->count;
    }
 
    /* Keep track of the patch lengths if we have a geometry shader, this way we can increment
@@ -741,6 +799,167 @@ llvm_pipeline_generic(struct draw_pt_middle_end *middle,
 }
 
 
+/**
+ * Whether every bound shader has a variant, which isn't the case when one
+ * failed to compile.  Nothing gets drawn then.
+ */
+static bool
+llvm_middle_end_has_variants(const struct llvm_middle_end *fpme)
+{
+   const struct draw_context *draw = fpme->draw;
+
+   return fpme->current_variant &&
+          (!draw->gs.geometry_shader ||
+           draw->gs.geometry_shader->current_variant) &&
+          (!draw->tcs.tess_ctrl_shader ||
+           draw->tcs.tess_ctrl_shader->current_variant) &&
+          (!draw->tes.tess_eval_shader ||
+           draw->tes.tess_eval_shader->current_variant);
+}
+
+
+static void
+llvm_pipeline_generic(struct draw_pt_middle_end *middle,
+                      const struct draw_fetch_info *fetch_info,
+                      const struct draw_prim_info *prim_info)
+{
+   struct llvm_middle_end *fpme = llvm_middle_end(middle);
+   struct draw_vertex_info vert_info;
+
+   assert(fetch_info->count > 0);
+
+   if (!llvm_middle_end_has_variants(fpme))
+      return;
+
+   if (!llvm_alloc_vertices(fpme, fetch_info->count, &vert_info)) {
+      assert(0);
+      return;
+   }
+
+   bool clipped = llvm_run_vs(fpme, fetch_info,
+                              llvm_vertex_id_offset(fpme, fetch_info),
+                              fpme->draw->pt.user.drawid,
+                              vert_info.verts);
+
+   llvm_pipeline_shaded(fpme, &vert_info, prim_info, clipped);
+}
+
+
+static void
+llvm_vs_job_execute(void *data, void *gdata, int thread_index)
+{
+   struct llvm_vs_job *job = (struct llvm_vs_job *) data;
+
+   /* Same as draw_vbo() on the calling thread. */
+   unsigned fpstate = util_fpstate_get();
+   util_fpstate_set_denorms_to_zero(fpstate);
+
+   job->clipped = llvm_run_vs(job->fpme, &job->fetch_info,
+                              job->vertex_id_offset, job->draw_id,
+                              job->vert_info.verts);
+
+   util_fpstate_set(fpstate);
+}
+
+
+/**
+ * Wait for the oldest queued segment and run the rest of the pipeline for
+ * it.
+ */
+static void
+llvm_retire_job(struct llvm_middle_end *fpme)
+{
+   struct llvm_vs_job *job = &fpme->jobs[fpme->first_job];
+
+   assert(fpme->num_jobs > 0);
+
+   util_queue_fence_wait(&job->fence);
+
+   fpme->first_job = (fpme->first_job + 1) % fpme->max_jobs;
+   fpme->num_jobs--;
+
+   llvm_pipeline_shaded(fpme, &job->vert_info, &job->prim_info, job->clipped);
+}
+
+
+static bool
+llvm_job_reserve(void **elts, unsigned *size, unsigned count, size_t elt_size)
+{
+   if (count <= *size)
+      return true;
+
+   void *new_elts = REALLOC(*elts, *size * elt_size, count * elt_size);
+   if (!new_elts)
+      return false;
+
+   *elts = new_elts;
+   *size = count;
+   return true;
+}
+
+
+/**
+ * Queue the vertex shading of a segment on the worker threads, or run the
+ * whole pipeline right away if we aren't batching.
+ */
+static void
+llvm_pipeline_run_or_queue(struct llvm_middle_end *fpme,
+                           const struct draw_fetch_info *fetch_info,
+                           const struct draw_prim_info *prim_info)
+{
+   if (!fpme->batching) {
+      llvm_pipeline_generic(&fpme->base, fetch_info, prim_info);
+      return;
+   }
+
+   assert(fetch_info->count > 0);
+   assert(prim_info->primitive_count == 1);
+
+   if (fpme->num_jobs == fpme->max_jobs)
+      llvm_retire_job(fpme);
+
+   struct llvm_vs_job *job =
+      &fpme->jobs[(fpme->first_job + fpme->num_jobs) % fpme->max_jobs];
+
+   if ((!fetch_info->linear &&
+        !llvm_job_reserve((void **) &job->fetch_elts, &job->fetch_elts_size,
+                          fetch_info->count, sizeof(unsigned))) ||
+       (!prim_info->linear &&
+        !llvm_job_reserve((void **) &job->draw_elts, &job->draw_elts_size,
+                          prim_info->count, sizeof(uint16_t))) ||
+       !llvm_alloc_vertices(fpme, fetch_info->count, &job->vert_info)) {
+      /* Keep the order of the segments. */
+      while (fpme->num_jobs)
+         llvm_retire_job(fpme);
+      llvm_pipeline_generic(&fpme->base, fetch_info, prim_info);
+      return;
+   }
+
+   job->fetch_info = *fetch_info;
+   if (!fetch_info->linear) {
+      memcpy(job->fetch_elts, fetch_info->elts,
+             fetch_info->count * sizeof(unsigned));
+      job->fetch_info.elts = job->fetch_elts;
+   }
+
+   job->prim_info = *prim_info;
+   job->draw_count = prim_info->count;
+   job->prim_info.primitive_lengths = &job->draw_count;
+   if (!prim_info->linear) {
+      memcpy(job->draw_elts, prim_info->elts,
+             prim_info->count * sizeof(uint16_t));
+      job->prim_info.elts = job->draw_elts;
+   }
+
+   job->vertex_id_offset = llvm_vertex_id_offset(fpme, fetch_info);
+   job->draw_id = fpme->draw->pt.user.drawid;
+
+   util_queue_add_job(fpme->queue, job, &job->fence,
+                      llvm_vs_job_execute, NULL, 0);
+   fpme->num_jobs++;
+}
+
+
 static inline enum mesa_prim
 prim_type(enum mesa_prim prim, unsigned flags)
 {
@@ -778,7 +997,7 @@ llvm_middle_end_run(struct draw_pt_middle_end *middle,
    prim_info.primitive_count = 1;
    prim_info.primitive_lengths = &draw_count;
 
-   llvm_pipeline_generic(middle, &fetch_info, &prim_info);
+   llvm_pipeline_run_or_queue(fpme, &fetch_info, &prim_info);
 }
 
 
@@ -806,7 +1025,7 @@ llvm_middle_end_linear_run(struct draw_pt_middle_end *middle,
    prim_info.primitive_count = 1;
    prim_info.primitive_lengths = &count;
 
-   llvm_pipeline_generic(middle, &fetch_info, &prim_info);
+   llvm_pipeline_run_or_queue(fpme, &fetch_info, &prim_info);
 }
 
 
@@ -836,12 +1055,55 @@ llvm_middle_end_linear_run_elts(struct draw_pt_middle_end *middle,
    prim_info.primitive_count = 1;
    prim_info.primitive_lengths = &draw_count;
 
-   llvm_pipeline_generic(middle, &fetch_info, &prim_info);
+   llvm_pipeline_run_or_queue(fpme, &fetch_info, &prim_info);
+
+   return true;
+}
+
+
+/**
+ * Large draws get their vertex shading spread over worker threads, one
+ * vsplit segment at a time.  The segments are emitted in order by the
+ * calling thread as they complete, so the primitive order is kept.
+ */
+static bool
+llvm_middle_end_begin_batch(struct draw_pt_middle_end *middle,
+                            unsigned vertex_count)
+{
+   struct llvm_middle_end *fpme = llvm_middle_end(middle);
+
+   assert(!fpme->batching);
+
+   if (!fpme->draw->pt.num_threads ||
+       vertex_count < LLVM_BATCH_MIN_VERTICES ||
+       !llvm_middle_end_has_variants(fpme))
+      return false;
+
+   fpme->queue = draw_get_worker_queue(fpme->draw);
+   if (!fpme->queue)
+      return false;
+
+   fpme->max_jobs = MIN2(2 * fpme->queue->max_threads, LLVM_BATCH_MAX_JOBS);
+   fpme->first_job = 0;
+   fpme->num_jobs = 0;
+   fpme->batching = true;
 
    return true;
 }
 
 
+static void
+llvm_middle_end_end_batch(struct draw_pt_middle_end *middle)
+{
+   struct llvm_middle_end *fpme = llvm_middle_end(middle);
+
+   while (fpme->num_jobs)
+      llvm_retire_job(fpme);
+
+   fpme->batching = false;
+}
+
+
 static void
 llvm_middle_end_finish(struct draw_pt_middle_end *middle)
 {
@@ -866,6 +1128,12 @@ llvm_middle_end_destroy(struct draw_pt_middle_end *middle)
    if (fpme->post_vs)
       draw_pt_post_vs_destroy(fpme->post_vs);
 
+   for (unsigned i = 0; i < LLVM_BATCH_MAX_JOBS; i++) {
+      util_queue_fence_destroy(&fpme->jobs[i].fence);
+      FREE(fpme->jobs[i].fetch_elts);
+      FREE(fpme->jobs[i].draw_elts);
+   }
+
    FREE(middle);
 }
 
@@ -887,11 +1155,18 @@ draw_pt_fetch_pipeline_or_emit_llvm(struct draw_context *draw)
    fpme->base.run             = llvm_middle_end_run;
    fpme->base.run_linear      = llvm_middle_end_linear_run;
    fpme->base.run_linear_elts = llvm_middle_end_linear_run_elts;
+   fpme->base.begin_batch     = llvm_middle_end_begin_batch;
+   fpme->base.end_batch       = llvm_middle_end_end_batch;
    fpme->base.finish          = llvm_middle_end_finish;
    fpme->base.destroy         = llvm_middle_end_destroy;
 
    fpme->draw = draw;
 
+   for (unsigned i = 0; i < LLVM_BATCH_MAX_JOBS; i++) {
+      fpme->jobs[i].fpme = fpme;
+      util_queue_fence_init(&fpme->jobs[i].fence);
+   }
+
    fpme->fetch = draw_pt_fetch_create(draw);
    if (!fpme->fetch)
       goto fail;
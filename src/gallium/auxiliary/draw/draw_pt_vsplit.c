@@ -23,18 +23,34 @@
  * DEALINGS IN THE SOFTWARE.
  */
 
+#include <inttypes.h>
 #include <stdbool.h>
 
 #include "util/macros.h"
+#include "util/u_debug.h"
 #include "util/u_math.h"
 #include "util/u_memory.h"
+#include "util/u_prim.h"
 
 #include "draw/draw_context.h"
 #include "draw/draw_private.h"
 #include "draw/draw_pt.h"
+#include "draw/draw_vbuf.h"
 
 #define SEGMENT_SIZE 1024
-#define MAP_SIZE     256
+
+/* Indexed lists are split by their unique vertices, which allows for more
+ * draw elements than fetch elements in a segment.
+ */
+#define SEGMENT_DRAW_ELTS (8 * SEGMENT_SIZE)
+
+#define CACHE_WAYS          4
+#define CACHE_DEFAULT_SIZE  512
+#define CACHE_MAX_SIZE      4096
+
+DEBUG_GET_ONCE_NUM_OPTION(vsplit_cache_size, "DRAW_VSPLIT_CACHE_SIZE", CACHE_DEFAULT_SIZE)
+DEBUG_GET_ONCE_BOOL_OPTION(vsplit_split_lists, "DRAW_VSPLIT_SPLIT_LISTS", true)
+DEBUG_GET_ONCE_BOOL_OPTION(vsplit_stats, "DRAW_VSPLIT_STATS", false)
 
 struct vsplit_frontend {
    struct draw_pt_front_end base;
@@ -47,16 +63,27 @@ struct vsplit_frontend {
    unsigned max_vertices;
    uint16_t segment_size;
 
+   /* draw elements per list segment, the emit paths hand them to the
+    * render in one draw_elements call
+    */
+   unsigned max_draw_elts;
+
    /* buffers for splitting */
    unsigned fetch_elts[SEGMENT_SIZE];
-   uint16_t draw_elts[SEGMENT_SIZE];
+   uint16_t draw_elts[SEGMENT_DRAW_ELTS];
    uint16_t identity_draw_elts[SEGMENT_SIZE];
 
+   /* split indexed lists by their unique vertices */
+   bool split_lists;
+
    struct {
-      /* map a fetch element to a draw element */
-      unsigned fetches[MAP_SIZE];
-      uint16_t draws[MAP_SIZE];
-      bool has_max_fetch;
+      /* Set-associative map of fetch elements to draw elements.  An entry
+       * is only a hit if it is below num_fetch_elts and fetch_elts holds
+       * the same fetch element there, so the map never needs clearing.
+       */
+      uint16_t (*sets)[CACHE_WAYS];
+      uint8_t *next_way;
+      unsigned set_shift;
 
       uint16_t num_fetch_elts;
       uint16_t num_draw_elts;
@@ -67,16 +94,32 @@ struct vsplit_frontend {
 static void
 vsplit_clear_cache(struct vsplit_frontend *vsplit)
 {
-   memset(vsplit->cache.fetches, 0xff, sizeof(vsplit->cache.fetches));
-   vsplit->cache.has_max_fetch = false;
    vsplit->cache.num_fetch_elts = 0;
    vsplit->cache.num_draw_elts = 0;
 }
 
 
+static inline void
+vsplit_count(struct vsplit_frontend *vsplit, unsigned num_fetch_elts,
+             unsigned num_draw_elts)
+{
+   struct draw_context *draw = vsplit->draw;
+
+   draw->pt.vertex_cache.fetches += num_fetch_elts;
+   draw->pt.vertex_cache.elements += num_draw_elts;
+   draw->pt.vertex_cache.primitives +=
+      vsplit->prim == MESA_PRIM_PATCHES ?
+      num_draw_elts / MAX2(draw->pt.vertices_per_patch, 1) :
+      u_decomposed_prims_for_vertices(vsplit->prim, num_draw_elts);
+}
+
+
 static void
 vsplit_flush_cache(struct vsplit_frontend *vsplit, unsigned start, unsigned flags)
 {
+   vsplit_count(vsplit, vsplit->cache.num_fetch_elts,
+                vsplit->cache.num_draw_elts);
+
    vsplit->middle->run(vsplit->middle, start,
          vsplit->fetch_elts, vsplit->cache.num_fetch_elts,
          vsplit->draw_elts, vsplit->cache.num_draw_elts, flags);
@@ -89,23 +132,27 @@ vsplit_flush_cache(struct vsplit_frontend *vsplit, unsigned start, unsigned flag
 static inline void
 vsplit_add_cache(struct vsplit_frontend *vsplit, unsigned fetch)
 {
-   unsigned hash;
-
-   hash = fetch % MAP_SIZE;
-
-   /* If the value isn't in the cache or it's an overflow due to the
-    * element bias */
-   if (vsplit->cache.fetches[hash] != fetch) {
-      /* update cache */
-      vsplit->cache.fetches[hash] = fetch;
-      vsplit->cache.draws[hash] = vsplit->cache.num_fetch_elts;
-
-      /* add fetch */
-      assert(vsplit->cache.num_fetch_elts < vsplit->segment_size);
-      vsplit->fetch_elts[vsplit->cache.num_fetch_elts++] = fetch;
+   /* Fibonacci hashing, which spreads strided element orders too. */
+   const unsigned set = (fetch * 2654435769u) >> vsplit->cache.set_shift;
+   uint16_t *ways = vsplit->cache.sets[set];
+   uint16_t draw;
+
+   for (unsigned i = 0; i < CACHE_WAYS; i++) {
+      draw = ways[i];
+      if (draw < vsplit->cache.num_fetch_elts &&
+          vsplit->fetch_elts[draw] == fetch) {
+         vsplit->draw_elts[vsplit->cache.num_draw_elts++] = draw;
+         return;
+      }
    }
 
-   vsplit->draw_elts[vsplit->cache.num_draw_elts++] = vsplit->cache.draws[hash];
+   /* add fetch, replacing the oldest way of the set */
+   assert(vsplit->cache.num_fetch_elts < vsplit->segment_size);
+   draw = vsplit->cache.num_fetch_elts++;
+   vsplit->fetch_elts[draw] = fetch;
+   ways[vsplit->cache.next_way[set]++ % CACHE_WAYS] = draw;
+
+   vsplit->draw_elts[vsplit->cache.num_draw_elts++] = draw;
 }
 
 
@@ -128,12 +175,6 @@ vsplit_add_cache_uint8(struct vsplit_frontend *vsplit, const uint8_t *elts,
    unsigned elt_idx;
    elt_idx = vsplit_get_base_idx(start, fetch);
    elt_idx = (unsigned)((int)(DRAW_GET_IDX(elts, elt_idx)) + elt_bias);
-   /* unlike the uint32_t case this can only happen with elt_bias */
-   if (elt_bias && elt_idx == DRAW_MAX_FETCH_IDX && !vsplit->cache.has_max_fetch) {
-      unsigned hash = elt_idx % MAP_SIZE;
-      vsplit->cache.fetches[hash] = 0;
-      vsplit->cache.has_max_fetch = true;
-   }
    vsplit_add_cache(vsplit, elt_idx);
 }
 
@@ -146,12 +187,6 @@ vsplit_add_cache_uint16(struct vsplit_frontend *vsplit, const uint16_t *elts,
    unsigned elt_idx;
    elt_idx = vsplit_get_base_idx(start, fetch);
    elt_idx = (unsigned)((int)(DRAW_GET_IDX(elts, elt_idx)) + elt_bias);
-   /* unlike the uint32_t case this can only happen with elt_bias */
-   if (elt_bias && elt_idx == DRAW_MAX_FETCH_IDX && !vsplit->cache.has_max_fetch) {
-      unsigned hash = elt_idx % MAP_SIZE;
-      vsplit->cache.fetches[hash] = 0;
-      vsplit->cache.has_max_fetch = true;
-   }
    vsplit_add_cache(vsplit, elt_idx);
 }
 
@@ -171,13 +206,6 @@ vsplit_add_cache_uint32(struct vsplit_frontend *vsplit, const uint32_t *elts,
     */
    elt_idx = vsplit_get_base_idx(start, fetch);
    elt_idx = (unsigned)((int)(DRAW_GET_IDX(elts, elt_idx)) + elt_bias);
-   /* Take care for DRAW_MAX_FETCH_IDX (since cache is initialized to -1). */
-   if (elt_idx == DRAW_MAX_FETCH_IDX && !vsplit->cache.has_max_fetch) {
-      unsigned hash = elt_idx % MAP_SIZE;
-      /* force update - any value will do except DRAW_MAX_FETCH_IDX */
-      vsplit->cache.fetches[hash] = 0;
-      vsplit->cache.has_max_fetch = true;
-   }
    vsplit_add_cache(vsplit, elt_idx);
 }
 
@@ -234,6 +262,12 @@ vsplit_prepare(struct draw_pt_front_end *frontend,
    middle->prepare(middle, vsplit->prim, opt, &vsplit->max_vertices);
 
    vsplit->segment_size = MIN2(SEGMENT_SIZE, vsplit->max_vertices);
+
+   vsplit->max_draw_elts = SEGMENT_DRAW_ELTS;
+   if (vsplit->draw->render) {
+      vsplit->max_draw_elts = MIN2(vsplit->max_draw_elts,
+                                   vsplit->draw->render->max_indices);
+   }
 }
 
 
@@ -252,6 +286,25 @@ vsplit_flush(struct draw_pt_front_end *frontend, unsigned flags)
 static void
 vsplit_destroy(struct draw_pt_front_end *frontend)
 {
+   struct vsplit_frontend *vsplit = (struct vsplit_frontend *) frontend;
+
+   if (debug_get_option_vsplit_stats()) {
+      struct draw_vertex_cache_stats stats;
+
+      draw_get_vertex_cache_stats(vsplit->draw, &stats);
+      if (stats.elements) {
+         debug_printf("draw: %" PRIu64 " vertex shader invocations for "
+                      "%" PRIu64 " elements, %.3f per element, "
+                      "%.3f per primitive\n",
+                      stats.fetches, stats.elements,
+                      (double) stats.fetches / stats.elements,
+                      stats.primitives ?
+                      (double) stats.fetches / stats.primitives : 0.0);
+      }
+   }
+
+   FREE(vsplit->cache.sets);
+   FREE(vsplit->cache.next_way);
    FREE(frontend);
 }
 
@@ -273,5 +326,20 @@ draw_pt_vsplit(struct draw_context *draw)
    for (unsigned i = 0; i < SEGMENT_SIZE; i++)
       vsplit->identity_draw_elts[i] = i;
 
+   /* at least two sets, so that the hash shift is defined */
+   unsigned cache_size = CLAMP(debug_get_option_vsplit_cache_size(),
+                               2 * CACHE_WAYS, CACHE_MAX_SIZE);
+   unsigned num_sets = util_next_power_of_two(cache_size / CACHE_WAYS);
+
+   vsplit->cache.set_shift = 32 - util_logbase2(num_sets);
+   vsplit->cache.sets = CALLOC(num_sets, sizeof(*vsplit->cache.sets));
+   vsplit->cache.next_way = CALLOC(num_sets, sizeof(*vsplit->cache.next_way));
+   if (!vsplit->cache.sets || !vsplit->cache.next_way) {
+      vsplit_destroy(&vsplit->base);
+      return NULL;
+   }
+
+   vsplit->split_lists = debug_get_option_vsplit_split_lists();
+
    return &vsplit->base;
 }
@@ -111,9 +111,13 @@ CONCAT2(vsplit_primitive_, ELT_TYPE)(struct vsplit_frontend *vsplit,
       draw_elts = vsplit->draw_elts;
    }
 
-   return vsplit->middle->run_linear_elts(vsplit->middle,
-                                          fetch_start, fetch_count,
-                                          draw_elts, icount, 0x0);
+   if (!vsplit->middle->run_linear_elts(vsplit->middle,
+                                        fetch_start, fetch_count,
+                                        draw_elts, icount, 0x0))
+      return false;
+
+   vsplit_count(vsplit, fetch_count, icount);
+   return true;
 }
 
 
@@ -203,6 +207,51 @@ CONCAT2(vsplit_segment_fan_, ELT_TYPE)(struct vsplit_frontend *vsplit,
 }
 
 
+/**
+ * Split a list primitive by the number of vertices it fetches instead of
+ * its element count, so that a segment holds as many primitives as its
+ * vertices allow.  With optimized index orders this keeps the clusters of
+ * primitives sharing vertices together instead of cutting them at a fixed
+ * element count.
+ */
+static bool
+CONCAT2(vsplit_segment_list_, ELT_TYPE)(struct vsplit_frontend *vsplit,
+                                        unsigned istart, unsigned icount,
+                                        unsigned incr)
+{
+   struct draw_context *draw = vsplit->draw;
+   const ELT_TYPE *ib = (const ELT_TYPE *) draw->pt.user.elts;
+   const int ibias = draw->pt.user.eltBias;
+   unsigned flags = DRAW_SPLIT_AFTER;
+   unsigned seg_start = 0;
+
+   if (!vsplit->split_lists || incr > vsplit->segment_size ||
+       incr > vsplit->max_draw_elts)
+      return false;
+
+   vsplit_clear_cache(vsplit);
+
+   for (unsigned i = 0; i < icount; i += incr) {
+      /* flush when the next primitive might not fit */
+      if (vsplit->cache.num_fetch_elts + incr > vsplit->segment_size ||
+          vsplit->cache.num_draw_elts + incr > vsplit->max_draw_elts) {
+         vsplit_flush_cache(vsplit, istart + seg_start, flags);
+         vsplit_clear_cache(vsplit);
+         flags |= DRAW_SPLIT_BEFORE;
+         seg_start = i;
+      }
+
+      for (unsigned j = 0; j < incr; j++)
+         ADD_CACHE(vsplit, ib, istart, i + j, ibias);
+   }
+
+   flags &= ~DRAW_SPLIT_AFTER;
+   vsplit_flush_cache(vsplit, istart + seg_start, flags);
+
+   return true;
+}
+
+
 #define LOCAL_VARS                                                         \
    struct vsplit_frontend *vsplit = (struct vsplit_frontend *) frontend;   \
    const enum mesa_prim prim = vsplit->prim;                          \
@@ -213,6 +262,9 @@ CONCAT2(vsplit_segment_fan_, ELT_TYPE)(struct vsplit_frontend *vsplit,
 #define PRIMITIVE(istart, icount)   \
    CONCAT2(vsplit_primitive_, ELT_TYPE)(vsplit, istart, icount)
 
+#define SEGMENT_LIST(istart, icount, incr)   \
+   CONCAT2(vsplit_segment_list_, ELT_TYPE)(vsplit, istart, icount, incr)
+
 #else /* ELT_TYPE */
 
 static void
@@ -220,6 +272,7 @@ vsplit_segment_simple_linear(struct vsplit_frontend *vsplit, unsigned flags,
                              unsigned istart, unsigned icount)
 {
    assert(icount <= vsplit->max_vertices);
+   vsplit_count(vsplit, icount, icount);
    vsplit->middle->run_linear(vsplit->middle, istart, icount, flags);
 }
 
@@ -241,9 +294,11 @@ vsplit_segment_loop_linear(struct vsplit_frontend *vsplit, unsigned flags,
          vsplit->fetch_elts[nr] = istart + nr;
       vsplit->fetch_elts[nr++] = i0;
 
+      vsplit_count(vsplit, nr, nr);
       vsplit->middle->run(vsplit->middle, istart, vsplit->fetch_elts, nr,
             vsplit->identity_draw_elts, nr, flags);
    } else {
+      vsplit_count(vsplit, icount, icount);
       vsplit->middle->run_linear(vsplit->middle, istart, icount, flags);
    }
 }
@@ -264,9 +319,11 @@ vsplit_segment_fan_linear(struct vsplit_frontend *vsplit, unsigned flags,
       for (unsigned i = 1 ; i < icount; i++)
          vsplit->fetch_elts[nr++] = istart + i;
 
+      vsplit_count(vsplit, nr, nr);
       vsplit->middle->run(vsplit->middle, istart, vsplit->fetch_elts, nr,
             vsplit->identity_draw_elts, nr, flags);
    } else {
+      vsplit_count(vsplit, icount, icount);
       vsplit->middle->run_linear(vsplit->middle, istart, icount, flags);
    }
 }
@@ -281,6 +338,8 @@ vsplit_segment_fan_linear(struct vsplit_frontend *vsplit, unsigned flags,
 
 #define PRIMITIVE(istart, icount) false
 
+#define SEGMENT_LIST(istart, icount, incr) false
+
 #define ELT_TYPE linear
 
 #endif /* ELT_TYPE */
@@ -62,6 +62,8 @@ FUNC(FUNC_VARS)
    /* no splitting required */
    if (count <= max_count_simple) {
       SEGMENT_SIMPLE(0x0, start, count);
+   } else if (first == incr && SEGMENT_LIST(start, count, incr)) {
+      /* list primitive, split by its vertices */
    } else {
       const unsigned rollback = first - incr;
       unsigned flags = DRAW_SPLIT_AFTER, seg_start = 0, seg_max;
@@ -171,6 +173,7 @@ FUNC(FUNC_VARS)
 #undef LOCAL_VARS
 
 #undef PRIMITIVE
+#undef SEGMENT_LIST
 #undef SEGMENT_SIMPLE
 #undef SEGMENT_LOOP
 #undef SEGMENT_FAN
@@ -356,22 +356,30 @@ int draw_tess_eval_shader_run(struct draw_tess_eval_shader *shader,
    shader->input_info = input_info;
 
 #if DRAW_LLVM_AVAILABLE
-   struct pipe_tessellation_factors factors;
-   struct pipe_tessellator_data data = { 0 };
-   struct pipe_tessellator *ptess = p_tess_init(shader->prim_mode,
-                                                shader->spacing,
-                                                !shader->vertex_order_cw,
-                                                shader->point_mode);
+   unsigned num_patches = input_prims->primitive_count;
+   struct pipe_tessellation_factors *factors = MALLOC(num_patches * sizeof(*factors));
+   struct pipe_tessellator_data *tess_data = MALLOC(num_patches * sizeof(*tess_data));
+   if (!factors || !tess_data || !shader->tessellator)
+      num_patches = 0;
+
+   for (unsigned i = 0; i < num_patches; i++)
+      llvm_fetch_tess_factors(shader, i, num_input_vertices_per_patch, &factors[i]);
+
+   /* tessellate all the patches up front, patches with the same factors
+    * share their domain points and indices
+    */
+   if (num_patches) {
+      p_tessellate_batch(shader->tessellator,
+                         draw_get_worker_queue(shader->draw),
+                         num_patches, factors, tess_data);
+   }
+
    unsigned first_patch = input_prims->start / shader->draw->pt.vertices_per_patch;
-   for (unsigned i = 0; i < input_prims->primitive_count; i++) {
+   for (unsigned i = 0; i < num_patches; i++) {
       uint32_t vert_start = output_verts->count;
       uint32_t prim_start = output_prims->primitive_count;
       uint32_t elt_start = output_prims->count;
-
-      llvm_fetch_tess_factors(shader, i, num_input_vertices_per_patch, &factors);
-
-      /* tessellate with the factors for this primitive */
-      p_tessellate(ptess, &factors, &data);
+      struct pipe_tessellator_data data = tess_data[i];
 
       if (data.num_domain_points == 0)
          continue;
@@ -395,7 +403,7 @@ int draw_tess_eval_shader_run(struct draw_tess_eval_shader *shader,
       /* run once per primitive? */
       char *output = (char *)output_verts->verts;
       output += vert_start * vertex_size;
-      llvm_tes_run(shader, first_patch + i, num_input_vertices_per_patch, &data, &factors, (struct vertex_header *)output);
+      llvm_tes_run(shader, first_patch + i, num_input_vertices_per_patch, &data, &factors[i], (struct vertex_header *)output);
 
       if (shader->draw->collect_statistics) {
          shader->draw->statistics.ds_invocations += data.num_domain_points;
@@ -414,7 +422,8 @@ int draw_tess_eval_shader_run(struct draw_tess_eval_shader *shader,
          output_prims->primitive_lengths[i] = prim_len;
       }
    }
-   p_tess_destroy(ptess);
+   FREE(factors);
+   FREE(tess_data);
 #endif
 
    *elts_out = elts;
@@ -593,6 +602,11 @@ draw_create_tess_eval_shader(struct draw_context *draw,
       memset(tes->tes_input, 0, sizeof(struct draw_tes_inputs));
 
       tes->jit_resources = &draw->llvm->jit_resources[PIPE_SHADER_TESS_EVAL];
+      if (!draw->tes.tess_pool)
+         draw->tes.tess_pool = p_tess_pool_create();
+      tes->tessellator = p_tess_init(tes->prim_mode, tes->spacing,
+                                     !tes->vertex_order_cw, tes->point_mode,
+                                     draw->tes.tess_pool);
       llvm_tes->variant_key_size =
          draw_tes_llvm_variant_key_size(
                                         tes->info.file_max[TGSI_FILE_SAMPLER]+1,
@@ -634,6 +648,8 @@ void draw_delete_tess_eval_shader(struct draw_context *draw,
 
       assert(shader->variants_cached == 0);
       align_free(dtes->tes_input);
+      if (dtes->tessellator)
+         p_tess_destroy(dtes->tessellator);
    }
 #endif
    if (dtes->state.type == PIPE_SHADER_IR_NIR && dtes->state.ir.nir)
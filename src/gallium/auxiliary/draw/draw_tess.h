@@ -32,6 +32,7 @@
 #include "tgsi/tgsi_scan.h"
 
 struct draw_context;
+struct pipe_tessellator;
 #if DRAW_LLVM_AVAILABLE
 
 #define NUM_PATCH_INPUTS 32
@@ -98,6 +99,7 @@ struct draw_tess_eval_shader {
    struct draw_tes_inputs *tes_input;
    struct lp_jit_resources *jit_resources;
    struct draw_tes_llvm_variant *current_variant;
+   struct pipe_tessellator *tessellator;
 #endif
 };
 
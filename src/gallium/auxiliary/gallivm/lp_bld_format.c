@@ -26,49 +26,520 @@
  **************************************************************************/
 
 
+#include "util/format/u_format.h"
+#include "util/u_math.h"
+#include "util/u_memory.h"
+#include "util/u_pointer.h"
+
+#include "lp_bld_const.h"
+#include "lp_bld_debug.h"
+#include "lp_bld_flow.h"
 #include "lp_bld_format.h"
+#include "lp_bld_intr.h"
+#include "lp_bld_misc.h"
+#include "lp_bld_pack.h"
+#include "lp_bld_struct.h"
+#include "lp_bld_swizzle.h"
+#include "lp_bld_type.h"
+
+
+/**
+ * Create a block cache holding (about) num_blocks decoded blocks.
+ */
+struct lp_build_format_cache *
+lp_build_format_cache_create(unsigned num_blocks)
+{
+   struct lp_build_format_cache *cache;
 
-LLVMTypeRef lp_build_format_cache_elem_type(struct gallivm_state *gallivm, enum cache_member member) {
-   assert(member == LP_BUILD_FORMAT_CACHE_MEMBER_DATA || member == LP_BUILD_FORMAT_CACHE_MEMBER_TAGS);
-   switch (member) {
-   case LP_BUILD_FORMAT_CACHE_MEMBER_DATA:
-      return LLVMInt32TypeInContext(gallivm->context);
-   case LP_BUILD_FORMAT_CACHE_MEMBER_TAGS:
-      return LLVMInt64TypeInContext(gallivm->context);
-   default:
-      unreachable("lp_build_format_cache_elem_type unhandled member type");
+   num_blocks = util_next_power_of_two(MAX2(num_blocks,
+                                            LP_BUILD_FORMAT_CACHE_WAYS));
+
+   cache = CALLOC_STRUCT(lp_build_format_cache);
+   if (!cache)
+      return NULL;
+
+   cache->tags = CALLOC(num_blocks, sizeof *cache->tags);
+   cache->data = align_malloc(num_blocks * 16 * sizeof *cache->data, 16);
+   if (!cache->tags || !cache->data) {
+      lp_build_format_cache_destroy(cache);
+      return NULL;
    }
+
+   cache->set_mask = num_blocks / LP_BUILD_FORMAT_CACHE_WAYS - 1;
+
+   return cache;
+}
+
+
+void
+lp_build_format_cache_destroy(struct lp_build_format_cache *cache)
+{
+   if (!cache)
+      return;
+
+   FREE(cache->tags);
+   align_free(cache->data);
+   FREE(cache);
 }
 
-LLVMTypeRef lp_build_format_cache_member_type(struct gallivm_state *gallivm, enum cache_member member) {
-   assert(member == LP_BUILD_FORMAT_CACHE_MEMBER_DATA || member == LP_BUILD_FORMAT_CACHE_MEMBER_TAGS);
-   unsigned elem_count =
-         member == LP_BUILD_FORMAT_CACHE_MEMBER_DATA ? LP_BUILD_FORMAT_CACHE_SIZE * 16 :
-         member == LP_BUILD_FORMAT_CACHE_MEMBER_TAGS ? LP_BUILD_FORMAT_CACHE_SIZE : 0;
-   return LLVMArrayType(lp_build_format_cache_elem_type(gallivm, member), elem_count);
+
+/**
+ * Invalidate all cached blocks and clear the statistics.
+ *
+ * Needs to be called whenever texture memory may have been rewritten
+ * since the cache was last used.
+ */
+void
+lp_build_format_cache_reset(struct lp_build_format_cache *cache)
+{
+   unsigned num_blocks = (cache->set_mask + 1) * LP_BUILD_FORMAT_CACHE_WAYS;
+
+   memset(cache->tags, 0, num_blocks * sizeof *cache->tags);
+   cache->access_total = 0;
+   cache->access_miss = 0;
+}
+
+
+/**
+ * Whether fetches from this format can go through the block cache.
+ *
+ * That is any 4x4 block compressed format which decodes to rgba8 unorm,
+ * either with one of our own decoders or with the util_format unpack
+ * function.
+ */
+bool
+lp_build_format_cache_supported(const struct util_format_description *format_desc)
+{
+   const struct util_format_unpack_description *unpack;
+
+   if (format_desc->block.width != 4 ||
+       format_desc->block.height != 4 ||
+       format_desc->block.depth != 1)
+      return false;
+
+   if (format_desc->layout == UTIL_FORMAT_LAYOUT_PLAIN ||
+       format_desc->layout == UTIL_FORMAT_LAYOUT_SUBSAMPLED ||
+       !util_format_fits_8unorm(format_desc))
+      return false;
+
+   if (format_desc->layout == UTIL_FORMAT_LAYOUT_S3TC ||
+       format_desc->layout == UTIL_FORMAT_LAYOUT_RGTC)
+      return true;
+
+   unpack = util_format_unpack_description(format_desc->format);
+   return unpack && unpack->unpack_rgba_8unorm_rect;
 }
 
+
 LLVMTypeRef
 lp_build_format_cache_type(struct gallivm_state *gallivm)
 {
    LLVMTypeRef elem_types[LP_BUILD_FORMAT_CACHE_MEMBER_COUNT];
-   LLVMTypeRef s;
+   LLVMTypeRef i32t = LLVMInt32TypeInContext(gallivm->context);
+   LLVMTypeRef i64t = LLVMInt64TypeInContext(gallivm->context);
+
+   elem_types[LP_BUILD_FORMAT_CACHE_MEMBER_TAGS] = LLVMPointerType(i64t, 0);
+   elem_types[LP_BUILD_FORMAT_CACHE_MEMBER_DATA] = LLVMPointerType(i32t, 0);
+   elem_types[LP_BUILD_FORMAT_CACHE_MEMBER_SET_MASK] = i32t;
+   elem_types[LP_BUILD_FORMAT_CACHE_MEMBER_ACCESS_TOTAL] = i64t;
+   elem_types[LP_BUILD_FORMAT_CACHE_MEMBER_ACCESS_MISS] = i64t;
+
+   return LLVMStructTypeInContext(gallivm->context, elem_types,
+                                  LP_BUILD_FORMAT_CACHE_MEMBER_COUNT, 0);
+}
+
+
+static void
+update_cache_access(struct gallivm_state *gallivm,
+                    LLVMValueRef cache,
+                    unsigned count,
+                    enum cache_member member)
+{
+   LLVMBuilderRef builder = gallivm->builder;
+   LLVMTypeRef i64t = LLVMInt64TypeInContext(gallivm->context);
+   LLVMValueRef member_ptr, cache_access;
+
+   assert(member == LP_BUILD_FORMAT_CACHE_MEMBER_ACCESS_TOTAL ||
+          member == LP_BUILD_FORMAT_CACHE_MEMBER_ACCESS_MISS);
+   member_ptr = lp_build_struct_get_ptr2(gallivm,
+                                         lp_build_format_cache_type(gallivm),
+                                         cache, member, "");
+   cache_access = LLVMBuildLoad2(builder, i64t, member_ptr, "cache_access");
+   cache_access = LLVMBuildAdd(builder, cache_access,
+                               LLVMConstInt(i64t, count, 0), "");
+   LLVMBuildStore(builder, cache_access, member_ptr);
+}
+
+
+/**
+ * Decode a whole block with the util_format unpack function.
+ */
+static void
+unpack_block_rgba8(struct gallivm_state *gallivm,
+                   const struct util_format_description *format_desc,
+                   LLVMValueRef ptr,
+                   LLVMValueRef col[4])
+{
+   const struct util_format_unpack_description *unpack =
+      util_format_unpack_description(format_desc->format);
+   LLVMBuilderRef builder = gallivm->builder;
+   LLVMTypeRef i8t = LLVMInt8TypeInContext(gallivm->context);
+   LLVMTypeRef pi8t = LLVMPointerType(i8t, 0);
+   LLVMTypeRef i32t = LLVMInt32TypeInContext(gallivm->context);
+   LLVMTypeRef i32x16t = LLVMVectorType(i32t, 16);
+   LLVMTypeRef function_type;
+   LLVMValueRef function, tmp_ptr, args[6], texels, rows[4];
+
+   /*
+    * Function to call looks like:
+    *   unpack(uint8_t *dst, unsigned dst_stride,
+    *          const uint8_t *src, unsigned src_stride,
+    *          unsigned width, unsigned height)
+    */
+   {
+      LLVMTypeRef arg_types[6];
+
+      arg_types[0] = pi8t;
+      arg_types[1] = i32t;
+      arg_types[2] = pi8t;
+      arg_types[3] = i32t;
+      arg_types[4] = i32t;
+      arg_types[5] = i32t;
+      function_type = LLVMFunctionType(LLVMVoidTypeInContext(gallivm->context),
+                                       arg_types, ARRAY_SIZE(arg_types), 0);
+   }
+
+   if (gallivm->cache)
+      gallivm->cache->dont_cache = true;
+   function = lp_build_const_func_pointer_from_type(gallivm,
+                 func_to_pointer((func_pointer) unpack->unpack_rgba_8unorm_rect),
+                 function_type, format_desc->short_name);
+
+   tmp_ptr = lp_build_alloca(gallivm, i32x16t, "");
+
+   args[0] = LLVMBuildBitCast(builder, tmp_ptr, pi8t, "");
+   args[1] = lp_build_const_int32(gallivm, 16);
+   args[2] = ptr;
+   args[3] = lp_build_const_int32(gallivm, 0);
+   args[4] = lp_build_const_int32(gallivm, 4);
+   args[5] = lp_build_const_int32(gallivm, 4);
+   LLVMBuildCall2(builder, function_type, function, args, ARRAY_SIZE(args), "");
+
+   /* The cache holds blocks column by column. */
+   texels = LLVMBuildLoad2(builder, i32x16t, tmp_ptr, "");
+   for (unsigned k = 0; k < 4; k++)
+      rows[k] = lp_build_extract_range(gallivm, texels, k * 4, 4);
+   lp_build_transpose_aos(gallivm, lp_type_uint_vec(32, 128), rows, col);
+}
+
+
+/**
+ * Decode a whole block into col[0..3], col[i] holding the four texels
+ * of column i as rgba8.
+ */
+static void
+decode_block_rgba8(struct gallivm_state *gallivm,
+                   const struct util_format_description *format_desc,
+                   LLVMValueRef ptr,
+                   LLVMValueRef col[4])
+{
+   if (format_desc->layout == UTIL_FORMAT_LAYOUT_S3TC) {
+      lp_build_s3tc_decode_block(gallivm, format_desc, ptr, col);
+   }
+   else if (format_desc->layout == UTIL_FORMAT_LAYOUT_RGTC) {
+      LLVMBuilderRef builder = gallivm->builder;
+      struct lp_type type = lp_type_int_vec(32, 16 * 32);
+      LLVMValueRef i[16], j[16], rgba;
+
+      for (unsigned k = 0; k < 16; k++) {
+         i[k] = lp_build_const_int32(gallivm, k / 4);
+         j[k] = lp_build_const_int32(gallivm, k % 4);
+      }
 
-   int members[] = {LP_BUILD_FORMAT_CACHE_MEMBER_DATA, LP_BUILD_FORMAT_CACHE_MEMBER_TAGS};
-   for (int i = 0; i < ARRAY_SIZE(members); ++i) {
-      int member = members[i];
-      elem_types[member] = lp_build_format_cache_member_type(gallivm, member);
+      rgba = lp_build_fetch_rgtc_rgba_aos(gallivm, format_desc, 16, ptr,
+                                          lp_build_const_int_vec(gallivm, type, 0),
+                                          LLVMConstVector(i, 16),
+                                          LLVMConstVector(j, 16));
+      rgba = LLVMBuildBitCast(builder, rgba, lp_build_vec_type(gallivm, type), "");
+      for (unsigned k = 0; k < 4; k++)
+         col[k] = lp_build_extract_range(gallivm, rgba, k * 4, 4);
    }
+   else {
+      unpack_block_rgba8(gallivm, format_desc, ptr, col);
+   }
+}
+
+
+static void
+generate_update_cache_one_block(struct gallivm_state *gallivm,
+                                LLVMValueRef function,
+                                const struct util_format_description *format_desc)
+{
+   LLVMBasicBlockRef block;
+   LLVMBuilderRef old_builder, builder;
+   LLVMTypeRef cache_type = lp_build_format_cache_type(gallivm);
+   LLVMTypeRef i32t = LLVMInt32TypeInContext(gallivm->context);
+   LLVMTypeRef i32x4t = LLVMVectorType(i32t, 4);
+   LLVMTypeRef i64t = LLVMInt64TypeInContext(gallivm->context);
+   LLVMValueRef ptr_addr, slot, cache;
+   LLVMValueRef tags, data, tag, row0, row1;
+   LLVMValueRef col[4];
+
+   ptr_addr = LLVMGetParam(function, 0);
+   slot     = LLVMGetParam(function, 1);
+   cache    = LLVMGetParam(function, 2);
+
+   lp_build_name(ptr_addr, "ptr_addr");
+   lp_build_name(slot,     "slot");
+   lp_build_name(cache,    "cache_addr");
+
+   /*
+    * Function body
+    */
+
+   old_builder = gallivm->builder;
+   block = LLVMAppendBasicBlockInContext(gallivm->context, function, "entry");
+   gallivm->builder = LLVMCreateBuilderInContext(gallivm->context);
+   builder = gallivm->builder;
+   LLVMPositionBuilderAtEnd(builder, block);
+
+   tags = lp_build_struct_get2(gallivm, cache_type, cache,
+                               LP_BUILD_FORMAT_CACHE_MEMBER_TAGS, "tags");
+   data = lp_build_struct_get2(gallivm, cache_type, cache,
+                               LP_BUILD_FORMAT_CACHE_MEMBER_DATA, "data");
+
+   /* Demote the block in way 0 to way 1. */
+   tag = lp_build_pointer_get2(builder, i64t, tags, slot);
+   lp_build_pointer_set(builder, tags,
+                        LLVMBuildAdd(builder, slot,
+                                     lp_build_const_int32(gallivm, 1), ""),
+                        tag);
+
+   row0 = LLVMBuildMul(builder, slot, lp_build_const_int32(gallivm, 4), "");
+   row1 = LLVMBuildAdd(builder, row0, lp_build_const_int32(gallivm, 4), "");
+   for (unsigned k = 0; k < 4; k++) {
+      LLVMValueRef index = lp_build_const_int32(gallivm, k);
+      LLVMValueRef src = LLVMBuildAdd(builder, row0, index, "");
+      LLVMValueRef dst = LLVMBuildAdd(builder, row1, index, "");
+      lp_build_pointer_set(builder, data, dst,
+                           lp_build_pointer_get2(builder, i32x4t, data, src));
+   }
+
+   /* And decode the new one into way 0. */
+   decode_block_rgba8(gallivm, format_desc, ptr_addr, col);
+
+   tag = LLVMBuildPtrToInt(builder, ptr_addr, i64t, "");
+   lp_build_pointer_set(builder, tags, slot, tag);
+   for (unsigned k = 0; k < 4; k++) {
+      LLVMValueRef dst = LLVMBuildAdd(builder, row0,
+                                      lp_build_const_int32(gallivm, k), "");
+      lp_build_pointer_set(builder, data, dst, col[k]);
+   }
+
+   LLVMBuildRetVoid(builder);
+
+   LLVMDisposeBuilder(builder);
+   gallivm->builder = old_builder;
+
+   gallivm_verify_function(gallivm, function);
+}
+
+
+static void
+update_cached_block(struct gallivm_state *gallivm,
+                    const struct util_format_description *format_desc,
+                    LLVMValueRef ptr_addr,
+                    LLVMValueRef slot,
+                    LLVMValueRef cache)
+{
+   LLVMBuilderRef builder = gallivm->builder;
+   LLVMModuleRef module = gallivm->module;
+   char name[256];
+   LLVMTypeRef i8t = LLVMInt8TypeInContext(gallivm->context);
+   LLVMTypeRef pi8t = LLVMPointerType(i8t, 0);
+   LLVMValueRef function, inst;
+   LLVMBasicBlockRef bb;
+   LLVMValueRef args[3];
+
+   snprintf(name, sizeof name, "%s_update_cache_one_block",
+            format_desc->short_name);
+   function = LLVMGetNamedFunction(module, name);
+
+   LLVMTypeRef ret_type = LLVMVoidTypeInContext(gallivm->context);
+   LLVMTypeRef arg_types[3];
+   arg_types[0] = pi8t;
+   arg_types[1] = LLVMInt32TypeInContext(gallivm->context);
+   arg_types[2] = LLVMTypeOf(cache);
+   LLVMTypeRef function_type = LLVMFunctionType(ret_type, arg_types, ARRAY_SIZE(arg_types), 0);
+
+   if (!function) {
+      function = LLVMAddFunction(module, name, function_type);
 
-#if LP_BUILD_FORMAT_CACHE_DEBUG
-   elem_types[LP_BUILD_FORMAT_CACHE_MEMBER_ACCESS_TOTAL] =
-         LLVMInt64TypeInContext(gallivm->context);
-   elem_types[LP_BUILD_FORMAT_CACHE_MEMBER_ACCESS_MISS] =
-         LLVMInt64TypeInContext(gallivm->context);
-#endif
+      for (unsigned arg = 0; arg < ARRAY_SIZE(arg_types); ++arg)
+         if (LLVMGetTypeKind(arg_types[arg]) == LLVMPointerTypeKind)
+            lp_add_function_attr(function, arg + 1, LP_FUNC_ATTR_NOALIAS);
+
+      LLVMSetFunctionCallConv(function, LLVMFastCallConv);
+      LLVMSetVisibility(function, LLVMHiddenVisibility);
+      generate_update_cache_one_block(gallivm, function, format_desc);
+   }
+
+   args[0] = ptr_addr;
+   args[1] = slot;
+   args[2] = cache;
+
+   LLVMBuildCall2(builder, function_type, function, args, ARRAY_SIZE(args), "");
+   bb = LLVMGetInsertBlock(builder);
+   inst = LLVMGetLastInstruction(bb);
+   LLVMSetInstructionCallConv(inst, LLVMFastCallConv);
+}
+
+
+/**
+ * Fetch texels through the block cache.
+ *
+ * @param n  number of pixels processed (n=1 or multiples of 4)
+ * @param base_ptr  base pointer of the texture
+ * @param offset <n x i32> vector with the relative offsets of the blocks
+ * @param i  is a <n x i32> vector with the x subpixel coordinate (0..3)
+ * @param j  is a <n x i32> vector with the y subpixel coordinate (0..3)
+ * @param cache  pointer to a lp_build_format_cache
+ * @return  a <4*n x i8> vector with the pixel RGBA values in AoS
+ */
+LLVMValueRef
+lp_build_fetch_cached_texels(struct gallivm_state *gallivm,
+                             const struct util_format_description *format_desc,
+                             unsigned n,
+                             LLVMValueRef base_ptr,
+                             LLVMValueRef offset,
+                             LLVMValueRef i,
+                             LLVMValueRef j,
+                             LLVMValueRef cache)
+{
+   LLVMBuilderRef builder = gallivm->builder;
+   LLVMTypeRef cache_type = lp_build_format_cache_type(gallivm);
+   LLVMTypeRef i8t = LLVMInt8TypeInContext(gallivm->context);
+   LLVMTypeRef i32t = LLVMInt32TypeInContext(gallivm->context);
+   LLVMTypeRef i64t = LLVMInt64TypeInContext(gallivm->context);
+   LLVMValueRef tags, data, set_mask, slot_var;
+   LLVMValueRef addr, block, hash, slot0, ij_index, color;
+   struct lp_type type;
+   struct lp_build_context bld32;
+   unsigned low_bit;
+
+   assert(lp_build_format_cache_supported(format_desc));
+   assert((n == 1) || (n % 4 == 0));
+
+   memset(&type, 0, sizeof type);
+   type.width = 32;
+   type.length = n;
+
+   lp_build_context_init(&bld32, gallivm, type);
+
+   tags = lp_build_struct_get2(gallivm, cache_type, cache,
+                               LP_BUILD_FORMAT_CACHE_MEMBER_TAGS, "tags");
+   data = lp_build_struct_get2(gallivm, cache_type, cache,
+                               LP_BUILD_FORMAT_CACHE_MEMBER_DATA, "data");
+   set_mask = lp_build_struct_get2(gallivm, cache_type, cache,
+                                   LP_BUILD_FORMAT_CACHE_MEMBER_SET_MASK,
+                                   "set_mask");
+
+   /*
+    * The set is picked by a simple hash of the (lower 32 bits of the)
+    * block address: drop the bits within a block, then fold the higher
+    * bits in with xor so that neighbouring rows of blocks don't all land
+    * in the same sets.
+    */
+   low_bit = util_logbase2(format_desc->block.bits / 8);
+   addr = LLVMBuildPtrToInt(builder, base_ptr, i64t, "");
+   block = LLVMBuildPtrToInt(builder, base_ptr, i32t, "");
+   block = lp_build_broadcast_scalar(&bld32, block);
+   block = LLVMBuildAdd(builder, offset, block, "");
+   block = LLVMBuildLShr(builder, block,
+                         lp_build_const_int_vec(gallivm, type, low_bit), "");
+   hash = LLVMBuildXor(builder, block,
+                       LLVMBuildLShr(builder, block,
+                                     lp_build_const_int_vec(gallivm, type, 8), ""), "");
+   hash = LLVMBuildXor(builder, hash,
+                       LLVMBuildLShr(builder, block,
+                                     lp_build_const_int_vec(gallivm, type, 16), ""), "");
+   hash = LLVMBuildAnd(builder, hash,
+                       lp_build_broadcast_scalar(&bld32, set_mask), "");
+   slot0 = LLVMBuildShl(builder, hash,
+                        lp_build_const_int_vec(gallivm, type,
+                                               util_logbase2(LP_BUILD_FORMAT_CACHE_WAYS)), "");
+   ij_index = LLVMBuildShl(builder, i, lp_build_const_int_vec(gallivm, type, 2), "");
+   ij_index = LLVMBuildAdd(builder, ij_index, j, "");
+
+   slot_var = lp_build_alloca(gallivm, i32t, "slot");
+
+   /*
+    * per-element:
+    *    compare address with the tags of both ways of the set
+    *    if neither matches demote way 0, decode the block into way 0
+    *    extract color from cache
+    *    assemble colors
+    */
+   color = bld32.undef;
+   for (unsigned k = 0; k < n; k++) {
+      LLVMValueRef index = lp_build_const_int32(gallivm, k);
+      LLVMValueRef offsetx, slotx, ijx, addrx, tag, cond, colorx;
+      struct lp_build_if_state if_miss, if_way1;
+
+      if (n > 1) {
+         offsetx = LLVMBuildExtractElement(builder, offset, index, "");
+         slotx = LLVMBuildExtractElement(builder, slot0, index, "");
+         ijx = LLVMBuildExtractElement(builder, ij_index, index, "");
+      } else {
+         offsetx = offset;
+         slotx = slot0;
+         ijx = ij_index;
+      }
+
+      addrx = LLVMBuildZExt(builder, offsetx, i64t, "");
+      addrx = LLVMBuildAdd(builder, addrx, addr, "");
+
+      LLVMBuildStore(builder, slotx, slot_var);
+      tag = lp_build_pointer_get2(builder, i64t, tags, slotx);
+      cond = LLVMBuildICmp(builder, LLVMIntNE, tag, addrx, "");
+
+      lp_build_if(&if_miss, gallivm, cond);
+      {
+         LLVMValueRef slot1 = LLVMBuildAdd(builder, slotx,
+                                           lp_build_const_int32(gallivm, 1), "");
+
+         tag = lp_build_pointer_get2(builder, i64t, tags, slot1);
+         cond = LLVMBuildICmp(builder, LLVMIntEQ, tag, addrx, "");
+
+         lp_build_if(&if_way1, gallivm, cond);
+         {
+            LLVMBuildStore(builder, slot1, slot_var);
+         }
+         lp_build_else(&if_way1);
+         {
+            LLVMValueRef ptr_addrx = LLVMBuildIntToPtr(builder, addrx,
+                                                       LLVMPointerType(i8t, 0), "");
+            update_cached_block(gallivm, format_desc, ptr_addrx, slotx, cache);
+            update_cache_access(gallivm, cache, 1,
+                                LP_BUILD_FORMAT_CACHE_MEMBER_ACCESS_MISS);
+         }
+         lp_build_endif(&if_way1);
+      }
+      lp_build_endif(&if_miss);
+
+      slotx = LLVMBuildLoad2(builder, i32t, slot_var, "");
+      slotx = LLVMBuildShl(builder, slotx, lp_build_const_int32(gallivm, 4), "");
+      colorx = lp_build_pointer_get2(builder, i32t, data,
+                                     LLVMBuildAdd(builder, slotx, ijx, ""));
+
+      if (n > 1)
+         color = LLVMBuildInsertElement(builder, color, colorx, index, "");
+      else
+         color = colorx;
+   }
 
-   s = LLVMStructTypeInContext(gallivm->context, elem_types,
-                               LP_BUILD_FORMAT_CACHE_MEMBER_COUNT, 0);
+   update_cache_access(gallivm, cache, n,
+                       LP_BUILD_FORMAT_CACHE_MEMBER_ACCESS_TOTAL);
 
-   return s;
+   return LLVMBuildBitCast(builder, color, LLVMVectorType(i8t, n * 4), "");
 }
@@ -44,49 +44,74 @@ struct lp_type;
 struct lp_build_context;
 
 
-#define LP_BUILD_FORMAT_CACHE_DEBUG 0
 /*
  * Block cache
  *
- * Optional block cache to be used when unpacking big pixel blocks.
- * Must be a power of 2
+ * Optional cache of decoded 4x4 pixel blocks, used when fetching from block
+ * compressed formats.  Every thread sampling textures owns one.
+ *
+ * The cache is 2-way set associative: a block may live in either way of the
+ * set its address hashes to.  On a miss the block in way 0 is moved to way 1
+ * and the new block is decoded into way 0.  The number of sets is chosen at
+ * creation time and read by the generated code, so the same code works with
+ * any cache size.
  */
 
-#define LP_BUILD_FORMAT_CACHE_SIZE 128
+#define LP_BUILD_FORMAT_CACHE_WAYS 2
+
+/** Default number of cached blocks per thread (must be a power of 2) */
+#define LP_BUILD_FORMAT_CACHE_BLOCKS 256
 
 /*
- * Note: cache_data needs 16 byte alignment.
+ * Note: data needs 16 byte alignment.
  */
 struct lp_build_format_cache
 {
-   alignas(16) uint32_t cache_data[LP_BUILD_FORMAT_CACHE_SIZE][4][4];
-   uint64_t cache_tags[LP_BUILD_FORMAT_CACHE_SIZE];
-#if LP_BUILD_FORMAT_CACHE_DEBUG
-   uint64_t cache_access_total;
-   uint64_t cache_access_miss;
-#endif
+   /** block addresses, [num_sets][LP_BUILD_FORMAT_CACHE_WAYS] */
+   uint64_t *tags;
+   /** decoded rgba8 texels, [num_sets][LP_BUILD_FORMAT_CACHE_WAYS][4][4] */
+   uint32_t *data;
+   uint32_t set_mask;
+   /* Statistics, reset with lp_build_format_cache_reset() */
+   uint64_t access_total;
+   uint64_t access_miss;
 };
 
 
 enum cache_member {
-   LP_BUILD_FORMAT_CACHE_MEMBER_DATA = 0,
-   LP_BUILD_FORMAT_CACHE_MEMBER_TAGS,
-#if LP_BUILD_FORMAT_CACHE_DEBUG
+   LP_BUILD_FORMAT_CACHE_MEMBER_TAGS = 0,
+   LP_BUILD_FORMAT_CACHE_MEMBER_DATA,
+   LP_BUILD_FORMAT_CACHE_MEMBER_SET_MASK,
    LP_BUILD_FORMAT_CACHE_MEMBER_ACCESS_TOTAL,
    LP_BUILD_FORMAT_CACHE_MEMBER_ACCESS_MISS,
-#endif
    LP_BUILD_FORMAT_CACHE_MEMBER_COUNT
 };
 
 
-LLVMTypeRef
-lp_build_format_cache_type(struct gallivm_state *gallivm);
+struct lp_build_format_cache *
+lp_build_format_cache_create(unsigned num_blocks);
 
-LLVMTypeRef
-lp_build_format_cache_member_type(struct gallivm_state *gallivm, enum cache_member member);
+void
+lp_build_format_cache_destroy(struct lp_build_format_cache *cache);
+
+void
+lp_build_format_cache_reset(struct lp_build_format_cache *cache);
+
+bool
+lp_build_format_cache_supported(const struct util_format_description *format_desc);
 
 LLVMTypeRef
-lp_build_format_cache_elem_type(struct gallivm_state *gallivm, enum cache_member member);
+lp_build_format_cache_type(struct gallivm_state *gallivm);
+
+LLVMValueRef
+lp_build_fetch_cached_texels(struct gallivm_state *gallivm,
+                             const struct util_format_description *format_desc,
+                             unsigned n,
+                             LLVMValueRef base_ptr,
+                             LLVMValueRef offset,
+                             LLVMValueRef i,
+                             LLVMValueRef j,
+                             LLVMValueRef cache);
 
 /*
  * AoS
@@ -191,8 +216,13 @@ lp_build_fetch_s3tc_rgba_aos(struct gallivm_state *gallivm,
                              LLVMValueRef base_ptr,
                              LLVMValueRef offset,
                              LLVMValueRef i,
-                             LLVMValueRef j,
-                             LLVMValueRef cache);
+                             LLVMValueRef j);
+
+void
+lp_build_s3tc_decode_block(struct gallivm_state *gallivm,
+                           const struct util_format_description *format_desc,
+                           LLVMValueRef ptr,
+                           LLVMValueRef col[4]);
 
 /*
  * RGTC
@@ -205,8 +235,7 @@ lp_build_fetch_rgtc_rgba_aos(struct gallivm_state *gallivm,
                              LLVMValueRef base_ptr,
                              LLVMValueRef offset,
                              LLVMValueRef i,
-                             LLVMValueRef j,
-                             LLVMValueRef cache);
+                             LLVMValueRef j);
 
 /*
  * special float formats
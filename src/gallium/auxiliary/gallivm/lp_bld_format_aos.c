@@ -727,6 +727,50 @@ lp_build_fetch_rgba_aos(struct gallivm_state *gallivm,
       return tmp;
    }
 
+   /*
+    * Block compressed formats, through the decoded block cache
+    */
+
+   if (cache && lp_build_format_cache_supported(format_desc)) {
+      struct lp_type tmp_type;
+      struct lp_build_if_state if_ctx;
+      LLVMValueRef tmp;
+
+      memset(&tmp_type, 0, sizeof tmp_type);
+      tmp_type.width = 8;
+      tmp_type.length = num_pixels * 4;
+      tmp_type.norm = true;
+
+      /* Threads whose cache couldn't be allocated pass a NULL cache, decode
+       * the blocks directly for them.
+       */
+      LLVMValueRef res = lp_build_alloca(gallivm, bld.vec_type, "");
+      lp_build_if(&if_ctx, gallivm, LLVMBuildIsNull(builder, cache, ""));
+      {
+         tmp = lp_build_fetch_rgba_aos(gallivm, format_desc, type, aligned,
+                                       base_ptr, offset, i, j, NULL);
+         LLVMBuildStore(builder, tmp, res);
+      }
+      lp_build_else(&if_ctx);
+      {
+         tmp = lp_build_fetch_cached_texels(gallivm,
+                                            format_desc,
+                                            num_pixels,
+                                            base_ptr,
+                                            offset,
+                                            i, j,
+                                            cache);
+
+         lp_build_conv(gallivm,
+                       tmp_type, type,
+                       &tmp, 1, &tmp, 1);
+         LLVMBuildStore(builder, tmp, res);
+      }
+      lp_build_endif(&if_ctx);
+
+      return LLVMBuildLoad2(builder, bld.vec_type, res, "");
+   }
+
    /*
     * s3tc rgb formats
     */
@@ -745,8 +789,7 @@ lp_build_fetch_rgba_aos(struct gallivm_state *gallivm,
                                          num_pixels,
                                          base_ptr,
                                          offset,
-                                         i, j,
-                                         cache);
+                                         i, j);
 
       lp_build_conv(gallivm,
                     tmp_type, type,
@@ -777,8 +820,7 @@ lp_build_fetch_rgba_aos(struct gallivm_state *gallivm,
                                          num_pixels,
                                          base_ptr,
                                          offset,
-                                         i, j,
-                                         cache);
+                                         i, j);
 
       lp_build_conv(gallivm,
                     tmp_type, type,
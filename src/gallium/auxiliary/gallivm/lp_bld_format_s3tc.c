@@ -1118,94 +1118,6 @@ lp_build_gather_s3tc_simple_scalar(struct gallivm_state *gallivm,
 }
 
 
-static void
-s3tc_store_cached_block(struct gallivm_state *gallivm,
-                        LLVMValueRef *col,
-                        LLVMValueRef tag_value,
-                        LLVMValueRef hash_index,
-                        LLVMValueRef cache)
-{
-   LLVMBuilderRef builder = gallivm->builder;
-   LLVMValueRef ptr, indices[3];
-   LLVMTypeRef type_ptr4x32;
-   unsigned count;
-
-   type_ptr4x32 = LLVMPointerType(LLVMVectorType(LLVMInt32TypeInContext(gallivm->context), 4), 0);
-   indices[0] = lp_build_const_int32(gallivm, 0);
-   indices[1] = lp_build_const_int32(gallivm, LP_BUILD_FORMAT_CACHE_MEMBER_TAGS);
-   indices[2] = hash_index;
-   LLVMTypeRef cache_type = lp_build_format_cache_type(gallivm);
-   ptr = LLVMBuildGEP2(builder, cache_type, cache, indices, ARRAY_SIZE(indices), "");
-   LLVMBuildStore(builder, tag_value, ptr);
-
-   indices[1] = lp_build_const_int32(gallivm, LP_BUILD_FORMAT_CACHE_MEMBER_DATA);
-   hash_index = LLVMBuildMul(builder, hash_index, lp_build_const_int32(gallivm, 16), "");
-   for (count = 0; count < 4; count++) {
-      indices[2] = hash_index;
-      ptr = LLVMBuildGEP2(builder, cache_type, cache, indices, ARRAY_SIZE(indices), "");
-      ptr = LLVMBuildBitCast(builder, ptr, type_ptr4x32, "");
-      LLVMBuildStore(builder, col[count], ptr);
-      hash_index = LLVMBuildAdd(builder, hash_index, lp_build_const_int32(gallivm, 4), "");
-   }
-}
-
-static LLVMValueRef
-lookup_cache_member(struct gallivm_state *gallivm, LLVMValueRef cache, enum cache_member member, LLVMValueRef index) {
-   assert(member == LP_BUILD_FORMAT_CACHE_MEMBER_DATA || member == LP_BUILD_FORMAT_CACHE_MEMBER_TAGS);
-   LLVMBuilderRef builder = gallivm->builder;
-   LLVMValueRef member_ptr, indices[3];
-
-   indices[0] = lp_build_const_int32(gallivm, 0);
-   indices[1] = lp_build_const_int32(gallivm, member);
-   indices[2] = index;
-
-   const char *name =
-         member == LP_BUILD_FORMAT_CACHE_MEMBER_DATA ? "cache_data" :
-         member == LP_BUILD_FORMAT_CACHE_MEMBER_TAGS ? "tag_data" : "";
-
-   member_ptr = LLVMBuildGEP2(builder, lp_build_format_cache_type(gallivm),
-                              cache, indices, ARRAY_SIZE(indices), "cache_gep");
-
-   return LLVMBuildLoad2(builder, lp_build_format_cache_elem_type(gallivm, member), member_ptr, name);
-}
-
-static LLVMValueRef
-s3tc_lookup_cached_pixel(struct gallivm_state *gallivm,
-                         LLVMValueRef cache,
-                         LLVMValueRef index)
-{
-   return lookup_cache_member(gallivm, cache, LP_BUILD_FORMAT_CACHE_MEMBER_DATA, index);
-}
-
-static LLVMValueRef
-s3tc_lookup_tag_data(struct gallivm_state *gallivm,
-                     LLVMValueRef cache,
-                     LLVMValueRef index)
-{
-   return lookup_cache_member(gallivm, cache, LP_BUILD_FORMAT_CACHE_MEMBER_TAGS, index);
-}
-
-#if LP_BUILD_FORMAT_CACHE_DEBUG
-static void
-s3tc_update_cache_access(struct gallivm_state *gallivm,
-                         LLVMValueRef ptr,
-                         unsigned count,
-                         unsigned index)
-{
-   LLVMBuilderRef builder = gallivm->builder;
-   LLVMValueRef member_ptr, cache_access;
-
-   assert(index == LP_BUILD_FORMAT_CACHE_MEMBER_ACCESS_TOTAL ||
-          index == LP_BUILD_FORMAT_CACHE_MEMBER_ACCESS_MISS);
-   LLVMTypeRef cache_type = lp_build_format_cache_type(gallivm);
-   member_ptr = lp_build_struct_get_ptr2(gallivm, cache_type, ptr, index, "");
-   cache_access = LLVMBuildLoad2(builder, LLVMInt64TypeInContext(gallivm->context), member_ptr, "cache_access");
-   cache_access = LLVMBuildAdd(builder, cache_access,
-                               LLVMConstInt(LLVMInt64TypeInContext(gallivm->context), count, 0), "");
-   LLVMBuildStore(builder, cache_access, member_ptr);
-}
-#endif
-
 /** 
  * Calculate 1/3(v1-v0) + v0 and 2*1/3(v1-v0) + v0.
  * The lerp is performed between the first 2 32bit colors
@@ -1911,38 +1823,23 @@ s3tc_decode_block_dxt5(struct gallivm_state *gallivm,
 }
 
 
-static void
-generate_update_cache_one_block(struct gallivm_state *gallivm,
-                                LLVMValueRef function,
-                                const struct util_format_description *format_desc)
+/**
+ * Decode a whole S3TC block, for filling the block cache.
+ *
+ * @param ptr  pointer to the block
+ * @param col  returns the decoded rgba8 texels, col[i] holding column i
+ */
+void
+lp_build_s3tc_decode_block(struct gallivm_state *gallivm,
+                           const struct util_format_description *format_desc,
+                           LLVMValueRef ptr,
+                           LLVMValueRef col[4])
 {
-   LLVMBasicBlockRef block;
-   LLVMBuilderRef old_builder;
-   LLVMValueRef ptr_addr;
-   LLVMValueRef hash_index;
-   LLVMValueRef cache;
-   LLVMValueRef dxt_block, tag_value;
-   LLVMValueRef col[LP_MAX_VECTOR_LENGTH];
-
-   ptr_addr     = LLVMGetParam(function, 0);
-   hash_index   = LLVMGetParam(function, 1);
-   cache        = LLVMGetParam(function, 2);
-
-   lp_build_name(ptr_addr,   "ptr_addr"  );
-   lp_build_name(hash_index, "hash_index");
-   lp_build_name(cache,      "cache_addr");
+   LLVMValueRef dxt_block;
 
-   /*
-    * Function body
-    */
-
-   old_builder = gallivm->builder;
-   block = LLVMAppendBasicBlockInContext(gallivm->context, function, "entry");
-   gallivm->builder = LLVMCreateBuilderInContext(gallivm->context);
-   LLVMPositionBuilderAtEnd(gallivm->builder, block);
+   assert(format_desc->layout == UTIL_FORMAT_LAYOUT_S3TC);
 
-   lp_build_gather_s3tc_simple_scalar(gallivm, format_desc, &dxt_block,
-                                      ptr_addr);
+   lp_build_gather_s3tc_simple_scalar(gallivm, format_desc, &dxt_block, ptr);
 
    switch (format_desc->format) {
    case PIPE_FORMAT_DXT1_RGB:
@@ -1964,198 +1861,6 @@ generate_update_cache_one_block(struct gallivm_state *gallivm,
       s3tc_decode_block_dxt1(gallivm, format_desc->format, dxt_block, col);
       break;
    }
-
-   tag_value = LLVMBuildPtrToInt(gallivm->builder, ptr_addr,
-                                 LLVMInt64TypeInContext(gallivm->context), "");
-   s3tc_store_cached_block(gallivm, col, tag_value, hash_index, cache);
-
-   LLVMBuildRetVoid(gallivm->builder);
-
-   LLVMDisposeBuilder(gallivm->builder);
-   gallivm->builder = old_builder;
-
-   gallivm_verify_function(gallivm, function);
-}
-
-
-static void
-update_cached_block(struct gallivm_state *gallivm,
-                    const struct util_format_description *format_desc,
-                    LLVMValueRef ptr_addr,
-                    LLVMValueRef hash_index,
-                    LLVMValueRef cache)
-
-{
-   LLVMBuilderRef builder = gallivm->builder;
-   LLVMModuleRef module = gallivm->module;
-   char name[256];
-   LLVMTypeRef i8t = LLVMInt8TypeInContext(gallivm->context);
-   LLVMTypeRef pi8t = LLVMPointerType(i8t, 0);
-   LLVMValueRef function, inst;
-   LLVMBasicBlockRef bb;
-   LLVMValueRef args[3];
-
-   snprintf(name, sizeof name, "%s_update_cache_one_block",
-            format_desc->short_name);
-   function = LLVMGetNamedFunction(module, name);
-
-   LLVMTypeRef ret_type = LLVMVoidTypeInContext(gallivm->context);
-   LLVMTypeRef arg_types[3];
-   arg_types[0] = pi8t;
-   arg_types[1] = LLVMInt32TypeInContext(gallivm->context);
-   arg_types[2] = LLVMTypeOf(cache); // XXX: put right type here
-   LLVMTypeRef function_type = LLVMFunctionType(ret_type, arg_types, ARRAY_SIZE(arg_types), 0);
-
-   if (!function) {
-      function = LLVMAddFunction(module, name, function_type);
-
-      for (unsigned arg = 0; arg < ARRAY_SIZE(arg_types); ++arg)
-         if (LLVMGetTypeKind(arg_types[arg]) == LLVMPointerTypeKind)
-            lp_add_function_attr(function, arg + 1, LP_FUNC_ATTR_NOALIAS);
-
-      LLVMSetFunctionCallConv(function, LLVMFastCallConv);
-      LLVMSetVisibility(function, LLVMHiddenVisibility);
-      generate_update_cache_one_block(gallivm, function, format_desc);
-   }
-
-   args[0] = ptr_addr;
-   args[1] = hash_index;
-   args[2] = cache;
- 
-   LLVMBuildCall2(builder, function_type, function, args, ARRAY_SIZE(args), "");
-   bb = LLVMGetInsertBlock(builder);
-   inst = LLVMGetLastInstruction(bb);
-   LLVMSetInstructionCallConv(inst, LLVMFastCallConv);
-}
-
-/*
- * cached lookup
- */
-static LLVMValueRef
-compressed_fetch_cached(struct gallivm_state *gallivm,
-                        const struct util_format_description *format_desc,
-                        unsigned n,
-                        LLVMValueRef base_ptr,
-                        LLVMValueRef offset,
-                        LLVMValueRef i,
-                        LLVMValueRef j,
-                        LLVMValueRef cache)
-
-{
-   LLVMBuilderRef builder = gallivm->builder;
-   unsigned count, low_bit, log2size;
-   LLVMValueRef color, offset_stored, addr, ptr_addrtrunc, tmp;
-   LLVMValueRef ij_index, hash_index, hash_mask, block_index;
-   LLVMTypeRef i8t = LLVMInt8TypeInContext(gallivm->context);
-   LLVMTypeRef i32t = LLVMInt32TypeInContext(gallivm->context);
-   LLVMTypeRef i64t = LLVMInt64TypeInContext(gallivm->context);
-   struct lp_type type;
-   struct lp_build_context bld32;
-   memset(&type, 0, sizeof type);
-   type.width = 32;
-   type.length = n;
-
-   lp_build_context_init(&bld32, gallivm, type);
-
-   /*
-    * compute hash - we use direct mapped cache, the hash function could
-    *                be better but it needs to be simple
-    * per-element:
-    *    compare offset with offset stored at tag (hash)
-    *    if not equal extract block, store block, update tag
-    *    extract color from cache
-    *    assemble colors
-    */
-
-   low_bit = util_logbase2(format_desc->block.bits / 8);
-   log2size = util_logbase2(LP_BUILD_FORMAT_CACHE_SIZE);
-   addr = LLVMBuildPtrToInt(builder, base_ptr, i64t, "");
-   ptr_addrtrunc = LLVMBuildPtrToInt(builder, base_ptr, i32t, "");
-   ptr_addrtrunc = lp_build_broadcast_scalar(&bld32, ptr_addrtrunc);
-   /* For the hash function, first mask off the unused lowest bits. Then just
-      do some xor with address bits - only use lower 32bits */
-   ptr_addrtrunc = LLVMBuildAdd(builder, offset, ptr_addrtrunc, "");
-   ptr_addrtrunc = LLVMBuildLShr(builder, ptr_addrtrunc,
-                                 lp_build_const_int_vec(gallivm, type, low_bit), "");
-   /* This only really makes sense for size 64,128,256 */
-   hash_index = ptr_addrtrunc;
-   ptr_addrtrunc = LLVMBuildLShr(builder, ptr_addrtrunc,
-                                 lp_build_const_int_vec(gallivm, type, 2*log2size), "");
-   hash_index = LLVMBuildXor(builder, ptr_addrtrunc, hash_index, "");
-   tmp = LLVMBuildLShr(builder, hash_index,
-                       lp_build_const_int_vec(gallivm, type, log2size), "");
-   hash_index = LLVMBuildXor(builder, hash_index, tmp, "");
-
-   hash_mask = lp_build_const_int_vec(gallivm, type, LP_BUILD_FORMAT_CACHE_SIZE - 1);
-   hash_index = LLVMBuildAnd(builder, hash_index, hash_mask, "");
-   ij_index = LLVMBuildShl(builder, i, lp_build_const_int_vec(gallivm, type, 2), "");
-   ij_index = LLVMBuildAdd(builder, ij_index, j, "");
-   block_index = LLVMBuildShl(builder, hash_index,
-                              lp_build_const_int_vec(gallivm, type, 4), "");
-   block_index = LLVMBuildAdd(builder, ij_index, block_index, "");
-
-   if (n > 1) {
-      color = bld32.undef;
-      for (count = 0; count < n; count++) {
-         LLVMValueRef index, cond, colorx;
-         LLVMValueRef block_indexx, hash_indexx, addrx, offsetx, ptr_addrx;
-         struct lp_build_if_state if_ctx;
-
-         index = lp_build_const_int32(gallivm, count);
-         offsetx = LLVMBuildExtractElement(builder, offset, index, "");
-         addrx = LLVMBuildZExt(builder, offsetx, i64t, "");
-         addrx = LLVMBuildAdd(builder, addrx, addr, "");
-         block_indexx = LLVMBuildExtractElement(builder, block_index, index, "");
-         hash_indexx = LLVMBuildLShr(builder, block_indexx,
-                                     lp_build_const_int32(gallivm, 4), "");
-         offset_stored = s3tc_lookup_tag_data(gallivm, cache, hash_indexx);
-         cond = LLVMBuildICmp(builder, LLVMIntNE, offset_stored, addrx, "");
-
-         lp_build_if(&if_ctx, gallivm, cond);
-         {
-            ptr_addrx = LLVMBuildIntToPtr(builder, addrx,
-                                          LLVMPointerType(i8t, 0), "");
-            update_cached_block(gallivm, format_desc, ptr_addrx, hash_indexx, cache);
-#if LP_BUILD_FORMAT_CACHE_DEBUG
-            s3tc_update_cache_access(gallivm, cache, 1,
-                                     LP_BUILD_FORMAT_CACHE_MEMBER_ACCESS_MISS);
-#endif
-         }
-         lp_build_endif(&if_ctx);
-
-         colorx = s3tc_lookup_cached_pixel(gallivm, cache, block_indexx);
-
-         color = LLVMBuildInsertElement(builder, color, colorx,
-                                        lp_build_const_int32(gallivm, count), "");
-      }
-   }
-   else {
-      LLVMValueRef cond;
-      struct lp_build_if_state if_ctx;
-
-      tmp = LLVMBuildZExt(builder, offset, i64t, "");
-      addr = LLVMBuildAdd(builder, tmp, addr, "");
-      offset_stored = s3tc_lookup_tag_data(gallivm, cache, hash_index);
-      cond = LLVMBuildICmp(builder, LLVMIntNE, offset_stored, addr, "");
-
-      lp_build_if(&if_ctx, gallivm, cond);
-      {
-         tmp = LLVMBuildIntToPtr(builder, addr, LLVMPointerType(i8t, 0), "");
-         update_cached_block(gallivm, format_desc, tmp, hash_index, cache);
-#if LP_BUILD_FORMAT_CACHE_DEBUG
-         s3tc_update_cache_access(gallivm, cache, 1,
-                                  LP_BUILD_FORMAT_CACHE_MEMBER_ACCESS_MISS);
-#endif
-      }
-      lp_build_endif(&if_ctx);
-
-      color = s3tc_lookup_cached_pixel(gallivm, cache, block_index);
-   }
-#if LP_BUILD_FORMAT_CACHE_DEBUG
-   s3tc_update_cache_access(gallivm, cache, n,
-                            LP_BUILD_FORMAT_CACHE_MEMBER_ACCESS_TOTAL);
-#endif
-   return LLVMBuildBitCast(builder, color, LLVMVectorType(i8t, n * 4), "");
 }
 
 
@@ -2191,8 +1896,7 @@ lp_build_fetch_s3tc_rgba_aos(struct gallivm_state *gallivm,
                              LLVMValueRef base_ptr,
                              LLVMValueRef offset,
                              LLVMValueRef i,
-                             LLVMValueRef j,
-                             LLVMValueRef cache)
+                             LLVMValueRef j)
 {
    LLVMValueRef rgba;
    LLVMTypeRef i8t = LLVMInt8TypeInContext(gallivm->context);
@@ -2205,11 +1909,6 @@ lp_build_fetch_s3tc_rgba_aos(struct gallivm_state *gallivm,
    assert((n == 1) || (n % 4 == 0));
 
 /*   debug_printf("format = %d\n", format_desc->format);*/
-   if (cache) {
-      rgba = compressed_fetch_cached(gallivm, format_desc, n,
-                                     base_ptr, offset, i, j, cache);
-      return rgba;
-   }
 
    /*
     * Could use n > 8 here with avx2, but doesn't seem faster.
@@ -2556,8 +2255,7 @@ lp_build_fetch_rgtc_rgba_aos(struct gallivm_state *gallivm,
                              LLVMValueRef base_ptr,
                              LLVMValueRef offset,
                              LLVMValueRef i,
-                             LLVMValueRef j,
-                             LLVMValueRef cache)
+                             LLVMValueRef j)
 {
    LLVMValueRef rgba;
    LLVMTypeRef i8t = LLVMInt8TypeInContext(gallivm->context);
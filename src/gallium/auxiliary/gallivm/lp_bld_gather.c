@@ -381,6 +381,72 @@ lp_build_gather_avx2(struct gallivm_state *gallivm,
 }
 
 
+/**
+ * 16-wide gather of 32bit elements for AVX-512.
+ *
+ * Unlike the AVX2 gathers above this goes through the generic masked
+ * gather intrinsic, which LLVM lowers to vpgatherdd/vgatherdps with a
+ * mask register when targeting AVX-512.
+ */
+static LLVMValueRef
+lp_build_gather_avx512(struct gallivm_state *gallivm,
+                       unsigned length,
+                       unsigned src_width,
+                       struct lp_type dst_type,
+                       LLVMValueRef base_ptr,
+                       LLVMValueRef offsets)
+{
+   LLVMBuilderRef builder = gallivm->builder;
+   LLVMTypeRef i1_type = LLVMInt1TypeInContext(gallivm->context);
+   LLVMTypeRef i8_type = LLVMInt8TypeInContext(gallivm->context);
+   LLVMTypeRef src_type, src_vec_type;
+   struct lp_type res_type = dst_type;
+   char intrinsic[64];
+
+   assert(src_width == 32 && length == 16);
+   res_type.length *= length;
+
+   if (dst_type.floating) {
+      src_type = LLVMFloatTypeInContext(gallivm->context);
+   } else {
+      src_type = LLVMIntTypeInContext(gallivm->context, src_width);
+   }
+   src_vec_type = LLVMVectorType(src_type, length);
+
+   assert(LLVMTypeOf(base_ptr) == LLVMPointerType(i8_type, 0));
+
+   /* offsets are in bytes */
+   LLVMValueRef src_ptrs = LLVMBuildGEP2(builder, i8_type, base_ptr,
+                                         &offsets, 1, "");
+
+#if LLVM_VERSION_MAJOR >= 16
+   snprintf(intrinsic, sizeof intrinsic, "llvm.masked.gather.v%u%s%u.v%up0",
+            length, dst_type.floating ? "f" : "i", src_width, length);
+#else
+   src_ptrs = LLVMBuildBitCast(builder, src_ptrs,
+                               LLVMVectorType(LLVMPointerType(src_type, 0),
+                                              length), "");
+   snprintf(intrinsic, sizeof intrinsic,
+            "llvm.masked.gather.v%u%s%u.v%up0%s%u",
+            length, dst_type.floating ? "f" : "i", src_width, length,
+            dst_type.floating ? "f" : "i", src_width);
+#endif
+
+   LLVMValueRef args[] = {
+      src_ptrs,
+      lp_build_const_int32(gallivm, src_width / 8),
+      LLVMConstAllOnes(LLVMVectorType(i1_type, length)),
+      LLVMGetUndef(src_vec_type),
+   };
+
+   LLVMValueRef res = lp_build_intrinsic(builder, intrinsic, src_vec_type,
+                                         args, ARRAY_SIZE(args), 0);
+
+   return LLVMBuildBitCast(builder, res,
+                           lp_build_vec_type(gallivm, res_type), "");
+}
+
+
 /**
  * Gather elements from scatter positions in memory into a single vector.
  * Use for fetching texels from a texture.
@@ -503,6 +569,10 @@ lp_build_gather(struct gallivm_state *gallivm,
               src_width == 64 && (length == 2 || length == 4)) {
       return lp_build_gather_avx2(gallivm, length, src_width, dst_type,
                                   base_ptr, offsets);
+   } else if (util_get_cpu_caps()->has_avx512f && !need_expansion &&
+              src_width == 32 && length == 16) {
+      return lp_build_gather_avx512(gallivm, length, src_width, dst_type,
+                                    base_ptr, offsets);
    } else {
       /* Vector */
 
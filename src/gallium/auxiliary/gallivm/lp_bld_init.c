@@ -65,21 +65,14 @@ enum LLVM_CodeGenOpt_Level {
 
 /**
  * Create the LLVM (optimization) pass manager and install
- * relevant optimization passes.
+ * relevant optimization passes for the module's tier.
  * \return  TRUE for success, FALSE for failure
  */
 static bool
 create_pass_manager(struct gallivm_state *gallivm)
 {
-   {
-      char *td_str;
-      // New ones from the Module.
-      td_str = LLVMCopyStringRepOfTargetData(gallivm->target);
-      LLVMSetDataLayout(gallivm->module, td_str);
-      free(td_str);
-   }
-
-   return lp_passmgr_create(gallivm->module, &gallivm->passmgr);
+   return lp_passmgr_create(gallivm->module, gallivm->opt_tier,
+                            &gallivm->passmgr);
 }
 
 /**
@@ -159,6 +152,9 @@ init_gallivm_engine(struct gallivm_state *gallivm)
       if (gallivm_perf & GALLIVM_PERF_NO_OPT) {
          optlevel = None;
       }
+      else if (gallivm->opt_tier == GALLIVM_OPT_TIER_FAST) {
+         optlevel = Less;
+      }
       else {
          optlevel = Default;
       }
@@ -169,6 +165,7 @@ init_gallivm_engine(struct gallivm_state *gallivm)
                                                     gallivm->module,
                                                     gallivm->memorymgr,
                                                     (unsigned) optlevel,
+                                                    gallivm->opt_tier == GALLIVM_OPT_TIER_FAST,
                                                     &error);
       if (ret) {
          _debug_printf("%s\n", error);
@@ -290,8 +287,13 @@ init_gallivm_state(struct gallivm_state *gallivm, const char *name,
       }
    }
 
-   if (!create_pass_manager(gallivm))
-      goto fail;
+   {
+      char *td_str;
+      // New ones from the Module.
+      td_str = LLVMCopyStringRepOfTargetData(gallivm->target);
+      LLVMSetDataLayout(gallivm->module, td_str);
+      free(td_str);
+   }
 
    if (gallivm_debug & GALLIVM_DEBUG_SYMBOLS)
       gallivm->di_builder = LLVMCreateDIBuilder(gallivm->module);
@@ -376,8 +378,10 @@ gallivm_add_global_mapping(struct gallivm_state *gallivm, LLVMValueRef sym, void
 /**
  * Compile a module.
  * This does IR optimization on all functions in the module.
+ * \return  false if no execution engine could be created for the module, in
+ *          which case gallivm_jit_function() returns NULL for its functions
  */
-void
+bool
 gallivm_compile_module(struct gallivm_state *gallivm)
 {
    assert(!gallivm->compiled);
@@ -395,9 +399,8 @@ gallivm_compile_module(struct gallivm_state *gallivm)
 
    LLVMSetDataLayout(gallivm->module, "");
    assert(!gallivm->engine);
-   if (!init_gallivm_engine(gallivm)) {
-      assert(0);
-   }
+   if (!init_gallivm_engine(gallivm))
+      return false;
    assert(gallivm->engine);
 
    if (gallivm->cache && gallivm->cache->data_size) {
@@ -420,10 +423,20 @@ gallivm_compile_module(struct gallivm_state *gallivm)
                    "[-mattr=<-mattr option(s)>]");
    }
 
-   lp_passmgr_run(gallivm->passmgr,
-                  gallivm->module,
-                  LLVMGetExecutionEngineTargetMachine(gallivm->engine),
-                  gallivm->module_name);
+   /* The pass manager is only created now, modules loaded from the shader
+    * cache don't need one.  Without it the module still gets compiled, just
+    * not optimized.
+    */
+   if (create_pass_manager(gallivm)) {
+      lp_passmgr_run(gallivm->passmgr,
+                     gallivm->module,
+                     LLVMGetExecutionEngineTargetMachine(gallivm->engine),
+                     gallivm->module_name);
+   } else {
+      _debug_printf("gallivm: failed to create the pass manager, "
+                    "compiling %s without optimizations\n",
+                    gallivm->module_name);
+   }
 
    /* Setting the module's DataLayout to an empty string will cause the
     * ExecutionEngine to copy to the DataLayout string from its target machine
@@ -484,6 +497,8 @@ gallivm_compile_module(struct gallivm_state *gallivm)
       }
    }
 #endif
+
+   return true;
 }
 
 
@@ -496,7 +511,9 @@ gallivm_jit_function(struct gallivm_state *gallivm,
    func_pointer jit_func;
    int64_t time_begin = 0;
 
-   assert(gallivm->compiled);
+   /* Compilation failed, see gallivm_compile_module(). */
+   if (!gallivm->compiled)
+      return NULL;
    assert(gallivm->engine);
 
    if (gallivm_debug & GALLIVM_DEBUG_PERF)
@@ -70,6 +70,10 @@ struct gallivm_state
    LLVMBuilderRef builder;
    LLVMDIBuilderRef di_builder;
    struct lp_cached_code *cache;
+   /* Set before gallivm_compile_module() to trade code quality for
+    * compile time.
+    */
+   enum gallivm_opt_tier opt_tier;
    unsigned compiled;
    LLVMValueRef coro_malloc_hook;
    LLVMValueRef coro_free_hook;
@@ -117,7 +121,7 @@ gallivm_add_global_mapping(struct gallivm_state *gallivm, LLVMValueRef sym, void
  * module and any structure associated to it should be avoided,
  * as module has been moved into ORCJIT and may be recycled
  */
-void
+bool
 gallivm_compile_module(struct gallivm_state *gallivm);
 
 func_pointer
@@ -304,10 +304,19 @@ void lpjit_exit()
    delete LPJit::jit;
 }
 
+/* The IR passes run when the module gets materialized, which is the only
+ * place the tier is known, see gallivm_compile_module().
+ */
+#define LP_FAST_TIER_FLAG "lp.fast_tier"
+
 LLVMErrorRef module_transform(void *Ctx, LLVMModuleRef mod) {
    struct lp_passmgr *mgr;
+   enum gallivm_opt_tier tier =
+      LLVMGetModuleFlag(mod, LP_FAST_TIER_FLAG, strlen(LP_FAST_TIER_FLAG)) ?
+      GALLIVM_OPT_TIER_FAST : GALLIVM_OPT_TIER_FULL;
 
-   lp_passmgr_create(mod, &mgr);
+   if (!lp_passmgr_create(mod, tier, &mgr))
+      return LLVMErrorSuccess;
 
    lp_passmgr_run(mgr, mod,
                   LPJit::get_instance()->tm,
@@ -633,7 +642,7 @@ gallivm_add_global_mapping(struct gallivm_state *gallivm, LLVMValueRef sym, void
    LPJit::add_mapping_to_jd(sym, addr, gallivm->_per_module_jd);
 }
 
-void
+bool
 gallivm_compile_module(struct gallivm_state *gallivm)
 {
    lp_init_printf_hook(gallivm);
@@ -646,6 +655,16 @@ gallivm_compile_module(struct gallivm_state *gallivm)
 
    lp_build_coro_add_malloc_hooks(gallivm);
 
+   /* The target machine is shared by all modules, so only the IR passes
+    * depend on the tier.
+    */
+   if (gallivm->opt_tier == GALLIVM_OPT_TIER_FAST) {
+      LLVMTypeRef int32_type = LLVMInt32TypeInContext(gallivm->context);
+      LLVMAddModuleFlag(gallivm->module, LLVMModuleFlagBehaviorOverride,
+                        LP_FAST_TIER_FLAG, strlen(LP_FAST_TIER_FLAG),
+                        LLVMValueAsMetadata(LLVMConstInt(int32_type, 1, 0)));
+   }
+
    LPJit::add_ir_module_to_jd(gallivm->_ts_context, gallivm->module,
       gallivm->_per_module_jd);
    /* ownership of module is now transferred into orc jit,
@@ -663,6 +682,7 @@ gallivm_compile_module(struct gallivm_state *gallivm)
       LPJit::set_object_cache(objcache);
    }
    /* defer compilation till first lookup by gallivm_jit_function */
+   return true;
 }
 
 func_pointer
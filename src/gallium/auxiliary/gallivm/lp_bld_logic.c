@@ -350,6 +350,18 @@ lp_build_select(struct lp_build_context *bld,
 
       res = LLVMBuildSelect(builder, mask, a, b, "");
    }
+   else if (util_get_cpu_caps()->has_avx512f &&
+            type.width * type.length == 512 &&
+            type.width >= 32) {
+      /* AVX-512 has no blendv, but compares write mask registers, which
+       * masked moves (vpblendmd/vpblendmq) take directly.  The mask is
+       * either all zeros or all ones per element, so testing for non-zero
+       * is a single vptestm.
+       */
+      mask = LLVMBuildICmp(builder, LLVMIntNE, mask,
+                           LLVMConstNull(LLVMTypeOf(mask)), "");
+      res = LLVMBuildSelect(builder, mask, a, b, "");
+   }
    else if (((util_get_cpu_caps()->has_sse4_1 &&
               type.width * type.length == 128) ||
              (util_get_cpu_caps()->has_avx &&
@@ -480,6 +480,7 @@ lp_build_create_jit_compiler_for_module(LLVMExecutionEngineRef *OutJIT,
                                         LLVMModuleRef M,
                                         LLVMMCJITMemoryManagerRef CMM,
                                         unsigned OptLevel,
+                                        bool FastISel,
                                         char **OutError)
 {
    using namespace llvm;
@@ -495,6 +496,10 @@ lp_build_create_jit_compiler_for_module(LLVMExecutionEngineRef *OutJIT,
 #if DETECT_ARCH_X86 && LLVM_VERSION_MAJOR < 13
    options.StackAlignmentOverride = 4;
 #endif
+   /* Instruction selection dominates the codegen time, the fast selector
+    * falls back to the DAG one for whatever it can't handle.
+    */
+   options.EnableFastISel = FastISel;
 
    builder.setEngineKind(EngineKind::JIT)
           .setErrorStr(&Error)
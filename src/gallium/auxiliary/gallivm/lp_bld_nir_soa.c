@@ -4570,7 +4570,10 @@ visit_barrier(struct lp_build_nir_soa_context *bld,
       LLVMAtomicOrdering ordering = LLVMAtomicOrderingSequentiallyConsistent;
       LLVMBuildFence(builder, ordering, false, "");
    }
-   if (exec_scope != SCOPE_NONE) {
+   /* Without a coroutine the workgroup is a single subgroup, which is
+    * always in sync with itself.
+    */
+   if (exec_scope != SCOPE_NONE && bld->coro && bld->coro->suspend) {
       LLVMBasicBlockRef resume = lp_build_insert_new_block(gallivm, "resume");
 
       lp_build_coro_suspend_switch(gallivm, bld->coro, resume, false);
@@ -4773,6 +4776,9 @@ static void visit_shuffle(struct lp_build_nir_soa_context *bld,
       /* freeze `src` in case inactive invocations contain poison */
       src = LLVMBuildFreeze(builder, src, "");
       result[0] = lp_build_intrinsic_binary(builder, "llvm.x86.avx2.permd", int_bld->vec_type, src, index);
+   } else if (util_get_cpu_caps()->has_avx512f && bit_size == 32 && index_bit_size == 32 && int_bld->type.length == 16) {
+      src = LLVMBuildFreeze(builder, src, "");
+      result[0] = lp_build_intrinsic_binary(builder, "llvm.x86.avx512.permvar.si.512", int_bld->vec_type, src, index);
    } else {
       LLVMValueRef res_store = lp_build_alloca(gallivm, int_bld->vec_type, "");
       struct lp_build_loop_state loop_state;
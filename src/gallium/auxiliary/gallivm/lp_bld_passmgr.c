@@ -56,26 +56,37 @@
 #include <llvm-c/Transforms/Coroutines.h>
 #endif
 
-#if USE_NEW_PASS == 0
 struct lp_passmgr {
+#if USE_NEW_PASS == 0
    LLVMPassManagerRef passmgr;
 #if HAVE_CORO == 1
    LLVMPassManagerRef cgpassmgr;
 #endif
-};
-#else
-struct lp_passmgr;
 #endif
+   enum gallivm_opt_tier tier;
+};
+
+/*
+ * Most modules don't use coroutines since only some compute shaders need
+ * them, so the coroutine lowering can be skipped for them.
+ */
+static bool
+lp_module_has_coroutines(LLVMModuleRef module)
+{
+   return LLVMGetNamedFunction(module, "llvm.coro.id") != NULL;
+}
 
 bool
-lp_passmgr_create(LLVMModuleRef module, struct lp_passmgr **mgr_p)
+lp_passmgr_create(LLVMModuleRef module, enum gallivm_opt_tier tier,
+                  struct lp_passmgr **mgr_p)
 {
-   struct lp_passmgr *mgr = NULL;
-#if USE_NEW_PASS == 0
-   mgr = CALLOC_STRUCT(lp_passmgr);
+   struct lp_passmgr *mgr = CALLOC_STRUCT(lp_passmgr);
    if (!mgr)
       return false;
 
+   mgr->tier = tier;
+
+#if USE_NEW_PASS == 0
    mgr->passmgr = LLVMCreateFunctionPassManagerForModule(module);
    if (!mgr->passmgr) {
       free(mgr);
@@ -101,7 +112,18 @@ lp_passmgr_create(LLVMModuleRef module, struct lp_passmgr **mgr_p)
    LLVMAddCoroElidePass(mgr->cgpassmgr);
 #endif
 
-   if ((gallivm_perf & GALLIVM_PERF_NO_OPT) == 0) {
+   if (gallivm_perf & GALLIVM_PERF_NO_OPT) {
+      /* We need at least this pass to prevent the backends to fail in
+       * unexpected ways.
+       */
+      LLVMAddPromoteMemoryToRegisterPass(mgr->passmgr);
+   }
+   else if (tier == GALLIVM_OPT_TIER_FAST) {
+      LLVMAddScalarReplAggregatesPass(mgr->passmgr);
+      LLVMAddEarlyCSEPass(mgr->passmgr);
+      LLVMAddCFGSimplificationPass(mgr->passmgr);
+   }
+   else {
       /*
        * TODO: Evaluate passes some more - keeping in mind
        * both quality of generated code and compile times.
@@ -132,12 +154,6 @@ lp_passmgr_create(LLVMModuleRef module, struct lp_passmgr **mgr_p)
       LLVMAddInstructionCombiningPass(mgr->passmgr);
       LLVMAddGVNPass(mgr->passmgr);
    }
-   else {
-      /* We need at least this pass to prevent the backends to fail in
-       * unexpected ways.
-       */
-      LLVMAddPromoteMemoryToRegisterPass(mgr->passmgr);
-   }
 #if HAVE_CORO == 1
    LLVMAddCoroCleanupPass(mgr->passmgr);
 #endif
@@ -161,29 +177,34 @@ lp_passmgr_run(struct lp_passmgr *mgr,
    char passes[1024];
    passes[0] = 0;
 
+   LLVMPassBuilderOptionsRef opts = LLVMCreatePassBuilderOptions();
+
    /*
     * there should be some way to combine these two pass runs but I'm not seeing it,
     * at the time of writing.
     */
-   strcpy(passes, "default<O0>");
-
-   LLVMPassBuilderOptionsRef opts = LLVMCreatePassBuilderOptions();
-   LLVMRunPasses(module, passes, tm, opts);
+   if (lp_module_has_coroutines(module)) {
+      strcpy(passes, "default<O0>");
+      LLVMRunPasses(module, passes, tm, opts);
+   }
 
-   if (!(gallivm_perf & GALLIVM_PERF_NO_OPT))
+   if (gallivm_perf & GALLIVM_PERF_NO_OPT)
+      strcpy(passes, "mem2reg");
+   else if (mgr->tier == GALLIVM_OPT_TIER_FAST)
+      strcpy(passes, "sroa,early-cse,simplifycfg");
+   else
 #if LLVM_VERSION_MAJOR >= 18
       strcpy(passes, "sroa,early-cse,simplifycfg,reassociate,mem2reg,instsimplify,instcombine<no-verify-fixpoint>");
 #else
       strcpy(passes, "sroa,early-cse,simplifycfg,reassociate,mem2reg,instsimplify,instcombine");
 #endif
-   else
-      strcpy(passes, "mem2reg");
 
    LLVMRunPasses(module, passes, tm, opts);
    LLVMDisposePassBuilderOptions(opts);
 #else
 #if HAVE_CORO == 1
-   LLVMRunPassManager(mgr->cgpassmgr, module);
+   if (lp_module_has_coroutines(module))
+      LLVMRunPassManager(mgr->cgpassmgr, module);
 #endif
    /* Run optimization passes */
    LLVMInitializeFunctionPassManager(mgr->passmgr);
@@ -230,6 +251,6 @@ lp_passmgr_dispose(struct lp_passmgr *mgr)
       mgr->cgpassmgr = NULL;
    }
 #endif
-   FREE(mgr);
 #endif
+   FREE(mgr);
 }
@@ -38,10 +38,17 @@ extern "C" {
 struct lp_passmgr;
 
 /*
- * mgr can be returned as NULL for modern pass mgr handling
- * so use a bool to denote success/fail.
+ * How much time to spend optimizing a module.  The fast tier only runs the
+ * cheap IR passes and uses fast instruction selection, for code which is
+ * cheap to execute or only used until a fully optimized version is ready.
  */
-bool lp_passmgr_create(LLVMModuleRef module, struct lp_passmgr **mgr);
+enum gallivm_opt_tier {
+   GALLIVM_OPT_TIER_FULL = 0,
+   GALLIVM_OPT_TIER_FAST,
+};
+
+bool lp_passmgr_create(LLVMModuleRef module, enum gallivm_opt_tier tier,
+                       struct lp_passmgr **mgr);
 void lp_passmgr_run(struct lp_passmgr *mgr,
                     LLVMModuleRef module,
                     LLVMTargetMachineRef tm,
@@ -132,6 +132,7 @@ lp_sampler_static_texture_state(struct lp_static_texture_state *state,
    state->tiled = !!(texture->flags & PIPE_RESOURCE_FLAG_SPARSE);
    if (state->tiled)
       state->tiled_samples = texture->nr_samples;
+   state->micro_tiled = !!(texture->flags & LP_RESOURCE_FLAG_MICRO_TILED);
 
    /*
     * the layer / element / level parameters are all either dynamic
@@ -179,6 +180,7 @@ lp_sampler_static_texture_state_image(struct lp_static_texture_state *state,
       if (view->u.tex.is_2d_view_of_3d)
          state->target = PIPE_TEXTURE_2D;
    }
+   state->micro_tiled = !!(resource->flags & LP_RESOURCE_FLAG_MICRO_TILED);
 
    /*
     * the layer / element / level parameters are all either dynamic
@@ -2236,6 +2238,64 @@ lp_build_sample_offset(struct lp_build_context *bld,
 
 
 
+/**
+ * Compute the offset of a texel in a micro tiled texture.
+ *
+ * The texture is made of LP_MICRO_TILE_SIZE x LP_MICRO_TILE_SIZE texel
+ * tiles stored row-major, with texels row-major inside each tile, so that
+ * a whole 2x2 filter footprint usually sits in one tile (a single cache
+ * line for 32bpp formats).  y_stride is the stride between rows of tiles.
+ * Only formats with 1x1 blocks can be micro tiled.
+ */
+void
+lp_build_micro_tiled_sample_offset(struct lp_build_context *bld,
+                                   const struct util_format_description *format_desc,
+                                   LLVMValueRef x,
+                                   LLVMValueRef y,
+                                   LLVMValueRef z,
+                                   LLVMValueRef y_stride,
+                                   LLVMValueRef z_stride,
+                                   LLVMValueRef *out_offset,
+                                   LLVMValueRef *out_i,
+                                   LLVMValueRef *out_j)
+{
+   struct gallivm_state *gallivm = bld->gallivm;
+   LLVMBuilderRef builder = gallivm->builder;
+   const unsigned texel_size = format_desc->block.bits / 8;
+   LLVMValueRef tile_shift =
+      lp_build_const_int_vec(gallivm, bld->type,
+                             util_logbase2(LP_MICRO_TILE_SIZE));
+   LLVMValueRef tile_mask =
+      lp_build_const_int_vec(gallivm, bld->type, LP_MICRO_TILE_SIZE - 1);
+   LLVMValueRef tile, sub, offset;
+
+   assert(format_desc->block.width == 1 && format_desc->block.height == 1);
+
+   tile = LLVMBuildLShr(builder, x, tile_shift, "");
+   sub = LLVMBuildAnd(builder, x, tile_mask, "");
+   offset = lp_build_mul_imm(bld, tile, texel_size * LP_MICRO_TILE_SIZE *
+                                        LP_MICRO_TILE_SIZE);
+   offset = lp_build_add(bld, offset, lp_build_mul_imm(bld, sub, texel_size));
+
+   if (y && y_stride) {
+      tile = LLVMBuildLShr(builder, y, tile_shift, "");
+      sub = LLVMBuildAnd(builder, y, tile_mask, "");
+      offset = lp_build_add(bld, offset, lp_build_mul(bld, tile, y_stride));
+      offset = lp_build_add(bld, offset,
+                            lp_build_mul_imm(bld, sub,
+                                             texel_size * LP_MICRO_TILE_SIZE));
+   }
+
+   if (z && z_stride) {
+      offset = lp_build_add(bld, offset, lp_build_mul(bld, z, z_stride));
+   }
+
+   *out_offset = offset;
+   *out_i = bld->zero;
+   *out_j = bld->zero;
+}
+
+
 void
 lp_build_tiled_sample_offset(struct lp_build_context *bld,
                              enum pipe_format format,
@@ -49,6 +49,16 @@ extern "C" {
 
 #define LP_MAX_TEXEL_BUFFER_ELEMENTS 134217728
 
+/**
+ * Textures with this resource flag store their texels in
+ * LP_MICRO_TILE_SIZE x LP_MICRO_TILE_SIZE blocks rather than in linear rows,
+ * see lp_build_micro_tiled_sample_offset().  The bit sits well above the
+ * private flags other drivers use, since they may reach gallivm sampling
+ * through draw.
+ */
+#define LP_RESOURCE_FLAG_MICRO_TILED (PIPE_RESOURCE_FLAG_DRV_PRIV << 12)
+#define LP_MICRO_TILE_SIZE 4
+
 struct util_format_description;
 struct lp_type;
 struct lp_build_context;
@@ -220,6 +230,7 @@ struct lp_static_texture_state
    unsigned level_zero_only:1;
    unsigned tiled:1;
    unsigned tiled_samples:5;
+   unsigned micro_tiled:1;
 };
 
 
@@ -782,6 +793,19 @@ lp_build_sample_offset(struct lp_build_context *bld,
                        LLVMValueRef *out_j);
 
 
+void
+lp_build_micro_tiled_sample_offset(struct lp_build_context *bld,
+                                   const struct util_format_description *format_desc,
+                                   LLVMValueRef x,
+                                   LLVMValueRef y,
+                                   LLVMValueRef z,
+                                   LLVMValueRef y_stride,
+                                   LLVMValueRef z_stride,
+                                   LLVMValueRef *out_offset,
+                                   LLVMValueRef *out_i,
+                                   LLVMValueRef *out_j);
+
+
 void
 lp_build_tiled_sample_offset(struct lp_build_context *bld,
                              enum pipe_format format,
@@ -192,6 +192,11 @@ lp_build_sample_texel_soa(struct lp_build_sample_context *bld,
                                    bld->static_texture_state,
                                    x, y, z, width, height, z_stride,
                                    &offset, &i, &j);
+   } else if (bld->static_texture_state->micro_tiled) {
+      lp_build_micro_tiled_sample_offset(&bld->int_coord_bld,
+                                         bld->format_desc,
+                                         x, y, z, y_stride, z_stride,
+                                         &offset, &i, &j);
    } else {
       lp_build_sample_offset(&bld->int_coord_bld,
                              bld->format_desc,
@@ -3030,6 +3035,11 @@ lp_build_fetch_texel(struct lp_build_sample_context *bld,
                                    bld->static_texture_state,
                                    x, y, z, width, height, img_stride_vec,
                                    &offset, &i, &j);
+   } else if (bld->static_texture_state->micro_tiled) {
+      lp_build_micro_tiled_sample_offset(int_coord_bld,
+                                         bld->format_desc,
+                                         x, y, z, row_stride_vec, img_stride_vec,
+                                         &offset, &i, &j);
    } else {
       lp_build_sample_offset(int_coord_bld,
                              bld->format_desc,
@@ -3574,7 +3584,8 @@ lp_build_sample_soa_code(struct gallivm_state *gallivm,
                  derived_sampler_state.min_img_filter ==
                     derived_sampler_state.mag_img_filter;
 
-      use_aos &= !static_texture_state->tiled;
+      use_aos &= !static_texture_state->tiled &&
+                 !static_texture_state->micro_tiled;
 
       if (gallivm_perf & GALLIVM_PERF_NO_AOS_SAMPLING) {
          use_aos = 0;
@@ -3919,8 +3930,8 @@ lp_build_sample_gen_func(struct gallivm_state *gallivm,
 
    if (dynamic_state->cache_ptr) {
       const struct util_format_description *format_desc;
-      format_desc = util_format_description(static_texture_state->format);
-      if (format_desc->layout == UTIL_FORMAT_LAYOUT_S3TC) {
+      format_desc = util_format_description(util_format_linear(static_texture_state->format));
+      if (lp_build_format_cache_supported(format_desc)) {
          need_cache = true;
       }
    }
@@ -4042,8 +4053,8 @@ lp_build_sample_soa_func(struct gallivm_state *gallivm,
    bool need_cache = false;
    if (dynamic_state->cache_ptr) {
       const struct util_format_description *format_desc;
-      format_desc = util_format_description(static_texture_state->format);
-      if (format_desc->layout == UTIL_FORMAT_LAYOUT_S3TC) {
+      format_desc = util_format_description(util_format_linear(static_texture_state->format));
+      if (lp_build_format_cache_supported(format_desc)) {
          need_cache = true;
       }
    }
@@ -4781,6 +4792,11 @@ lp_build_img_op_soa(const struct lp_static_texture_state *static_texture_state,
                                    static_texture_state,
                                    x, y, z, width, height, img_stride_vec,
                                    &offset, &i, &j);
+   } else if (static_texture_state->micro_tiled) {
+      lp_build_micro_tiled_sample_offset(&int_coord_bld,
+                                         format_desc,
+                                         x, y, z, row_stride_vec, img_stride_vec,
+                                         &offset, &i, &j);
    } else {
       lp_build_sample_offset(&int_coord_bld,
                              format_desc,
@@ -23,16 +23,52 @@
  *
  **************************************************************************/
 
+#include "util/hash_table.h"
+#include "util/u_dynarray.h"
 #include "util/u_math.h"
 #include "util/u_memory.h"
+#include "util/u_queue.h"
 #include "pipe/p_defines.h"
 #include "p_tessellator.h"
 #include "tessellator.hpp"
 
 #include <new>
 
+/* The cache is emptied at the start of a call once it grows past this, and
+ * stops growing within a call once it does.
+ */
+#define P_TESS_CACHE_MAX_SIZE (16 * 1024 * 1024)
+
+/* Topologies generated at once, the cache budget is checked in between. */
+#define P_TESS_MAX_MISSES 64
+
+/* Topologies generated by each thread of a batch. */
+#define P_TESS_MIN_BLOCK_SIZE 8
+
+/* The TES reads the domain points a whole vector at a time. */
+#define P_TESS_POINT_ALIGN 16
+
 namespace pipe_tessellator_wrap
 {
+   /// Tessellation factors after the clamping and rounding done by the
+   /// tessellator, patches with the same key have the same topology.
+   struct topology_key
+   {
+      float tf[6];
+   };
+
+   /// Domain points and indices of a tessellated patch
+   struct topology
+   {
+      struct topology_key key;
+      uint32_t num_domain_points;
+      uint32_t num_indices;
+      float    *domain_points_u;
+      float    *domain_points_v;
+      uint32_t *indices;
+      size_t   size;
+   };
+
    /// Wrapper class for the CHWTessellator reference tessellator from MSFT
    /// This class will store data not originally stored in CHWTessellator
    class pipe_ts : private CHWTessellator
@@ -40,9 +76,6 @@ namespace pipe_tessellator_wrap
    private:
       typedef CHWTessellator SUPER;
       enum mesa_prim    prim_mode;
-      alignas(32) float      domain_points_u[MAX_POINT_COUNT];
-      alignas(32) float      domain_points_v[MAX_POINT_COUNT];
-      uint32_t               num_domain_points;
 
    public:
       void Init(enum mesa_prim tes_prim_mode,
@@ -69,36 +102,32 @@ namespace pipe_tessellator_wrap
                      out_prim);
 
          prim_mode          = tes_prim_mode;
-         num_domain_points = 0;
       }
 
-      void Tessellate(const struct pipe_tessellation_factors *tess_factors,
-                      struct pipe_tessellator_data *tess_data)
+      /// Tessellate the patch of the key and copy the result into the
+      /// topology, nothing else is touched so that the tessellators of a
+      /// batch can run on different threads.
+      void Generate(struct topology *topo)
       {
+         const float *tf = topo->key.tf;
+
+         topo->num_domain_points = 0;
+         topo->num_indices = 0;
+         topo->size = 0;
+
          switch (prim_mode)
             {
             case MESA_PRIM_QUADS:
-               SUPER::TessellateQuadDomain(
-                                           tess_factors->outer_tf[0],
-                                           tess_factors->outer_tf[1],
-                                           tess_factors->outer_tf[2],
-                                           tess_factors->outer_tf[3],
-                                           tess_factors->inner_tf[0],
-                                           tess_factors->inner_tf[1]);
+               SUPER::TessellateQuadDomain(tf[0], tf[1], tf[2], tf[3],
+                                           tf[4], tf[5]);
                break;
 
             case MESA_PRIM_TRIANGLES:
-               SUPER::TessellateTriDomain(
-                                          tess_factors->outer_tf[0],
-                                          tess_factors->outer_tf[1],
-                                          tess_factors->outer_tf[2],
-                                          tess_factors->inner_tf[0]);
+               SUPER::TessellateTriDomain(tf[0], tf[1], tf[2], tf[3]);
                break;
 
             case MESA_PRIM_LINES:
-               SUPER::TessellateIsoLineDomain(
-                                              tess_factors->outer_tf[0],
-                                              tess_factors->outer_tf[1]);
+               SUPER::TessellateIsoLineDomain(tf[0], tf[1]);
                break;
 
             default:
@@ -106,38 +135,560 @@ namespace pipe_tessellator_wrap
                return;
             }
 
-         num_domain_points = (uint32_t)SUPER::GetPointCount();
+         uint32_t num_domain_points = (uint32_t)SUPER::GetPointCount();
+         uint32_t num_indices = (uint32_t)SUPER::GetIndexCount();
+         uint32_t padded_points = align(num_domain_points, P_TESS_POINT_ALIGN);
+         size_t size = 2 * padded_points * sizeof(float) +
+                       num_indices * sizeof(uint32_t);
+
+         char *mem = (char *)align_malloc(MAX2(size, 1), 64);
+         if (!mem)
+            return;
+
+         topo->domain_points_u = (float *)mem;
+         topo->domain_points_v = topo->domain_points_u + padded_points;
+         topo->indices = (uint32_t *)(topo->domain_points_v + padded_points);
 
          DOMAIN_POINT *points = SUPER::GetPoints();
          for (uint32_t i = 0; i < num_domain_points; i++) {
-            domain_points_u[i] = points[i].u;
-            domain_points_v[i] = points[i].v;
+            topo->domain_points_u[i] = points[i].u;
+            topo->domain_points_v[i] = points[i].v;
+         }
+         for (uint32_t i = num_domain_points; i < padded_points; i++) {
+            topo->domain_points_u[i] = 0.0f;
+            topo->domain_points_v[i] = 0.0f;
+         }
+         memcpy(topo->indices, SUPER::GetIndices(), num_indices * sizeof(uint32_t));
+
+         topo->num_domain_points = num_domain_points;
+         topo->num_indices = num_indices;
+         topo->size = size;
+      }
+   };
+
+   static pipe_ts *
+   create_ts(enum mesa_prim tes_prim_mode,
+             enum pipe_tess_spacing spacing,
+             bool tes_vertex_order_cw, bool tes_point_mode)
+   {
+      void *mem = align_malloc(sizeof(pipe_ts), 256);
+      if (!mem)
+         return NULL;
+
+      pipe_ts *ts = new (mem) pipe_ts();
+      ts->Init(tes_prim_mode, spacing, tes_vertex_order_cw, tes_point_mode);
+      return ts;
+   }
+
+   static void
+   destroy_ts(pipe_ts *ts)
+   {
+      ts->~pipe_ts();
+      align_free(ts);
+   }
+
+   static uint32_t
+   topology_key_hash(const void *key)
+   {
+      return _mesa_hash_data(key, sizeof(struct topology_key));
+   }
+
+   static bool
+   topology_key_equal(const void *a, const void *b)
+   {
+      return memcmp(a, b, sizeof(struct topology_key)) == 0;
+   }
+
+   /// Clamp a factor the way the tessellator does, NaN goes to the lower
+   /// bound.
+   static inline float
+   clamp_tf(float tf, float lower, float upper, bool integer)
+   {
+      tf = tf >= lower ? MIN2(tf, upper) : lower;
+      return integer ? ceilf(tf) : tf;
+   }
+
+   struct tess_block
+   {
+      struct util_queue_fence fence;
+      pipe_ts **workers;
+      struct topology **topos;
+      unsigned count;
+   };
+
+   static void
+   tess_block_execute(void *data, void *gdata, int thread_index)
+   {
+      struct tess_block *block = (struct tess_block *)data;
+      pipe_ts *ts = block->workers[thread_index];
+
+      for (unsigned i = 0; i < block->count; i++)
+         ts->Generate(block->topos[i]);
+   }
+
+   class pipe_tess_ctx;
+
+   /// Worker tessellators and cache budget shared by tessellation contexts.
+   struct tess_pool
+   {
+      unsigned refcount;
+
+      /// Bytes cached by all the contexts.
+      size_t cache_size;
+      struct util_dynarray contexts;
+
+      /// One tessellator per queue thread, set to the mode of the context
+      /// before each batch.
+      unsigned num_workers;
+      pipe_ts **workers;
+      struct tess_block *blocks;
+   };
+
+   static struct tess_pool *
+   tess_pool_create()
+   {
+      struct tess_pool *pool = CALLOC_STRUCT(tess_pool);
+      if (!pool)
+         return NULL;
+
+      pool->refcount = 1;
+      util_dynarray_init(&pool->contexts, NULL);
+      return pool;
+   }
+
+   static void
+   tess_pool_release(struct tess_pool *pool)
+   {
+      if (--pool->refcount)
+         return;
+
+      assert(!util_dynarray_num_elements(&pool->contexts, pipe_tess_ctx *));
+
+      for (unsigned i = 0; i < pool->num_workers; i++)
+         destroy_ts(pool->workers[i]);
+      FREE(pool->workers);
+      FREE(pool->blocks);
+      util_dynarray_fini(&pool->contexts);
+      FREE(pool);
+   }
+
+   static bool
+   tess_pool_reserve_workers(struct tess_pool *pool, unsigned count)
+   {
+      if (count <= pool->num_workers)
+         return true;
+
+      pipe_ts **workers =
+         (pipe_ts **)REALLOC(pool->workers,
+                             pool->num_workers * sizeof(*workers),
+                             count * sizeof(*workers));
+      if (!workers)
+         return false;
+      pool->workers = workers;
+
+      struct tess_block *blocks =
+         (struct tess_block *)REALLOC(pool->blocks,
+                                      (pool->num_workers + 1) * sizeof(*blocks),
+                                      (count + 1) * sizeof(*blocks));
+      if (!blocks)
+         return false;
+      pool->blocks = blocks;
+
+      while (pool->num_workers < count) {
+         pipe_ts *ts = create_ts(MESA_PRIM_TRIANGLES, PIPE_TESS_SPACING_EQUAL,
+                                 false, false);
+         if (!ts)
+            return false;
+         pool->workers[pool->num_workers++] = ts;
+      }
+
+      return true;
+   }
+
+   static void
+   tess_pool_clear_caches(struct tess_pool *pool);
+
+   static void
+   tess_pool_free_transient(struct tess_pool *pool);
+
+   /// Tessellator with a cache of the topologies generated for each set of
+   /// factors, the topologies missing from it are also generated by the
+   /// worker tessellators of its pool.
+   class pipe_tess_ctx
+   {
+   private:
+      pipe_ts ts;
+      enum mesa_prim prim_mode;
+      enum pipe_tess_spacing spacing;
+      bool vertex_order_cw;
+      bool point_mode;
+
+      struct hash_table *topologies;
+      size_t cache_size;
+      /// Topologies generated past the cache budget, in topologies only
+      /// until the next call with a context of the pool.
+      struct util_dynarray transient;
+      struct util_dynarray misses;
+      struct util_dynarray results;
+
+      struct tess_pool *pool;
+
+      /// Quantize the factors of a patch, returns false if it is culled.
+      bool QuantizeFactors(const struct pipe_tessellation_factors *factors,
+                           struct topology_key *key)
+      {
+         float lower, upper;
+         bool integer = false;
+
+         switch (spacing) {
+         case PIPE_TESS_SPACING_EQUAL:
+            lower = PIPE_TESSELLATOR_MIN_ODD_TESSELLATION_FACTOR;
+            upper = PIPE_TESSELLATOR_MAX_EVEN_TESSELLATION_FACTOR;
+            integer = true;
+            break;
+         case PIPE_TESS_SPACING_FRACTIONAL_EVEN:
+            lower = PIPE_TESSELLATOR_MIN_EVEN_TESSELLATION_FACTOR;
+            upper = PIPE_TESSELLATOR_MAX_EVEN_TESSELLATION_FACTOR;
+            break;
+         case PIPE_TESS_SPACING_FRACTIONAL_ODD:
+         default:
+            lower = PIPE_TESSELLATOR_MIN_ODD_TESSELLATION_FACTOR;
+            upper = PIPE_TESSELLATOR_MAX_ODD_TESSELLATION_FACTOR;
+            break;
+         }
+
+         unsigned num_outer, num_inner;
+         switch (prim_mode) {
+         case MESA_PRIM_QUADS:
+            num_outer = 4;
+            num_inner = 2;
+            break;
+         case MESA_PRIM_TRIANGLES:
+            num_outer = 3;
+            num_inner = 1;
+            break;
+         case MESA_PRIM_LINES:
+            num_outer = 2;
+            num_inner = 0;
+            break;
+         default:
+            return false;
+         }
+
+         /* A patch is culled if an outer factor isn't positive, NaN
+          * included.
+          */
+         for (unsigned i = 0; i < num_outer; i++) {
+            if (!(factors->outer_tf[i] > 0.0f))
+               return false;
+         }
+
+         memset(key, 0, sizeof(*key));
+
+         if (prim_mode == MESA_PRIM_LINES) {
+            /* The line density always uses integer spacing. */
+            key->tf[0] = clamp_tf(factors->outer_tf[0],
+                                  PIPE_TESSELLATOR_MIN_ISOLINE_DENSITY_TESSELLATION_FACTOR,
+                                  PIPE_TESSELLATOR_MAX_ISOLINE_DENSITY_TESSELLATION_FACTOR,
+                                  true);
+            key->tf[1] = clamp_tf(factors->outer_tf[1], lower, upper, integer);
+            return true;
+         }
+
+         /* Clamping the inner factors with the usual bounds is fine with
+          * fractional odd spacing too, the tessellator still sees which of
+          * them are above one.
+          */
+         for (unsigned i = 0; i < num_outer; i++)
+            key->tf[i] = clamp_tf(factors->outer_tf[i], lower, upper, integer);
+         for (unsigned i = 0; i < num_inner; i++)
+            key->tf[num_outer + i] = clamp_tf(factors->inner_tf[i], lower, upper, integer);
+
+         return true;
+      }
+
+      static void FreeTopology(struct topology *topo)
+      {
+         if (topo->size)
+            align_free(topo->domain_points_u);
+         FREE(topo);
+      }
+
+      void ClearCache()
+      {
+         hash_table_foreach(topologies, entry)
+            FreeTopology((struct topology *)entry->data);
+         _mesa_hash_table_clear(topologies, NULL);
+         util_dynarray_clear(&transient);
+         pool->cache_size -= cache_size;
+         cache_size = 0;
+      }
+
+      void FreeTransient()
+      {
+         util_dynarray_foreach(&transient, struct topology *, topo) {
+            _mesa_hash_table_remove_key(topologies, &(*topo)->key);
+            FreeTopology(*topo);
+         }
+         util_dynarray_clear(&transient);
+      }
+
+      /// Generate the topologies missing from the cache, in blocks on the
+      /// worker threads and the calling thread if there are enough of them.
+      /// They are only kept for the current call if cache is false.
+      void GenerateMisses(struct util_queue *queue, bool cache)
+      {
+         struct topology **topos = (struct topology **)util_dynarray_begin(&misses);
+         unsigned count = util_dynarray_num_elements(&misses, struct topology *);
+         struct tess_block *blocks = NULL;
+
+         unsigned block_count = 1;
+         if (queue && count >= 2 * P_TESS_MIN_BLOCK_SIZE &&
+             tess_pool_reserve_workers(pool, queue->max_threads)) {
+            for (unsigned i = 0; i < queue->max_threads; i++)
+               pool->workers[i]->Init(prim_mode, spacing, vertex_order_cw, point_mode);
+
+            blocks = pool->blocks;
+            block_count = MIN2(count / P_TESS_MIN_BLOCK_SIZE, queue->max_threads + 1);
+         }
+
+         unsigned block_size = DIV_ROUND_UP(count, block_count);
+
+         for (unsigned i = 1; i < block_count; i++) {
+            unsigned begin = MIN2(i * block_size, count);
+
+            blocks[i].workers = pool->workers;
+            blocks[i].topos = &topos[begin];
+            blocks[i].count = MIN2((i + 1) * block_size, count) - begin;
+            util_queue_fence_init(&blocks[i].fence);
+            util_queue_add_job(queue, &blocks[i], &blocks[i].fence,
+                               tess_block_execute, NULL, 0);
+         }
+
+         for (unsigned i = 0; i < MIN2(block_size, count); i++)
+            ts.Generate(topos[i]);
+
+         for (unsigned i = 1; i < block_count; i++) {
+            util_queue_fence_wait(&blocks[i].fence);
+            util_queue_fence_destroy(&blocks[i].fence);
+         }
+
+         /* They stay cached if there is no room to track them. */
+         struct topology **slot = NULL;
+         if (!cache && count)
+            slot = (struct topology **)util_dynarray_grow(&transient, struct topology *, count);
+         if (slot) {
+            memcpy(slot, topos, count * sizeof(*topos));
+            return;
+         }
+
+         size_t size = 0;
+         for (unsigned i = 0; i < count; i++)
+            size += sizeof(struct topology) + topos[i]->size;
+         cache_size += size;
+         pool->cache_size += size;
+      }
+
+   public:
+      void Init(enum mesa_prim tes_prim_mode,
+                enum pipe_tess_spacing ts_spacing,
+                bool tes_vertex_order_cw, bool tes_point_mode,
+                struct tess_pool *tess_pool)
+      {
+         ts.Init(tes_prim_mode, ts_spacing, tes_vertex_order_cw, tes_point_mode);
+
+         prim_mode = tes_prim_mode;
+         spacing = ts_spacing;
+         vertex_order_cw = tes_vertex_order_cw;
+         point_mode = tes_point_mode;
+
+         topologies = _mesa_hash_table_create(NULL, topology_key_hash,
+                                              topology_key_equal);
+         cache_size = 0;
+         util_dynarray_init(&transient, NULL);
+         util_dynarray_init(&misses, NULL);
+         util_dynarray_init(&results, NULL);
+
+         if (tess_pool) {
+            tess_pool->refcount++;
+            pool = tess_pool;
+         } else {
+            pool = tess_pool_create();
+         }
+
+         if (pool) {
+            pipe_tess_ctx **slot = (pipe_tess_ctx **)
+               util_dynarray_grow(&pool->contexts, pipe_tess_ctx *, 1);
+            if (slot) {
+               *slot = this;
+            } else {
+               tess_pool_release(pool);
+               pool = NULL;
+            }
+         }
+      }
+
+      bool IsValid()
+      {
+         return topologies != NULL && pool != NULL;
+      }
+
+      void Destroy()
+      {
+         if (pool) {
+            if (topologies)
+               ClearCache();
+            util_dynarray_delete_unordered(&pool->contexts, pipe_tess_ctx *, this);
+            tess_pool_release(pool);
+         }
+         if (topologies)
+            _mesa_hash_table_destroy(topologies, NULL);
+         util_dynarray_fini(&transient);
+         util_dynarray_fini(&misses);
+         util_dynarray_fini(&results);
+      }
+
+      void Tessellate(struct util_queue *queue, unsigned count,
+                      const struct pipe_tessellation_factors *tess_factors,
+                      struct pipe_tessellator_data *tess_data)
+      {
+         if (!count)
+            return;
+
+         /* Nothing returned by the previous calls with the contexts of the
+          * pool is in use anymore.
+          */
+         tess_pool_free_transient(pool);
+         if (pool->cache_size > P_TESS_CACHE_MAX_SIZE)
+            tess_pool_clear_caches(pool);
+
+         util_dynarray_clear(&results);
+
+         struct topology **patches =
+            (struct topology **)util_dynarray_resize(&results, struct topology *, count);
+         if (!patches) {
+            memset(tess_data, 0, count * sizeof(*tess_data));
+            return;
+         }
+
+         /* The misses are generated a few at a time, those past the budget
+          * of the cache are only kept until the next call.  The patches
+          * which repeat one of them within the call still share it.
+          */
+         unsigned i = 0;
+         while (i < count) {
+            bool cache = pool->cache_size <= P_TESS_CACHE_MAX_SIZE;
+
+            util_dynarray_clear(&misses);
+
+            for (; i < count &&
+                   util_dynarray_num_elements(&misses, struct topology *) < P_TESS_MAX_MISSES;
+                 i++) {
+               struct topology_key key;
+
+               patches[i] = NULL;
+               if (!QuantizeFactors(&tess_factors[i], &key))
+                  continue;
+
+               uint32_t hash = topology_key_hash(&key);
+               struct hash_entry *entry =
+                  _mesa_hash_table_search_pre_hashed(topologies, hash, &key);
+               if (entry) {
+                  patches[i] = (struct topology *)entry->data;
+                  continue;
+               }
+
+               struct topology *topo = CALLOC_STRUCT(topology);
+               if (!topo)
+                  continue;
+
+               topo->key = key;
+               if (!_mesa_hash_table_insert_pre_hashed(topologies, hash, &topo->key, topo)) {
+                  FREE(topo);
+                  continue;
+               }
+
+               util_dynarray_append(&misses, struct topology *, topo);
+               patches[i] = topo;
+            }
+
+            GenerateMisses(queue, cache);
          }
-         tess_data->num_domain_points = num_domain_points;
-         tess_data->domain_points_u = &domain_points_u[0];
-         tess_data->domain_points_v = &domain_points_v[0];
 
-         tess_data->num_indices = (uint32_t)SUPER::GetIndexCount();
+         for (unsigned i = 0; i < count; i++) {
+            struct topology *topo = patches[i];
+
+            if (!topo || !topo->num_domain_points) {
+               memset(&tess_data[i], 0, sizeof(tess_data[i]));
+               continue;
+            }
 
-         tess_data->indices = (uint32_t*)SUPER::GetIndices();
+            tess_data[i].num_domain_points = topo->num_domain_points;
+            tess_data[i].domain_points_u = topo->domain_points_u;
+            tess_data[i].domain_points_v = topo->domain_points_v;
+            tess_data[i].num_indices = topo->num_indices;
+            tess_data[i].indices = topo->indices;
+         }
       }
+
+      friend void tess_pool_clear_caches(struct tess_pool *pool);
+      friend void tess_pool_free_transient(struct tess_pool *pool);
    };
+
+   static void
+   tess_pool_clear_caches(struct tess_pool *pool)
+   {
+      util_dynarray_foreach(&pool->contexts, pipe_tess_ctx *, ctx)
+         (*ctx)->ClearCache();
+   }
+
+   static void
+   tess_pool_free_transient(struct tess_pool *pool)
+   {
+      util_dynarray_foreach(&pool->contexts, pipe_tess_ctx *, ctx)
+         (*ctx)->FreeTransient();
+   }
 } // namespace Tessellator
 
+/* allocate a pool of worker tessellators */
+struct pipe_tessellator_pool *
+p_tess_pool_create(void)
+{
+   return (struct pipe_tessellator_pool *)pipe_tessellator_wrap::tess_pool_create();
+}
+
+/* release a pool of worker tessellators */
+void p_tess_pool_release(struct pipe_tessellator_pool *pipe_pool)
+{
+   using pipe_tessellator_wrap::tess_pool;
+
+   tess_pool_release((tess_pool *)pipe_pool);
+}
+
 /* allocate tessellator */
 struct pipe_tessellator *
 p_tess_init(enum mesa_prim tes_prim_mode,
             enum pipe_tess_spacing spacing,
-            bool tes_vertex_order_cw, bool tes_point_mode)
+            bool tes_vertex_order_cw, bool tes_point_mode,
+            struct pipe_tessellator_pool *pool)
 {
    void *mem;
-   using pipe_tessellator_wrap::pipe_ts;
+   using pipe_tessellator_wrap::pipe_tess_ctx;
+   using pipe_tessellator_wrap::tess_pool;
+
+   mem = align_malloc(sizeof(pipe_tess_ctx), 256);
+   if (!mem)
+      return NULL;
 
-   mem = align_malloc(sizeof(pipe_ts), 256);
+   pipe_tess_ctx* tessellator = new (mem) pipe_tess_ctx();
 
-   pipe_ts* tessellator = new (mem) pipe_ts();
+   tessellator->Init(tes_prim_mode, spacing, tes_vertex_order_cw, tes_point_mode,
+                     (tess_pool *)pool);
 
-   tessellator->Init(tes_prim_mode, spacing, tes_vertex_order_cw, tes_point_mode);
+   if (!tessellator->IsValid()) {
+      p_tess_destroy((struct pipe_tessellator *)tessellator);
+      return NULL;
+   }
 
    return (struct pipe_tessellator *)tessellator;
 }
@@ -145,10 +696,11 @@ p_tess_init(enum mesa_prim tes_prim_mode,
 /* destroy tessellator */
 void p_tess_destroy(struct pipe_tessellator *pipe_tess)
 {
-   using pipe_tessellator_wrap::pipe_ts;
-   pipe_ts *tessellator = (pipe_ts*)pipe_tess;
+   using pipe_tessellator_wrap::pipe_tess_ctx;
+   pipe_tess_ctx *tessellator = (pipe_tess_ctx*)pipe_tess;
 
-   tessellator->~pipe_ts();
+   tessellator->Destroy();
+   tessellator->~pipe_tess_ctx();
    align_free(tessellator);
 }
 
@@ -157,9 +709,21 @@ void p_tessellate(struct pipe_tessellator *pipe_tess,
                   const struct pipe_tessellation_factors *tess_factors,
                   struct pipe_tessellator_data *tess_data)
 {
-   using pipe_tessellator_wrap::pipe_ts;
-   pipe_ts *tessellator = (pipe_ts*)pipe_tess;
+   using pipe_tessellator_wrap::pipe_tess_ctx;
+   pipe_tess_ctx *tessellator = (pipe_tess_ctx*)pipe_tess;
 
-   tessellator->Tessellate(tess_factors, tess_data);
+   tessellator->Tessellate(NULL, 1, tess_factors, tess_data);
 }
 
+/* perform tessellation of several patches */
+void p_tessellate_batch(struct pipe_tessellator *pipe_tess,
+                        struct util_queue *queue,
+                        unsigned count,
+                        const struct pipe_tessellation_factors *tess_factors,
+                        struct pipe_tessellator_data *tess_data)
+{
+   using pipe_tessellator_wrap::pipe_tess_ctx;
+   pipe_tess_ctx *tessellator = (pipe_tess_ctx*)pipe_tess;
+
+   tessellator->Tessellate(queue, count, tess_factors, tess_data);
+}
@@ -32,6 +32,8 @@ extern "C" {
 #endif
 
 struct pipe_tessellator;
+struct pipe_tessellator_pool;
+struct util_queue;
 struct pipe_tessellation_factors
 {
    float outer_tf[4];
@@ -50,19 +52,38 @@ struct pipe_tessellator_data
     // For Tri: domain_points_w[i] = 1.0f - domain_points_u[i] - domain_points_v[i]
 };
 
-/// Allocate and initialize a new tessellation context
+/// Allocate a pool of worker tessellators and a topology cache budget,
+/// shared by the tessellation contexts created with it.  These must all be
+/// used from one thread at a time.
+struct pipe_tessellator_pool *p_tess_pool_create(void);
+/// Release the pool, it lives until its last tessellation context is
+/// destroyed
+void p_tess_pool_release(struct pipe_tessellator_pool *pool);
+
+/// Allocate and initialize a new tessellation context, which gets a pool of
+/// its own if pool is NULL
 struct pipe_tessellator *p_tess_init(enum mesa_prim tes_prim_mode,
                                      enum pipe_tess_spacing spacing,
-                                     bool tes_vertex_order_cw, bool tes_point_mode);
+                                     bool tes_vertex_order_cw, bool tes_point_mode,
+                                     struct pipe_tessellator_pool *pool);
 /// Destroy & de-allocate tessellation context
 void p_tess_destroy(struct pipe_tessellator *pipe_ts);
 
-
 /// Perform Tessellation
+/// Patches with the same factors after clamping share their data, which
+/// stays valid until the next tessellation with a context of the same pool.
 void p_tessellate(struct pipe_tessellator *pipe_ts,
                   const struct pipe_tessellation_factors *tess_factors,
                   struct pipe_tessellator_data *tess_data);
 
+/// Perform Tessellation of count patches at once, on the threads of queue
+/// too if it isn't NULL
+void p_tessellate_batch(struct pipe_tessellator *pipe_ts,
+                        struct util_queue *queue,
+                        unsigned count,
+                        const struct pipe_tessellation_factors *tess_factors,
+                        struct pipe_tessellator_data *tess_data);
+
 #ifdef __cplusplus
 }
 #endif
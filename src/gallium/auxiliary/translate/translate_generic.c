@@ -642,7 +642,7 @@ generic_run_one(struct translate_generic *tg,
          }
       } else {
          if (likely(tg->attrib[attr].copy_size >= 0)) {
-            memcpy(data, &instance_id, 4);
+            memcpy(dst, &instance_id, 4);
          } else {
             data[0] = (float)instance_id;
             tg->attrib[attr].emit(data, dst);
@@ -0,0 +1,544 @@
+/*
+ * Copyright © 2026 The Mesa Authors
+ * SPDX-License-Identifier: MIT
+ */
+
+/**
+ * @file
+ * Translate backend generating the vertex fetch/convert code with gallivm.
+ *
+ * This is what non-x86 targets use instead of translate_generic, and what x86
+ * uses for the keys translate_sse can't handle.  The attributes are fetched
+ * as <4 x float> AoS vectors with lp_build_fetch_rgba_aos(), which has fast
+ * paths for the common vertex formats and falls back to util_format for the
+ * rest.
+ */
+
+
+#include "util/format/u_format.h"
+#include "util/u_memory.h"
+#include "util/u_pointer.h"
+#include "gallivm/lp_bld.h"
+#include "gallivm/lp_bld_const.h"
+#include "gallivm/lp_bld_debug.h"
+#include "gallivm/lp_bld_flow.h"
+#include "gallivm/lp_bld_format.h"
+#include "gallivm/lp_bld_init.h"
+#include "gallivm/lp_bld_struct.h"
+#include "gallivm/lp_bld_type.h"
+#include "translate.h"
+
+
+/* What set_buffer() provides for an element, read by the generated code. */
+struct translate_llvm_attrib {
+   const uint8_t *input_ptr;
+   uint32_t input_stride;
+   uint32_t max_index;
+};
+
+enum {
+   TRANSLATE_LLVM_ATTRIB_INPUT_PTR,
+   TRANSLATE_LLVM_ATTRIB_INPUT_STRIDE,
+   TRANSLATE_LLVM_ATTRIB_MAX_INDEX,
+   TRANSLATE_LLVM_ATTRIB_NUM_FIELDS,
+};
+
+typedef void
+(*translate_llvm_func)(const struct translate_llvm_attrib *attribs,
+                       const void *elts,
+                       unsigned start,
+                       unsigned count,
+                       unsigned start_instance,
+                       unsigned instance_id,
+                       void *output_buffer);
+
+/* How an element is converted. */
+enum translate_llvm_emit {
+   /* Same input and output format. */
+   TRANSLATE_LLVM_EMIT_COPY,
+   /* R32*_FLOAT from any non pure integer format. */
+   TRANSLATE_LLVM_EMIT_FLOAT,
+   /* R32*_UINT/SINT from a pure integer format of the same signedness. */
+   TRANSLATE_LLVM_EMIT_INT,
+   /* Instance id as a 32-bit integer. */
+   TRANSLATE_LLVM_EMIT_INSTANCE_ID,
+   /* Instance id converted to float. */
+   TRANSLATE_LLVM_EMIT_INSTANCE_ID_FLOAT,
+};
+
+struct translate_llvm {
+   struct translate translate;
+
+   lp_context_ref context;
+   struct gallivm_state *gallivm;
+
+   enum translate_llvm_emit emit[TRANSLATE_MAX_ATTRIBS];
+
+   /* Indexed by the index size, 0 is the linear variant. */
+   translate_llvm_func funcs[5];
+
+   struct translate_llvm_attrib attribs[TRANSLATE_MAX_ATTRIBS];
+};
+
+
+static inline struct translate_llvm *
+translate_llvm(struct translate *translate)
+{
+   return (struct translate_llvm *)translate;
+}
+
+
+static void
+translate_llvm_func_name(char *name, size_t size, unsigned index_size)
+{
+   if (index_size)
+      snprintf(name, size, "translate_elts%u", index_size * 8);
+   else
+      snprintf(name, size, "translate_linear");
+}
+
+
+static bool
+translate_llvm_get_emit(const struct translate_element *element,
+                        enum translate_llvm_emit *emit)
+{
+   const struct util_format_description *in_desc =
+      util_format_description(element->input_format);
+   const struct util_format_description *out_desc =
+      util_format_description(element->output_format);
+
+   if (!in_desc || !out_desc)
+      return false;
+
+   if (element->type == TRANSLATE_ELEMENT_INSTANCE_ID) {
+      switch (element->output_format) {
+      case PIPE_FORMAT_R32_USCALED:
+      case PIPE_FORMAT_R32_SSCALED:
+      case PIPE_FORMAT_R32_UINT:
+      case PIPE_FORMAT_R32_SINT:
+         *emit = TRANSLATE_LLVM_EMIT_INSTANCE_ID;
+         return true;
+      case PIPE_FORMAT_R32_FLOAT:
+         *emit = TRANSLATE_LLVM_EMIT_INSTANCE_ID_FLOAT;
+         return true;
+      default:
+         return false;
+      }
+   }
+
+   if (element->input_format == element->output_format &&
+       in_desc->block.width == 1 &&
+       in_desc->block.height == 1 &&
+       !(in_desc->block.bits & 7)) {
+      *emit = TRANSLATE_LLVM_EMIT_COPY;
+      return true;
+   }
+
+   if (in_desc->layout != UTIL_FORMAT_LAYOUT_PLAIN ||
+       in_desc->block.width != 1 || in_desc->block.height != 1)
+      return false;
+
+   /* The output has to be 32-bit channels starting at R. */
+   if (out_desc->layout != UTIL_FORMAT_LAYOUT_PLAIN ||
+       out_desc->block.bits != 32 * out_desc->nr_channels)
+      return false;
+
+   for (unsigned i = 0; i < out_desc->nr_channels; i++) {
+      if (out_desc->channel[i].size != 32 ||
+          out_desc->swizzle[i] != PIPE_SWIZZLE_X + i)
+         return false;
+   }
+
+   if (in_desc->channel[0].pure_integer) {
+      enum util_format_type type = in_desc->channel[0].type;
+
+      if (!out_desc->channel[0].pure_integer ||
+          out_desc->channel[0].type != type)
+         return false;
+
+      for (unsigned i = 0; i < in_desc->nr_channels; i++) {
+         if (in_desc->channel[i].type != type)
+            return false;
+      }
+
+      *emit = TRANSLATE_LLVM_EMIT_INT;
+      return true;
+   }
+
+   if (out_desc->channel[0].type != UTIL_FORMAT_TYPE_FLOAT)
+      return false;
+
+   *emit = TRANSLATE_LLVM_EMIT_FLOAT;
+   return true;
+}
+
+
+/**
+ * Generate the code for one index size.  Everything set_buffer() provides
+ * is loaded once before the vertex loop.
+ */
+static LLVMValueRef
+translate_llvm_build_func(struct translate_llvm *tl,
+                          LLVMTypeRef attrib_type,
+                          unsigned index_size)
+{
+   struct gallivm_state *gallivm = tl->gallivm;
+   const struct translate_key *key = &tl->translate.key;
+   LLVMContextRef context = gallivm->context;
+   LLVMBuilderRef builder = gallivm->builder;
+   LLVMTypeRef i8t = LLVMInt8TypeInContext(context);
+   LLVMTypeRef i32t = LLVMInt32TypeInContext(context);
+   LLVMTypeRef i64t = LLVMInt64TypeInContext(context);
+   LLVMTypeRef f32t = LLVMFloatTypeInContext(context);
+   LLVMTypeRef elt_type = index_size ? LLVMIntTypeInContext(context, index_size * 8) : i8t;
+   LLVMTypeRef aosi_type = LLVMVectorType(i32t, 4);
+   LLVMTypeRef arg_types[7];
+   char func_name[32];
+
+   arg_types[0] = LLVMPointerType(attrib_type, 0);  /* attribs */
+   arg_types[1] = LLVMPointerType(elt_type, 0);     /* elts */
+   arg_types[2] = i32t;                             /* start */
+   arg_types[3] = i32t;                             /* count */
+   arg_types[4] = i32t;                             /* start_instance */
+   arg_types[5] = i32t;                             /* instance_id */
+   arg_types[6] = LLVMPointerType(i8t, 0);          /* output_buffer */
+
+   translate_llvm_func_name(func_name, sizeof(func_name), index_size);
+
+   LLVMTypeRef func_type = LLVMFunctionType(LLVMVoidTypeInContext(context),
+                                            arg_types, ARRAY_SIZE(arg_types), 0);
+   LLVMValueRef func = LLVMAddFunction(gallivm->module, func_name, func_type);
+   LLVMSetFunctionCallConv(func, LLVMCCallConv);
+
+   LLVMValueRef attribs_ptr = LLVMGetParam(func, 0);
+   LLVMValueRef elts_ptr = LLVMGetParam(func, 1);
+   LLVMValueRef start = LLVMGetParam(func, 2);
+   LLVMValueRef count = LLVMGetParam(func, 3);
+   LLVMValueRef start_instance = LLVMGetParam(func, 4);
+   LLVMValueRef instance_id = LLVMGetParam(func, 5);
+   LLVMValueRef output_ptr = LLVMGetParam(func, 6);
+
+   lp_build_name(attribs_ptr, "attribs");
+   lp_build_name(elts_ptr, "elts");
+   lp_build_name(output_ptr, "output");
+
+   LLVMBasicBlockRef block = LLVMAppendBasicBlockInContext(context, func, "entry");
+   LLVMPositionBuilderAtEnd(builder, block);
+
+   LLVMValueRef input_ptrs[TRANSLATE_MAX_ATTRIBS] = {0};
+   LLVMValueRef input_strides[TRANSLATE_MAX_ATTRIBS] = {0};
+   LLVMValueRef max_indices[TRANSLATE_MAX_ATTRIBS] = {0};
+   LLVMValueRef instance_offsets[TRANSLATE_MAX_ATTRIBS] = {0};
+
+   for (unsigned i = 0; i < key->nr_elements; i++) {
+      const struct translate_element *element = &key->element[i];
+
+      if (element->type != TRANSLATE_ELEMENT_NORMAL)
+         continue;
+
+      LLVMValueRef index = lp_build_const_int32(gallivm, i);
+      LLVMValueRef attrib_ptr = LLVMBuildGEP2(builder, attrib_type, attribs_ptr,
+                                              &index, 1, "");
+
+      input_ptrs[i] = lp_build_struct_get2(gallivm, attrib_type, attrib_ptr,
+                                           TRANSLATE_LLVM_ATTRIB_INPUT_PTR,
+                                           "input_ptr");
+      input_strides[i] = lp_build_struct_get2(gallivm, attrib_type, attrib_ptr,
+                                              TRANSLATE_LLVM_ATTRIB_INPUT_STRIDE,
+                                              "input_stride");
+      input_strides[i] = LLVMBuildZExt(builder, input_strides[i], i64t, "");
+
+      if (element->instance_divisor) {
+         /* Same for all vertices, the index isn't clamped, like in
+          * translate_generic.
+          */
+         LLVMValueRef divisor = lp_build_const_int32(gallivm, element->instance_divisor);
+         LLVMValueRef instance_index = LLVMBuildUDiv(builder, instance_id, divisor, "");
+         instance_index = LLVMBuildAdd(builder, start_instance, instance_index, "");
+         instance_index = LLVMBuildZExt(builder, instance_index, i64t, "");
+         instance_offsets[i] = LLVMBuildMul(builder, instance_index, input_strides[i], "");
+      } else if (index_size) {
+         max_indices[i] = lp_build_struct_get2(gallivm, attrib_type, attrib_ptr,
+                                               TRANSLATE_LLVM_ATTRIB_MAX_INDEX,
+                                               "max_index");
+      }
+   }
+
+   struct lp_build_loop_state loop;
+   lp_build_loop_begin(&loop, gallivm, lp_build_const_int32(gallivm, 0));
+   {
+      LLVMValueRef elt;
+      if (index_size) {
+         elt = LLVMBuildLoad2(builder, elt_type,
+                              LLVMBuildGEP2(builder, elt_type, elts_ptr,
+                                            &loop.counter, 1, ""), "");
+         elt = LLVMBuildZExt(builder, elt, i32t, "elt");
+      } else {
+         elt = LLVMBuildAdd(builder, start, loop.counter, "elt");
+      }
+
+      LLVMValueRef vertex_offset =
+         LLVMBuildMul(builder, loop.counter,
+                      lp_build_const_int32(gallivm, key->output_stride), "");
+      LLVMValueRef vertex_ptr = LLVMBuildGEP2(builder, i8t, output_ptr,
+                                              &vertex_offset, 1, "vertex");
+
+      for (unsigned i = 0; i < key->nr_elements; i++) {
+         const struct translate_element *element = &key->element[i];
+         const struct util_format_description *in_desc =
+            util_format_description(element->input_format);
+         const struct util_format_description *out_desc =
+            util_format_description(element->output_format);
+         LLVMValueRef dst_offset = lp_build_const_int32(gallivm, element->output_offset);
+         LLVMValueRef dst_ptr = LLVMBuildGEP2(builder, i8t, vertex_ptr,
+                                              &dst_offset, 1, "");
+
+         if (tl->emit[i] == TRANSLATE_LLVM_EMIT_INSTANCE_ID ||
+             tl->emit[i] == TRANSLATE_LLVM_EMIT_INSTANCE_ID_FLOAT) {
+            LLVMValueRef value = instance_id;
+            LLVMTypeRef value_type = i32t;
+
+            if (tl->emit[i] == TRANSLATE_LLVM_EMIT_INSTANCE_ID_FLOAT) {
+               value = LLVMBuildUIToFP(builder, value, f32t, "");
+               value_type = f32t;
+            }
+
+            dst_ptr = LLVMBuildBitCast(builder, dst_ptr,
+                                       LLVMPointerType(value_type, 0), "");
+            LLVMSetAlignment(LLVMBuildStore(builder, value, dst_ptr), 1);
+            continue;
+         }
+
+         LLVMValueRef src_offset;
+         if (element->instance_divisor) {
+            src_offset = instance_offsets[i];
+         } else {
+            LLVMValueRef index = elt;
+            if (index_size) {
+               /* clamp to avoid going out of bounds */
+               LLVMValueRef in_bounds = LLVMBuildICmp(builder, LLVMIntULE, index,
+                                                      max_indices[i], "");
+               index = LLVMBuildSelect(builder, in_bounds, index, max_indices[i], "");
+            }
+            index = LLVMBuildZExt(builder, index, i64t, "");
+            src_offset = LLVMBuildMul(builder, index, input_strides[i], "");
+         }
+
+         LLVMValueRef src_ptr = LLVMBuildGEP2(builder, i8t, input_ptrs[i],
+                                              &src_offset, 1, "");
+
+         if (tl->emit[i] == TRANSLATE_LLVM_EMIT_COPY) {
+            LLVMTypeRef copy_type = LLVMIntTypeInContext(context, in_desc->block.bits);
+            LLVMTypeRef copy_ptr_type = LLVMPointerType(copy_type, 0);
+
+            src_ptr = LLVMBuildBitCast(builder, src_ptr, copy_ptr_type, "");
+            dst_ptr = LLVMBuildBitCast(builder, dst_ptr, copy_ptr_type, "");
+
+            LLVMValueRef value = LLVMBuildLoad2(builder, copy_type, src_ptr, "");
+            LLVMSetAlignment(value, 1);
+            LLVMSetAlignment(LLVMBuildStore(builder, value, dst_ptr), 1);
+            continue;
+         }
+
+         /* Pure integers come back as their bits in the float vector. */
+         LLVMValueRef aos = lp_build_fetch_rgba_aos(gallivm, in_desc,
+                                                    lp_float32_vec4_type(),
+                                                    false, src_ptr,
+                                                    lp_build_const_int32(gallivm, 0),
+                                                    lp_build_const_int32(gallivm, 0),
+                                                    lp_build_const_int32(gallivm, 0),
+                                                    NULL);
+         aos = LLVMBuildBitCast(builder, aos, aosi_type, "");
+
+         if (out_desc->nr_channels == 4) {
+            dst_ptr = LLVMBuildBitCast(builder, dst_ptr,
+                                       LLVMPointerType(aosi_type, 0), "");
+            LLVMSetAlignment(LLVMBuildStore(builder, aos, dst_ptr), 1);
+         } else {
+            dst_ptr = LLVMBuildBitCast(builder, dst_ptr,
+                                       LLVMPointerType(i32t, 0), "");
+            for (unsigned c = 0; c < out_desc->nr_channels; c++) {
+               LLVMValueRef chan = lp_build_const_int32(gallivm, c);
+               LLVMValueRef value = LLVMBuildExtractElement(builder, aos, chan, "");
+               LLVMValueRef chan_ptr = LLVMBuildGEP2(builder, i32t, dst_ptr,
+                                                     &chan, 1, "");
+               LLVMSetAlignment(LLVMBuildStore(builder, value, chan_ptr), 1);
+            }
+         }
+      }
+   }
+   lp_build_loop_end_cond(&loop, count, lp_build_const_int32(gallivm, 1),
+                          LLVMIntUGE);
+
+   LLVMBuildRetVoid(builder);
+
+   gallivm_verify_function(gallivm, func);
+
+   return func;
+}
+
+
+static void UTIL_CDECL
+llvm_run_elts(struct translate *translate,
+              const unsigned *elts,
+              unsigned count,
+              unsigned start_instance,
+              unsigned instance_id,
+              void *output_buffer)
+{
+   struct translate_llvm *tl = translate_llvm(translate);
+
+   if (count)
+      tl->funcs[4](tl->attribs, elts, 0, count, start_instance, instance_id,
+                   output_buffer);
+}
+
+static void UTIL_CDECL
+llvm_run_elts16(struct translate *translate,
+                const uint16_t *elts,
+                unsigned count,
+                unsigned start_instance,
+                unsigned instance_id,
+                void *output_buffer)
+{
+   struct translate_llvm *tl = translate_llvm(translate);
+
+   if (count)
+      tl->funcs[2](tl->attribs, elts, 0, count, start_instance, instance_id,
+                   output_buffer);
+}
+
+static void UTIL_CDECL
+llvm_run_elts8(struct translate *translate,
+               const uint8_t *elts,
+               unsigned count,
+               unsigned start_instance,
+               unsigned instance_id,
+               void *output_buffer)
+{
+   struct translate_llvm *tl = translate_llvm(translate);
+
+   if (count)
+      tl->funcs[1](tl->attribs, elts, 0, count, start_instance, instance_id,
+                   output_buffer);
+}
+
+static void UTIL_CDECL
+llvm_run(struct translate *translate,
+         unsigned start,
+         unsigned count,
+         unsigned start_instance,
+         unsigned instance_id,
+         void *output_buffer)
+{
+   struct translate_llvm *tl = translate_llvm(translate);
+
+   if (count)
+      tl->funcs[0](tl->attribs, NULL, start, count, start_instance, instance_id,
+                   output_buffer);
+}
+
+
+static void
+llvm_set_buffer(struct translate *translate,
+                unsigned buf,
+                const void *ptr,
+                unsigned stride,
+                unsigned max_index)
+{
+   struct translate_llvm *tl = translate_llvm(translate);
+   const struct translate_key *key = &tl->translate.key;
+
+   for (unsigned i = 0; i < key->nr_elements; i++) {
+      if (key->element[i].type == TRANSLATE_ELEMENT_NORMAL &&
+          key->element[i].input_buffer == buf) {
+         tl->attribs[i].input_ptr = ((const uint8_t *)ptr +
+                                     key->element[i].input_offset);
+         tl->attribs[i].input_stride = stride;
+         tl->attribs[i].max_index = max_index;
+      }
+   }
+}
+
+
+static void
+llvm_release(struct translate *translate)
+{
+   struct translate_llvm *tl = translate_llvm(translate);
+
+   if (tl->gallivm)
+      gallivm_destroy(tl->gallivm);
+   lp_context_destroy(&tl->context);
+   FREE(tl);
+}
+
+
+struct translate *
+translate_llvm_create(const struct translate_key *key)
+{
+   static const unsigned index_sizes[] = { 0, 1, 2, 4 };
+   LLVMValueRef funcs[ARRAY_SIZE(index_sizes)];
+
+   assert(key->nr_elements <= TRANSLATE_MAX_ATTRIBS);
+
+   if (!lp_build_init())
+      return NULL;
+
+   struct translate_llvm *tl = CALLOC_STRUCT(translate_llvm);
+   if (!tl)
+      return NULL;
+
+   tl->translate.key = *key;
+   tl->translate.release = llvm_release;
+   tl->translate.set_buffer = llvm_set_buffer;
+   tl->translate.run_elts = llvm_run_elts;
+   tl->translate.run_elts16 = llvm_run_elts16;
+   tl->translate.run_elts8 = llvm_run_elts8;
+   tl->translate.run = llvm_run;
+
+   for (unsigned i = 0; i < key->nr_elements; i++) {
+      if (!translate_llvm_get_emit(&key->element[i], &tl->emit[i])) {
+         FREE(tl);
+         return NULL;
+      }
+   }
+
+   lp_context_create(&tl->context);
+   tl->gallivm = gallivm_create("translate", &tl->context, NULL);
+   if (!tl->gallivm) {
+      llvm_release(&tl->translate);
+      return NULL;
+   }
+
+   LLVMContextRef context = tl->gallivm->context;
+   LLVMTypeRef attrib_elem_types[TRANSLATE_LLVM_ATTRIB_NUM_FIELDS];
+   attrib_elem_types[TRANSLATE_LLVM_ATTRIB_INPUT_PTR] =
+      LLVMPointerType(LLVMInt8TypeInContext(context), 0);
+   attrib_elem_types[TRANSLATE_LLVM_ATTRIB_INPUT_STRIDE] =
+   attrib_elem_types[TRANSLATE_LLVM_ATTRIB_MAX_INDEX] =
+      LLVMInt32TypeInContext(context);
+   LLVMTypeRef attrib_type =
+      LLVMStructTypeInContext(context, attrib_elem_types,
+                              ARRAY_SIZE(attrib_elem_types), 0);
+
+   for (unsigned i = 0; i < ARRAY_SIZE(index_sizes); i++)
+      funcs[i] = translate_llvm_build_func(tl, attrib_type, index_sizes[i]);
+
+   gallivm_compile_module(tl->gallivm);
+
+   for (unsigned i = 0; i < ARRAY_SIZE(index_sizes); i++) {
+      char func_name[32];
+
+      translate_llvm_func_name(func_name, sizeof(func_name), index_sizes[i]);
+      tl->funcs[index_sizes[i]] = (translate_llvm_func)
+         gallivm_jit_function(tl->gallivm, funcs[i], func_name);
+      if (!tl->funcs[index_sizes[i]]) {
+         llvm_release(&tl->translate);
+         return NULL;
+      }
+   }
+
+   gallivm_free_ir(tl->gallivm);
+
+   return &tl->translate;
+}
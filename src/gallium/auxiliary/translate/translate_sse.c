@@ -1559,6 +1559,8 @@ translate_sse2_create(const struct translate_key *key)
       else {
          assert(key->element[i].type == TRANSLATE_ELEMENT_INSTANCE_ID);
 
+         /* The instance id has to be loaded even without divisors. */
+         p->use_instancing = true;
          p->element_to_buffer_variant[i] = ELEMENT_BUFFER_INSTANCE_ID;
       }
    }
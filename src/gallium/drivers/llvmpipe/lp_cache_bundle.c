@@ -0,0 +1,362 @@
+/*
+ * Copyright © 2026 The Mesa Authors
+ * SPDX-License-Identifier: MIT
+ */
+
+/*
+ * Shader cache bundle file format (native byte order):
+ *
+ *   header:  "LPCBNDL\0", version, number of entries, 20-byte cache id
+ *   entries: 20-byte key, code size, crc32 of the code, code
+ *
+ * The cache id identifies the driver build, the gallivm perf flags and
+ * the CPU (see lp_disk_cache_create()); bundles with a different id are
+ * ignored as a whole.
+ */
+
+#include <stdio.h>
+#include <string.h>
+#include <sys/stat.h>
+
+#include "util/detect_os.h"
+#if DETECT_OS_POSIX
+#include <dirent.h>
+#endif
+
+#include "util/crc32.h"
+#include "util/hash_table.h"
+#include "util/os_file.h"
+#include "util/simple_mtx.h"
+#include "util/u_debug.h"
+#include "util/u_memory.h"
+#include "util/u_string.h"
+#include "gallivm/lp_bld_misc.h"
+#include "lp_cache_bundle.h"
+#include "lp_debug.h"
+
+
+#define LP_CACHE_BUNDLE_MAGIC "LPCBNDL"
+#define LP_CACHE_BUNDLE_VERSION 1
+#define LP_CACHE_BUNDLE_SUFFIX ".lpcb"
+
+
+struct lp_cache_bundle_header
+{
+   char magic[8];
+   uint32_t version;
+   uint32_t num_entries;
+   unsigned char cache_id[20];
+};
+
+
+struct lp_cache_bundle_entry_header
+{
+   unsigned char key[20];
+   uint32_t size;
+   uint32_t crc32;
+};
+
+
+struct lp_cache_bundle_entry
+{
+   unsigned char key[20];
+   uint32_t size;
+   uint8_t data[];
+};
+
+
+struct lp_cache_bundle
+{
+   simple_mtx_t mutex;
+   unsigned char cache_id[20];
+   struct hash_table *entries;
+};
+
+
+static uint32_t
+key_hash(const void *key)
+{
+   return _mesa_hash_data(key, 20);
+}
+
+
+static bool
+key_equal(const void *a, const void *b)
+{
+   return memcmp(a, b, 20) == 0;
+}
+
+
+struct lp_cache_bundle *
+lp_cache_bundle_create(const unsigned char cache_id[20])
+{
+   struct lp_cache_bundle *bundle = CALLOC_STRUCT(lp_cache_bundle);
+   if (!bundle)
+      return NULL;
+
+   bundle->entries = _mesa_hash_table_create(NULL, key_hash, key_equal);
+   if (!bundle->entries) {
+      FREE(bundle);
+      return NULL;
+   }
+
+   simple_mtx_init(&bundle->mutex, mtx_plain);
+   memcpy(bundle->cache_id, cache_id, sizeof(bundle->cache_id));
+
+   return bundle;
+}
+
+
+static void
+delete_entry(struct hash_entry *entry)
+{
+   FREE(entry->data);
+}
+
+
+void
+lp_cache_bundle_destroy(struct lp_cache_bundle *bundle)
+{
+   if (!bundle)
+      return;
+
+   _mesa_hash_table_destroy(bundle->entries, delete_entry);
+   simple_mtx_destroy(&bundle->mutex);
+   FREE(bundle);
+}
+
+
+/**
+ * Add a copy of the code to the bundle, unless the key is already present.
+ * The mutex must be held.
+ */
+static bool
+bundle_insert_locked(struct lp_cache_bundle *bundle,
+                     const unsigned char key[20],
+                     const void *data, uint32_t size)
+{
+   if (_mesa_hash_table_search(bundle->entries, key))
+      return false;
+
+   struct lp_cache_bundle_entry *entry = MALLOC(sizeof(*entry) + size);
+   if (!entry)
+      return false;
+
+   memcpy(entry->key, key, sizeof(entry->key));
+   entry->size = size;
+   memcpy(entry->data, data, size);
+
+   _mesa_hash_table_insert(bundle->entries, entry->key, entry);
+   return true;
+}
+
+
+/**
+ * Load a single bundle file.  Returns the number of entries added.
+ */
+static unsigned
+bundle_load_file(struct lp_cache_bundle *bundle, const char *filename)
+{
+   struct lp_cache_bundle_header header;
+   unsigned added = 0;
+   size_t size;
+
+   char *buf = os_read_file(filename, &size);
+   if (!buf) {
+      LP_DBG(DEBUG_SCREEN, "llvmpipe: can't read cache bundle %s\n", filename);
+      return 0;
+   }
+
+   if (size < sizeof(header))
+      goto invalid;
+
+   memcpy(&header, buf, sizeof(header));
+   if (memcmp(header.magic, LP_CACHE_BUNDLE_MAGIC, sizeof(header.magic)) ||
+       header.version != LP_CACHE_BUNDLE_VERSION)
+      goto invalid;
+
+   if (memcmp(header.cache_id, bundle->cache_id, sizeof(header.cache_id))) {
+      LP_DBG(DEBUG_SCREEN,
+             "llvmpipe: cache bundle %s was built for another driver or CPU\n",
+             filename);
+      free(buf);
+      return 0;
+   }
+
+   size_t offset = sizeof(header);
+
+   simple_mtx_lock(&bundle->mutex);
+   for (unsigned i = 0; i < header.num_entries; i++) {
+      struct lp_cache_bundle_entry_header entry;
+
+      if (size - offset < sizeof(entry))
+         break;
+      memcpy(&entry, buf + offset, sizeof(entry));
+      offset += sizeof(entry);
+
+      if (size - offset < entry.size)
+         break;
+
+      /* Skip damaged entries rather than handing them to the JIT. */
+      if (util_hash_crc32(buf + offset, entry.size) == entry.crc32 &&
+          bundle_insert_locked(bundle, entry.key, buf + offset, entry.size))
+         added++;
+
+      offset += entry.size;
+   }
+   simple_mtx_unlock(&bundle->mutex);
+
+   free(buf);
+
+   LP_DBG(DEBUG_SCREEN, "llvmpipe: loaded %u shaders from cache bundle %s\n",
+          added, filename);
+   return added;
+
+invalid:
+   LP_DBG(DEBUG_SCREEN, "llvmpipe: %s is not a cache bundle\n", filename);
+   free(buf);
+   return 0;
+}
+
+
+/**
+ * Preload a bundle file, or all the *.lpcb files of a directory.
+ * Returns the number of shaders added.
+ */
+unsigned
+lp_cache_bundle_load(struct lp_cache_bundle *bundle, const char *path)
+{
+   struct stat st;
+
+   if (stat(path, &st) != 0)
+      return 0;
+
+#if DETECT_OS_POSIX
+   if (S_ISDIR(st.st_mode)) {
+      const size_t suffix_len = strlen(LP_CACHE_BUNDLE_SUFFIX);
+      unsigned added = 0;
+      struct dirent *ent;
+
+      DIR *dir = opendir(path);
+      if (!dir)
+         return 0;
+
+      while ((ent = readdir(dir))) {
+         const size_t len = strlen(ent->d_name);
+         if (len <= suffix_len ||
+             strcmp(ent->d_name + len - suffix_len, LP_CACHE_BUNDLE_SUFFIX))
+            continue;
+
+         char *filename;
+         if (asprintf(&filename, "%s/%s", path, ent->d_name) == -1)
+            continue;
+         added += bundle_load_file(bundle, filename);
+         free(filename);
+      }
+
+      closedir(dir);
+      return added;
+   }
+#endif
+
+   return bundle_load_file(bundle, path);
+}
+
+
+/**
+ * Look up the code for a shader.  On success cache->data is a malloc'ed
+ * copy which the gallivm state takes ownership of.
+ */
+bool
+lp_cache_bundle_find(struct lp_cache_bundle *bundle,
+                     const unsigned char key[20],
+                     struct lp_cached_code *cache)
+{
+   bool found = false;
+
+   simple_mtx_lock(&bundle->mutex);
+   struct hash_entry *he = _mesa_hash_table_search(bundle->entries, key);
+   if (he) {
+      const struct lp_cache_bundle_entry *entry = he->data;
+      void *data = malloc(entry->size);
+      if (data) {
+         memcpy(data, entry->data, entry->size);
+         cache->data = data;
+         cache->data_size = entry->size;
+         found = true;
+      }
+   }
+   simple_mtx_unlock(&bundle->mutex);
+
+   return found;
+}
+
+
+void
+lp_cache_bundle_add(struct lp_cache_bundle *bundle,
+                    const unsigned char key[20],
+                    const struct lp_cached_code *cache)
+{
+   if (!cache->data_size || cache->dont_cache)
+      return;
+
+   simple_mtx_lock(&bundle->mutex);
+   bundle_insert_locked(bundle, key, cache->data, cache->data_size);
+   simple_mtx_unlock(&bundle->mutex);
+}
+
+
+/**
+ * Write all the shaders of the bundle to a file.  The file is replaced
+ * atomically so that concurrent readers never see a partial bundle.
+ */
+bool
+lp_cache_bundle_write(struct lp_cache_bundle *bundle, const char *filename)
+{
+   struct lp_cache_bundle_header header = { 0 };
+   char *tmp_filename;
+   bool ok = true;
+
+   if (asprintf(&tmp_filename, "%s.tmp", filename) == -1)
+      return false;
+
+   FILE *f = fopen(tmp_filename, "wb");
+   if (!f) {
+      free(tmp_filename);
+      return false;
+   }
+
+   simple_mtx_lock(&bundle->mutex);
+
+   memcpy(header.magic, LP_CACHE_BUNDLE_MAGIC, sizeof(header.magic));
+   header.version = LP_CACHE_BUNDLE_VERSION;
+   header.num_entries = _mesa_hash_table_num_entries(bundle->entries);
+   memcpy(header.cache_id, bundle->cache_id, sizeof(header.cache_id));
+   ok = fwrite(&header, sizeof(header), 1, f) == 1;
+
+   hash_table_foreach(bundle->entries, he) {
+      const struct lp_cache_bundle_entry *entry = he->data;
+      struct lp_cache_bundle_entry_header entry_header;
+
+      if (!ok)
+         break;
+
+      memcpy(entry_header.key, entry->key, sizeof(entry_header.key));
+      entry_header.size = entry->size;
+      entry_header.crc32 = util_hash_crc32(entry->data, entry->size);
+
+      ok = fwrite(&entry_header, sizeof(entry_header), 1, f) == 1 &&
+           fwrite(entry->data, 1, entry->size, f) == entry->size;
+   }
+
+   simple_mtx_unlock(&bundle->mutex);
+
+   ok = (fclose(f) == 0) && ok;
+   if (ok)
+      ok = rename(tmp_filename, filename) == 0;
+   if (!ok)
+      remove(tmp_filename);
+
+   free(tmp_filename);
+   return ok;
+}
@@ -0,0 +1,50 @@
+/*
+ * Copyright © 2026 The Mesa Authors
+ * SPDX-License-Identifier: MIT
+ */
+
+/**
+ * Shader cache bundles.
+ *
+ * A bundle is a single file holding the compiled object code of many
+ * shader variants, keyed the same way as the on-disk shader cache.  A
+ * bundle is written by running a workload once with LP_CACHE_BUNDLE_EXPORT
+ * set, and bundles are preloaded at screen creation from LP_CACHE_BUNDLE,
+ * so that a fresh process (with an empty disk cache) doesn't have to JIT
+ * the variants it is going to need.
+ */
+
+#ifndef LP_CACHE_BUNDLE_H
+#define LP_CACHE_BUNDLE_H
+
+#include <stdbool.h>
+#include <stdint.h>
+
+struct lp_cache_bundle;
+struct lp_cached_code;
+
+
+struct lp_cache_bundle *
+lp_cache_bundle_create(const unsigned char cache_id[20]);
+
+void
+lp_cache_bundle_destroy(struct lp_cache_bundle *bundle);
+
+unsigned
+lp_cache_bundle_load(struct lp_cache_bundle *bundle, const char *path);
+
+bool
+lp_cache_bundle_find(struct lp_cache_bundle *bundle,
+                     const unsigned char key[20],
+                     struct lp_cached_code *cache);
+
+void
+lp_cache_bundle_add(struct lp_cache_bundle *bundle,
+                    const unsigned char key[20],
+                    const struct lp_cached_code *cache);
+
+bool
+lp_cache_bundle_write(struct lp_cache_bundle *bundle, const char *filename);
+
+
+#endif /* LP_CACHE_BUNDLE_H */
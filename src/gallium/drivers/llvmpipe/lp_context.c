@@ -107,6 +107,12 @@ llvmpipe_destroy(struct pipe_context *pipe)
 
    llvmpipe_sampler_matrix_destroy(llvmpipe);
 
+   if (llvmpipe->fs_async) {
+      util_queue_finish(&llvmpipe->fs_queue);
+      util_queue_destroy(&llvmpipe->fs_queue);
+   }
+   if (llvmpipe->fs_queue_context.ref)
+      lp_context_destroy(&llvmpipe->fs_queue_context);
    lp_context_destroy(&llvmpipe->context);
 
    align_free(llvmpipe);
@@ -196,6 +202,40 @@ llvmpipe_get_device_reset_status(struct pipe_context *pipe)
 }
 
 
+/**
+ * Wrap the context with u_threaded_context if the frontend prefers that, so
+ * that state validation, vertex processing and binning happen in another
+ * thread.
+ */
+static struct pipe_context *
+llvmpipe_context_init_tc(struct llvmpipe_context *llvmpipe, unsigned flags)
+{
+   struct llvmpipe_screen *lp_screen = llvmpipe_screen(llvmpipe->pipe.screen);
+
+   if (!(flags & PIPE_CONTEXT_PREFER_THREADED))
+      return &llvmpipe->pipe;
+
+   /* Compute-only contexts don't bin anything, there's nothing to overlap. */
+   if (flags & PIPE_CONTEXT_COMPUTE_ONLY)
+      return &llvmpipe->pipe;
+
+   struct pipe_context *tc = threaded_context_create(
+      &llvmpipe->pipe, &lp_screen->transfer_pool,
+      llvmpipe_replace_buffer_storage,
+      &(struct threaded_context_options){
+         .is_resource_busy = llvmpipe_is_resource_busy,
+         .driver_calls_flush_notify = true,
+         .unsynchronized_get_device_reset_status = true,
+      },
+      &llvmpipe->tc);
+
+   if (tc && tc != &llvmpipe->pipe)
+      threaded_context_init_bytes_mapped_limit((struct threaded_context *)tc, 4);
+
+   return tc;
+}
+
+
 struct pipe_context *
 llvmpipe_create_context(struct pipe_screen *screen, void *priv,
                         unsigned flags)
@@ -267,6 +307,19 @@ llvmpipe_create_context(struct pipe_screen *screen, void *priv,
 #endif
 #else
    lp_context_create(&llvmpipe->context);
+
+   /* The background queue needs its own LLVMContext, which is why this
+    * isn't available with USE_GLOBAL_LLVM_CONTEXT.
+    */
+   if (lp_screen->async_fs) {
+      lp_context_create(&llvmpipe->fs_queue_context);
+      llvmpipe->fs_async =
+         llvmpipe->fs_queue_context.ref &&
+         util_queue_init(&llvmpipe->fs_queue, "lpfs", 64, 1,
+                         UTIL_QUEUE_INIT_RESIZE_IF_FULL |
+                         UTIL_QUEUE_INIT_USE_MINIMUM_PRIORITY,
+                         llvmpipe);
+   }
 #endif
 
    if (!llvmpipe->context.ref)
@@ -288,6 +341,11 @@ llvmpipe_create_context(struct pipe_screen *screen, void *priv,
    draw_set_constant_buffer_stride(llvmpipe->draw,
                                    lp_get_constant_buffer_stride(screen));
 
+   /* Large draws can be vertex shaded while the rasterizer threads work on
+    * the previous scene.
+    */
+   draw_set_vertex_threads(llvmpipe->draw, lp_screen->num_threads);
+
    /* FIXME: devise alternative to draw_texture_samplers */
 
    llvmpipe->setup = lp_setup_create(&llvmpipe->pipe, llvmpipe->draw);
@@ -347,7 +405,8 @@ llvmpipe_create_context(struct pipe_screen *screen, void *priv,
    mtx_lock(&lp_screen->ctx_mutex);
    list_addtail(&llvmpipe->list, &lp_screen->ctx_list);
    mtx_unlock(&lp_screen->ctx_mutex);
-   return &llvmpipe->pipe;
+
+   return llvmpipe_context_init_tc(llvmpipe, flags);
 
  fail:
    llvmpipe_destroy(&llvmpipe->pipe);
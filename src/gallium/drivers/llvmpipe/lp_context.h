@@ -35,6 +35,8 @@
 
 #include "draw/draw_vertex.h"
 #include "util/u_blitter.h"
+#include "util/u_queue.h"
+#include "util/u_threaded_context.h"
 
 #include "lp_tex_sample.h"
 #include "lp_jit.h"
@@ -60,6 +62,9 @@ struct llvmpipe_context {
    struct pipe_context pipe;  /**< base class */
 
    struct list_head list;
+
+   /** The threaded_context wrapping us, if any */
+   struct threaded_context *tc;
    /** Constant state objects */
    const struct pipe_blend_state *blend;
    struct pipe_sampler_state *samplers[PIPE_SHADER_MESH_TYPES][PIPE_MAX_SAMPLERS];
@@ -119,6 +124,8 @@ struct llvmpipe_context {
 
    uint64_t dirty; /**< Mask of LP_NEW_x flags */
    unsigned cs_dirty; /**< Mask of LP_CSNEW_x flags */
+   /** Whether the last compute grid's block fits in a single subgroup */
+   bool cs_single_subgroup;
    /** Mapped vertex buffers */
    uint8_t *mapped_vbuffer[PIPE_MAX_ATTRIBS];
 
@@ -165,6 +172,13 @@ struct llvmpipe_context {
    unsigned nr_fs_variants;
    unsigned nr_fs_instrs;
 
+   /** Background compilation of fragment shader variants (LP_ASYNC_FS) */
+   bool fs_async;
+   struct util_queue fs_queue;
+   lp_context_ref fs_queue_context;  /**< used by the queue thread only */
+   /** The bound variant, if its fallback is standing in for it */
+   struct lp_fragment_shader_variant *fs_pending;
+
    bool permit_linear_rasterizer;
    bool single_vp;
 
@@ -28,82 +28,252 @@
  * based on threadpool.c but modified heavily to be compute shader tuned.
  */
 
+#include "util/u_atomic.h"
 #include "util/u_thread.h"
+#include "util/thread_sched.h"
+#include "util/u_math.h"
 #include "util/u_memory.h"
+#include "gallivm/lp_bld_format.h"
 #include "lp_cs_tpool.h"
+#include "lp_perf.h"
 
-static int
-lp_cs_tpool_worker(void *data)
+/*
+ * Textures may be rewritten between dispatches, so don't keep cached
+ * blocks from one task to the next.
+ */
+static void
+lp_cs_local_mem_flush(struct lp_cs_local_mem *lmem)
 {
-   struct lp_cs_tpool *pool = data;
-   struct lp_cs_local_mem lmem;
+   struct lp_build_format_cache *cache = lmem->format_cache;
 
-   memset(&lmem, 0, sizeof(lmem));
-   mtx_lock(&pool->m);
+   if (cache) {
+      LP_COUNT_ADD(nr_texture_cache_access, cache->access_total);
+      LP_COUNT_ADD(nr_texture_cache_miss, cache->access_miss);
+      lp_build_format_cache_reset(cache);
+   }
+}
 
-   while (!pool->shutdown) {
-      struct lp_cs_tpool_task *task;
-      unsigned iter_per_thread;
+static void
+lp_cs_local_mem_fini(struct lp_cs_local_mem *lmem)
+{
+   lp_cs_local_mem_flush(lmem);
+   lp_build_format_cache_destroy(lmem->format_cache);
+   FREE(lmem->local_mem_ptr);
+}
 
-      while (list_is_empty(&pool->workqueue) && !pool->shutdown)
-         cnd_wait(&pool->new_work, &pool->m);
+static inline uint64_t
+range_pack(unsigned begin, unsigned end)
+{
+   return ((uint64_t)end << 32) | begin;
+}
 
-      if (pool->shutdown)
-         break;
+/**
+ * Take up to chunk iterations from the front of a range.
+ * \return the number of iterations taken, the first one in *first.
+ */
+static unsigned
+range_take_front(struct lp_cs_tpool_range *range, unsigned chunk,
+                 unsigned *first)
+{
+   uint64_t old = p_atomic_read(&range->iters);
+
+   for (;;) {
+      unsigned begin = (uint32_t)old, end = old >> 32;
+      unsigned n;
+      uint64_t prev;
+
+      if (begin >= end)
+         return 0;
+
+      n = MIN2(chunk, end - begin);
+      prev = p_atomic_cmpxchg(&range->iters, old, range_pack(begin + n, end));
+      if (prev == old) {
+         *first = begin;
+         return n;
+      }
+      old = prev;
+   }
+}
 
-      task = list_first_entry(&pool->workqueue, struct lp_cs_tpool_task,
-                              list);
+/**
+ * Steal the back half of a range.
+ * \return the number of iterations taken, the first one in *first.
+ */
+static unsigned
+range_steal_back(struct lp_cs_tpool_range *range, unsigned *first)
+{
+   uint64_t old = p_atomic_read(&range->iters);
 
-      unsigned this_iter = task->iter_start;
+   for (;;) {
+      unsigned begin = (uint32_t)old, end = old >> 32;
+      unsigned n;
+      uint64_t prev;
 
-      iter_per_thread = task->iter_per_thread;
+      if (begin >= end)
+         return 0;
 
-      if (task->iter_remainder &&
-          task->iter_start + task->iter_remainder == task->iter_total) {
-         task->iter_remainder--;
-         iter_per_thread = 1;
+      n = DIV_ROUND_UP(end - begin, 2);
+      prev = p_atomic_cmpxchg(&range->iters, old, range_pack(begin, end - n));
+      if (prev == old) {
+         *first = end - n;
+         return n;
       }
+      old = prev;
+   }
+}
 
-      task->iter_start += iter_per_thread;
+/**
+ * Execute iterations of a task until none are left to take.
+ *
+ * self is the index of the calling worker, whose own range is drained
+ * first, or num_threads for a thread which only steals.
+ *
+ * \return whether any iteration was executed.
+ */
+static bool
+lp_cs_tpool_run_task(struct lp_cs_tpool *pool,
+                     struct lp_cs_tpool_task *task,
+                     unsigned self,
+                     struct lp_cs_local_mem *lmem)
+{
+   bool ran = false;
+
+   for (;;) {
+      unsigned first, n = 0, total;
+
+      /* The chunk size may be stale if the task gets retired and queued
+       * again meanwhile, which is harmless.
+       */
+      if (self < pool->num_threads)
+         n = range_take_front(&task->ranges[self],
+                              p_atomic_read_relaxed(&task->chunk), &first);
+
+      for (unsigned i = 1; !n && i <= pool->num_threads; i++) {
+         unsigned victim = (self + i) % pool->num_threads;
+         if (victim != self)
+            n = range_steal_back(&task->ranges[victim], &first);
+      }
 
-      if (task->iter_start == task->iter_total)
-         list_del(&task->list);
+      if (!n)
+         return ran;
 
-      mtx_unlock(&pool->m);
-      for (unsigned i = 0; i < iter_per_thread; i++)
-         task->work(task->data, this_iter + i, &lmem);
+      /* Now that we own some iterations the task can't be retired
+       * under us, and the atomics above ordered us after its setup.
+       */
+      if (lmem->task_seq != task->seq) {
+         lp_cs_local_mem_flush(lmem);
+         lmem->task_seq = task->seq;
+      }
+
+      for (unsigned i = 0; i < n; i++)
+         task->work(task->data, first + i, lmem);
+
+      /* Read the total before the task can get retired by our add. */
+      total = task->iter_total;
+      if (p_atomic_add_return(&task->iter_finished, n) == total)
+         util_queue_fence_signal(&task->finish);
+
+      ran = true;
+   }
+}
+
+static int
+lp_cs_tpool_worker(void *data)
+{
+   struct lp_cs_tpool_worker *worker = data;
+   struct lp_cs_tpool *pool = worker->pool;
+   struct lp_cs_local_mem lmem;
+
+   memset(&lmem, 0, sizeof(lmem));
+
+   while (!p_atomic_read(&pool->shutdown)) {
+      unsigned generation = p_atomic_read(&pool->generation);
+      bool ran = false;
+
+      for (unsigned t = 0; t < LP_CS_TPOOL_MAX_TASKS; t++) {
+         struct lp_cs_tpool_task *task = &pool->tasks[t];
+
+         if (p_atomic_read(&task->active))
+            ran |= lp_cs_tpool_run_task(pool, task, worker->index, &lmem);
+      }
+
+      if (ran)
+         continue;
+
+      lp_cs_local_mem_flush(&lmem);
 
       mtx_lock(&pool->m);
-      task->iter_finished += iter_per_thread;
-      if (task->iter_finished == task->iter_total)
-         cnd_broadcast(&task->finish);
+      while (pool->generation == generation && !pool->shutdown)
+         cnd_wait(&pool->new_work, &pool->m);
+      mtx_unlock(&pool->m);
    }
-   mtx_unlock(&pool->m);
-   FREE(lmem.local_mem_ptr);
+
+   lp_cs_local_mem_fini(&lmem);
    return 0;
 }
 
 struct lp_cs_tpool *
-lp_cs_tpool_create(unsigned num_threads)
+lp_cs_tpool_create(unsigned num_threads, bool pin_threads)
 {
    struct lp_cs_tpool *pool = CALLOC_STRUCT(lp_cs_tpool);
 
    if (!pool)
       return NULL;
 
+   /* Initialized even without threads, lp_cs_tpool_destroy() destroys them. */
+   for (unsigned t = 0; t < LP_CS_TPOOL_MAX_TASKS; t++)
+      util_queue_fence_init(&pool->tasks[t].finish);
+
+   if (num_threads) {
+      pool->threads = CALLOC(num_threads, sizeof(*pool->threads));
+      pool->workers = CALLOC(num_threads, sizeof(*pool->workers));
+      if (!pool->threads || !pool->workers)
+         goto fail;
+
+      for (unsigned t = 0; t < LP_CS_TPOOL_MAX_TASKS; t++) {
+         struct lp_cs_tpool_task *task = &pool->tasks[t];
+
+         task->ranges = align_calloc(num_threads * sizeof(*task->ranges),
+                                     alignof(struct lp_cs_tpool_range));
+         if (!task->ranges)
+            goto fail;
+      }
+   }
+
    (void) mtx_init(&pool->m, mtx_plain);
    cnd_init(&pool->new_work);
+   cnd_init(&pool->task_free);
 
-   list_inithead(&pool->workqueue);
    assert (num_threads <= LP_MAX_THREADS);
+   /* The workers look at num_threads, so set it before starting them. */
+   pool->num_threads = num_threads;
    for (unsigned i = 0; i < num_threads; i++) {
-      if (thrd_success != u_thread_create(pool->threads + i, lp_cs_tpool_worker, pool)) {
+      pool->workers[i].pool = pool;
+      pool->workers[i].index = i;
+      if (thrd_success != u_thread_create(pool->threads + i, lp_cs_tpool_worker,
+                                          &pool->workers[i])) {
+         /* The ranges of the missing workers get stolen by the others. */
          num_threads = i;  /* previous thread is max */
          break;
       }
    }
-   pool->num_threads = num_threads;
+   pool->num_started = num_threads;
+
+   if (pin_threads) {
+      for (unsigned i = 0; i < num_threads; i++)
+         util_thread_sched_pin_worker(pool->threads[i], i, num_threads);
+   }
    return pool;
+
+fail:
+   for (unsigned t = 0; t < LP_CS_TPOOL_MAX_TASKS; t++) {
+      util_queue_fence_destroy(&pool->tasks[t].finish);
+      align_free(pool->tasks[t].ranges);
+   }
+   FREE(pool->workers);
+   FREE(pool->threads);
+   FREE(pool);
+   return NULL;
 }
 
 void
@@ -113,16 +283,25 @@ lp_cs_tpool_destroy(struct lp_cs_tpool *pool)
       return;
 
    mtx_lock(&pool->m);
-   pool->shutdown = true;
+   p_atomic_set(&pool->shutdown, true);
    cnd_broadcast(&pool->new_work);
    mtx_unlock(&pool->m);
 
-   for (unsigned i = 0; i < pool->num_threads; i++) {
+   for (unsigned i = 0; i < pool->num_started; i++) {
       thrd_join(pool->threads[i], NULL);
    }
 
+   for (unsigned t = 0; t < LP_CS_TPOOL_MAX_TASKS; t++) {
+      assert(!pool->tasks[t].in_use);
+      util_queue_fence_destroy(&pool->tasks[t].finish);
+      align_free(pool->tasks[t].ranges);
+   }
+
+   cnd_destroy(&pool->task_free);
    cnd_destroy(&pool->new_work);
    mtx_destroy(&pool->m);
+   FREE(pool->workers);
+   FREE(pool->threads);
    FREE(pool);
 }
 
@@ -130,7 +309,8 @@ struct lp_cs_tpool_task *
 lp_cs_tpool_queue_task(struct lp_cs_tpool *pool,
                        lp_cs_tpool_task_func work, void *data, int num_iters)
 {
-   struct lp_cs_tpool_task *task;
+   struct lp_cs_tpool_task *task = NULL;
+   unsigned iter_per_thread, iter_remainder, begin;
 
    if (pool->num_threads == 0) {
       struct lp_cs_local_mem lmem;
@@ -139,27 +319,54 @@ lp_cs_tpool_queue_task(struct lp_cs_tpool *pool,
       for (unsigned t = 0; t < num_iters; t++) {
          work(data, t, &lmem);
       }
-      FREE(lmem.local_mem_ptr);
+      lp_cs_local_mem_fini(&lmem);
       return NULL;
    }
-   task = CALLOC_STRUCT(lp_cs_tpool_task);
-   if (!task) {
+
+   if (num_iters <= 0)
       return NULL;
+
+   mtx_lock(&pool->m);
+
+   for (;;) {
+      for (unsigned t = 0; t < LP_CS_TPOOL_MAX_TASKS; t++) {
+         if (!pool->tasks[t].in_use) {
+            task = &pool->tasks[t];
+            break;
+         }
+      }
+      if (task)
+         break;
+      cnd_wait(&pool->task_free, &pool->m);
    }
 
+   /* Nobody can be executing this task: all its ranges are empty and
+    * remain so until they get set below.
+    */
+   task->in_use = true;
    task->work = work;
    task->data = data;
+   task->seq = ++pool->task_seq;
    task->iter_total = num_iters;
+   task->iter_finished = 0;
+   util_queue_fence_reset(&task->finish);
 
-   task->iter_per_thread = num_iters / pool->num_threads;
-   task->iter_remainder = num_iters % pool->num_threads;
-
-   cnd_init(&task->finish);
+   /* Hand out contiguous ranges, which workers take from in chunks small
+    * enough to leave something to steal.
+    */
+   iter_per_thread = num_iters / pool->num_threads;
+   iter_remainder = num_iters % pool->num_threads;
+   p_atomic_set(&task->chunk, MAX2(1, iter_per_thread / 8));
 
-   mtx_lock(&pool->m);
-
-   list_addtail(&task->list, &pool->workqueue);
+   begin = 0;
+   for (unsigned i = 0; i < pool->num_threads; i++) {
+      unsigned end = begin + iter_per_thread + (i < iter_remainder);
+      p_atomic_set(&task->ranges[i].iters, range_pack(begin, end));
+      begin = end;
+   }
+   p_atomic_set(&task->active, true);
 
+   p_atomic_inc(&pool->generation);
    cnd_broadcast(&pool->new_work);
    mtx_unlock(&pool->m);
    return task;
@@ -174,12 +381,25 @@ lp_cs_tpool_wait_for_task(struct lp_cs_tpool *pool,
    if (!pool || !task)
       return;
 
+   /* Help with whatever is left rather than just sleeping. */
+   if (!util_queue_fence_is_signalled(&task->finish)) {
+      struct lp_cs_local_mem lmem;
+
+      memset(&lmem, 0, sizeof(lmem));
+      lp_cs_tpool_run_task(pool, task, pool->num_threads, &lmem);
+      lp_cs_local_mem_fini(&lmem);
+   }
+
+   util_queue_fence_wait(&task->finish);
+
+   /* Order the retirement after the last use of the task by any worker. */
+   (void) p_atomic_read(&task->iter_finished);
+
    mtx_lock(&pool->m);
-   while (task->iter_finished < task->iter_total)
-      cnd_wait(&task->finish, &pool->m);
+   p_atomic_set(&task->active, false);
+   task->in_use = false;
+   cnd_signal(&pool->task_free);
    mtx_unlock(&pool->m);
 
-   cnd_destroy(&task->finish);
-   FREE(task);
    *task_handle = NULL;
 }
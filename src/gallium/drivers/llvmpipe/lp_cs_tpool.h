@@ -30,47 +30,83 @@
  * structs with just unique indexes in them.
  * It also supports a local memory support struct to be passed from
  * outside the thread exec function.
+ *
+ * Handing out iterations is lock-free: each worker owns a contiguous
+ * range of every task's iterations and takes chunks from its front,
+ * and workers which run out steal the back half of someone else's
+ * range.  The mutex is only taken to queue/retire a task and by idle
+ * workers going to sleep.  Several tasks may be in flight at once, and
+ * the thread waiting for a task helps executing it.
  */
 #ifndef LP_CS_QUEUE
 #define LP_CS_QUEUE
 
 #include "util/compiler.h"
 
+#include "util/u_queue.h"
 #include "util/u_thread.h"
-#include "util/list.h"
 
 #include "lp_limits.h"
 
-struct lp_cs_tpool {
-   mtx_t m;
-   cnd_t new_work;
+/* Maximum number of tasks queued at the same time. */
+#define LP_CS_TPOOL_MAX_TASKS 16
 
-   thrd_t threads[LP_MAX_THREADS];
-   unsigned num_threads;
-   struct list_head workqueue;
-   bool shutdown;
-};
+struct lp_build_format_cache;
 
 struct lp_cs_local_mem {
    unsigned local_size;
    void *local_mem_ptr;
+   /* Texture block cache, created by the task function on first use and
+    * emptied whenever the thread moves on to another task.
+    */
+   struct lp_build_format_cache *format_cache;
+   unsigned task_seq;
 };
 
 typedef void (*lp_cs_tpool_task_func)(void *data, int iter_idx, struct lp_cs_local_mem *lmem);
 
+/* A range of iterations, begin in the low and end in the high 32 bits,
+ * padded to avoid false sharing between workers.
+ */
+struct lp_cs_tpool_range {
+   alignas(64) uint64_t iters;
+};
+
 struct lp_cs_tpool_task {
    lp_cs_tpool_task_func work;
    void *data;
-   struct list_head list;
-   cnd_t finish;
+   unsigned seq;
+   unsigned chunk;
    unsigned iter_total;
-   unsigned iter_start;
    unsigned iter_finished;
-   unsigned iter_per_thread;
-   unsigned iter_remainder;
+   bool active;
+   bool in_use;
+   struct util_queue_fence finish;
+   struct lp_cs_tpool_range *ranges;   /* [num_threads] */
+};
+
+struct lp_cs_tpool_worker {
+   struct lp_cs_tpool *pool;
+   unsigned index;
+};
+
+struct lp_cs_tpool {
+   mtx_t m;
+   cnd_t new_work;
+   cnd_t task_free;
+
+   thrd_t *threads;
+   struct lp_cs_tpool_worker *workers;
+   unsigned num_threads;   /* number of iteration ranges per task */
+   unsigned num_started;   /* number of worker threads running */
+   unsigned generation;
+   unsigned task_seq;
+   bool shutdown;
+
+   struct lp_cs_tpool_task tasks[LP_CS_TPOOL_MAX_TASKS];
 };
 
-struct lp_cs_tpool *lp_cs_tpool_create(unsigned num_threads);
+struct lp_cs_tpool *lp_cs_tpool_create(unsigned num_threads, bool pin_threads);
 void lp_cs_tpool_destroy(struct lp_cs_tpool *);
 
 struct lp_cs_tpool_task *lp_cs_tpool_queue_task(struct lp_cs_tpool *,
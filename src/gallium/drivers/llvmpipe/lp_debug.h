@@ -65,6 +65,8 @@
 #define PERF_NO_ALPHATEST   0x80  	/* disable alpha testing */
 #define PERF_NO_RAST_LINEAR 0x100  	/* disable linear rast */
 #define PERF_NO_SHADE       0x200  	/* disable fragment shaders */
+#define PERF_NO_BIN_SCHED   0x400  	/* hand out bins in raster order */
+#define PERF_NO_HIZ         0x800  	/* no hierarchical depth culling */
 
 
 extern int LP_PERF;
@@ -73,6 +73,9 @@ llvmpipe_draw_vbo(struct pipe_context *pipe, const struct pipe_draw_info *info,
       return;
    }
 
+   if (lp->fs_pending)
+      llvmpipe_poll_fs_pending(lp);
+
    if (lp->dirty)
       llvmpipe_update_derived(lp);
 
@@ -261,14 +261,18 @@ lp_fence_get_fd(struct pipe_screen *pscreen,
    struct lp_fence *lp_fence = (struct lp_fence *)fence;
 
    /* It's not ideal, but since we cannot properly support sync files
-    * from userspace, what we will do instead is wait for llvmpipe to
-    * finish rendering, and then export the sync file. If its not a
-    * sync file we imported we can just export a dummy one that is always
-    * signalled since llvmpipe should have now finished all its work.
+    * from userspace, what we will do instead is wait for the rendering the
+    * fence was created for to finish, and then export the sync file. If its
+    * not a sync file we imported we can just export a dummy one that is
+    * always signalled since llvmpipe should have now finished that work.
+    *
+    * The fence comes from flushing the calling context, which has been
+    * synchronized with its threaded_context already.  The other contexts
+    * belong to other threads and aren't touched.
     */
-   list_for_each_entry(struct llvmpipe_context, ctx, &screen->ctx_list, list) {
-      llvmpipe_finish((struct pipe_context *)ctx, __func__);
-   }
+   if (lp_fence && lp_fence->type == LP_FENCE_TYPE_SW &&
+       !lp_fence_signalled(lp_fence))
+      lp_fence_wait(lp_fence);
 
    if (lp_fence && lp_fence->sync_fd != -1) {
       return os_dupfd_cloexec(lp_fence->sync_fd);
@@ -59,6 +59,12 @@ llvmpipe_flush(struct pipe_context *pipe,
    /* ask the setup module to flush */
    lp_setup_flush(llvmpipe->setup, reason);
 
+   /* Everything the threaded context executed so far is in the scenes now,
+    * which llvmpipe_is_resource_busy() tracks.
+    */
+   if (llvmpipe->tc)
+      tc_driver_internal_flush_notify(llvmpipe->tc);
+
    mtx_lock(&screen->rast_mutex);
    lp_rast_fence(screen->rast, (struct lp_fence **)fence);
    mtx_unlock(&screen->rast_mutex);
@@ -66,7 +66,12 @@
 
 #define LP_MAX_SAMPLES 4
 
-#define LP_MAX_THREADS 32
+/**
+ * Upper bound on the number of rasterizer / compute threads.  Per-thread
+ * state is sized from the actual thread count, this only guards against
+ * nonsensical LP_NUM_THREADS values.
+ */
+#define LP_MAX_THREADS 1024
 
 
 /**
@@ -33,6 +33,7 @@
 #include "util/u_pack_color.h"
 #include "util/u_rect.h"
 #include "util/u_sse.h"
+#include "util/format/u_format.h"
 
 #include "lp_jit.h"
 #include "lp_rast.h"
@@ -98,6 +99,7 @@ lp_fs_linear_run(const struct lp_rast_state *state,
        dady[0][3] != 0.0f) {
       if (LP_DEBUG & DEBUG_LINEAR2)
          debug_printf("  -- w not constant\n");
+      LP_COUNT(nr_linear_fallback[LP_LINEAR_FALLBACK_W]);
       goto fail;
    }
 
@@ -110,6 +112,7 @@ lp_fs_linear_run(const struct lp_rast_state *state,
       if (val < 0.0f || val > 1.0f) {
          if (LP_DEBUG & DEBUG_LINEAR2)
             debug_printf("  -- const[%d] out of range %f\n", i, val);
+         LP_COUNT(nr_linear_fallback[LP_LINEAR_FALLBACK_CONSTANT]);
          goto fail;
       }
       constants[i] = (uint8_t)(val * 255.0f);
@@ -156,6 +159,7 @@ lp_fs_linear_run(const struct lp_rast_state *state,
                                  dady[i+1])) {
          if (LP_DEBUG & DEBUG_LINEAR2)
             debug_printf("  -- init_interp(%d) failed\n", i);
+         LP_COUNT(nr_linear_fallback[LP_LINEAR_FALLBACK_INTERP]);
          goto fail;
       }
 
@@ -188,6 +192,7 @@ lp_fs_linear_run(const struct lp_rast_state *state,
                   x, y, width, height, a0, dadx, dady, rgba_order)) {
          if (LP_DEBUG & DEBUG_LINEAR2)
             debug_printf("  -- init_sampler(%d) failed\n", i);
+         LP_COUNT(nr_linear_fallback[LP_LINEAR_FALLBACK_TEXCOORD]);
          goto fail;
       }
 
@@ -295,6 +300,7 @@ lp_linear_check_variant(struct lp_fragment_shader_variant *variant)
        info->base.file_max[TGSI_FILE_INPUT] >= LP_MAX_LINEAR_INPUTS) {
       if (LP_DEBUG & DEBUG_LINEAR)
          debug_printf("  -- too many inputs/constants\n");
+      variant->linear_fallback = LP_LINEAR_FALLBACK_SHADER;
       goto fail;
    }
 
@@ -320,6 +326,7 @@ lp_linear_check_variant(struct lp_fragment_shader_variant *variant)
       if (info->base.input_interpolate[unit] != TGSI_INTERPOLATE_PERSPECTIVE) {
          if (LP_DEBUG & DEBUG_LINEAR)
             debug_printf(" -- samp[%d]: texcoord not perspective\n", i);
+         variant->linear_fallback = LP_LINEAR_FALLBACK_SAMPLER;
          goto fail;
       }
 
@@ -328,6 +335,7 @@ lp_linear_check_variant(struct lp_fragment_shader_variant *variant)
       if (!lp_linear_check_sampler(samp, tex_info)) {
          if (LP_DEBUG & DEBUG_LINEAR)
             debug_printf(" -- samp[%d]: check_sampler failed\n", i);
+         variant->linear_fallback = LP_LINEAR_FALLBACK_SAMPLER;
          goto fail;
       }
    }
@@ -337,6 +345,7 @@ lp_linear_check_variant(struct lp_fragment_shader_variant *variant)
    if (variant->linear_function == NULL) {
       if (LP_DEBUG & DEBUG_LINEAR)
          debug_printf("  -- no linear shader\n");
+      variant->linear_fallback = LP_LINEAR_FALLBACK_SHADER;
       goto fail;
    }
 
@@ -376,3 +385,89 @@ lp_linear_check_variant(struct lp_fragment_shader_variant *variant)
 {
 }
 #endif
+
+
+/* Formats which the blit and blend fastpaths can read and write as
+ * 32-bit words: unorm RGBA with 8 or 10 bits per color channel.  Returns
+ * the bits holding the alpha (or X) channel, or zero if the format isn't
+ * one of those.
+ */
+uint32_t
+lp_linear_format_alpha_mask(enum pipe_format format)
+{
+   switch (format) {
+   case PIPE_FORMAT_B8G8R8A8_UNORM:
+   case PIPE_FORMAT_B8G8R8X8_UNORM:
+   case PIPE_FORMAT_R8G8B8A8_UNORM:
+   case PIPE_FORMAT_R8G8B8X8_UNORM:
+      return 0xff000000;
+   case PIPE_FORMAT_B10G10R10A2_UNORM:
+   case PIPE_FORMAT_B10G10R10X2_UNORM:
+   case PIPE_FORMAT_R10G10B10A2_UNORM:
+   case PIPE_FORMAT_R10G10B10X2_UNORM:
+      return 0xc0000000;
+   default:
+      return 0;
+   }
+}
+
+
+static enum pipe_format
+linear_format_rgbx(enum pipe_format format)
+{
+   switch (format) {
+   case PIPE_FORMAT_B8G8R8A8_UNORM:
+      return PIPE_FORMAT_B8G8R8X8_UNORM;
+   case PIPE_FORMAT_R8G8B8A8_UNORM:
+      return PIPE_FORMAT_R8G8B8X8_UNORM;
+   case PIPE_FORMAT_B10G10R10A2_UNORM:
+      return PIPE_FORMAT_B10G10R10X2_UNORM;
+   case PIPE_FORMAT_R10G10B10A2_UNORM:
+      return PIPE_FORMAT_R10G10B10X2_UNORM;
+   default:
+      return format;
+   }
+}
+
+
+/* Can a BLIT_RGBA/BLIT_RGB1 shader be implemented by copying the texels
+ * of sampler 0 to a color buffer of cbuf_format?  For BLIT_RGB1 only the
+ * color channels need to match, as the copy sets the alpha bits.
+ */
+bool
+lp_linear_blit_compatible(enum lp_fs_kind kind,
+                          const struct lp_sampler_static_state *samp0,
+                          enum pipe_format cbuf_format)
+{
+   const enum pipe_format tex_format = samp0->texture_state.format;
+
+   /* The blit paths read level zero directly, as linear rows, at
+    * normalized coordinates.
+    */
+   if (!samp0->texture_state.level_zero_only ||
+       !samp0->sampler_state.normalized_coords ||
+       samp0->sampler_state.compare_mode ||
+       samp0->texture_state.tiled ||
+       samp0->texture_state.micro_tiled)
+      return false;
+
+   if (samp0->texture_state.swizzle_r != PIPE_SWIZZLE_X ||
+       samp0->texture_state.swizzle_g != PIPE_SWIZZLE_Y ||
+       samp0->texture_state.swizzle_b != PIPE_SWIZZLE_Z ||
+       (kind == LP_FS_KIND_BLIT_RGBA &&
+        samp0->texture_state.swizzle_a != PIPE_SWIZZLE_W))
+      return false;
+
+   switch (kind) {
+   case LP_FS_KIND_BLIT_RGBA:
+      return tex_format != PIPE_FORMAT_NONE &&
+             util_is_format_compatible(util_format_description(tex_format),
+                                       util_format_description(cbuf_format));
+   case LP_FS_KIND_BLIT_RGB1:
+      return lp_linear_format_alpha_mask(tex_format) &&
+             lp_linear_format_alpha_mask(cbuf_format) &&
+             linear_format_rgbx(tex_format) == linear_format_rgbx(cbuf_format);
+   default:
+      return false;
+   }
+}
@@ -117,6 +117,8 @@ lp_linear_blit_rgb1_blit(const struct lp_rast_state *state,
 {
    const struct lp_jit_resources *resources = &state->jit_resources;
    const struct lp_jit_texture *texture = &resources->textures[0];
+   const uint32_t alpha_mask =
+      lp_linear_format_alpha_mask(state->variant->key.cbuf_format[0]);
 
    LP_DBG(DEBUG_RAST, "%s\n", __func__);
 
@@ -148,7 +150,7 @@ lp_linear_blit_rgb1_blit(const struct lp_rast_state *state,
       uint32_t *dst_row = (uint32_t *)color;
 
       for (x = 0; x < width; x++) {
-         *dst_row++ = *src_row++ | 0xff000000;
+         *dst_row++ = *src_row++ | alpha_mask;
       }
 
       color += stride;
@@ -201,9 +203,13 @@ lp_linear_check_fastpath(struct lp_fragment_shader_variant *variant)
    if (!samp0)
       return false;
 
-   const enum pipe_format tex_format = samp0->texture_state.format;
+   const enum pipe_format cbuf_format = variant->key.cbuf_format[0];
+   const bool blit_compatible =
+      lp_linear_format_alpha_mask(cbuf_format) &&
+      lp_linear_blit_compatible(variant->shader->kind, samp0, cbuf_format);
+
    if (variant->shader->kind == LP_FS_KIND_BLIT_RGBA &&
-       tex_format == PIPE_FORMAT_B8G8R8A8_UNORM &&
+       blit_compatible &&
        is_nearest_clamp_sampler(samp0) &&
        variant->opaque) {
       variant->jit_linear_blit             = lp_linear_blit_rgba_blit;
@@ -211,8 +217,7 @@ lp_linear_check_fastpath(struct lp_fragment_shader_variant *variant)
 
    if (variant->shader->kind == LP_FS_KIND_BLIT_RGB1 &&
        variant->opaque &&
-       (tex_format == PIPE_FORMAT_B8G8R8A8_UNORM ||
-        tex_format == PIPE_FORMAT_B8G8R8X8_UNORM) &&
+       blit_compatible &&
        is_nearest_clamp_sampler(samp0)) {
       variant->jit_linear_blit             = lp_linear_blit_rgb1_blit;
    }
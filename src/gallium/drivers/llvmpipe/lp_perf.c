@@ -25,6 +25,8 @@
  *
  **************************************************************************/
 
+#include <inttypes.h>
+
 #include "util/u_debug.h"
 #include "lp_debug.h"
 #include "lp_perf.h"
@@ -34,6 +36,32 @@
 struct lp_counters lp_count;
 
 
+static const char *
+linear_fallback_name(enum lp_linear_fallback reason)
+{
+   switch (reason) {
+   case LP_LINEAR_FALLBACK_SHADER:
+      return "shader";
+   case LP_LINEAR_FALLBACK_STATE:
+      return "state";
+   case LP_LINEAR_FALLBACK_FORMAT:
+      return "cbuf_format";
+   case LP_LINEAR_FALLBACK_SAMPLER:
+      return "sampler";
+   case LP_LINEAR_FALLBACK_W:
+      return "w_not_constant";
+   case LP_LINEAR_FALLBACK_CONSTANT:
+      return "constant_range";
+   case LP_LINEAR_FALLBACK_INTERP:
+      return "interp_range";
+   case LP_LINEAR_FALLBACK_TEXCOORD:
+      return "texcoord_range";
+   default:
+      return "?";
+   }
+}
+
+
 void
 lp_reset_counters(void)
 {
@@ -49,6 +77,7 @@ lp_print_counters(void)
       float p1, p2, p3, p4, p5, p6;
 
       debug_printf("llvmpipe: nr_triangles:                 %9u\n", lp_count.nr_tris);
+      debug_printf("llvmpipe:   nr_64bit_triangles:         %9u\n", lp_count.nr_tris_64bit);
       debug_printf("llvmpipe: nr_culled_triangles:          %9u\n", lp_count.nr_culled_tris);
       debug_printf("llvmpipe: nr_rectangles:                %9u\n", lp_count.nr_rects);
       debug_printf("llvmpipe: nr_culled_rectangles:         %9u\n", lp_count.nr_culled_rects);
@@ -114,13 +143,65 @@ lp_print_counters(void)
       debug_printf("llvmpipe:   nr_rect_part_4x4:           %9u (%3.0f%% of %u)\n", lp_count.nr_rect_partially_covered_4, p2, total_4);
 
 
+      unsigned total_fallback = 0;
+      for (unsigned i = 0; i < LP_LINEAR_FALLBACK_MAX; i++)
+         total_fallback += lp_count.nr_linear_fallback[i];
+
+      debug_printf("llvmpipe: nr_linear_rects:              %9u\n", lp_count.nr_linear_rects);
+      debug_printf("llvmpipe:   nr_linear_blit:             %9u\n", lp_count.nr_linear_blit);
+      debug_printf("llvmpipe:   nr_linear_shaded:           %9u\n", lp_count.nr_linear_shaded);
+      debug_printf("llvmpipe:   nr_linear_fallback:         %9u\n", total_fallback);
+      for (unsigned i = 0; i < LP_LINEAR_FALLBACK_MAX; i++) {
+         if (lp_count.nr_linear_fallback[i])
+            debug_printf("llvmpipe:     %-27s%9u\n",
+                         linear_fallback_name(i),
+                         lp_count.nr_linear_fallback[i]);
+      }
+
+      debug_printf("llvmpipe: nr_hiz_scans:                 %9u\n", lp_count.nr_hiz_scans);
+      debug_printf("llvmpipe: nr_hiz_culled_64x64:          %9u\n", lp_count.nr_hiz_culled_64);
+      debug_printf("llvmpipe: nr_hiz_culled_16x16:          %9u\n", lp_count.nr_hiz_culled_16);
+
+      debug_printf("llvmpipe: nr_scene_flush_mem:           %9u\n", lp_count.nr_scene_flush_mem);
+      debug_printf("llvmpipe: nr_scene_flush_resources:     %9u\n", lp_count.nr_scene_flush_resources);
+      debug_printf("llvmpipe: nr_scene_blocks_malloced:     %9u\n", lp_count.nr_scene_blocks_malloced);
+      debug_printf("llvmpipe: nr_scene_blocks_recycled:     %9u\n", lp_count.nr_scene_blocks_recycled);
+
       debug_printf("llvmpipe: nr_color_tile_clear:          %9u\n", lp_count.nr_color_tile_clear);
       debug_printf("llvmpipe: nr_color_tile_load:           %9u\n", lp_count.nr_color_tile_load);
       debug_printf("llvmpipe: nr_color_tile_store:          %9u\n", lp_count.nr_color_tile_store);
 
+      p1 = lp_count.nr_texture_cache_access ?
+         100.0 * (float) (lp_count.nr_texture_cache_access -
+                          lp_count.nr_texture_cache_miss) /
+                 (float) lp_count.nr_texture_cache_access : 0.0;
+
+      debug_printf("llvmpipe: nr_texture_cache_access:      %9" PRIu64 "\n", lp_count.nr_texture_cache_access);
+      debug_printf("llvmpipe:   nr_texture_cache_miss:      %9" PRIu64 " (%3.0f%% hit rate)\n", lp_count.nr_texture_cache_miss, p1);
+
       debug_printf("llvmpipe: nr_llvm_compiles:             %u\n", lp_count.nr_llvm_compiles);
+      debug_printf("llvmpipe: nr_async_fs_compiles:         %u\n", lp_count.nr_async_fs_compiles);
+      debug_printf("llvmpipe: nr_fast_tier_fs_compiles:     %u\n", lp_count.nr_fast_tier_fs_compiles);
       debug_printf("llvmpipe: total LLVM compile time:      %.2f sec\n", lp_count.llvm_compile_time / 1000000.0);
       debug_printf("llvmpipe: average LLVM compile time:    %.2f sec\n", lp_count.llvm_compile_time / 1000000.0 / lp_count.nr_llvm_compiles);
 
    }
 }
+
+
+void
+lp_print_thread_counters(unsigned thread_index,
+                         const struct lp_thread_counters *counters)
+{
+   if (LP_DEBUG & DEBUG_COUNTERS) {
+      uint64_t total = counters->busy_time + counters->idle_time;
+      float idle = total ? 100.0 * (float) counters->idle_time / (float) total : 0.0;
+
+      debug_printf("llvmpipe: thread %3u: scenes %7u bins %9u stolen %9u "
+                   "busy %.3f sec idle %.3f sec (%3.0f%%)\n",
+                   thread_index, counters->nr_scenes,
+                   counters->nr_bins, counters->nr_bins_stolen,
+                   counters->busy_time / 1000000000.0,
+                   counters->idle_time / 1000000000.0, idle);
+   }
+}
@@ -34,6 +34,28 @@
 #define LP_PERF_H
 
 #include "util/compiler.h"
+#include "util/u_atomic.h"
+
+
+/**
+ * Why a rectangle on the linear rasterizer path had to be shaded with the
+ * regular SoA shader instead of a linear shader.  The first reasons are
+ * decided when the variant is compiled (see variant->linear_fallback), the
+ * others when the linear shader rejects a particular rectangle.
+ */
+enum lp_linear_fallback
+{
+   LP_LINEAR_FALLBACK_SHADER,   /**< shader isn't a candidate */
+   LP_LINEAR_FALLBACK_STATE,    /**< depth/stencil, discard, logicop, ... */
+   LP_LINEAR_FALLBACK_FORMAT,   /**< color buffer format */
+   LP_LINEAR_FALLBACK_SAMPLER,  /**< texture format, filtering or swizzle */
+   LP_LINEAR_FALLBACK_W,        /**< w not constant */
+   LP_LINEAR_FALLBACK_CONSTANT, /**< constant outside [0,1] */
+   LP_LINEAR_FALLBACK_INTERP,   /**< interpolated input outside [0,1] */
+   LP_LINEAR_FALLBACK_TEXCOORD, /**< texture coordinates out of range */
+   LP_LINEAR_FALLBACK_MAX
+};
+
 
 /**
  * Various counters
@@ -41,6 +63,7 @@
 struct lp_counters
 {
    unsigned nr_tris;
+   unsigned nr_tris_64bit;     /**< tris needing 64-bit rasterization */
    unsigned nr_culled_tris;
    unsigned nr_rects;
    unsigned nr_culled_rects;
@@ -62,22 +85,58 @@ struct lp_counters
    unsigned nr_rect_fully_covered_4;
    unsigned nr_rect_partially_covered_4;
    unsigned nr_non_empty_4;
+   unsigned nr_linear_rects;   /**< rects/tiles on the linear rasterizer */
+   unsigned nr_linear_blit;
+   unsigned nr_linear_shaded;
+   unsigned nr_linear_fallback[LP_LINEAR_FALLBACK_MAX];
+   unsigned nr_hiz_scans;
+   unsigned nr_hiz_culled_64;  /**< primitives skipped for a whole tile */
+   unsigned nr_hiz_culled_16;  /**< 16x16 blocks skipped */
    unsigned nr_llvm_compiles;
+   unsigned nr_async_fs_compiles;  /**< fs variants compiled in background */
+   unsigned nr_fast_tier_fs_compiles;  /**< fs stand-ins for those */
    int64_t llvm_compile_time;  /**< total, in microseconds */
 
+   /* Scene flushes forced by the scene memory budgets.  These are
+    * counted in release builds too.
+    */
+   unsigned nr_scene_flush_mem;
+   unsigned nr_scene_flush_resources;
+   unsigned nr_scene_blocks_malloced;
+   unsigned nr_scene_blocks_recycled;
+
    unsigned nr_color_tile_clear;
    unsigned nr_color_tile_load;
    unsigned nr_color_tile_store;
+
+   uint64_t nr_texture_cache_access;  /**< texels fetched via block cache */
+   uint64_t nr_texture_cache_miss;    /**< blocks decoded into the cache */
 };
 
 
 extern struct lp_counters lp_count;
 
 
-/** Increment the named counter (only for debug builds) */
+/**
+ * Per rasterizer thread counters.  These are only gathered when
+ * LP_DEBUG=counters is set, and are printed when the screen is destroyed.
+ */
+struct lp_thread_counters
+{
+   uint64_t busy_time;    /**< nanoseconds spent rasterizing bins */
+   uint64_t idle_time;    /**< nanoseconds spent waiting for other threads */
+   unsigned nr_scenes;
+   unsigned nr_bins;
+   unsigned nr_bins_stolen;
+};
+
+
+/** Increment the named counter (only for debug builds).  The binning
+ * workers and the rasterizer threads update them concurrently.
+ */
 #if MESA_DEBUG && !THREAD_SANITIZER
-#define LP_COUNT(counter) lp_count.counter++
-#define LP_COUNT_ADD(counter, incr)  lp_count.counter += (incr)
+#define LP_COUNT(counter) p_atomic_inc(&lp_count.counter)
+#define LP_COUNT_ADD(counter, incr)  p_atomic_add(&lp_count.counter, (incr))
 #define LP_COUNT_GET(counter) (lp_count.counter)
 #else
 #define LP_COUNT(counter) do {} while (0)
@@ -94,4 +153,9 @@ extern void
 lp_print_counters(void);
 
 
+extern void
+lp_print_thread_counters(unsigned thread_index,
+                         const struct lp_thread_counters *counters);
+
+
 #endif /* LP_PERF_H */
@@ -33,6 +33,7 @@
 #include "util/u_pack_color.h"
 #include "util/u_string.h"
 #include "util/u_thread.h"
+#include "util/thread_sched.h"
 #include "util/u_memset.h"
 #include "util/os_time.h"
 
@@ -65,6 +66,43 @@ const float lp_sample_pos_4x[4][2] = { { 0.375, 0.125 },
                                        { 0.125, 0.625 },
                                        { 0.625, 0.875 } };
 
+
+/**
+ * Prepare the per-thread bin queues for a new scene.
+ * Returns false if the bins should be handed out in raster order instead,
+ * in which case lp_scene_bin_iter_next() is used.
+ */
+static bool
+bin_sched_begin(struct lp_rasterizer *rast,
+                const struct lp_scene *scene)
+{
+   const unsigned num_bins = scene->tiles_x * scene->tiles_y;
+
+   if (rast->num_threads < 2 || rast->no_rast ||
+       (LP_PERF & PERF_NO_BIN_SCHED))
+      return false;
+
+   if (rast->num_bin_entries < num_bins) {
+      struct lp_rast_bin_entry *entries =
+         REALLOC(rast->bin_entries,
+                 rast->num_bin_entries * sizeof(*entries),
+                 num_bins * sizeof(*entries));
+      if (!entries)
+         return false;
+
+      rast->bin_entries = entries;
+      rast->num_bin_entries = num_bins;
+   }
+
+   /* The threads publish their queues after the barrier in
+    * thread_function(), until then they must look empty.
+    */
+   for (unsigned i = 0; i < rast->num_threads; i++)
+      rast->bin_queues[i].range = 0;
+
+   return true;
+}
+
 /**
  * Begin rasterizing a scene.
  * Called once per scene by one thread.
@@ -74,11 +112,14 @@ lp_rast_begin(struct lp_rasterizer *rast,
               struct lp_scene *scene)
 {
    rast->curr_scene = scene;
+   scene->rast_tasks_pending = MAX2(1, rast->num_threads);
 
    LP_DBG(DEBUG_RAST, "%s\n", __func__);
 
    lp_scene_begin_rasterization(scene);
    lp_scene_bin_iter_begin(scene);
+
+   rast->bin_sched = bin_sched_begin(rast, scene);
 }
 
 
@@ -114,6 +155,11 @@ lp_rast_tile_begin(struct lp_rasterizer_task *task,
    task->thread_data.vis_counter = 0;
    task->thread_data.ps_invocations = 0;
 
+   /* Every bin sets its state before its first command, the previous
+    * state may belong to an older scene.
+    */
+   task->state = NULL;
+
    for (unsigned i = 0; i < scene->fb.nr_cbufs; i++) {
       if (scene->fb.cbufs[i].texture) {
          task->color_tiles[i] = scene->cbufs[i].map +
@@ -126,6 +172,8 @@ lp_rast_tile_begin(struct lp_rasterizer_task *task,
                          scene->zsbuf.stride * task->y +
                          scene->zsbuf.format_bytes * task->x;
    }
+
+   lp_rast_hiz_begin_tile(task);
 }
 
 
@@ -285,6 +333,9 @@ lp_rast_clear_zstencil(struct lp_rasterizer_task *task,
             dst_layer += scene->zsbuf.layer_stride;
          }
       }
+
+      lp_rast_hiz_clear(task, arg.clear_zstencil.value,
+                        arg.clear_zstencil.mask);
    }
 }
 
@@ -317,10 +368,17 @@ lp_rast_shade_tile(struct lp_rasterizer_task *task,
 
    const struct lp_fragment_shader_variant *variant = state->variant;
 
+   const unsigned occluded = lp_rast_hiz_occluded(task, inputs);
+   if (occluded == 0xffff)
+      return;
+
    unsigned view_index = inputs->view_index;
    /* render the whole 64x64 tile in 4x4 chunks */
    for (unsigned y = 0; y < task->height; y += 4){
       for (unsigned x = 0; x < task->width; x += 4) {
+         if ((occluded >> ((y / 16) * 4 + x / 16)) & 1)
+            continue;
+
          /* color buffer */
          uint8_t *color[PIPE_MAX_COLOR_BUFS];
          unsigned stride[PIPE_MAX_COLOR_BUFS];
@@ -429,6 +487,9 @@ lp_rast_shade_quads_mask_sample(struct lp_rasterizer_task *task,
    assert((x % 4) == 0);
    assert((y % 4) == 0);
 
+   if (lp_rast_hiz_block_occluded(task, inputs, x, y))
+      return;
+
    /* color buffer */
    uint8_t *color[PIPE_MAX_COLOR_BUFS];
    unsigned stride[PIPE_MAX_COLOR_BUFS];
@@ -564,7 +625,7 @@ lp_rast_blit_tile_to_dest(struct lp_rasterizer_task *task,
 
       if (variant->shader->kind == LP_FS_KIND_BLIT_RGBA ||
           (variant->shader->kind == LP_FS_KIND_BLIT_RGB1 &&
-           cbuf->format == PIPE_FORMAT_B8G8R8X8_UNORM)) {
+           !util_format_has_alpha(cbuf->format))) {
          util_copy_rect(dst,
                         cbuf->format,
                         dst_stride,
@@ -576,7 +637,8 @@ lp_rast_blit_tile_to_dest(struct lp_rasterizer_task *task,
       }
 
       if (variant->shader->kind == LP_FS_KIND_BLIT_RGB1) {
-         if (cbuf->format == PIPE_FORMAT_B8G8R8A8_UNORM) {
+         const uint32_t alpha_mask = lp_linear_format_alpha_mask(cbuf->format);
+         if (alpha_mask) {
             dst += task->x * 4;
             src += src_x * 4;
             dst += task->y * dst_stride;
@@ -587,7 +649,7 @@ lp_rast_blit_tile_to_dest(struct lp_rasterizer_task *task,
                uint32_t *dst_row = (uint32_t *)dst;
 
                for (int x = 0; x < task->width; ++x) {
-                  *dst_row++ = *src_row++ | 0xff000000;
+                  *dst_row++ = *src_row++ | alpha_mask;
                }
                dst += dst_stride;
                src += src_stride;
@@ -686,6 +748,7 @@ void
 lp_rast_set_state(struct lp_rasterizer_task *task,
                   const union lp_rast_cmd_arg arg)
 {
+   lp_rast_hiz_end_state(task, task->state);
    task->state = arg.set_state;
 }
 
@@ -987,10 +1050,9 @@ debug_rasterize_bin(struct lp_rasterizer_task *task,
  */
 static void
 rasterize_bin(struct lp_rasterizer_task *task,
-              const struct cmd_bin *bin, int x, int y)
+              const struct cmd_bin *bin, int x, int y,
+              struct lp_bin_info info)
 {
-   struct lp_bin_info info = lp_characterize_bin(bin);
-
    lp_rast_tile_begin(task, bin, x, y);
 
    if (LP_DEBUG & DEBUG_NO_FASTPATH) {
@@ -1036,6 +1098,122 @@ is_empty_bin(const struct cmd_bin *bin)
 }
 
 
+static int
+compare_bin_cost(const void *a, const void *b)
+{
+   const struct lp_rast_bin_entry *ea = a, *eb = b;
+
+   /* most expensive first */
+   return (int) eb->info.count - (int) ea->info.count;
+}
+
+
+/**
+ * Characterize this thread's share of the scene's bins, sort them by
+ * decreasing cost and publish them in the thread's queue.
+ *
+ * Bins are dealt round-robin in raster order so that each thread starts
+ * with a similar mix of cheap and expensive tiles.
+ */
+static void
+bin_sched_fill_queue(struct lp_rasterizer_task *task,
+                     struct lp_scene *scene)
+{
+   struct lp_rasterizer *rast = task->rast;
+   const unsigned num_threads = rast->num_threads;
+   const unsigned index = task->thread_index;
+   const unsigned num_bins = scene->tiles_x * scene->tiles_y;
+   const unsigned start = index * (num_bins / num_threads) +
+                          MIN2(index, num_bins % num_threads);
+   struct lp_rast_bin_entry *entries = rast->bin_entries + start;
+   unsigned count = 0;
+
+   for (unsigned k = index; k < num_bins; k += num_threads) {
+      const unsigned x = k % scene->tiles_x;
+      const unsigned y = k / scene->tiles_x;
+      const struct cmd_bin *bin = lp_scene_get_bin(scene, x, y);
+
+      if (is_empty_bin(bin))
+         continue;
+
+      entries[count].info = lp_characterize_bin(bin);
+      entries[count].x = x;
+      entries[count].y = y;
+      count++;
+   }
+
+   qsort(entries, count, sizeof(*entries), compare_bin_cost);
+
+   p_atomic_set(&rast->bin_queues[index].range,
+                ((uint64_t) start << 32) | (start + count));
+}
+
+
+/**
+ * Claim the next bin of a queue, from the head (owner) or the tail (thief).
+ * Returns false once the queue is empty.
+ */
+static bool
+bin_queue_pop(struct lp_rast_bin_queue *queue, bool steal, unsigned *entry)
+{
+   uint64_t range = p_atomic_read(&queue->range);
+
+   for (;;) {
+      const uint32_t head = range >> 32;
+      const uint32_t tail = (uint32_t) range;
+      uint64_t new_range, old_range;
+
+      if (head >= tail)
+         return false;
+
+      if (steal)
+         new_range = ((uint64_t) head << 32) | (tail - 1);
+      else
+         new_range = ((uint64_t) (head + 1) << 32) | tail;
+
+      old_range = p_atomic_cmpxchg(&queue->range, range, new_range);
+      if (old_range == range) {
+         *entry = steal ? tail - 1 : head;
+         return true;
+      }
+
+      range = old_range;
+   }
+}
+
+
+/**
+ * Rasterize this thread's own queue, most expensive bins first, then
+ * steal the cheapest remaining bins from the other threads' queues.
+ */
+static void
+rasterize_scene_bins_sched(struct lp_rasterizer_task *task,
+                           struct lp_scene *scene)
+{
+   struct lp_rasterizer *rast = task->rast;
+   const unsigned num_threads = rast->num_threads;
+   unsigned entry;
+
+   bin_sched_fill_queue(task, scene);
+
+   for (unsigned i = 0; i < num_threads; i++) {
+      const unsigned victim = (task->thread_index + i) % num_threads;
+      const bool steal = victim != task->thread_index;
+
+      while (bin_queue_pop(&rast->bin_queues[victim], steal, &entry)) {
+         const struct lp_rast_bin_entry *e = &rast->bin_entries[entry];
+
+         rasterize_bin(task, lp_scene_get_bin(scene, e->x, e->y),
+                       e->x, e->y, e->info);
+
+         task->counters.nr_bins++;
+         if (steal)
+            task->counters.nr_bins_stolen++;
+      }
+   }
+}
+
+
 /**
  * Rasterize/execute all bins within a scene.
  * Called per thread.
@@ -1046,43 +1224,43 @@ rasterize_scene(struct lp_rasterizer_task *task,
 {
    task->scene = scene;
 
+   lp_rast_hiz_begin_scene(task);
+
    /* Clear the cache tags. This should not always be necessary but
     * simpler for now.
     */
-#if LP_USE_TEXTURE_CACHE
-   memset(task->thread_data.cache->cache_tags, 0,
-          sizeof(task->thread_data.cache->cache_tags));
-#if LP_BUILD_FORMAT_CACHE_DEBUG
-   task->thread_data.cache->cache_access_total = 0;
-   task->thread_data.cache->cache_access_miss = 0;
-#endif
-#endif
+   if (task->thread_data.cache)
+      lp_build_format_cache_reset(task->thread_data.cache);
 
-   if (!task->rast->no_rast) {
+   if (task->rast->bin_sched) {
+      assert(scene);
+      rasterize_scene_bins_sched(task, scene);
+   } else if (!task->rast->no_rast) {
       /* loop over scene bins, rasterize each */
       struct cmd_bin *bin;
       int i, j;
 
       assert(scene);
       while ((bin = lp_scene_bin_iter_next(scene, &i, &j))) {
-         if (!is_empty_bin(bin))
-            rasterize_bin(task, bin, i, j);
+         if (!is_empty_bin(bin)) {
+            rasterize_bin(task, bin, i, j, lp_characterize_bin(bin));
+            task->counters.nr_bins++;
+         }
       }
    }
 
-#if LP_BUILD_FORMAT_CACHE_DEBUG
-   {
-      uint64_t total, miss;
-      total = task->thread_data.cache->cache_access_total;
-      miss = task->thread_data.cache->cache_access_miss;
-      if (total) {
-         debug_printf("thread %d cache access %llu miss %llu hit rate %f\n",
-                 task->thread_index, (long long unsigned)total,
-                 (long long unsigned)miss,
-                 (float)(total - miss)/(float)total);
-      }
+   if (task->thread_data.cache) {
+      LP_COUNT_ADD(nr_texture_cache_access,
+                   task->thread_data.cache->access_total);
+      LP_COUNT_ADD(nr_texture_cache_miss,
+                   task->thread_data.cache->access_miss);
    }
-#endif
+
+   /* The last task done with the scene marks its resources idle before the
+    * fence signals, see llvmpipe_is_resource_busy().
+    */
+   if (p_atomic_dec_zero(&scene->rast_tasks_pending))
+      lp_scene_resources_idle(scene);
 
    if (scene->fence) {
       lp_fence_signal(scene->fence);
@@ -1201,11 +1379,24 @@ thread_function(void *init_data)
       if (debug)
          debug_printf("thread %d doing work\n", task->thread_index);
 
+      int64_t busy_start = 0, idle_start = 0;
+      if (LP_DEBUG & DEBUG_COUNTERS)
+         busy_start = os_time_get_nano();
+
       rasterize_scene(task, rast->curr_scene);
 
+      if (LP_DEBUG & DEBUG_COUNTERS)
+         idle_start = os_time_get_nano();
+
       /* wait for all threads to finish with this scene */
       util_barrier_wait(&rast->barrier);
 
+      if (LP_DEBUG & DEBUG_COUNTERS) {
+         task->counters.busy_time += idle_start - busy_start;
+         task->counters.idle_time += os_time_get_nano() - idle_start;
+         task->counters.nr_scenes++;
+      }
+
       /* XXX: shouldn't be necessary:
        */
       if (task->thread_index == 0) {
@@ -1229,9 +1420,11 @@ thread_function(void *init_data)
 
 /**
  * Initialize semaphores and spawn the threads.
+ * If pin_threads is set, the threads are spread evenly over the L3 core
+ * complexes so that the tiles a thread works on stay in one cache domain.
  */
 static void
-create_rast_threads(struct lp_rasterizer *rast)
+create_rast_threads(struct lp_rasterizer *rast, bool pin_threads)
 {
    /* NOTE: if num_threads is zero, we won't use any threads */
    for (unsigned i = 0; i < rast->num_threads; i++) {
@@ -1246,6 +1439,11 @@ create_rast_threads(struct lp_rasterizer *rast)
          break;
       }
    }
+
+   if (pin_threads) {
+      for (unsigned i = 0; i < rast->num_threads; i++)
+         util_thread_sched_pin_worker(rast->threads[i], i, rast->num_threads);
+   }
 }
 
 
@@ -1253,28 +1451,49 @@ create_rast_threads(struct lp_rasterizer *rast)
  * Create new lp_rasterizer.  If num_threads is zero, don't create any
  * new threads, do rendering synchronously.
  * \param num_threads  number of rasterizer threads to create
+ * \param pin_threads  restrict each thread to one L3 core complex
  */
 struct lp_rasterizer *
-lp_rast_create(unsigned num_threads)
+lp_rast_create(unsigned num_threads, bool pin_threads)
 {
    struct lp_rasterizer *rast = CALLOC_STRUCT(lp_rasterizer);
    if (!rast) {
       goto no_rast;
    }
 
+   rast->tasks = CALLOC(MAX2(1, num_threads), sizeof(*rast->tasks));
+   if (!rast->tasks) {
+      goto no_tasks;
+   }
+
+   if (num_threads > 0) {
+      rast->threads = CALLOC(num_threads, sizeof(*rast->threads));
+      if (!rast->threads) {
+         goto no_threads;
+      }
+
+      rast->bin_queues = align_calloc(num_threads * sizeof(*rast->bin_queues),
+                                      CACHE_LINE_SIZE);
+      if (!rast->bin_queues) {
+         goto no_bin_queues;
+      }
+   }
+
    rast->full_scenes = lp_scene_queue_create();
    if (!rast->full_scenes) {
       goto no_full_scenes;
    }
 
+   const unsigned cache_blocks = lp_texture_cache_blocks();
    for (unsigned i = 0; i < MAX2(1, num_threads); i++) {
       struct lp_rasterizer_task *task = &rast->tasks[i];
       task->rast = rast;
       task->thread_index = i;
-      task->thread_data.cache =
-         align_malloc(sizeof(struct lp_build_format_cache), 16);
-      if (!task->thread_data.cache) {
-         goto no_thread_data_cache;
+      if (cache_blocks) {
+         task->thread_data.cache = lp_build_format_cache_create(cache_blocks);
+         if (!task->thread_data.cache) {
+            goto no_thread_data_cache;
+         }
       }
    }
 
@@ -1282,7 +1501,7 @@ lp_rast_create(unsigned num_threads)
 
    rast->no_rast = debug_get_bool_option("LP_NO_RAST", false);
 
-   create_rast_threads(rast);
+   create_rast_threads(rast, pin_threads);
 
    /* for synchronizing rasterization threads */
    if (rast->num_threads > 0) {
@@ -1294,14 +1513,18 @@ lp_rast_create(unsigned num_threads)
    return rast;
 
 no_thread_data_cache:
-   for (unsigned i = 0; i < MAX2(1, rast->num_threads); i++) {
-      if (rast->tasks[i].thread_data.cache) {
-         align_free(rast->tasks[i].thread_data.cache);
-      }
+   for (unsigned i = 0; i < MAX2(1, num_threads); i++) {
+      lp_build_format_cache_destroy(rast->tasks[i].thread_data.cache);
    }
 
    lp_scene_queue_destroy(rast->full_scenes);
 no_full_scenes:
+   align_free(rast->bin_queues);
+no_bin_queues:
+   FREE(rast->threads);
+no_threads:
+   FREE(rast->tasks);
+no_tasks:
    FREE(rast);
 no_rast:
    return NULL;
@@ -1349,7 +1572,8 @@ lp_rast_destroy(struct lp_rasterizer *rast)
 #endif
    }
    for (unsigned i = 0; i < MAX2(1, rast->num_threads); i++) {
-      align_free(rast->tasks[i].thread_data.cache);
+      lp_print_thread_counters(i, &rast->tasks[i].counters);
+      lp_build_format_cache_destroy(rast->tasks[i].thread_data.cache);
    }
 
    lp_fence_reference(&rast->last_fence, NULL);
@@ -1361,6 +1585,10 @@ lp_rast_destroy(struct lp_rasterizer *rast)
 
    lp_scene_queue_destroy(rast->full_scenes);
 
+   align_free(rast->bin_queues);
+   FREE(rast->bin_entries);
+   FREE(rast->threads);
+   FREE(rast->tasks);
    FREE(rast);
 }
 
@@ -0,0 +1,503 @@
+/*
+ * Copyright © 2026 The Mesa Authors
+ * SPDX-License-Identifier: MIT
+ */
+
+/*
+ * Hierarchical depth culling.
+ *
+ * Each rasterizer thread keeps conservative min/max bounds of the depth
+ * values in the tile it is working on, for the whole tile and for each of
+ * its 16x16 blocks.  Before a primitive is shaded in a tile, the range of
+ * its depth plane over the tile (and over each block) is compared against
+ * those bounds, and tiles/blocks where the depth test is known to fail
+ * everywhere are skipped without running the fragment shader.
+ *
+ * The bounds are exact after a depth clear, and are otherwise obtained by
+ * scanning the depth buffer.  Depth writes with a LESS-like function can
+ * only lower values, so the max bound stays valid while such a state is
+ * active (and vice versa for GREATER-like functions).  When a state that
+ * wrote depth is replaced, the bounds it may have invalidated are marked
+ * stale and rescanned on the next use.
+ */
+
+#include <float.h>
+#include <math.h>
+#include "util/format/u_format.h"
+#include "util/u_math.h"
+#include "lp_debug.h"
+#include "lp_perf.h"
+#include "lp_rast_priv.h"
+#include "lp_state_fs.h"
+
+
+/**
+ * Rescan a valid but possibly loose summary after this many checks, if
+ * depth has been written in the meantime.
+ */
+#define LP_HIZ_RESCAN_CHECKS 32
+
+/**
+ * Don't rescan a stale summary more often than every this many checks.
+ */
+#define LP_HIZ_MIN_RESCAN_CHECKS 4
+
+
+/**
+ * Setup the depth decoding for a new scene.
+ */
+void
+lp_rast_hiz_begin_scene(struct lp_rasterizer_task *task)
+{
+   const struct lp_scene *scene = task->scene;
+   struct lp_rast_hiz *hiz = &task->hiz;
+
+   hiz->enabled = false;
+
+   if (!UTIL_ARCH_LITTLE_ENDIAN ||
+       (LP_PERF & PERF_NO_HIZ) ||
+       !scene->fb.zsbuf.texture ||
+       !scene->zsbuf.map ||
+       scene->zsbuf.nr_samples > 1 ||
+       scene->fb_max_layer > 0)
+      return;
+
+   const struct util_format_description *desc =
+      util_format_description(scene->fb.zsbuf.format);
+   if (!desc || !util_format_has_depth(desc) || desc->swizzle[0] >= 4)
+      return;
+
+   const struct util_format_channel_description *chan =
+      &desc->channel[desc->swizzle[0]];
+
+   switch (desc->block.bits) {
+   case 16:
+   case 32:
+   case 64:
+      break;
+   default:
+      return;
+   }
+
+   if (chan->type == UTIL_FORMAT_TYPE_FLOAT && chan->size == 32) {
+      hiz->is_float = true;
+      hiz->scale = 1.0f;
+      hiz->quantum = 0.0f;
+   } else if (chan->type == UTIL_FORMAT_TYPE_UNSIGNED && chan->normalized &&
+              chan->size <= 32) {
+      const double max = (double) u_uintN_max(chan->size);
+      hiz->is_float = false;
+      hiz->scale = (float) (1.0 / max);
+      /* Allow for the rounding of the fragment depth to the format. */
+      hiz->quantum = (float) (2.0 / max);
+   } else {
+      return;
+   }
+
+   hiz->format_bytes = desc->block.bits / 8;
+   hiz->shift = chan->shift;
+   hiz->mask = u_uintN_max(chan->size);
+   hiz->enabled = true;
+}
+
+
+/**
+ * Beginning of a new tile: nothing is known about its depth values.
+ */
+void
+lp_rast_hiz_begin_tile(struct lp_rasterizer_task *task)
+{
+   struct lp_rast_hiz *hiz = &task->hiz;
+
+   hiz->stale_min = true;
+   hiz->stale_max = true;
+   hiz->dirty = false;
+   hiz->checks = LP_HIZ_MIN_RESCAN_CHECKS;
+   hiz->inputs = NULL;
+}
+
+
+static inline float
+hiz_decode(const struct lp_rast_hiz *hiz, uint64_t value)
+{
+   const uint64_t bits = (value >> hiz->shift) & hiz->mask;
+
+   if (hiz->is_float)
+      return uif((uint32_t) bits);
+
+   return (float) bits * hiz->scale;
+}
+
+
+static inline uint64_t
+hiz_load(const uint8_t *ptr, unsigned format_bytes)
+{
+   switch (format_bytes) {
+   case 2:
+      return *(const uint16_t *) ptr;
+   case 4:
+      return *(const uint32_t *) ptr;
+   default:
+      return *(const uint64_t *) ptr;
+   }
+}
+
+
+/**
+ * Compute exact bounds from the current contents of the depth buffer.
+ */
+static void
+hiz_scan(struct lp_rasterizer_task *task)
+{
+   const struct lp_scene *scene = task->scene;
+   struct lp_rast_hiz *hiz = &task->hiz;
+   const unsigned stride = scene->zsbuf.stride;
+   const unsigned bytes = hiz->format_bytes;
+
+   for (unsigned i = 0; i < 16; i++) {
+      /* Blocks outside of the framebuffer have no pixels to shade. */
+      hiz->block_min[i] = INFINITY;
+      hiz->block_max[i] = -INFINITY;
+   }
+
+   for (unsigned y = 0; y < task->height; y++) {
+      const uint8_t *row = task->depth_tile + y * stride;
+      float *block_min = &hiz->block_min[(y / 16) * 4];
+      float *block_max = &hiz->block_max[(y / 16) * 4];
+
+      for (unsigned x = 0; x < task->width; x++) {
+         const float z = hiz_decode(hiz, hiz_load(row + x * bytes, bytes));
+         block_min[x / 16] = MIN2(block_min[x / 16], z);
+         block_max[x / 16] = MAX2(block_max[x / 16], z);
+      }
+   }
+
+   hiz->tile_min = INFINITY;
+   hiz->tile_max = -INFINITY;
+   for (unsigned i = 0; i < 16; i++) {
+      hiz->tile_min = MIN2(hiz->tile_min, hiz->block_min[i]);
+      hiz->tile_max = MAX2(hiz->tile_max, hiz->block_max[i]);
+   }
+
+   hiz->stale_min = false;
+   hiz->stale_max = false;
+   hiz->dirty = false;
+   hiz->checks = 0;
+
+   LP_COUNT(nr_hiz_scans);
+}
+
+
+/**
+ * A depth/stencil clear of the whole tile.
+ */
+void
+lp_rast_hiz_clear(struct lp_rasterizer_task *task,
+                  uint64_t clear_value, uint64_t clear_mask)
+{
+   struct lp_rast_hiz *hiz = &task->hiz;
+
+   if (!hiz->enabled)
+      return;
+
+   const uint64_t depth_mask = hiz->mask << hiz->shift;
+
+   hiz->inputs = NULL;
+
+   if ((clear_mask & depth_mask) == 0) {
+      /* stencil only */
+      return;
+   }
+
+   if ((clear_mask & depth_mask) != depth_mask) {
+      hiz->stale_min = true;
+      hiz->stale_max = true;
+      return;
+   }
+
+   const float z = hiz_decode(hiz, clear_value);
+
+   hiz->tile_min = hiz->tile_max = z;
+   for (unsigned i = 0; i < 16; i++) {
+      hiz->block_min[i] = z;
+      hiz->block_max[i] = z;
+   }
+
+   hiz->stale_min = false;
+   hiz->stale_max = false;
+   hiz->dirty = false;
+   hiz->checks = 0;
+}
+
+
+/**
+ * The given state is being replaced: account for the depth values its
+ * primitives may have written.
+ */
+void
+lp_rast_hiz_end_state(struct lp_rasterizer_task *task,
+                      const struct lp_rast_state *state)
+{
+   struct lp_rast_hiz *hiz = &task->hiz;
+
+   if (!hiz->enabled || !state || !state->variant)
+      return;
+
+   const struct lp_depth_state *depth = &state->variant->key.depth;
+
+   hiz->inputs = NULL;
+
+   if (!depth->enabled || !depth->writemask)
+      return;
+
+   switch (depth->func) {
+   case PIPE_FUNC_NEVER:
+   case PIPE_FUNC_EQUAL:
+      break;
+   case PIPE_FUNC_LESS:
+   case PIPE_FUNC_LEQUAL:
+      hiz->stale_min = true;
+      break;
+   case PIPE_FUNC_GREATER:
+   case PIPE_FUNC_GEQUAL:
+      hiz->stale_max = true;
+      break;
+   default:
+      hiz->stale_min = true;
+      hiz->stale_max = true;
+      break;
+   }
+}
+
+
+/**
+ * The depth plane of a primitive, as the fragment shader evaluates it.
+ */
+struct hiz_plane
+{
+   unsigned func;
+   float z0, dzdx, dzdy;
+   float err;
+   bool restrict_depth;
+   bool clamp_viewport;
+   bool unorm;
+   float min_depth, max_depth;
+   float quantum;
+};
+
+
+static inline float
+hiz_plane_clamp(const struct hiz_plane *p, float z)
+{
+   if (p->restrict_depth)
+      z = CLAMP(z, 0.0f, 1.0f);
+   if (p->clamp_viewport)
+      z = CLAMP(z, p->min_depth, p->max_depth);
+   if (p->unorm)
+      z = CLAMP(z, 0.0f, 1.0f);
+   return z;
+}
+
+
+/**
+ * Will the primitive fail the depth test everywhere in the window-space
+ * box [x0, x1] x [y0, y1], given the depth bounds of that box?
+ */
+static inline bool
+hiz_plane_occluded(const struct hiz_plane *p,
+                   float x0, float y0, float x1, float y1,
+                   float bound_min, float bound_max)
+{
+   const float z = p->z0 + p->dzdx * x0 + p->dzdy * y0;
+   const float ex = p->dzdx * (x1 - x0);
+   const float ey = p->dzdy * (y1 - y0);
+
+   float zmin = z + MIN2(ex, 0.0f) + MIN2(ey, 0.0f) - p->err;
+   float zmax = z + MAX2(ex, 0.0f) + MAX2(ey, 0.0f) + p->err;
+
+   zmin = hiz_plane_clamp(p, zmin) - p->quantum;
+   zmax = hiz_plane_clamp(p, zmax) + p->quantum;
+
+   /* NaNs compare false and are never culled. */
+   switch (p->func) {
+   case PIPE_FUNC_LESS:
+   case PIPE_FUNC_LEQUAL:
+      return zmin > bound_max;
+   case PIPE_FUNC_GREATER:
+   case PIPE_FUNC_GEQUAL:
+      return zmax < bound_min;
+   case PIPE_FUNC_EQUAL:
+      return zmin > bound_max || zmax < bound_min;
+   default:
+      return false;
+   }
+}
+
+
+/**
+ * Check whether the primitive can be culled against the current state's
+ * depth test, and make sure the bounds it needs are up to date.
+ */
+static bool
+hiz_plane_init(struct lp_rasterizer_task *task,
+               const struct lp_rast_shader_inputs *inputs,
+               struct hiz_plane *p)
+{
+   struct lp_rast_hiz *hiz = &task->hiz;
+   const struct lp_rast_state *state = task->state;
+
+   if (!state || !state->variant || !state->variant->hiz_cull ||
+       inputs->layer != 0 || inputs->view_index != 0)
+      return false;
+
+   const struct lp_fragment_shader_variant_key *key = &state->variant->key;
+
+   if (key->depth_clamp && !state->jit_context.viewports)
+      return false;
+   bool need_min, need_max;
+
+   switch (key->depth.func) {
+   case PIPE_FUNC_LESS:
+   case PIPE_FUNC_LEQUAL:
+      need_min = false;
+      need_max = true;
+      break;
+   case PIPE_FUNC_GREATER:
+   case PIPE_FUNC_GEQUAL:
+      need_min = true;
+      need_max = false;
+      break;
+   case PIPE_FUNC_EQUAL:
+      need_min = true;
+      need_max = true;
+      break;
+   default:
+      return false;
+   }
+
+   hiz->checks++;
+
+   if ((need_min && hiz->stale_min) || (need_max && hiz->stale_max)) {
+      if (hiz->checks < LP_HIZ_MIN_RESCAN_CHECKS)
+         return false;
+      hiz_scan(task);
+   } else if (hiz->dirty && hiz->checks >= LP_HIZ_RESCAN_CHECKS) {
+      hiz_scan(task);
+   }
+
+   const float (*a0)[4] = (const float (*)[4]) GET_A0(inputs);
+   const float (*dadx)[4] = (const float (*)[4]) GET_DADX(inputs);
+   const float (*dady)[4] = (const float (*)[4]) GET_DADY(inputs);
+
+   p->func = key->depth.func;
+   /* The polygon offset is stored in the X component of a0. */
+   p->z0 = a0[0][2] + a0[0][0];
+   p->dzdx = dadx[0][2];
+   p->dzdy = dady[0][2];
+
+   /* Allow for the shader evaluating the plane in a different order. */
+   p->err = 8.0f * FLT_EPSILON *
+            (fabsf(a0[0][2]) + fabsf(a0[0][0]) +
+             fabsf(p->dzdx) * (float) (task->x + TILE_SIZE + 1) +
+             fabsf(p->dzdy) * (float) (task->y + TILE_SIZE + 1));
+
+   p->restrict_depth = key->restrict_depth_values;
+   p->clamp_viewport = key->depth_clamp;
+   p->unorm = !hiz->is_float;
+   if (p->clamp_viewport) {
+      const struct lp_jit_viewport *vp =
+         &state->jit_context.viewports[inputs->viewport_index];
+      p->min_depth = vp->min_depth;
+      p->max_depth = vp->max_depth;
+   }
+   p->quantum = hiz->quantum;
+
+   if (key->depth.writemask)
+      hiz->dirty = true;
+
+   return true;
+}
+
+
+/**
+ * Compute the occluded 16x16 blocks of the current tile for a primitive.
+ * Called through lp_rast_hiz_occluded(), which caches the result.
+ */
+unsigned
+lp_rast_hiz_update(struct lp_rasterizer_task *task,
+                   const struct lp_rast_shader_inputs *inputs)
+{
+   struct lp_rast_hiz *hiz = &task->hiz;
+   struct hiz_plane p;
+   unsigned occluded = 0;
+
+   if (hiz_plane_init(task, inputs, &p)) {
+      /* Sample positions are within one pixel of the pixel's corner. */
+      const float x0 = (float) task->x - 1.0f;
+      const float y0 = (float) task->y - 1.0f;
+
+      if (hiz_plane_occluded(&p, x0, y0,
+                             x0 + TILE_SIZE + 2, y0 + TILE_SIZE + 2,
+                             hiz->tile_min, hiz->tile_max)) {
+         occluded = 0xffff;
+         LP_COUNT(nr_hiz_culled_64);
+      } else {
+         for (unsigned i = 0; i < 16; i++) {
+            const float bx = x0 + (i & 3) * 16;
+            const float by = y0 + (i >> 2) * 16;
+
+            if (hiz_plane_occluded(&p, bx, by, bx + 18, by + 18,
+                                   hiz->block_min[i], hiz->block_max[i]))
+               occluded |= 1 << i;
+         }
+         LP_COUNT_ADD(nr_hiz_culled_16, util_bitcount(occluded));
+      }
+   }
+
+   hiz->inputs = inputs;
+   hiz->occluded = occluded;
+
+   return occluded;
+}
+
+
+/**
+ * Is the primitive occluded everywhere in the given tile-relative box
+ * (inclusive)?
+ */
+bool
+lp_rast_hiz_rect_occluded(struct lp_rasterizer_task *task,
+                          const struct lp_rast_shader_inputs *inputs,
+                          const struct u_rect *box)
+{
+   struct lp_rast_hiz *hiz = &task->hiz;
+   struct hiz_plane p;
+
+   if (!hiz->enabled)
+      return false;
+
+   if (hiz->inputs == inputs && hiz->occluded == 0xffff)
+      return true;
+
+   if (!hiz_plane_init(task, inputs, &p))
+      return false;
+
+   float bound_min = INFINITY, bound_max = -INFINITY;
+   for (int by = box->y0 / 16; by <= box->y1 / 16; by++) {
+      for (int bx = box->x0 / 16; bx <= box->x1 / 16; bx++) {
+         bound_min = MIN2(bound_min, hiz->block_min[by * 4 + bx]);
+         bound_max = MAX2(bound_max, hiz->block_max[by * 4 + bx]);
+      }
+   }
+
+   if (!hiz_plane_occluded(&p,
+                           (float) (task->x + box->x0) - 1.0f,
+                           (float) (task->y + box->y0) - 1.0f,
+                           (float) (task->x + box->x1) + 2.0f,
+                           (float) (task->y + box->y1) + 2.0f,
+                           bound_min, bound_max))
+      return false;
+
+   LP_COUNT(nr_hiz_culled_64);
+   return true;
+}
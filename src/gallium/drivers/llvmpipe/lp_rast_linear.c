@@ -81,6 +81,8 @@ lp_rast_linear_tile(struct lp_rasterizer_task *task,
    const struct lp_fragment_shader_variant *variant = state->variant;
    const struct lp_scene *scene = task->scene;
 
+   LP_COUNT(nr_linear_rects);
+
    if (variant->jit_linear_blit && inputs->is_blit) {
       if (variant->jit_linear_blit(state,
                                    task->x,
@@ -91,8 +93,10 @@ lp_rast_linear_tile(struct lp_rasterizer_task *task,
                                    GET_DADX(inputs),
                                    GET_DADY(inputs),
                                    scene->cbufs[0].map,
-                                   scene->cbufs[0].stride))
+                                   scene->cbufs[0].stride)) {
+         LP_COUNT(nr_linear_blit);
          return;
+      }
    }
 
    if (variant->jit_linear) {
@@ -105,8 +109,12 @@ lp_rast_linear_tile(struct lp_rasterizer_task *task,
                               GET_DADX(inputs),
                               GET_DADY(inputs),
                               scene->cbufs[0].map,
-                              scene->cbufs[0].stride))
+                              scene->cbufs[0].stride)) {
+         LP_COUNT(nr_linear_shaded);
          return;
+      }
+   } else {
+      LP_COUNT(nr_linear_fallback[variant->linear_fallback]);
    }
 
    {
@@ -151,6 +159,9 @@ lp_rast_linear_rect(struct lp_rasterizer_task *task,
     */
    const struct lp_rast_state *state = task->state;
    struct lp_fragment_shader_variant *variant = state->variant;
+
+   LP_COUNT(nr_linear_rects);
+
    if (variant->jit_linear_blit && inputs->is_blit) {
       if (variant->jit_linear_blit(state,
                                    box.x0, box.y0,
@@ -160,6 +171,7 @@ lp_rast_linear_rect(struct lp_rasterizer_task *task,
                                    GET_DADY(inputs),
                                    scene->cbufs[0].map,
                                    scene->cbufs[0].stride)) {
+         LP_COUNT(nr_linear_blit);
          return;
       }
    }
@@ -173,8 +185,11 @@ lp_rast_linear_rect(struct lp_rasterizer_task *task,
                               GET_DADY(inputs),
                               scene->cbufs[0].map,
                               scene->cbufs[0].stride)) {
+         LP_COUNT(nr_linear_shaded);
          return;
       }
+   } else {
+      LP_COUNT(nr_linear_fallback[variant->linear_fallback]);
    }
 
    lp_rast_linear_rect_fallback(task, inputs, &box);
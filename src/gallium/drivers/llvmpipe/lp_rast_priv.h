@@ -29,6 +29,7 @@
 #define LP_RAST_PRIV_H
 
 #include "util/format/u_format.h"
+#include "util/u_memory.h"
 #include "util/u_thread.h"
 #include "gallivm/lp_bld_debug.h"
 #include "lp_memory.h"
@@ -37,6 +38,7 @@
 #include "lp_state.h"
 #include "lp_texture.h"
 #include "lp_limits.h"
+#include "lp_perf.h"
 
 
 #define TILE_VECTOR_HEIGHT 4
@@ -76,6 +78,43 @@ extern const struct lp_rasterizer_task *jit_task;
 struct lp_rasterizer;
 struct cmd_bin;
 
+
+/**
+ * Conservative depth bounds of the tile being rasterized, for the whole
+ * tile and for each of its 16x16 blocks.  Used to reject occluded
+ * primitives before running the fragment shader, see lp_rast_hiz.c.
+ */
+struct lp_rast_hiz
+{
+   /** Depth buffer is single-sampled, single-layered and decodable */
+   bool enabled;
+
+   /** Set once depth writes may have moved values below/above the bounds */
+   bool stale_min, stale_max;
+
+   /** Depth may have been written since the bounds were last scanned */
+   bool dirty;
+
+   /** Number of primitives checked since the bounds were last scanned */
+   unsigned checks;
+
+   /* How to decode a depth value from the depth buffer */
+   unsigned format_bytes;
+   unsigned shift;
+   uint64_t mask;
+   bool is_float;
+   float scale;
+   float quantum;
+
+   /** Occluded 16x16 blocks of the last primitive checked */
+   const struct lp_rast_shader_inputs *inputs;
+   unsigned occluded;
+
+   float tile_min, tile_max;
+   float block_min[16], block_max[16];
+};
+
+
 /**
  * Per-thread rasterization state
  */
@@ -100,6 +139,11 @@ struct lp_rasterizer_task
    /** Non-interpolated passthru state and occlude counter for visible pixels */
    struct lp_jit_thread_data thread_data;
 
+   /** Only updated when LP_DEBUG=counters is set */
+   struct lp_thread_counters counters;
+
+   struct lp_rast_hiz hiz;
+
    util_semaphore work_ready;
    util_semaphore work_done;
 #ifdef _WIN32
@@ -108,6 +152,30 @@ struct lp_rasterizer_task
 };
 
 
+/**
+ * A non-empty bin waiting to be rasterized, along with its characterization
+ * which doubles as the cost estimate used for scheduling.
+ */
+struct lp_rast_bin_entry
+{
+   struct lp_bin_info info;
+   uint16_t x, y;
+};
+
+
+/**
+ * Per-thread queue of bins, sorted by decreasing cost.
+ *
+ * The owner takes bins from the head, idle threads steal from the tail.
+ * Both ends are packed into a single word so that either side claims a
+ * bin with one compare-and-swap.
+ */
+struct lp_rast_bin_queue
+{
+   alignas(CACHE_LINE_SIZE) uint64_t range; /**< head << 32 | tail */
+};
+
+
 /**
  * This is the state required while rasterizing tiles.
  * Note that this contains per-thread information too.
@@ -124,19 +192,86 @@ struct lp_rasterizer
    /** The scene currently being rasterized by the threads */
    struct lp_scene *curr_scene;
 
-   /** A task object for each rasterization thread */
-   struct lp_rasterizer_task tasks[LP_MAX_THREADS];
+   /** A task object for each rasterization thread (at least one) */
+   struct lp_rasterizer_task *tasks;
 
    unsigned num_threads;
-   thrd_t threads[LP_MAX_THREADS];
+   thrd_t *threads;
 
    /** For synchronizing the rasterization threads */
    util_barrier barrier;
 
+   /**
+    * Cost-ordered bin scheduling, see rasterize_scene().  Each thread
+    * fills its own slice of bin_entries and publishes it in its queue.
+    */
+   bool bin_sched;
+   struct lp_rast_bin_queue *bin_queues;
+   struct lp_rast_bin_entry *bin_entries;
+   unsigned num_bin_entries;
+
    struct lp_fence *last_fence;
 };
 
 
+void
+lp_rast_hiz_begin_scene(struct lp_rasterizer_task *task);
+
+void
+lp_rast_hiz_begin_tile(struct lp_rasterizer_task *task);
+
+void
+lp_rast_hiz_clear(struct lp_rasterizer_task *task,
+                  uint64_t clear_value, uint64_t clear_mask);
+
+void
+lp_rast_hiz_end_state(struct lp_rasterizer_task *task,
+                      const struct lp_rast_state *state);
+
+unsigned
+lp_rast_hiz_update(struct lp_rasterizer_task *task,
+                   const struct lp_rast_shader_inputs *inputs);
+
+bool
+lp_rast_hiz_rect_occluded(struct lp_rasterizer_task *task,
+                          const struct lp_rast_shader_inputs *inputs,
+                          const struct u_rect *box);
+
+
+/**
+ * Return the mask of the current tile's 16x16 blocks (bit = y * 4 + x)
+ * in which the primitive is known to fail the depth test everywhere.
+ * 0xffff means the primitive can be skipped for the whole tile.
+ */
+static inline unsigned
+lp_rast_hiz_occluded(struct lp_rasterizer_task *task,
+                     const struct lp_rast_shader_inputs *inputs)
+{
+   if (!task->hiz.enabled)
+      return 0;
+
+   if (task->hiz.inputs == inputs)
+      return task->hiz.occluded;
+
+   return lp_rast_hiz_update(task, inputs);
+}
+
+
+/**
+ * Is the 4x4 block at window position x, y known to be occluded?
+ */
+static inline bool
+lp_rast_hiz_block_occluded(struct lp_rasterizer_task *task,
+                           const struct lp_rast_shader_inputs *inputs,
+                           unsigned x, unsigned y)
+{
+   const unsigned occluded = lp_rast_hiz_occluded(task, inputs);
+   const unsigned i = ((y % TILE_SIZE) / 16) * 4 + (x % TILE_SIZE) / 16;
+
+   return (occluded >> i) & 1;
+}
+
+
 void
 lp_rast_shade_quads_mask_sample(struct lp_rasterizer_task *task,
                                 const struct lp_rast_shader_inputs *inputs,
@@ -239,6 +374,9 @@ lp_rast_shade_quads_all(struct lp_rasterizer_task *task,
    unsigned depth_sample_stride = 0;
    unsigned view_index = inputs->view_index;
 
+   if (lp_rast_hiz_block_occluded(task, inputs, x, y))
+      return;
+
    /* color buffer */
    for (unsigned i = 0; i < scene->fb.nr_cbufs; i++) {
       if (scene->fb.cbufs[i].texture) {
@@ -165,6 +165,9 @@ lp_rast_rectangle(struct lp_rasterizer_task *task,
    struct u_rect box;
    intersect_rect_and_tile(task, rect, &box);
 
+   if (lp_rast_hiz_rect_occluded(task, &rect->inputs, &box))
+      return;
+
    /* The interior of the rectangle (if there is one) will be
     * rasterized as full 4x4 stamps.
     *
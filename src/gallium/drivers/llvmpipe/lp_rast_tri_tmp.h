@@ -210,6 +210,11 @@ TAG(lp_rast_triangle)(struct lp_rasterizer_task *task,
       return;
    }
 
+   /* 16x16 blocks where the triangle is known to fail the depth test */
+   const unsigned occluded = lp_rast_hiz_occluded(task, &tri->inputs);
+   if (occluded == 0xffff)
+      return;
+
    outmask = 0;                 /* outside one or more trivial reject planes */
    partmask = 0;                /* outside one or more trivial accept planes */
 
@@ -305,6 +310,9 @@ TAG(lp_rast_triangle)(struct lp_rasterizer_task *task,
 
    LP_COUNT_ADD(nr_empty_16, util_bitcount(0xffff & ~(partial_mask | inmask)));
 
+   inmask &= ~occluded;
+   partial_mask &= ~occluded;
+
    /* Iterate over partials:
     */
    while (partial_mask) {
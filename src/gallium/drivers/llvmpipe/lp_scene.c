@@ -29,11 +29,13 @@
 #include "util/u_math.h"
 #include "util/u_memory.h"
 #include "util/reallocarray.h"
+#include "util/u_atomic.h"
 #include "util/u_inlines.h"
 #include "util/format/u_format.h"
 #include "lp_scene.h"
 #include "lp_fence.h"
 #include "lp_debug.h"
+#include "lp_perf.h"
 #include "lp_context.h"
 #include "lp_state_fs.h"
 #include "lp_setup_context.h"
@@ -57,6 +59,74 @@ struct shader_ref {
 };
 
 
+/**
+ * Set up an empty data block pool which keeps at most max_size bytes worth
+ * of blocks, and no more than LP_SCENE_BLOCK_POOL_MAX_BLOCKS, around.
+ */
+void
+lp_scene_block_pool_init(struct lp_scene_block_pool *pool, unsigned max_size)
+{
+   pool->head = NULL;
+   pool->count = 0;
+   pool->max_count = MIN2(max_size / sizeof(struct data_block),
+                          LP_SCENE_BLOCK_POOL_MAX_BLOCKS);
+}
+
+
+/**
+ * Free all blocks in the pool.  No scene may be using the pool anymore.
+ */
+void
+lp_scene_block_pool_fini(struct lp_scene_block_pool *pool)
+{
+   struct data_block *block, *tmp;
+
+   for (block = pool->head; block; block = tmp) {
+      tmp = block->next;
+      FREE(block);
+   }
+   pool->head = NULL;
+   pool->count = 0;
+}
+
+
+/**
+ * Get a data block, from the pool if possible.
+ */
+static struct data_block *
+block_pool_get(struct lp_scene_block_pool *pool)
+{
+   if (pool && pool->head) {
+      struct data_block *block = pool->head;
+
+      pool->head = block->next;
+      pool->count--;
+      LP_COUNT(nr_scene_blocks_recycled);
+      return block;
+   }
+
+   LP_COUNT(nr_scene_blocks_malloced);
+   return MALLOC_STRUCT(data_block);
+}
+
+
+/**
+ * Return a data block to the pool, or free it if the pool is full.
+ */
+static void
+block_pool_put(struct lp_scene_block_pool *pool, struct data_block *block)
+{
+   if (!pool || pool->count >= pool->max_count) {
+      FREE(block);
+      return;
+   }
+
+   block->next = pool->head;
+   pool->head = block;
+   pool->count++;
+}
+
+
 /**
  * Create a new scene object.
  * \param queue  the queue to put newly rendered/emptied scenes into
@@ -72,8 +142,12 @@ lp_scene_create(struct lp_setup_context *setup)
    scene->pipe = setup->pipe;
    scene->setup = setup;
    scene->data.head = &scene->data.first;
+   scene->max_size = setup->scene_max_size;
+   scene->max_resource_size = setup->scene_max_resource_size;
+   scene->block_pool = &setup->block_pool;
 
    (void) mtx_init(&scene->mutex, mtx_plain);
+   util_dynarray_init(&scene->deferred_frees, NULL);
 
 #if MESA_DEBUG
    /* Do some scene limit sanity checks here */
@@ -101,6 +175,7 @@ void
 lp_scene_destroy(struct lp_scene *scene)
 {
    lp_scene_end_rasterization(scene);
+   util_dynarray_fini(&scene->deferred_frees);
    mtx_destroy(&scene->mutex);
    free(scene->tiles);
    assert(scene->data.head == &scene->data.first);
@@ -152,6 +227,9 @@ lp_scene_bin_reset(struct lp_scene *scene, unsigned x, unsigned y)
       bin->tail->next = NULL;
       bin->tail->count = 0;
    }
+
+   if (scene->reset_bins)
+      BITSET_SET(scene->reset_bins, scene->tiles_x * y + x);
 }
 
 
@@ -200,6 +278,46 @@ lp_scene_begin_rasterization(struct lp_scene *scene)
 }
 
 
+static void
+scene_resources_idle_locked(struct lp_scene *scene)
+{
+   if (!scene->resources_busy)
+      return;
+
+   for (struct resource_ref *ref = scene->resources; ref; ref = ref->next) {
+      for (int i = 0; i < ref->count; i++)
+         p_atomic_dec(&llvmpipe_resource(ref->resource[i])->scene_refs);
+   }
+
+   for (struct resource_ref *ref = scene->writeable_resources; ref;
+        ref = ref->next) {
+      for (int i = 0; i < ref->count; i++) {
+         struct llvmpipe_resource *lpr = llvmpipe_resource(ref->resource[i]);
+         p_atomic_dec(&lpr->scene_refs);
+         p_atomic_dec(&lpr->scene_writes);
+      }
+   }
+
+   scene->resources_busy = false;
+}
+
+
+/**
+ * Called by the rasterizer once it's done with the scene, before the fence
+ * signals, so that llvmpipe_is_resource_busy() doesn't have to wait for the
+ * scene to be recycled.  The references themselves are kept until
+ * lp_scene_end_rasterization().
+ */
+void
+lp_scene_resources_idle(struct lp_scene *scene)
+{
+   mtx_lock(&scene->mutex);
+   scene_resources_idle_locked(scene);
+   mtx_unlock(&scene->mutex);
+}
+
+
+
 /**
  * Free all the temporary data in a scene.
  */
@@ -234,6 +352,12 @@ lp_scene_end_rasterization(struct lp_scene *scene)
     */
    memset(scene->tiles, 0, sizeof(struct cmd_bin) * scene->num_alloced_tiles);
 
+   scene_resources_idle_locked(scene);
+
+   util_dynarray_foreach(&scene->deferred_frees, void *, data)
+      align_free(*data);
+   util_dynarray_clear(&scene->deferred_frees);
+
    /* Decrement texture ref counts
     */
    int j = 0;
@@ -295,7 +419,7 @@ lp_scene_end_rasterization(struct lp_scene *scene)
       for (block = list->head; block; block = tmp) {
          tmp = block->next;
          if (block != &list->first)
-            FREE(block);
+            block_pool_put(scene->block_pool, block);
       }
 
       list->head = &list->first;
@@ -342,12 +466,14 @@ lp_scene_new_cmd_block(struct lp_scene *scene,
 struct data_block *
 lp_scene_new_data_block(struct lp_scene *scene)
 {
-   if (scene->scene_size + DATA_BLOCK_SIZE > LP_SCENE_MAX_SIZE) {
+   if (scene->scene_size + DATA_BLOCK_SIZE > scene->max_size) {
       if (0) debug_printf("%s: failed\n", __func__);
+      if (!scene->alloc_failed)
+         p_atomic_inc(&lp_count.nr_scene_flush_mem);
       scene->alloc_failed = true;
       return NULL;
    } else {
-      struct data_block *block = MALLOC_STRUCT(data_block);
+      struct data_block *block = block_pool_get(scene->block_pool);
       if (!block)
          return NULL;
 
@@ -440,16 +566,33 @@ lp_scene_add_resource_reference(struct lp_scene *scene,
    pipe_resource_reference(&ref->resource[ref->count++], resource);
    scene->resource_reference_size += llvmpipe_resource_size(resource);
 
+   p_atomic_inc(&llvmpipe_resource(resource)->scene_refs);
+   if (writeable)
+      p_atomic_inc(&llvmpipe_resource(resource)->scene_writes);
+   scene->resources_busy = true;
+
    /* Heuristic to advise scene flushes.  This isn't helpful in the
     * initial setup of the scene, but after that point flush on the
     * next resource added which exceeds 64MB in referenced texture
     * data.
     */
-   int flush = (initializing_scene || scene->resource_reference_size < LP_SCENE_MAX_RESOURCE_SIZE);
+   int flush = (initializing_scene || scene->resource_reference_size < scene->max_resource_size);
+   if (!flush)
+      p_atomic_inc(&lp_count.nr_scene_flush_resources);
    mtx_unlock(&scene->mutex);
    return flush;
 }
 
+/**
+ * Free the storage with align_free() once the scene has been rasterized.
+ */
+void
+lp_scene_defer_free(struct lp_scene *scene, void *data)
+{
+   util_dynarray_append(&scene->deferred_frees, void *, data);
+}
+
+
 /**
  * Add a reference to a fragment shader variant
  * Return FALSE if out of memory, TRUE otherwise.
@@ -663,3 +806,141 @@ lp_scene_end_binning(struct lp_scene *scene)
          lp_debug_bins(scene);
    }
 }
+
+
+/**
+ * Prepare a private worker scene for binning on behalf of "scene".
+ *
+ * The worker shares the binning-relevant state of the real scene, but the
+ * framebuffer state is only copied, not referenced, so the worker must
+ * never be rasterized.  The embedded first data block is marked full so
+ * that everything binned by the worker lives in malloc'ed blocks which can
+ * be handed over to the real scene.
+ *
+ * \return false if the worker's bins couldn't be allocated, in which case
+ *         the worker must not be used for binning
+ */
+bool
+lp_scene_begin_worker_binning(struct lp_scene *worker,
+                              const struct lp_scene *scene)
+{
+   const unsigned num_bins = lp_scene_get_num_bins(scene);
+
+   /* Set up the data blocks first, so that the worker can always be
+    * discarded.
+    */
+   worker->data.first.used = DATA_BLOCK_SIZE;
+   worker->data.first.next = NULL;
+   worker->data.head = &worker->data.first;
+
+   if (worker->num_alloced_tiles < num_bins) {
+      struct cmd_bin *tiles = reallocarray(worker->tiles, num_bins,
+                                           sizeof(struct cmd_bin));
+      if (!tiles) {
+         worker->alloc_failed = true;
+         return false;
+      }
+      worker->tiles = tiles;
+
+      BITSET_WORD *reset_bins = reallocarray(worker->reset_bins,
+                                             BITSET_WORDS(num_bins),
+                                             sizeof(BITSET_WORD));
+      if (!reset_bins) {
+         worker->alloc_failed = true;
+         return false;
+      }
+      worker->reset_bins = reset_bins;
+      worker->num_alloced_tiles = num_bins;
+   }
+   memset(worker->tiles, 0, sizeof(struct cmd_bin) * num_bins);
+   memset(worker->reset_bins, 0, BITSET_WORDS(num_bins) * sizeof(BITSET_WORD));
+
+   worker->pipe = scene->pipe;
+   worker->setup = scene->setup;
+   worker->fb = scene->fb;
+   worker->fb_max_layer = scene->fb_max_layer;
+   worker->fb_max_samples = scene->fb_max_samples;
+   memcpy(worker->fixed_sample_pos, scene->fixed_sample_pos,
+          sizeof(worker->fixed_sample_pos));
+   worker->had_queries = scene->had_queries;
+   worker->tiles_x = scene->tiles_x;
+   worker->tiles_y = scene->tiles_y;
+   worker->scene_size = scene->scene_size;
+   worker->max_size = scene->max_size;
+   worker->max_resource_size = scene->max_resource_size;
+   worker->block_pool = NULL;   /* the pool is only used by the context's thread */
+   worker->alloc_failed = false;
+
+   return true;
+}
+
+
+/**
+ * Append the commands binned by a worker to the real scene and hand over
+ * the data blocks they live in.  Workers must be merged in primitive
+ * order to preserve the command order within each bin.
+ */
+void
+lp_scene_merge_worker(struct lp_scene *scene, struct lp_scene *worker)
+{
+   struct data_block *head = worker->data.head;
+
+   if (head != &worker->data.first) {
+      struct data_block *tail = head;
+      unsigned size = sizeof(struct data_block);
+
+      while (tail->next != &worker->data.first) {
+         tail = tail->next;
+         size += sizeof(struct data_block);
+      }
+
+      /* Keep the real scene's current block at the head of its list. */
+      tail->next = scene->data.head->next;
+      scene->data.head->next = head;
+      scene->scene_size += size;
+
+      worker->data.head = &worker->data.first;
+   }
+
+   const unsigned num_bins = lp_scene_get_num_bins(scene);
+   for (unsigned i = 0; i < num_bins; i++) {
+      struct cmd_bin *src = &worker->tiles[i];
+      struct cmd_bin *dst = &scene->tiles[i];
+
+      /* An opaque whole tile command overwrites everything binned before
+       * it, including what the real scene and the earlier workers hold.
+       */
+      if (BITSET_TEST(worker->reset_bins, i)) {
+         dst->head = NULL;
+         dst->tail = NULL;
+         dst->last_state = NULL;
+      }
+
+      if (!src->head)
+         continue;
+
+      if (dst->tail)
+         dst->tail->next = src->head;
+      else
+         dst->head = src->head;
+      dst->tail = src->tail;
+      dst->last_state = src->last_state;
+   }
+}
+
+
+/**
+ * Throw away everything a worker scene has binned.
+ */
+void
+lp_scene_discard_worker(struct lp_scene *worker)
+{
+   struct data_block *block, *tmp;
+
+   for (block = worker->data.head; block != &worker->data.first;
+        block = tmp) {
+      tmp = block->next;
+      FREE(block);
+   }
+   worker->data.head = &worker->data.first;
+}
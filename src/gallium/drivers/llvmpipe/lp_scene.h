@@ -35,6 +35,8 @@
 #ifndef LP_SCENE_H
 #define LP_SCENE_H
 
+#include "util/bitset.h"
+#include "util/u_dynarray.h"
 #include "util/u_thread.h"
 #include "lp_rast.h"
 #include "lp_debug.h"
@@ -42,8 +44,10 @@
 struct lp_scene_queue;
 struct lp_rast_state;
 
-/* We're limited to 2K by 2K for 32bit fixed point rasterization.
- * Will need a 64-bit version for larger framebuffers.
+/* Edge functions are evaluated with 64-bit constants (see lp_rast_plane),
+ * so the full LP_MAX_WIDTH x LP_MAX_HEIGHT framebuffer can be binned.
+ * The cheaper 32-bit rasterization functions are only chosen per triangle,
+ * when its bounding box fits in MAX_FIXED_LENGTH32.
  */
 #define TILES_X (LP_MAX_WIDTH / TILE_SIZE)
 #define TILES_Y (LP_MAX_HEIGHT / TILE_SIZE)
@@ -59,12 +63,18 @@ struct lp_rast_state;
  */
 #define DATA_BLOCK_SIZE (64 * 1024)
 
-/* Scene temporary storage is clamped to this size:
+/* Minimum scene temporary storage budget.  The actual budget is chosen
+ * per screen from the thread count and the amount of system memory, see
+ * llvmpipe_init_scene_budget().
  */
 #define LP_SCENE_MAX_SIZE (36*1024*1024)
 
-/* The maximum amount of texture storage referenced by a scene is
- * clamped to this size:
+/* Upper bound for the scene temporary storage budget:
+ */
+#define LP_SCENE_MAX_SIZE_LIMIT (256*1024*1024)
+
+/* Minimum budget for the amount of texture storage referenced by a scene.
+ * It is scaled along with the scene storage budget.
  */
 #define LP_SCENE_MAX_RESOURCE_SIZE (64*1024*1024)
 
@@ -91,6 +101,28 @@ struct data_block {
 
 
 
+/**
+ * Upper bound on the number of free blocks a context keeps around.  The
+ * pool is never trimmed, so this is what an idle context holds on to.
+ */
+#define LP_SCENE_BLOCK_POOL_MAX_BLOCKS 32
+
+
+/**
+ * Free list of scene data blocks, shared by all scenes of a setup context.
+ *
+ * Blocks are taken while binning and given back when the setup context
+ * recycles a scene in lp_scene_end_rasterization(), both on the thread
+ * which owns the context, so the pool needs no locking.  The parallel
+ * binning workers don't use it.
+ */
+struct lp_scene_block_pool {
+   struct data_block *head;
+   unsigned count;
+   unsigned max_count;
+};
+
+
 /**
  * For each screen tile we have one of these bins.
  */
@@ -177,6 +209,17 @@ struct lp_scene {
    /** list of frag shaders referenced by the scene commands */
    struct shader_ref *frag_shaders;
 
+   /** Whether the resource references still count as busy, see
+    * lp_scene_resources_idle()
+    */
+   bool resources_busy;
+
+   /** Rasterizer tasks which haven't finished the scene yet */
+   unsigned rast_tasks_pending;
+
+   /** Storage to free after rasterization, see lp_setup_free_after_scenes() */
+   struct util_dynarray deferred_frees;
+
    /** Total memory used by the scene (in bytes).  This sums all the
     * data blocks and counts all bins, state, resource references and
     * other random allocations within the scene.
@@ -188,6 +231,13 @@ struct lp_scene {
     */
    unsigned resource_reference_size;
 
+   /** Storage budgets, see LP_SCENE_MAX_SIZE / LP_SCENE_MAX_RESOURCE_SIZE */
+   unsigned max_size;
+   unsigned max_resource_size;
+
+   /** Where data blocks come from and go back to, NULL to use malloc */
+   struct lp_scene_block_pool *block_pool;
+
    bool alloc_failed;
    bool permit_linear_rasterizer;
 
@@ -203,6 +253,12 @@ struct lp_scene {
    unsigned num_alloced_tiles;
    struct cmd_bin *tiles;
    struct data_block_list data;
+
+   /** Worker scenes only: the bins lp_scene_bin_reset() was called on,
+    * so that lp_scene_merge_worker() drops what came before in the real
+    * scene's bins too.  NULL for real scenes.
+    */
+   BITSET_WORD *reset_bins;
 };
 
 
@@ -217,6 +273,11 @@ bool lp_scene_is_oom(struct lp_scene *scene);
 
 struct data_block *lp_scene_new_data_block(struct lp_scene *scene);
 
+void lp_scene_block_pool_init(struct lp_scene_block_pool *pool,
+                              unsigned max_size);
+
+void lp_scene_block_pool_fini(struct lp_scene_block_pool *pool);
+
 struct cmd_block *lp_scene_new_cmd_block(struct lp_scene *scene,
                                          struct cmd_bin *bin);
 
@@ -228,6 +289,10 @@ bool lp_scene_add_resource_reference(struct lp_scene *scene,
 unsigned lp_scene_is_resource_referenced(const struct lp_scene *scene,
                                          const struct pipe_resource *resource);
 
+void lp_scene_resources_idle(struct lp_scene *scene);
+
+void lp_scene_defer_free(struct lp_scene *scene, void *data);
+
 bool lp_scene_add_frag_shader_reference(struct lp_scene *scene,
                                         struct lp_fragment_shader_variant *variant);
 
@@ -249,7 +314,7 @@ lp_scene_alloc(struct lp_scene *scene, unsigned size)
    if (LP_DEBUG & DEBUG_MEM)
       debug_printf("alloc %u block %u/%u tot %u/%u\n",
                    size, block->used, (unsigned)DATA_BLOCK_SIZE,
-                   scene->scene_size, LP_SCENE_MAX_SIZE);
+                   scene->scene_size, scene->max_size);
 
    if (block->used + size > DATA_BLOCK_SIZE) {
       block = lp_scene_new_data_block(scene);
@@ -283,7 +348,7 @@ lp_scene_alloc_aligned(struct lp_scene *scene, unsigned size,
       debug_printf("alloc %u block %u/%u tot %u/%u\n",
                    size + alignment - 1,
                    block->used, (unsigned)DATA_BLOCK_SIZE,
-                   scene->scene_size, LP_SCENE_MAX_SIZE);
+                   scene->scene_size, scene->max_size);
 
    if (block->used + size + alignment - 1 > DATA_BLOCK_SIZE) {
       block = lp_scene_new_data_block(scene);
@@ -415,6 +480,21 @@ void
 lp_scene_end_binning(struct lp_scene *scene);
 
 
+/* Private worker scenes used for parallel binning.  A worker scene only
+ * provides tile bins and data blocks; its contents are appended to the
+ * real scene with lp_scene_merge_worker().
+ */
+bool
+lp_scene_begin_worker_binning(struct lp_scene *worker,
+                              const struct lp_scene *scene);
+
+void
+lp_scene_merge_worker(struct lp_scene *scene, struct lp_scene *worker);
+
+void
+lp_scene_discard_worker(struct lp_scene *worker);
+
+
 /* Begin/end rasterization of a scene
  */
 void
@@ -55,6 +55,9 @@
 #include "lp_rast.h"
 #include "lp_cs_tpool.h"
 #include "lp_flush.h"
+#include "lp_scene.h"
+#include "lp_cache_bundle.h"
+#include "lp_tex_sample.h"
 
 #include "frontend/sw_winsys.h"
 
@@ -101,6 +104,8 @@ static const struct debug_named_value lp_perf_flags[] = {
    { "no_alphatest",   PERF_NO_ALPHATEST, NULL },
    { "no_rast_linear", PERF_NO_RAST_LINEAR, NULL },
    { "no_shade",       PERF_NO_SHADE, NULL },
+   { "no_bin_sched",   PERF_NO_BIN_SCHED, NULL },
+   { "no_hiz",         PERF_NO_HIZ, NULL },
    DEBUG_NAMED_VALUE_END
 };
 
@@ -725,6 +730,7 @@ llvmpipe_flush_frontbuffer(struct pipe_screen *_screen,
    assert(texture->dt);
 
    if (texture->dt) {
+      _pipe = threaded_context_unwrap_sync(_pipe);
       if (_pipe)
          llvmpipe_flush_resource(_pipe, resource, 0, true, true,
                                  false, "frontbuffer");
@@ -749,6 +755,15 @@ llvmpipe_destroy_screen(struct pipe_screen *_screen)
 
    disk_cache_destroy(screen->disk_shader_cache);
 
+   if (screen->cache_bundle) {
+      if (screen->cache_bundle_export &&
+          !lp_cache_bundle_write(screen->cache_bundle,
+                                 screen->cache_bundle_export))
+         debug_printf("llvmpipe: failed to write cache bundle %s\n",
+                      screen->cache_bundle_export);
+      lp_cache_bundle_destroy(screen->cache_bundle);
+   }
+
    glsl_type_singleton_decref();
 
 #if defined(HAVE_LIBDRM) && defined(HAVE_LINUX_UDMABUF_H)
@@ -770,6 +785,8 @@ llvmpipe_destroy_screen(struct pipe_screen *_screen)
 #endif
    mtx_destroy(&screen->rast_mutex);
    mtx_destroy(&screen->cs_mutex);
+   slab_destroy_parent(&screen->transfer_pool);
+   util_idalloc_mt_fini(&screen->buffer_ids);
    FREE(screen);
 }
 
@@ -832,6 +849,8 @@ lp_disk_cache_create(struct llvmpipe_screen *screen)
 {
    struct mesa_sha1 ctx;
    unsigned gallivm_perf = gallivm_get_perf_flags();
+   /* Samplers only go through the block cache when it is enabled. */
+   bool texture_cache = lp_texture_cache_blocks() != 0;
    unsigned char sha1[20];
    char cache_id[20 * 2 + 1];
    _mesa_sha1_init(&ctx);
@@ -841,11 +860,22 @@ lp_disk_cache_create(struct llvmpipe_screen *screen)
       return;
 
    _mesa_sha1_update(&ctx, &gallivm_perf, sizeof(gallivm_perf));
+   _mesa_sha1_update(&ctx, &texture_cache, sizeof(texture_cache));
    update_cache_sha1_cpu(&ctx);
    _mesa_sha1_final(&ctx, sha1);
    mesa_bytes_to_hex(cache_id, sha1, 20);
 
    screen->disk_shader_cache = disk_cache_create("llvmpipe", cache_id, 0);
+
+   /* Cache bundles are only valid for the same cache id. */
+   const char *bundle_path = debug_get_option("LP_CACHE_BUNDLE", NULL);
+   screen->cache_bundle_export = debug_get_option("LP_CACHE_BUNDLE_EXPORT",
+                                                  NULL);
+   if (bundle_path || screen->cache_bundle_export) {
+      screen->cache_bundle = lp_cache_bundle_create(sha1);
+      if (screen->cache_bundle && bundle_path)
+         lp_cache_bundle_load(screen->cache_bundle, bundle_path);
+   }
 }
 
 
@@ -877,6 +907,10 @@ lp_disk_cache_find_shader(struct llvmpipe_screen *screen,
 {
    unsigned char sha1[CACHE_KEY_SIZE];
 
+   if (screen->cache_bundle &&
+       lp_cache_bundle_find(screen->cache_bundle, ir_sha1_cache_key, cache))
+      return;
+
    if (!screen->disk_shader_cache)
       return;
    disk_cache_compute_key(screen->disk_shader_cache, ir_sha1_cache_key,
@@ -891,6 +925,9 @@ lp_disk_cache_find_shader(struct llvmpipe_screen *screen,
    }
    cache->data_size = binary_size;
    cache->data = buffer;
+
+   if (screen->cache_bundle)
+      lp_cache_bundle_add(screen->cache_bundle, ir_sha1_cache_key, cache);
 }
 
 
@@ -901,6 +938,9 @@ lp_disk_cache_insert_shader(struct llvmpipe_screen *screen,
 {
    unsigned char sha1[CACHE_KEY_SIZE];
 
+   if (screen->cache_bundle)
+      lp_cache_bundle_add(screen->cache_bundle, ir_sha1_cache_key, cache);
+
    if (!screen->disk_shader_cache || !cache->data_size || cache->dont_cache)
       return;
    disk_cache_compute_key(screen->disk_shader_cache, ir_sha1_cache_key,
@@ -919,13 +959,14 @@ llvmpipe_screen_late_init(struct llvmpipe_screen *screen)
    if (screen->late_init_done)
       goto out;
 
-   screen->rast = lp_rast_create(screen->num_threads);
+   screen->rast = lp_rast_create(screen->num_threads, screen->pin_threads);
    if (!screen->rast) {
       ret = false;
       goto out;
    }
 
-   screen->cs_tpool = lp_cs_tpool_create(screen->num_threads);
+   screen->cs_tpool = lp_cs_tpool_create(screen->num_threads,
+                                         screen->pin_threads);
    if (!screen->cs_tpool) {
       lp_rast_destroy(screen->rast);
       ret = false;
@@ -947,6 +988,31 @@ out:
 }
 
 
+/**
+ * Choose how much memory a scene may use before it gets flushed.
+ *
+ * Each rasterizer thread needs bins to chew on, so the budget grows with
+ * the thread count (one LP_SCENE_MAX_SIZE per 8 threads), but a single
+ * scene never takes more than 1/256th of system memory.
+ */
+static void
+llvmpipe_init_scene_budget(struct llvmpipe_screen *screen)
+{
+   uint64_t size = (uint64_t)LP_SCENE_MAX_SIZE *
+                   MAX2(1, screen->num_threads / 8);
+   uint64_t total_ram;
+
+   if (os_get_total_physical_memory(&total_ram))
+      size = MIN2(size, total_ram / 256);
+
+   size = CLAMP(size, LP_SCENE_MAX_SIZE, LP_SCENE_MAX_SIZE_LIMIT);
+
+   screen->scene_max_size = size;
+   screen->scene_max_resource_size =
+      (uint64_t)LP_SCENE_MAX_RESOURCE_SIZE * size / LP_SCENE_MAX_SIZE;
+}
+
+
 /**
  * Create a new pipe_screen object
  */
@@ -998,6 +1064,16 @@ llvmpipe_create_screen(struct sw_winsys *winsys)
    screen->num_threads = debug_get_num_option("LP_NUM_THREADS",
                                               screen->num_threads);
    screen->num_threads = MIN2(screen->num_threads, LP_MAX_THREADS);
+   screen->num_bin_threads = debug_get_num_option("LP_BIN_THREADS", 0);
+   screen->num_bin_threads = MIN2(screen->num_bin_threads,
+                                  screen->num_threads);
+   screen->pin_threads =
+      debug_get_bool_option("LP_PIN_THREADS",
+                            util_get_cpu_caps()->num_L3_caches > 1);
+   screen->async_fs = debug_get_bool_option("LP_ASYNC_FS", false);
+   screen->tiled_textures = debug_get_bool_option("LP_TILED_TEXTURES", false);
+
+   llvmpipe_init_scene_budget(screen);
 
 #if defined(HAVE_LIBDRM) && defined(HAVE_LINUX_UDMABUF_H)
    screen->udmabuf_fd = open("/dev/udmabuf", O_RDWR);
@@ -1027,6 +1103,10 @@ llvmpipe_create_screen(struct sw_winsys *winsys)
 
    (void) mtx_init(&screen->late_mutex, mtx_plain);
 
+   slab_create_parent(&screen->transfer_pool,
+                      sizeof(struct llvmpipe_transfer), 16);
+   util_idalloc_mt_init_tc(&screen->buffer_ids);
+
    llvmpipe_init_shader_caps(&screen->base);
    llvmpipe_init_compute_caps(&screen->base);
    llvmpipe_init_screen_caps(&screen->base);
@@ -38,6 +38,8 @@
 #include "pipe/p_defines.h"
 #include "util/u_thread.h"
 #include "util/list.h"
+#include "util/u_idalloc.h"
+#include "util/slab.h"
 #include "util/vma.h"
 #include "gallivm/lp_bld.h"
 #include "gallivm/lp_bld_misc.h"
@@ -52,6 +54,14 @@ struct llvmpipe_screen
    struct sw_winsys *winsys;
 
    unsigned num_threads;
+   unsigned num_bin_threads;
+   bool pin_threads;
+   bool async_fs;
+   bool tiled_textures;
+
+   /* Per-scene storage budgets, see llvmpipe_init_scene_budget() */
+   unsigned scene_max_size;
+   unsigned scene_max_resource_size;
 
    /* Increments whenever textures are modified.  Contexts can track this.
     */
@@ -69,10 +79,18 @@ struct llvmpipe_screen
    mtx_t ctx_mutex;
    struct list_head ctx_list;
 
+   /* For threaded_context, see llvmpipe_create_context() */
+   struct slab_parent_pool transfer_pool;
+   struct util_idalloc_mt buffer_ids;
+
    char renderer_string[100];
 
    struct disk_cache *disk_shader_cache;
 
+   /* Preloaded and/or recorded shader code, see lp_cache_bundle.h */
+   struct lp_cache_bundle *cache_bundle;
+   const char *cache_bundle_export;
+
 #if defined(HAVE_LIBDRM) && defined(HAVE_LINUX_UDMABUF_H)
    int udmabuf_fd;
 #endif
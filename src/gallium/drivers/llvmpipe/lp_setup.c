@@ -973,6 +973,31 @@ lp_setup_is_resource_referenced(const struct lp_setup_context *setup,
 }
 
 
+/**
+ * Free buffer storage with align_free() once the scenes binned so far are
+ * done with it.  Scenes are rasterized in the order they were binned, so
+ * only the newest one has to hold on to it.
+ */
+void
+lp_setup_free_after_scenes(struct lp_setup_context *setup, void *data)
+{
+   struct lp_scene *last = NULL;
+
+   for (unsigned i = 0; i < setup->num_active_scenes; i++) {
+      struct lp_scene *scene = setup->scenes[i];
+
+      /* Scenes without a fence are idle. */
+      if (scene->fence && (!last || scene->fence->id > last->fence->id))
+         last = scene;
+   }
+
+   if (last)
+      lp_scene_defer_free(last, data);
+   else
+      align_free(data);
+}
+
+
 /**
  * Called by vbuf code when we're about to draw something.
  *
@@ -1313,6 +1338,16 @@ lp_setup_destroy(struct lp_setup_context *setup)
 
    LP_DBG(DEBUG_SETUP, "number of scenes used: %d\n", setup->num_active_scenes);
    slab_destroy(&setup->scene_slab);
+   lp_scene_block_pool_fini(&setup->block_pool);
+
+   if (setup->bin_workers) {
+      for (unsigned i = 0; i < setup->num_bin_workers; i++) {
+         lp_scene_discard_worker(&setup->bin_workers[i]);
+         free(setup->bin_workers[i].tiles);
+         free(setup->bin_workers[i].reset_bins);
+      }
+      FREE(setup->bin_workers);
+   }
 
    FREE(setup);
 }
@@ -1345,6 +1380,10 @@ lp_setup_create(struct pipe_context *pipe,
    setup->pipe = pipe;
 
    setup->num_threads = screen->num_threads;
+   setup->num_bin_workers = screen->num_bin_threads;
+   setup->scene_max_size = screen->scene_max_size;
+   setup->scene_max_resource_size = screen->scene_max_resource_size;
+   lp_scene_block_pool_init(&setup->block_pool, setup->scene_max_size);
    setup->vbuf = draw_vbuf_stage(draw, &setup->base);
    if (!setup->vbuf) {
       goto no_vbuf;
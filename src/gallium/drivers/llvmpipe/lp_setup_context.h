@@ -91,7 +91,14 @@ struct lp_setup_context
    unsigned num_threads;
    unsigned scene_idx;
 
+   /** Number of parallel triangle binning workers, 0 for serial binning */
+   unsigned num_bin_workers;
+   struct lp_scene *bin_workers;         /**< private worker scenes */
+
    struct slab_mempool scene_slab;
+   struct lp_scene_block_pool block_pool;
+   unsigned scene_max_size;
+   unsigned scene_max_resource_size;
    int num_active_scenes;
    struct lp_scene *scenes[MAX_SCENES];  /**< all the scenes */
    struct lp_scene *scene;               /**< current scene being built */
@@ -244,9 +251,18 @@ lp_setup_flush_and_restart(struct lp_setup_context *setup);
 
 bool
 lp_setup_whole_tile(struct lp_setup_context *setup,
+                    struct lp_scene *scene,
                     const struct lp_rast_shader_inputs *inputs,
                     int tx, int ty, bool opaque);
 
+bool
+lp_setup_bin_triangles_parallel(struct lp_setup_context *setup,
+                                const void *vertex_buffer,
+                                unsigned stride,
+                                const uint16_t *indices,
+                                unsigned start,
+                                unsigned nr);
+
 bool
 lp_setup_is_blit(const struct lp_setup_context *setup,
                  const struct lp_rast_shader_inputs *inputs);
@@ -293,6 +309,7 @@ lp_setup_analyse_triangles(struct lp_setup_context *setup,
 
 bool
 lp_setup_bin_triangle(struct lp_setup_context *setup,
+                      struct lp_scene *scene,
                       struct lp_rast_triangle *tri,
                       bool use_32bits,
                       bool opaque,
@@ -54,6 +54,9 @@ altivec.h inclusion in -std=c++98..11 causes bool to be redefined
 #include "lp_state_fs.h"
 #include "lp_state_setup.h"
 #include "lp_context.h"
+#include "lp_cs_tpool.h"
+#include "lp_scene.h"
+#include "lp_screen.h"
 
 #include <inttypes.h>
 
@@ -273,13 +276,13 @@ check_opaque(const struct lp_setup_context *setup,
  */
 static bool
 do_triangle_ccw(struct lp_setup_context *setup,
+                struct lp_scene *scene,
                 struct fixed_position *position,
                 const float (*v0)[4],
                 const float (*v1)[4],
                 const float (*v2)[4],
                 bool frontfacing)
 {
-   struct lp_scene *scene = setup->scene;
 
    const float (*pv)[4];
    if (setup->flatshade_first) {
@@ -371,6 +374,8 @@ do_triangle_ccw(struct lp_setup_context *setup,
 #endif
 
    LP_COUNT(nr_tris);
+   if (!use_32bits)
+      LP_COUNT(nr_tris_64bit);
 
    /*
     * Rotate the tri such that v0 is closest to the fb origin.
@@ -744,7 +749,7 @@ do_triangle_ccw(struct lp_setup_context *setup,
                                   s_planes, setup->multisample);
    }
 
-   return lp_setup_bin_triangle(setup, tri, use_32bits,
+   return lp_setup_bin_triangle(setup, scene, tri, use_32bits,
                                 check_opaque(setup, v0, v1, v2),
                                 &bbox, nr_planes, viewport_index);
 }
@@ -779,6 +784,7 @@ floor_pot(uint32_t n)
 
 bool
 lp_setup_bin_triangle(struct lp_setup_context *setup,
+                      struct lp_scene *scene,
                       struct lp_rast_triangle *tri,
                       bool use_32bits,
                       bool opaque,
@@ -786,7 +792,6 @@ lp_setup_bin_triangle(struct lp_setup_context *setup,
                       int nr_planes,
                       unsigned viewport_index)
 {
-   struct lp_scene *scene = setup->scene;
    unsigned cmd;
 
    /* What is the largest power-of-two boundary this triangle crosses:
@@ -970,7 +975,8 @@ lp_setup_bin_triangle(struct lp_setup_context *setup,
                /* triangle covers the whole tile- shade whole tile */
                LP_COUNT(nr_fully_covered_64);
                in = true;
-               if (!lp_setup_whole_tile(setup, &tri->inputs, x, y, opaque))
+               if (!lp_setup_whole_tile(setup, scene, &tri->inputs,
+                                        x, y, opaque))
                   goto fail;
             }
 
@@ -1017,11 +1023,11 @@ retry_triangle_ccw(struct lp_setup_context *setup,
       return;
    }
 
-   if (!do_triangle_ccw(setup, position, v0, v1, v2, front)) {
+   if (!do_triangle_ccw(setup, setup->scene, position, v0, v1, v2, front)) {
       if (!lp_setup_flush_and_restart(setup))
          return;
 
-      if (!do_triangle_ccw(setup, position, v0, v1, v2, front))
+      if (!do_triangle_ccw(setup, setup->scene, position, v0, v1, v2, front))
          return;
    }
 }
@@ -1274,3 +1280,187 @@ lp_setup_choose_triangle(struct lp_setup_context *setup)
       break;
    }
 }
+
+
+/*
+ * Parallel triangle binning.
+ *
+ * A batch of triangles is split into contiguous chunks, one per worker.
+ * Each worker runs the regular triangle setup, but bins into a private
+ * worker scene.  Once all workers are done, the private bins are appended
+ * to the real scene bins in chunk order, so the commands in every bin end
+ * up in the same order as with serial binning.
+ */
+
+/** Minimum number of triangles worth handing to a binning worker */
+#define LP_SETUP_BIN_CHUNK_MIN 64
+
+struct lp_setup_bin_job {
+   struct lp_setup_context *setup;
+   const void *vertex_buffer;
+   unsigned stride;
+   const uint16_t *indices;   /**< NULL for non-indexed draws */
+   unsigned start;            /**< first vertex for non-indexed draws */
+   unsigned nr_tris;
+   unsigned nr_chunks;
+};
+
+
+static inline const float (*
+bin_job_vert(const struct lp_setup_bin_job *job, unsigned i))[4]
+{
+   unsigned index = job->indices ? job->indices[i] : job->start + i;
+   return (const float (*)[4])((const char *)job->vertex_buffer +
+                               index * job->stride);
+}
+
+
+/**
+ * Cull and bin one triangle into a worker scene.  This mirrors
+ * triangle_cw/ccw/both, minus the flush-and-retry.
+ */
+static bool
+bin_triangle_worker(struct lp_setup_context *setup,
+                    struct lp_scene *scene,
+                    const float (*v0)[4],
+                    const float (*v1)[4],
+                    const float (*v2)[4])
+{
+   alignas(16) struct fixed_position position;
+   const bool ccw_is_front = setup->ccw_is_frontface;
+   const bool cull_ccw = setup->cullmode &
+      (ccw_is_front ? PIPE_FACE_FRONT : PIPE_FACE_BACK);
+   const bool cull_cw = setup->cullmode &
+      (ccw_is_front ? PIPE_FACE_BACK : PIPE_FACE_FRONT);
+
+   int8_t area_sign = calc_fixed_position(setup, &position, v0, v1, v2);
+
+   if (area_sign > 0 && !cull_ccw) {
+      return do_triangle_ccw(setup, scene, &position, v0, v1, v2,
+                             ccw_is_front);
+   } else if (area_sign < 0 && !cull_cw) {
+      if (setup->flatshade_first) {
+         rotate_fixed_position_12(&position);
+         return do_triangle_ccw(setup, scene, &position, v0, v2, v1,
+                                !ccw_is_front);
+      } else {
+         rotate_fixed_position_01(&position);
+         return do_triangle_ccw(setup, scene, &position, v1, v0, v2,
+                                !ccw_is_front);
+      }
+   }
+
+   return true;
+}
+
+
+static void
+bin_triangles_chunk(void *data, int chunk, struct lp_cs_local_mem *lmem)
+{
+   const struct lp_setup_bin_job *job = data;
+   struct lp_setup_context *setup = job->setup;
+   struct lp_scene *worker = &setup->bin_workers[chunk];
+   const unsigned first = job->nr_tris * chunk / job->nr_chunks;
+   const unsigned last = job->nr_tris * (chunk + 1) / job->nr_chunks;
+
+   for (unsigned t = first; t < last; t++) {
+      if (!bin_triangle_worker(setup, worker,
+                               bin_job_vert(job, 3 * t + 0),
+                               bin_job_vert(job, 3 * t + 1),
+                               bin_job_vert(job, 3 * t + 2))) {
+         worker->alloc_failed = true;
+         return;
+      }
+   }
+}
+
+
+/**
+ * Bin a list of triangles using the binning workers.
+ *
+ * \param indices  vertex indices, or NULL to use consecutive vertices
+ *                 beginning at start
+ * \param nr       number of vertices (a multiple of three)
+ * \return false if nothing was binned and the caller needs to take the
+ *         serial path
+ */
+bool
+lp_setup_bin_triangles_parallel(struct lp_setup_context *setup,
+                                const void *vertex_buffer,
+                                unsigned stride,
+                                const uint16_t *indices,
+                                unsigned start,
+                                unsigned nr)
+{
+   struct llvmpipe_screen *screen = llvmpipe_screen(setup->pipe->screen);
+   struct lp_scene *scene = setup->scene;
+   const unsigned nr_tris = nr / 3;
+   const unsigned nr_chunks = MIN2(setup->num_bin_workers,
+                                   nr_tris / LP_SETUP_BIN_CHUNK_MIN);
+
+   if (nr_chunks < 2 ||
+       setup->rasterizer_discard ||
+       setup->cullmode == PIPE_FACE_FRONT_AND_BACK ||
+       !scene || lp_scene_is_oom(scene) ||
+       lp_setup_zero_sample_mask(setup))
+      return false;
+
+   if (!setup->bin_workers) {
+      setup->bin_workers = CALLOC(setup->num_bin_workers,
+                                  sizeof(*setup->bin_workers));
+      if (!setup->bin_workers)
+         return false;
+   }
+
+   bool begun = true;
+   for (unsigned i = 0; i < nr_chunks; i++)
+      begun &= lp_scene_begin_worker_binning(&setup->bin_workers[i], scene);
+
+   if (!begun) {
+      for (unsigned i = 0; i < nr_chunks; i++)
+         lp_scene_discard_worker(&setup->bin_workers[i]);
+      return false;
+   }
+
+   struct lp_setup_bin_job job = {
+      .setup = setup,
+      .vertex_buffer = vertex_buffer,
+      .stride = stride,
+      .indices = indices,
+      .start = start,
+      .nr_tris = nr_tris,
+      .nr_chunks = nr_chunks,
+   };
+
+   mtx_lock(&screen->cs_mutex);
+   struct lp_cs_tpool_task *task =
+      lp_cs_tpool_queue_task(screen->cs_tpool, bin_triangles_chunk,
+                             &job, nr_chunks);
+   mtx_unlock(&screen->cs_mutex);
+
+   /* A NULL task without pool threads means the work already ran inline. */
+   bool failed = !task && screen->cs_tpool->num_threads > 0;
+   lp_cs_tpool_wait_for_task(screen->cs_tpool, &task);
+
+   for (unsigned i = 0; i < nr_chunks; i++)
+      failed |= setup->bin_workers[i].alloc_failed;
+
+   if (failed) {
+      /* Some worker ran out of memory, redo the whole batch serially so
+       * that scene flushes happen at the right primitive.
+       */
+      for (unsigned i = 0; i < nr_chunks; i++)
+         lp_scene_discard_worker(&setup->bin_workers[i]);
+      return false;
+   }
+
+   for (unsigned i = 0; i < nr_chunks; i++)
+      lp_scene_merge_worker(scene, &setup->bin_workers[i]);
+
+   struct llvmpipe_context *lp_context = llvmpipe_context(setup->pipe);
+   if (lp_context->active_statistics_queries) {
+      lp_context->pipeline_statistics.c_primitives += nr_tris;
+   }
+
+   return true;
+}
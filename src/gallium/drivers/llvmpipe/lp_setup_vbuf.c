@@ -165,6 +165,19 @@ rect(struct lp_setup_context *setup,
 }
 
 
+/**
+ * Can triangle lists go through the parallel binning workers?  Not if
+ * they might be turned into rectangles for the linear rasterizer.
+ */
+static inline bool
+parallel_binning(const struct lp_setup_context *setup,
+                 bool uses_constant_interp)
+{
+   return setup->num_bin_workers > 1 &&
+          !(setup->permit_linear_rasterizer && !uses_constant_interp);
+}
+
+
 /**
  * draw elements / indexed primitives
  */
@@ -223,7 +236,11 @@ lp_setup_draw_elements(struct vbuf_render *vbr, const uint16_t *indices, uint nr
       break;
 
    case MESA_PRIM_TRIANGLES:
-      if (nr % 6 == 0 && !uses_constant_interp) {
+      if (parallel_binning(setup, uses_constant_interp) &&
+          lp_setup_bin_triangles_parallel(setup, vertex_buffer, stride,
+                                          indices, 0, nr)) {
+         /* Binned by the worker threads. */
+      } else if (nr % 6 == 0 && !uses_constant_interp) {
          for (i = 5; i < nr; i += 6) {
             rect(setup,
                  get_vert(vertex_buffer, indices[i-5], stride),
@@ -431,7 +448,11 @@ lp_setup_draw_arrays(struct vbuf_render *vbr, uint start, uint nr)
       break;
 
    case MESA_PRIM_TRIANGLES:
-      if (nr % 6 == 0 && !uses_constant_interp) {
+      if (parallel_binning(setup, uses_constant_interp) &&
+          lp_setup_bin_triangles_parallel(setup, vertex_buffer, stride,
+                                          NULL, 0, nr)) {
+         /* Binned by the worker threads. */
+      } else if (nr % 6 == 0 && !uses_constant_interp) {
          for (i = 5; i < nr; i += 6) {
             rect(setup,
                  get_vert(vertex_buffer, i-5, stride),
@@ -125,6 +125,9 @@ llvmpipe_set_framebuffer_state(struct pipe_context *,
 void
 llvmpipe_update_fs(struct llvmpipe_context *lp);
 
+void
+llvmpipe_poll_fs_pending(struct llvmpipe_context *lp);
+
 void 
 llvmpipe_update_setup(struct llvmpipe_context *lp);
 
@@ -146,6 +149,10 @@ llvmpipe_mesh_update_derived(struct llvmpipe_context *llvmpipe);
 void
 llvmpipe_update_derived(struct llvmpipe_context *llvmpipe);
 
+void
+llvmpipe_rebind_buffer(struct llvmpipe_context *llvmpipe,
+                       struct pipe_resource *buffer);
+
 void
 llvmpipe_init_sampler_funcs(struct llvmpipe_context *llvmpipe);
 
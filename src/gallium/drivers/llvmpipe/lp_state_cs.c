@@ -31,6 +31,7 @@
 #include "gallivm/lp_bld_debug.h"
 #include "gallivm/lp_bld_intr.h"
 #include "gallivm/lp_bld_flow.h"
+#include "gallivm/lp_bld_format.h"
 #include "gallivm/lp_bld_pack.h"
 #include "gallivm/lp_bld_gather.h"
 #include "gallivm/lp_bld_coro.h"
@@ -46,6 +47,7 @@
 #include "lp_memory.h"
 #include "lp_query.h"
 #include "lp_cs_tpool.h"
+#include "lp_tex_sample.h"
 #include "frontend/sw_winsys.h"
 #include "nir/nir_to_tgsi_info.h"
 #include "nir/tgsi_to_nir.h"
@@ -310,6 +312,20 @@ mesh_convert_to_aos(struct gallivm_state *gallivm,
 #endif
 }
 
+static inline unsigned
+cs_subgroup_size(void)
+{
+   return MIN2(lp_native_vector_width / 32, 16);
+}
+
+
+static inline bool
+cs_block_is_single_subgroup(unsigned x, unsigned y, unsigned z)
+{
+   return x * y * z <= cs_subgroup_size();
+}
+
+
 static void
 generate_compute(struct llvmpipe_context *lp,
                  struct lp_compute_shader *shader,
@@ -338,7 +354,12 @@ generate_compute(struct llvmpipe_context *lp,
    bool is_mesh = nir->info.stage == MESA_SHADER_MESH;
    unsigned i;
 
-   bool use_coro = nir->info.uses_memory_barrier || is_mesh;
+   /* Invocations only need to be suspended at execution barriers, and
+    * not even there when the whole workgroup runs as a single subgroup.
+    * Everything else runs as a flat loop over the subgroups.
+    */
+   bool use_coro = is_mesh ||
+                   (nir->info.uses_control_barrier && !key->single_subgroup);
 
    LLVMValueRef output_array = NULL;
 
@@ -354,7 +375,7 @@ generate_compute(struct llvmpipe_context *lp,
    cs_type.sign = true;          /* values are signed */
    cs_type.norm = false;         /* values are not limited to [0,1] or [-1,1] */
    cs_type.width = 32;           /* 32-bit float */
-   cs_type.length = MIN2(lp_native_vector_width / 32, 16); /* n*4 elements per vector */
+   cs_type.length = cs_subgroup_size(); /* n*4 elements per vector */
    snprintf(func_name, sizeof(func_name), "cs_variant");
 
    snprintf(func_name_coro, sizeof(func_name), "cs_co_variant");
@@ -1165,6 +1186,20 @@ make_variant_key(struct llvmpipe_context *lp,
                                                &lp->images[sh_type][i]);
       }
    }
+
+   /* Only matters to shaders with barriers, so don't create variants
+    * per block size for anything else.
+    */
+   if (nir->info.uses_control_barrier) {
+      if (!nir->info.workgroup_size_variable) {
+         key->single_subgroup =
+            cs_block_is_single_subgroup(nir->info.workgroup_size[0],
+                                        nir->info.workgroup_size[1],
+                                        nir->info.workgroup_size[2]);
+      } else if (sh_type == PIPE_SHADER_COMPUTE) {
+         key->single_subgroup = lp->cs_single_subgroup;
+      }
+   }
    return key;
 }
 
@@ -1174,6 +1209,7 @@ dump_cs_variant_key(const struct lp_compute_shader_variant_key *key)
 {
    int i;
    debug_printf("cs variant %p:\n", (void *) key);
+   debug_printf("single_subgroup = %u\n", key->single_subgroup);
 
    for (i = 0; i < key->nr_samplers; ++i) {
       const struct lp_sampler_static_state *samplers = lp_cs_variant_key_samplers(key);
@@ -1331,13 +1367,20 @@ generate_variant(struct llvmpipe_context *lp,
 /* module has been moved into ORCJIT after gallivm_compile_module */
    variant->nr_instrs += lp_build_count_ir_module(variant->gallivm->module);
 
-   gallivm_compile_module(variant->gallivm);
+   bool compiled = gallivm_compile_module(variant->gallivm);
 #else
-   gallivm_compile_module(variant->gallivm);
+   bool compiled = gallivm_compile_module(variant->gallivm);
 
    variant->nr_instrs += lp_build_count_ir_module(variant->gallivm->module);
 #endif
 
+   if (!compiled) {
+      gallivm_destroy(variant->gallivm);
+      FREE(variant->function_name);
+      FREE(variant);
+      return NULL;
+   }
+
    variant->jit_function = (lp_jit_cs_func)
       gallivm_jit_function(variant->gallivm, variant->function, variant->function_name);
 
@@ -1698,6 +1741,11 @@ cs_exec_fn(void *init_data, int iter_idx, struct lp_cs_local_mem *lmem)
       memset(lmem->local_mem_ptr, 0, job_info->req_local_mem);
    thread_data.shared = lmem->local_mem_ptr;
 
+   /* Without a cache the shaders decode the blocks directly. */
+   if (!lmem->format_cache && lp_texture_cache_blocks())
+      lmem->format_cache = lp_build_format_cache_create(lp_texture_cache_blocks());
+   thread_data.cache = lmem->format_cache;
+
    thread_data.payload = job_info->payload;
 
    unsigned grid_z, grid_y, grid_x;
@@ -1780,8 +1828,22 @@ llvmpipe_launch_grid(struct pipe_context *pipe,
 
    memset(&job_info, 0, sizeof(job_info));
 
+   bool single_subgroup = cs_block_is_single_subgroup(info->block[0],
+                                                      info->block[1],
+                                                      info->block[2]);
+   if (llvmpipe->cs_single_subgroup != single_subgroup) {
+      llvmpipe->cs_single_subgroup = single_subgroup;
+      const struct shader_info *cs_info = &llvmpipe->cs->base.ir.nir->info;
+      if (cs_info->uses_control_barrier && cs_info->workgroup_size_variable)
+         llvmpipe->cs_dirty |= LP_CSNEW_CS;
+   }
+
    llvmpipe_cs_update_derived(llvmpipe);
 
+   /* The shader failed to compile, see generate_variant(). */
+   if (!llvmpipe->csctx->cs.current.variant)
+      return;
+
    fill_grid_size(pipe, 0, info, job_info.grid_size);
 
    job_info.grid_base[0] = info->grid_base[0];
@@ -2125,6 +2187,11 @@ llvmpipe_draw_mesh_tasks(struct pipe_context *pipe,
    if (lp->dirty)
       llvmpipe_update_derived(lp);
 
+   /* A shader failed to compile, see generate_variant(). */
+   if ((lp->tss && !lp->task_ctx->cs.current.variant) ||
+       !lp->mesh_ctx->cs.current.variant)
+      return;
+
    unsigned draw_count = info->draw_count;
    if (info->indirect && info->indirect_draw_count) {
       struct pipe_transfer *dc_transfer;
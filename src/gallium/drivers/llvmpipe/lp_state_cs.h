@@ -41,6 +41,8 @@ struct lp_compute_shader_variant_key
    unsigned nr_samplers:8;
    unsigned nr_sampler_views:8;
    unsigned nr_images:8;
+   /* The workgroup fits in a single subgroup, so barriers are no-ops. */
+   unsigned single_subgroup:1;
 };
 
 #define LP_CS_MAX_VARIANT_KEY_SIZE                                      \
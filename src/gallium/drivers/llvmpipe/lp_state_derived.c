@@ -202,10 +202,7 @@ check_linear_rasterizer(struct llvmpipe_context *lp)
       (lp->framebuffer.nr_cbufs == 1 && lp->framebuffer.cbufs[0].texture &&
        util_res_sample_count(lp->framebuffer.cbufs[0].texture) == 1 &&
        lp->framebuffer.cbufs[0].texture->target == PIPE_TEXTURE_2D &&
-       (lp->framebuffer.cbufs[0].format == PIPE_FORMAT_B8G8R8A8_UNORM ||
-        lp->framebuffer.cbufs[0].format == PIPE_FORMAT_B8G8R8X8_UNORM ||
-        lp->framebuffer.cbufs[0].format == PIPE_FORMAT_R8G8B8A8_UNORM ||
-        lp->framebuffer.cbufs[0].format == PIPE_FORMAT_R8G8B8X8_UNORM));
+       lp_linear_format_alpha_mask(lp->framebuffer.cbufs[0].format) != 0);
 
    /* permit_linear means guardband, hence fake scissor, which we can only
     * handle if there's just one vp. */
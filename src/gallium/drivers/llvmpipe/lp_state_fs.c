@@ -3148,8 +3148,7 @@ generate_unswizzled_blend(struct gallivm_state *gallivm,
  * 2x2 pixels.
  */
 static void
-generate_fragment(struct llvmpipe_context *lp,
-                  struct lp_fragment_shader *shader,
+generate_fragment(struct lp_fragment_shader *shader,
                   struct lp_fragment_shader_variant *variant,
                   unsigned partial_mask)
 {
@@ -3733,6 +3732,7 @@ lp_debug_fs_variant(struct lp_fragment_shader_variant *variant)
    debug_printf("variant->opaque = %u\n", variant->opaque);
    debug_printf("variant->potentially_opaque = %u\n", variant->potentially_opaque);
    debug_printf("variant->blit = %u\n", variant->blit);
+   debug_printf("variant->hiz_cull = %u\n", variant->hiz_cull);
    debug_printf("shader->kind = %s\n", lp_debug_fs_kind(variant->shader->kind));
    debug_printf("\n");
 }
@@ -3762,15 +3762,14 @@ lp_fs_get_ir_cache_key(struct lp_fragment_shader_variant *variant,
 
 
 /**
- * Generate a new fragment shader variant from the shader code and
- * other state indicated by the key.
+ * Allocate a new fragment shader variant for the given key.  The code is
+ * generated by compile_variant().
  */
 static struct lp_fragment_shader_variant *
-generate_variant(struct llvmpipe_context *lp,
-                 struct lp_fragment_shader *shader,
-                 const struct lp_fragment_shader_variant_key *key)
+create_variant(struct llvmpipe_context *lp,
+               struct lp_fragment_shader *shader,
+               const struct lp_fragment_shader_variant_key *key)
 {
-   struct nir_shader *nir = shader->base.ir.nir;
    struct lp_fragment_shader_variant *variant =
       MALLOC(sizeof *variant + shader->variant_key_size - sizeof variant->key);
    if (!variant)
@@ -3779,34 +3778,80 @@ generate_variant(struct llvmpipe_context *lp,
    memset(variant, 0, sizeof(*variant));
 
    pipe_reference_init(&variant->reference, 1);
+   util_queue_fence_init(&variant->ready);
    lp_fs_reference(lp, &variant->shader, shader);
 
    memcpy(&variant->key, key, shader->variant_key_size);
 
-   struct llvmpipe_screen *screen = llvmpipe_screen(lp->pipe.screen);
+   variant->list_item_global.base = variant;
+   variant->list_item_local.base = variant;
+   variant->no = shader->variants_created++;
+
+   return variant;
+}
+
+
+/**
+ * Blit shaders are trivial, the full optimization pipeline wouldn't improve
+ * them.
+ */
+static bool
+fs_always_fast_tier(const struct lp_fragment_shader *shader)
+{
+   return shader->kind == LP_FS_KIND_BLIT_RGBA ||
+          shader->kind == LP_FS_KIND_BLIT_RGB1;
+}
+
+
+/**
+ * Generate the code of a fragment shader variant from the shader code and
+ * other state indicated by the key.  This may run on the context's
+ * background queue, so it must not touch any context state.
+ *
+ * \param found  result of an earlier shader cache search for the variant,
+ *               or NULL to search the cache here
+ */
+static bool
+compile_variant(struct llvmpipe_screen *screen,
+                lp_context_ref *context,
+                struct lp_fragment_shader_variant *variant,
+                const struct lp_cached_code *found)
+{
+   struct lp_fragment_shader *shader = variant->shader;
+   const struct lp_fragment_shader_variant_key *key = &variant->key;
+   struct nir_shader *nir = shader->base.ir.nir;
+
+   /* Held while the NIR gets read, up to the end of code generation. */
+   simple_mtx_lock(&shader->compile_mutex);
+
    struct lp_cached_code cached = { 0 };
    unsigned char ir_sha1_cache_key[20];
    bool needs_caching = false;
-   if (shader->base.ir.nir) {
+   /* Stand-ins share the key of the fully optimized variant, so they must
+    * not go into the cache.
+    */
+   if (shader->base.ir.nir && !variant->fast_tier) {
       lp_fs_get_ir_cache_key(variant, ir_sha1_cache_key);
 
-      lp_disk_cache_find_shader(screen, &cached, ir_sha1_cache_key);
+      if (found)
+         cached = *found;
+      else
+         lp_disk_cache_find_shader(screen, &cached, ir_sha1_cache_key);
       if (!cached.data_size)
          needs_caching = true;
    }
 
    char module_name[64];
    snprintf(module_name, sizeof(module_name), "fs%u_variant%u",
-            shader->no, shader->variants_created);
-   variant->gallivm = gallivm_create(module_name, &lp->context, &cached);
+            shader->no, variant->no);
+   variant->gallivm = gallivm_create(module_name, context, &cached);
    if (!variant->gallivm) {
-      FREE(variant);
-      return NULL;
+      simple_mtx_unlock(&shader->compile_mutex);
+      return false;
    }
 
-   variant->list_item_global.base = variant;
-   variant->list_item_local.base = variant;
-   variant->no = shader->variants_created++;
+   if (variant->fast_tier || fs_always_fast_tier(shader))
+      variant->gallivm->opt_tier = GALLIVM_OPT_TIER_FAST;
 
    /*
     * Determine whether we are touching all channels in the color buffer.
@@ -3865,7 +3910,6 @@ generate_variant(struct llvmpipe_context *lp,
          lp_fs_variant_key_sampler_idx(key, 0);
       assert(samp0);
 
-      const enum pipe_format texture_format = samp0->texture_state.format;
       const enum pipe_texture_target target = samp0->texture_state.target;
       const unsigned min_img_filter = samp0->sampler_state.min_img_filter;
       const unsigned mag_img_filter = samp0->sampler_state.mag_img_filter;
@@ -3881,32 +3925,55 @@ generate_variant(struct llvmpipe_context *lp,
           min_img_filter == PIPE_TEX_FILTER_NEAREST &&
           mag_img_filter == PIPE_TEX_FILTER_NEAREST &&
           min_mip_filter == PIPE_TEX_MIPFILTER_NONE &&
-          ((texture_format &&
-            util_is_format_compatible(util_format_description(texture_format),
-                                      cbuf0_format_desc)) ||
-           (shader->kind == LP_FS_KIND_BLIT_RGB1 &&
-            (texture_format == PIPE_FORMAT_B8G8R8A8_UNORM ||
-             texture_format == PIPE_FORMAT_B8G8R8X8_UNORM) &&
-            (key->cbuf_format[0] == PIPE_FORMAT_B8G8R8A8_UNORM ||
-             key->cbuf_format[0] == PIPE_FORMAT_B8G8R8X8_UNORM)))) {
+          lp_linear_blit_compatible(shader->kind, samp0,
+                                    key->cbuf_format[0])) {
          variant->blit = 1;
       }
    }
 
+   /* Determine whether occluded primitives may be skipped without running
+    * the shader: the depth test alone must decide whether anything is
+    * written, the depth must come from the interpolated position, and the
+    * shader must not have side effects.
+    */
+   variant->hiz_cull =
+         key->depth.enabled &&
+         (key->depth.func == PIPE_FUNC_LESS ||
+          key->depth.func == PIPE_FUNC_LEQUAL ||
+          key->depth.func == PIPE_FUNC_GREATER ||
+          key->depth.func == PIPE_FUNC_GEQUAL ||
+          key->depth.func == PIPE_FUNC_EQUAL) &&
+         !key->stencil[0].enabled &&
+         !key->multisample &&
+         key->zsbuf_nr_samples <= 1 &&
+         !(nir->info.outputs_written & BITFIELD64_BIT(FRAG_RESULT_DEPTH)) &&
+         (!nir->info.writes_memory || nir->info.fs.early_fragment_tests);
+
    /* Determine whether this shader + pipeline state is a candidate for
     * the linear path.
     */
-   const bool linear_pipeline =
+   const bool linear_state =
          !key->stencil[0].enabled &&
          !key->depth.enabled &&
          !nir->info.fs.uses_discard &&
-         !key->blend.logicop_enable &&
-         (key->cbuf_format[0] == PIPE_FORMAT_B8G8R8A8_UNORM ||
-          key->cbuf_format[0] == PIPE_FORMAT_B8G8R8X8_UNORM ||
-          key->cbuf_format[0] == PIPE_FORMAT_R8G8B8A8_UNORM ||
-          key->cbuf_format[0] == PIPE_FORMAT_R8G8B8X8_UNORM);
+         !key->blend.logicop_enable;
+   const bool linear_pipeline =
+         linear_state &&
+         lp_linear_format_alpha_mask(key->cbuf_format[0]) != 0;
+
+   /* The LLVM linear shaders only write 8-bit color buffers, the 10-bit
+    * formats are handled by the blit/blend fastpaths alone.
+    */
+   const bool linear_llvm_format =
+         linear_pipeline &&
+         lp_linear_format_alpha_mask(key->cbuf_format[0]) == 0xff000000;
 
-   memcpy(&variant->key, key, sizeof *key);
+   if (shader->kind == LP_FS_KIND_GENERAL)
+      variant->linear_fallback = LP_LINEAR_FALLBACK_SHADER;
+   else if (!linear_state)
+      variant->linear_fallback = LP_LINEAR_FALLBACK_STATE;
+   else
+      variant->linear_fallback = LP_LINEAR_FALLBACK_FORMAT;
 
    if ((LP_DEBUG & DEBUG_FS) || (gallivm_debug & GALLIVM_DEBUG_IR)) {
       lp_debug_fs_variant(variant);
@@ -3917,12 +3984,12 @@ generate_variant(struct llvmpipe_context *lp,
    lp_jit_init_types(variant);
 
    if (variant->jit_function[RAST_EDGE_TEST] == NULL)
-      generate_fragment(lp, shader, variant, RAST_EDGE_TEST);
+      generate_fragment(shader, variant, RAST_EDGE_TEST);
 
    if (variant->jit_function[RAST_WHOLE] == NULL) {
       if (variant->opaque) {
          /* Specialized shader, which doesn't need to read the color buffer. */
-         generate_fragment(lp, shader, variant, RAST_WHOLE);
+         generate_fragment(shader, variant, RAST_WHOLE);
       }
    }
 
@@ -3942,11 +4009,11 @@ generate_variant(struct llvmpipe_context *lp,
       /* If the original fastpath doesn't cover this variant, try the new
        * code:
        */
-      if (variant->jit_linear == NULL) {
+      if (variant->jit_linear == NULL && linear_llvm_format) {
          if (shader->kind == LP_FS_KIND_BLIT_RGBA ||
              shader->kind == LP_FS_KIND_BLIT_RGB1 ||
              shader->kind == LP_FS_KIND_LLVM_LINEAR) {
-            llvmpipe_fs_variant_linear_llvm(lp, shader, variant);
+            llvmpipe_fs_variant_linear_llvm(shader, variant);
          }
       }
    } else {
@@ -3956,6 +4023,8 @@ generate_variant(struct llvmpipe_context *lp,
       }
    }
 
+   simple_mtx_unlock(&shader->compile_mutex);
+
    /*
     * Compile everything
     */
@@ -3964,13 +4033,16 @@ generate_variant(struct llvmpipe_context *lp,
 /* module has been moved into ORCJIT after gallivm_compile_module */
    variant->nr_instrs += lp_build_count_ir_module(variant->gallivm->module);
 
-   gallivm_compile_module(variant->gallivm);
+   bool compiled = gallivm_compile_module(variant->gallivm);
 #else
-   gallivm_compile_module(variant->gallivm);
+   bool compiled = gallivm_compile_module(variant->gallivm);
 
    variant->nr_instrs += lp_build_count_ir_module(variant->gallivm->module);
 #endif
 
+   if (!compiled)
+      return false;
+
    if (variant->function[RAST_EDGE_TEST]) {
       variant->jit_function[RAST_EDGE_TEST] = (lp_jit_frag_func)
             gallivm_jit_function(variant->gallivm,
@@ -4000,6 +4072,11 @@ generate_variant(struct llvmpipe_context *lp,
        * code to determine active inputs.
        */
       lp_linear_check_variant(variant);
+
+      if (shader->kind == LP_FS_KIND_GENERAL)
+         variant->linear_fallback = LP_LINEAR_FALLBACK_SHADER;
+      else if (!linear_llvm_format)
+         variant->linear_fallback = LP_LINEAR_FALLBACK_FORMAT;
    }
 
    if (needs_caching) {
@@ -4008,10 +4085,85 @@ generate_variant(struct llvmpipe_context *lp,
 
    gallivm_free_ir(variant->gallivm);
 
+   return true;
+}
+
+
+/**
+ * Compile a variant on the context thread.
+ */
+static bool
+compile_variant_now(struct llvmpipe_context *lp,
+                    struct lp_fragment_shader_variant *variant,
+                    const struct lp_cached_code *found)
+{
+   int64_t t0 = os_time_get();
+   bool ok = compile_variant(llvmpipe_screen(lp->pipe.screen), &lp->context,
+                             variant, found);
+   int64_t t1 = os_time_get();
+   int64_t dt = t1 - t0;
+   LP_COUNT_ADD(llvm_compile_time, dt);
+   LP_COUNT_ADD(nr_llvm_compiles, 2);  /* emit vs. omit in/out test */
+
+   return ok;
+}
+
+
+/**
+ * Generate a new fragment shader variant from the shader code and
+ * other state indicated by the key.
+ */
+static struct lp_fragment_shader_variant *
+generate_variant(struct llvmpipe_context *lp,
+                 struct lp_fragment_shader *shader,
+                 const struct lp_fragment_shader_variant_key *key)
+{
+   struct lp_fragment_shader_variant *variant =
+      create_variant(lp, shader, key);
+   if (!variant)
+      return NULL;
+
+   if (!compile_variant_now(lp, variant, NULL)) {
+      lp_fs_variant_reference(lp, &variant, NULL);
+      return NULL;
+   }
+
    return variant;
 }
 
 
+static void
+compile_variant_job(void *data, void *gdata, int thread_index)
+{
+   struct lp_fragment_shader_variant *variant = data;
+   struct llvmpipe_context *lp = gdata;
+   const struct lp_cached_code miss = { 0 };
+
+   compile_variant(llvmpipe_screen(lp->pipe.screen), &lp->fs_queue_context,
+                   variant, variant->cache_miss ? &miss : NULL);
+}
+
+
+/**
+ * Account for a variant which was compiled in the background, waiting for
+ * the compilation to complete if necessary, and retire its fallback unless
+ * the compilation failed.
+ */
+static void
+finish_async_variant(struct llvmpipe_context *lp,
+                     struct lp_fragment_shader_variant *variant)
+{
+   assert(variant->async);
+
+   util_queue_fence_wait(&variant->ready);
+   variant->async = false;
+
+   lp->nr_fs_instrs += variant->nr_instrs;
+   if (variant->jit_function[RAST_WHOLE])
+      lp_fs_variant_reference(lp, &variant->fallback, NULL);
+}
+
+
 static void *
 llvmpipe_create_fs_state(struct pipe_context *pipe,
                          const struct pipe_shader_state *templ)
@@ -4025,6 +4177,7 @@ llvmpipe_create_fs_state(struct pipe_context *pipe,
    pipe_reference_init(&shader->reference, 1);
    shader->no = fs_no++;
    list_inithead(&shader->variants.list);
+   simple_mtx_init(&shader->compile_mutex, mtx_plain);
 
    shader->base.type = PIPE_SHADER_IR_NIR;
 
@@ -4046,6 +4199,7 @@ llvmpipe_create_fs_state(struct pipe_context *pipe,
 
    shader->draw_data = draw_create_fragment_shader(llvmpipe->draw, templ);
    if (shader->draw_data == NULL) {
+      simple_mtx_destroy(&shader->compile_mutex);
       FREE(shader);
       return NULL;
    }
@@ -4151,6 +4305,11 @@ llvmpipe_remove_shader_variant(struct llvmpipe_context *lp,
                    lp->nr_fs_variants, variant->nr_instrs, lp->nr_fs_instrs);
    }
 
+   if (variant->async)
+      finish_async_variant(lp, variant);
+   if (lp->fs_pending == variant)
+      lp->fs_pending = NULL;
+
    /* remove from shader's list */
    list_del(&variant->list_item_local.list);
    variant->shader->variants_cached--;
@@ -4166,7 +4325,10 @@ void
 llvmpipe_destroy_shader_variant(struct llvmpipe_context *lp,
                                 struct lp_fragment_shader_variant *variant)
 {
-   gallivm_destroy(variant->gallivm);
+   if (variant->gallivm)
+      gallivm_destroy(variant->gallivm);
+   lp_fs_variant_reference(lp, &variant->fallback, NULL);
+   util_queue_fence_destroy(&variant->ready);
    lp_fs_reference(lp, &variant->shader, NULL);
    if (variant->function_name[RAST_EDGE_TEST])
       FREE(variant->function_name[RAST_EDGE_TEST]);
@@ -4187,6 +4349,7 @@ llvmpipe_destroy_fs(struct llvmpipe_context *llvmpipe,
 
    ralloc_free(shader->base.ir.nir);
    assert(shader->variants_cached == 0);
+   simple_mtx_destroy(&shader->compile_mutex);
    FREE(shader);
 }
 
@@ -4392,6 +4555,101 @@ llvmpipe_set_shader_images(struct pipe_context *pipe,
 }
 
 
+/**
+ * Update the state derived from a buffer whose storage was replaced by
+ * threaded_context.  The draw module keeps pointers to the constants and
+ * shader buffers of the vertex stages and to the stream output targets, the
+ * other stages look everything up again when it's flagged dirty.
+ */
+void
+llvmpipe_rebind_buffer(struct llvmpipe_context *llvmpipe,
+                       struct pipe_resource *buffer)
+{
+   const uint8_t *data = llvmpipe_resource_data(buffer);
+
+   for (unsigned sh = 0; sh < PIPE_SHADER_MESH_TYPES; sh++) {
+      const bool draw_stage = sh == PIPE_SHADER_VERTEX ||
+                              sh == PIPE_SHADER_GEOMETRY ||
+                              sh == PIPE_SHADER_TESS_CTRL ||
+                              sh == PIPE_SHADER_TESS_EVAL;
+      bool bound = false;
+
+      for (unsigned i = 0; i < ARRAY_SIZE(llvmpipe->constants[sh]); i++) {
+         const struct pipe_constant_buffer *cb = &llvmpipe->constants[sh][i];
+         if (cb->buffer != buffer)
+            continue;
+
+         if (draw_stage) {
+            draw_set_mapped_constant_buffer(llvmpipe->draw, sh, i,
+                                            data + cb->buffer_offset,
+                                            cb->buffer_size);
+         }
+         bound = true;
+      }
+
+      for (unsigned i = 0; i < ARRAY_SIZE(llvmpipe->ssbos[sh]); i++) {
+         const struct pipe_shader_buffer *sb = &llvmpipe->ssbos[sh][i];
+         if (sb->buffer != buffer)
+            continue;
+
+         if (draw_stage) {
+            draw_set_mapped_shader_buffer(llvmpipe->draw, sh, i,
+                                          data + sb->buffer_offset,
+                                          sb->buffer_size);
+         }
+         bound = true;
+      }
+
+      for (unsigned i = 0; i < llvmpipe->num_images[sh]; i++)
+         bound |= llvmpipe->images[sh][i].resource == buffer;
+
+      for (unsigned i = 0; i < llvmpipe->num_sampler_views[sh]; i++) {
+         const struct pipe_sampler_view *view = llvmpipe->sampler_views[sh][i];
+         bound |= view && view->texture == buffer;
+      }
+
+      if (!bound)
+         continue;
+
+      switch (sh) {
+      case PIPE_SHADER_COMPUTE:
+         llvmpipe->cs_dirty |= LP_CSNEW_CONSTANTS | LP_CSNEW_SSBOS |
+                               LP_CSNEW_IMAGES | LP_CSNEW_SAMPLER_VIEW;
+         break;
+      case PIPE_SHADER_FRAGMENT:
+         llvmpipe->dirty |= LP_NEW_FS_CONSTANTS | LP_NEW_FS_SSBOS |
+                            LP_NEW_FS_IMAGES | LP_NEW_SAMPLER_VIEW;
+         break;
+      case PIPE_SHADER_TASK:
+         llvmpipe->dirty |= LP_NEW_TASK_CONSTANTS | LP_NEW_TASK_SSBOS |
+                            LP_NEW_TASK_IMAGES | LP_NEW_TASK_SAMPLER_VIEW;
+         break;
+      case PIPE_SHADER_MESH:
+         llvmpipe->dirty |= LP_NEW_MESH_CONSTANTS | LP_NEW_MESH_SSBOS |
+                            LP_NEW_MESH_IMAGES | LP_NEW_MESH_SAMPLER_VIEW;
+         break;
+      default:
+         /* mapped again for every draw */
+         break;
+      }
+   }
+
+   bool so_bound = false;
+   for (unsigned i = 0; i < llvmpipe->num_so_targets; i++) {
+      struct draw_so_target *target = llvmpipe->so_targets[i];
+      if (target && target->target.buffer == buffer) {
+         target->mapping = llvmpipe_resource(buffer)->data;
+         so_bound = true;
+      }
+   }
+
+   if (so_bound) {
+      draw_set_mapped_so_targets(llvmpipe->draw, llvmpipe->num_so_targets,
+                                 llvmpipe->so_targets);
+   }
+}
+
+
 /**
  * Return the blend factor equivalent to a destination alpha of one.
  */
@@ -4678,6 +4936,183 @@ make_variant_key(struct llvmpipe_context *lp,
 }
 
 
+/**
+ * Make a copy of the key without the specializations which only affect
+ * performance: a variant compiled for the generic key works for every key
+ * it was derived from, as it reads the actual values from the texture
+ * state at runtime.  See also llvmpipe_create_image_handle().
+ */
+static const struct lp_fragment_shader_variant_key *
+make_generic_variant_key(const struct lp_fragment_shader *shader,
+                         const struct lp_fragment_shader_variant_key *key,
+                         char *store)
+{
+   struct lp_fragment_shader_variant_key *generic =
+      (struct lp_fragment_shader_variant_key *)store;
+
+   memcpy(generic, key, shader->variant_key_size);
+
+   struct lp_sampler_static_state *fs_sampler =
+      lp_fs_variant_key_samplers(generic);
+   for (unsigned i = 0;
+        i < MAX2(generic->nr_samplers, generic->nr_sampler_views); ++i) {
+      fs_sampler[i].texture_state.pot_width = false;
+      fs_sampler[i].texture_state.pot_height = false;
+      fs_sampler[i].texture_state.pot_depth = false;
+   }
+
+   struct lp_image_static_state *lp_image = lp_fs_variant_key_images(generic);
+   for (unsigned i = 0; i < generic->nr_images; ++i) {
+      lp_image[i].image_state.pot_width = false;
+      lp_image[i].image_state.pot_height = false;
+      lp_image[i].image_state.pot_depth = false;
+   }
+
+   return generic;
+}
+
+
+static struct lp_fragment_shader_variant *
+find_variant(struct lp_fragment_shader *shader,
+             const struct lp_fragment_shader_variant_key *key)
+{
+   struct lp_fs_variant_list_item *li;
+   LIST_FOR_EACH_ENTRY(li, &shader->variants.list, list) {
+      if (memcmp(&li->base->key, key, shader->variant_key_size) == 0)
+         return li->base;
+   }
+   return NULL;
+}
+
+
+/**
+ * Put a new variant into the shader's and the context's lists.
+ */
+static void
+add_variant(struct llvmpipe_context *lp,
+            struct lp_fragment_shader_variant *variant)
+{
+   struct lp_fragment_shader *shader = variant->shader;
+
+   list_add(&variant->list_item_local.list, &shader->variants.list);
+   list_add(&variant->list_item_global.list, &lp->fs_variants_list.list);
+   lp->nr_fs_variants++;
+   if (!variant->async)
+      lp->nr_fs_instrs += variant->nr_instrs;
+   shader->variants_cached++;
+}
+
+
+/**
+ * Queue the compilation of a new variant on the context's background
+ * queue, with a stand-in for the same key compiled at the fast tier bound
+ * meanwhile.  The stand-in isn't put into any list, the variant holds the
+ * only reference to it.
+ *
+ * Variants found in the shader cache are loaded right away instead, which
+ * is cheaper than compiling the stand-in.
+ */
+static struct lp_fragment_shader_variant *
+generate_tiered_variant(struct llvmpipe_context *lp,
+                        struct lp_fragment_shader *shader,
+                        const struct lp_fragment_shader_variant_key *key)
+{
+   if (fs_always_fast_tier(shader))
+      return NULL;
+
+   struct lp_fragment_shader_variant *variant =
+      create_variant(lp, shader, key);
+   if (!variant)
+      return NULL;
+
+   if (shader->base.ir.nir) {
+      struct lp_cached_code cached = { 0 };
+      unsigned char ir_sha1_cache_key[20];
+
+      lp_fs_get_ir_cache_key(variant, ir_sha1_cache_key);
+      lp_disk_cache_find_shader(llvmpipe_screen(lp->pipe.screen), &cached,
+                                ir_sha1_cache_key);
+      if (cached.data_size) {
+         if (!compile_variant_now(lp, variant, &cached))
+            lp_fs_variant_reference(lp, &variant, NULL);
+         return variant;
+      }
+      variant->cache_miss = true;
+   }
+
+   struct lp_fragment_shader_variant *standin =
+      create_variant(lp, shader, key);
+   if (!standin) {
+      lp_fs_variant_reference(lp, &variant, NULL);
+      return NULL;
+   }
+
+   standin->fast_tier = true;
+
+   LP_COUNT(nr_fast_tier_fs_compiles);
+   if (!compile_variant_now(lp, standin, NULL)) {
+      lp_fs_variant_reference(lp, &standin, NULL);
+      lp_fs_variant_reference(lp, &variant, NULL);
+      return NULL;
+   }
+
+   variant->async = true;
+   lp_fs_variant_reference(lp, &variant->fallback, standin);
+   lp_fs_variant_reference(lp, &standin, NULL);
+
+   LP_COUNT(nr_async_fs_compiles);
+   util_queue_add_job(&lp->fs_queue, variant, &variant->ready,
+                      compile_variant_job, NULL, 0);
+
+   return variant;
+}
+
+
+/**
+ * Queue the compilation of a new variant on the context's background
+ * queue, with an existing variant for the generic key standing in for it
+ * meanwhile.  Without one, a fast tier stand-in is compiled instead, see
+ * generate_tiered_variant().
+ */
+static struct lp_fragment_shader_variant *
+generate_async_variant(struct llvmpipe_context *lp,
+                       struct lp_fragment_shader *shader,
+                       const struct lp_fragment_shader_variant_key *key)
+{
+   char store[LP_FS_MAX_VARIANT_KEY_SIZE];
+   const struct lp_fragment_shader_variant_key *generic_key =
+      make_generic_variant_key(shader, key, store);
+
+   struct lp_fragment_shader_variant *generic = NULL;
+   if (memcmp(generic_key, key, shader->variant_key_size) != 0)
+      generic = find_variant(shader, generic_key);
+   if (!generic)
+      return generate_tiered_variant(lp, shader, key);
+
+   list_move_to(&generic->list_item_global.list, &lp->fs_variants_list.list);
+
+   /* While the generic variant is still compiling, or if that failed,
+    * whatever stands in for it works for this key as well.
+    */
+   struct lp_fragment_shader_variant *fallback =
+      generic->fallback ? generic->fallback : generic;
+
+   struct lp_fragment_shader_variant *variant =
+      create_variant(lp, shader, key);
+   if (!variant)
+      return NULL;
+
+   variant->async = true;
+   lp_fs_variant_reference(lp, &variant->fallback, fallback);
+
+   LP_COUNT(nr_async_fs_compiles);
+   util_queue_add_job(&lp->fs_queue, variant, &variant->ready,
+                      compile_variant_job, NULL, 0);
+
+   return variant;
+}
+
+
 /**
  * Update fragment shader state.  This is called just prior to drawing
  * something when some fragment-related state has changed.
@@ -4691,15 +5126,8 @@ llvmpipe_update_fs(struct llvmpipe_context *lp)
    const struct lp_fragment_shader_variant_key *key =
       make_variant_key(lp, shader, store);
 
-   struct lp_fragment_shader_variant *variant = NULL;
-   struct lp_fs_variant_list_item *li;
    /* Search the variants for one which matches the key */
-   LIST_FOR_EACH_ENTRY(li, &shader->variants.list, list) {
-      if (memcmp(&li->base->key, key, shader->variant_key_size) == 0) {
-         variant = li->base;
-         break;
-      }
-   }
+   struct lp_fragment_shader_variant *variant = find_variant(shader, key);
 
    if (variant) {
       /* Move this variant to the head of the list to implement LRU
@@ -4758,27 +5186,46 @@ llvmpipe_update_fs(struct llvmpipe_context *lp)
       }
 
       /*
-       * Generate the new variant.
+       * Generate the new variant, in the background if possible.
        */
-      int64_t t0 = os_time_get();
-      variant = generate_variant(lp, shader, key);
-      int64_t t1 = os_time_get();
-      int64_t dt = t1 - t0;
-      LP_COUNT_ADD(llvm_compile_time, dt);
-      LP_COUNT_ADD(nr_llvm_compiles, 2);  /* emit vs. omit in/out test */
+      if (lp->fs_async)
+         variant = generate_async_variant(lp, shader, key);
+      if (!variant)
+         variant = generate_variant(lp, shader, key);
 
       /* Put the new variant into the list */
-      if (variant) {
-         list_add(&variant->list_item_local.list, &shader->variants.list);
-         list_add(&variant->list_item_global.list, &lp->fs_variants_list.list);
-         lp->nr_fs_variants++;
-         lp->nr_fs_instrs += variant->nr_instrs;
-         shader->variants_cached++;
-      }
+      if (variant)
+         add_variant(lp, variant);
    }
 
-   /* Bind this variant */
-   lp_setup_set_fs_variant(lp->setup, variant);
+   /* Swap in variants as soon as their background compilation completes,
+    * see llvmpipe_poll_fs_pending().
+    */
+   lp->fs_pending = NULL;
+   if (variant && variant->async) {
+      if (util_queue_fence_is_signalled(&variant->ready))
+         finish_async_variant(lp, variant);
+      else
+         lp->fs_pending = variant;
+   }
+
+   /* Bind this variant, or the one standing in for it */
+   lp_setup_set_fs_variant(lp->setup, variant && variant->fallback ?
+                           variant->fallback : variant);
+}
+
+
+/**
+ * Called before every draw while the bound variant is still compiling in
+ * the background.  Draws with unchanged state don't go through
+ * llvmpipe_update_derived(), so the completion has to be checked here for
+ * the variant to replace its fallback.
+ */
+void
+llvmpipe_poll_fs_pending(struct llvmpipe_context *lp)
+{
+   if (util_queue_fence_is_signalled(&lp->fs_pending->ready))
+      lp->dirty |= LP_NEW_FS;
 }
 
 
@@ -32,6 +32,8 @@
 
 #include "util/list.h"
 #include "util/compiler.h"
+#include "util/simple_mtx.h"
+#include "util/u_queue.h"
 #include "pipe/p_state.h"
 #include "gallivm/lp_bld_sample.h" /* for struct lp_sampler_static_state */
 #include "gallivm/lp_bld_jit_sample.h"
@@ -39,6 +41,7 @@
 #include "lp_bld_interp.h" /* for struct lp_shader_input */
 #include "util/u_inlines.h"
 #include "lp_jit.h"
+#include "lp_perf.h"
 
 struct lp_fragment_shader;
 
@@ -150,9 +153,39 @@ struct lp_fragment_shader_variant
 
    unsigned opaque:1;
    unsigned blit:1;
+
+   /*
+    * Whether primitives can be rejected against the rasterizer's
+    * hierarchical depth bounds (lp_rast_hiz.c).
+    */
+   unsigned hiz_cull:1;
    unsigned linear_input_mask:16;
    struct pipe_reference reference;
 
+   /*
+    * Whether the variant was queued for background compilation (LP_ASYNC_FS)
+    * and the context hasn't yet seen it complete.  Until then the fallback
+    * variant, which is compiled from a less specialized key or at a lower
+    * optimization tier, is bound in its place.  The fallback stays bound if
+    * background compilation fails.
+    * Not a bitfield, as the other flags are written by the queue thread.
+    */
+   bool async;
+   struct util_queue_fence ready;
+   struct lp_fragment_shader_variant *fallback;
+
+   /*
+    * Whether the variant is a stand-in compiled with the fast optimization
+    * tier, see generate_tiered_variant().
+    */
+   bool fast_tier;
+
+   /*
+    * Whether the shader cache was already searched for the variant without
+    * success, so that background compilation doesn't search it again.
+    */
+   bool cache_miss;
+
    struct gallivm_state *gallivm;
 
    LLVMTypeRef jit_context_type;
@@ -175,6 +208,9 @@ struct lp_fragment_shader_variant
    lp_jit_linear_func jit_linear;
    lp_jit_linear_func jit_linear_blit;
 
+   /* Why there is no jit_linear, for the linear path coverage counters */
+   enum lp_linear_fallback linear_fallback;
+
    /* Functions within the linear path:
     */
    LLVMValueRef linear_function;
@@ -213,6 +249,12 @@ struct lp_fragment_shader
 
    struct draw_fragment_shader *draw_data;
 
+   /* Variants may be compiled concurrently by the context and its
+    * background queue, but code generation isn't safe to run in parallel
+    * on the same NIR.  The LLVM compilation itself runs unlocked.
+    */
+   simple_mtx_t compile_mutex;
+
    /* For debugging/profiling purposes */
    unsigned variant_key_size;
    unsigned no;
@@ -234,8 +276,7 @@ void
 llvmpipe_fs_variant_linear_fastpath(struct lp_fragment_shader_variant *variant);
 
 void
-llvmpipe_fs_variant_linear_llvm(struct llvmpipe_context *lp,
-                                struct lp_fragment_shader *shader,
+llvmpipe_fs_variant_linear_llvm(struct lp_fragment_shader *shader,
                                 struct lp_fragment_shader_variant *variant);
 
 void
@@ -247,6 +288,14 @@ lp_debug_fs_kind(enum lp_fs_kind kind);
 void
 lp_linear_check_variant(struct lp_fragment_shader_variant *variant);
 
+uint32_t
+lp_linear_format_alpha_mask(enum pipe_format format);
+
+bool
+lp_linear_blit_compatible(enum lp_fs_kind kind,
+                          const struct lp_sampler_static_state *samp0,
+                          enum pipe_format cbuf_format);
+
 void
 llvmpipe_destroy_fs(struct llvmpipe_context *llvmpipe,
                     struct lp_fragment_shader *shader);
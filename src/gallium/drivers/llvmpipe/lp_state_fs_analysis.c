@@ -382,6 +382,95 @@ llvmpipe_nir_is_linear_compat(struct nir_shader *shader,
 }
 
 
+/*
+ * Check if the given alu src is component 'comp' of the texture
+ * instruction 'tex'.
+ */
+static bool
+is_tex_component(const nir_alu_src *src, const nir_tex_instr *tex,
+                 unsigned comp)
+{
+   return src->src.ssa == &tex->def && src->swizzle[0] == comp;
+}
+
+
+/*
+ * Examine a linear NIR shader to determine whether it just copies the
+ * texels of texture unit 0, addressed by the first FS input, to the color
+ * output (BLIT_RGBA), possibly replacing alpha with one (BLIT_RGB1).  Such
+ * shaders may be implemented by the blit fastpaths.
+ */
+static enum lp_fs_kind
+llvmpipe_nir_get_linear_kind(const struct lp_fragment_shader *shader)
+{
+   const struct lp_tgsi_info *info = &shader->info;
+   nir_intrinsic_instr *store = NULL;
+   nir_tex_instr *tex = NULL;
+
+   if (info->num_texs != 1)
+      return LP_FS_KIND_LLVM_LINEAR;
+
+   /* The fastpaths take the texcoords straight from the first input's
+    * x and y setup coefficients.
+    */
+   const struct lp_tgsi_texture_info *tex_info = &info->tex[0];
+   if (tex_info->sampler_unit != 0 ||
+       tex_info->texture_unit != 0 ||
+       tex_info->coord[0].u.index != 0 ||
+       tex_info->coord[0].swizzle != 0 ||
+       tex_info->coord[1].swizzle != 1 ||
+       shader->inputs[0].src_index != 1 ||
+       (shader->inputs[0].interp != LP_INTERP_PERSPECTIVE &&
+        shader->inputs[0].interp != LP_INTERP_LINEAR))
+      return LP_FS_KIND_LLVM_LINEAR;
+
+   nir_foreach_function_impl(impl, shader->base.ir.nir) {
+      nir_foreach_block(block, impl) {
+         nir_foreach_instr(instr, block) {
+            if (instr->type == nir_instr_type_tex) {
+               tex = nir_instr_as_tex(instr);
+            } else if (instr->type == nir_instr_type_intrinsic) {
+               nir_intrinsic_instr *intrin = nir_instr_as_intrinsic(instr);
+               if (intrin->intrinsic == nir_intrinsic_load_ubo)
+                  return LP_FS_KIND_LLVM_LINEAR;
+               if (intrin->intrinsic == nir_intrinsic_store_deref) {
+                  if (store)
+                     return LP_FS_KIND_LLVM_LINEAR;
+                  store = intrin;
+               }
+            } else if (instr->type == nir_instr_type_alu) {
+               if (nir_instr_as_alu(instr)->op == nir_op_fmul)
+                  return LP_FS_KIND_LLVM_LINEAR;
+            }
+         }
+      }
+   }
+
+   if (!tex || !store ||
+       tex->def.num_components != 4 ||
+       nir_alu_type_get_base_type(tex->dest_type) != nir_type_float ||
+       nir_intrinsic_write_mask(store) != 0xf)
+      return LP_FS_KIND_LLVM_LINEAR;
+
+   const nir_def *color = store->src[1].ssa;
+   if (color == &tex->def)
+      return LP_FS_KIND_BLIT_RGBA;
+
+   if (color->parent_instr->type == nir_instr_type_alu) {
+      const nir_alu_instr *alu = nir_instr_as_alu(color->parent_instr);
+      if (alu->op == nir_op_vec4 &&
+          is_tex_component(&alu->src[0], tex, 0) &&
+          is_tex_component(&alu->src[1], tex, 1) &&
+          is_tex_component(&alu->src[2], tex, 2) &&
+          nir_src_is_const(alu->src[3].src) &&
+          nir_src_comp_as_float(alu->src[3].src, alu->src[3].swizzle[0]) == 1.0)
+         return LP_FS_KIND_BLIT_RGB1;
+   }
+
+   return LP_FS_KIND_LLVM_LINEAR;
+}
+
+
 /*
  * Analyze the given NIR fragment shader and set its shader->kind field
  * to LP_FS_KIND_x.
@@ -393,7 +482,7 @@ llvmpipe_fs_analyse_nir(struct lp_fragment_shader *shader)
        !shader->info.sampler_texture_units_different &&
        shader->info.num_texs <= LP_MAX_LINEAR_TEXTURES &&
        llvmpipe_nir_is_linear_compat(shader->base.ir.nir, &shader->info)) {
-      shader->kind = LP_FS_KIND_LLVM_LINEAR;
+      shader->kind = llvmpipe_nir_get_linear_kind(shader);
    } else {
       shader->kind = LP_FS_KIND_GENERAL;
    }
@@ -33,6 +33,7 @@
 #include "util/u_pack_color.h"
 #include "util/u_surface.h"
 #include "util/u_sse.h"
+#include "util/format/u_format.h"
 
 #include "lp_jit.h"
 #include "lp_rast.h"
@@ -82,7 +83,7 @@ struct shader {
    alignas(16) uint32_t out0[64];
    const uint32_t *src0;
    const uint32_t *src1;
-   __m128i const0;
+   __m128i const0;              /* alpha bits of the color buffer format */
    int width;                   /* rounded up to multiple of 4 */
 };
 
@@ -129,6 +130,45 @@ blend_premul(struct color_blend *blend)
 }
 
 
+/* Premultiplied alpha blending for the 10:10:10:2 formats.  With just
+ * two bits of alpha there are only four blend weights, so this is plain
+ * integer arithmetic rather than SSE.
+ */
+static inline uint32_t
+blend_premul_rgb10a2_pixel(uint32_t src, uint32_t dst)
+{
+   const unsigned inv_alpha = 3 - (src >> 30);
+   uint32_t res = 0;
+
+   if (inv_alpha == 0)
+      return src;
+
+   for (unsigned shift = 0; shift < 30; shift += 10) {
+      const unsigned s = (src >> shift) & 0x3ff;
+      const unsigned d = (dst >> shift) & 0x3ff;
+      const unsigned c = s + (d * inv_alpha + 1) / 3;
+      res |= MIN2(c, 0x3ff) << shift;
+   }
+
+   const unsigned a = (src >> 30) + ((dst >> 30) * inv_alpha + 1) / 3;
+   return res | (MIN2(a, 3) << 30);
+}
+
+
+static void
+blend_premul_rgb10a2(struct color_blend *blend)
+{
+   const uint32_t *src = blend->src;
+   uint32_t *dst = (uint32_t *)blend->color;
+   const int width = blend->width;
+
+   blend->color += blend->stride;
+
+   for (int i = 0; i < width; i++)
+      dst[i] = blend_premul_rgb10a2_pixel(src[i], dst[i]);
+}
+
+
 static void
 blend_noop(struct color_blend *blend)
 {
@@ -254,8 +294,10 @@ init_nearest_sampler(struct nearest_sampler *samp,
 {
    const float oow = 1.0f / w0;
 
-   if (dwdx != 0.0 || dwdy != 0.0)
+   if (dwdx != 0.0 || dwdy != 0.0) {
+      LP_COUNT(nr_linear_fallback[LP_LINEAR_FALLBACK_W]);
       return false;
+   }
 
    samp->texture = texture;
    samp->width = width;
@@ -315,7 +357,7 @@ init_nearest_sampler(struct nearest_sampler *samp,
 static const uint32_t *
 shade_rgb1(struct shader *shader)
 {
-   const __m128i rgb1 = _mm_set1_epi32(0xff000000);
+   const __m128i rgb1 = shader->const0;
    const uint32_t *src0 = shader->src0;
    uint32_t *dst = shader->out0;
    int width = shader->width;
@@ -332,9 +374,13 @@ shade_rgb1(struct shader *shader)
 
 static void
 init_shader(struct shader *shader,
-           int x, int y, int width, int height)
+            const struct lp_rast_state *state,
+            int x, int y, int width, int height)
 {
+   const enum pipe_format cbuf_format = state->variant->key.cbuf_format[0];
+
    shader->width = align(width, 4);
+   shader->const0 = _mm_set1_epi32(lp_linear_format_alpha_mask(cbuf_format));
 }
 
 
@@ -405,6 +451,8 @@ blit_rgb1_blit(const struct lp_rast_state *state,
 {
    const struct lp_jit_resources *resources = &state->jit_resources;
    const struct lp_jit_texture *texture = &resources->textures[0];
+   const uint32_t alpha_mask =
+      lp_linear_format_alpha_mask(state->variant->key.cbuf_format[0]);
    const uint8_t *src;
    unsigned src_stride;
    int src_x, src_y;
@@ -439,7 +487,7 @@ blit_rgb1_blit(const struct lp_rast_state *state,
       uint32_t *dst_row = (uint32_t *)color;
 
       for (x = 0; x < width; x++) {
-         *dst_row++ = *src_row++ | 0xff000000;
+         *dst_row++ = *src_row++ | alpha_mask;
       }
 
       color += stride;
@@ -519,7 +567,7 @@ blit_rgb1(const struct lp_rast_state *state,
 
    init_blend(&blend, x, y, width, height, color, stride);
 
-   init_shader(&shader, x, y, width, height);
+   init_shader(&shader, state, x, y, width, height);
 
    /* Rasterize the rectangle and run the shader:
     */
@@ -573,6 +621,46 @@ blit_rgba_blend_premul(const struct lp_rast_state *state,
 }
 
 
+/* Linear shader variant implementing the BLIT_RGBA shader with
+ * one/inv_src_alpha blending to a 10:10:10:2 color buffer.
+ */
+static bool
+blit_rgb10a2_blend_premul(const struct lp_rast_state *state,
+                          unsigned x, unsigned y,
+                          unsigned width, unsigned height,
+                          const float (*a0)[4],
+                          const float (*dadx)[4],
+                          const float (*dady)[4],
+                          uint8_t *color,
+                          unsigned stride)
+{
+   const struct lp_jit_resources *resources = &state->jit_resources;
+   struct nearest_sampler samp;
+   struct color_blend blend;
+
+   LP_DBG(DEBUG_RAST, "%s\n", __func__);
+
+   if (!init_nearest_sampler(&samp,
+                             &resources->textures[0],
+                             x, y, width, height,
+                             a0[1][0], dadx[1][0], dady[1][0],
+                             a0[1][1], dadx[1][1], dady[1][1],
+                             a0[0][3], dadx[0][3], dady[0][3]))
+      return false;
+
+   init_blend(&blend, x, y, width, height, color, stride);
+
+   /* Rasterize the rectangle and run the shader:
+    */
+   for (y = 0; y < height; y++) {
+      blend.src = samp.fetch(&samp);
+      blend_premul_rgb10a2(&blend);
+   }
+
+   return true;
+}
+
+
 /* Linear shader which always emits red.  Used for debugging.
  */
 static bool
@@ -653,24 +741,33 @@ llvmpipe_fs_variant_linear_fastpath(struct lp_fragment_shader_variant *variant)
    if (!samp0)
       return;
 
-   enum pipe_format tex_format = samp0->texture_state.format;
+   /* The fastpaths copy whole 32-bit texels, so the texture must have the
+    * color buffer's layout.
+    */
+   const enum pipe_format tex_format = samp0->texture_state.format;
+   const enum pipe_format cbuf_format = variant->key.cbuf_format[0];
+   const uint32_t alpha_mask = lp_linear_format_alpha_mask(cbuf_format);
+   if (!alpha_mask ||
+       !lp_linear_blit_compatible(variant->shader->kind, samp0, cbuf_format))
+      return;
+
    if (variant->shader->kind == LP_FS_KIND_BLIT_RGBA &&
-       tex_format == PIPE_FORMAT_B8G8R8A8_UNORM &&
        is_nearest_clamp_sampler(samp0)) {
       if (variant->opaque) {
          variant->jit_linear_blit = blit_rgba_blit;
          variant->jit_linear = blit_rgba;
       } else if (is_one_inv_src_alpha_blend(variant) &&
-                 util_get_cpu_caps()->has_sse2) {
-         variant->jit_linear = blit_rgba_blend_premul;
+                 util_format_has_alpha(tex_format)) {
+         if (alpha_mask == 0xc0000000)
+            variant->jit_linear = blit_rgb10a2_blend_premul;
+         else if (util_get_cpu_caps()->has_sse2)
+            variant->jit_linear = blit_rgba_blend_premul;
       }
       return;
    }
 
    if (variant->shader->kind == LP_FS_KIND_BLIT_RGB1 &&
        variant->opaque &&
-       (tex_format == PIPE_FORMAT_B8G8R8A8_UNORM ||
-        tex_format == PIPE_FORMAT_B8G8R8X8_UNORM) &&
        is_nearest_clamp_sampler(samp0)) {
       variant->jit_linear_blit = blit_rgb1_blit;
       variant->jit_linear = blit_rgb1;
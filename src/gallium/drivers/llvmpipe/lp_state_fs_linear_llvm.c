@@ -236,8 +236,7 @@ llvm_fragment_body(struct lp_build_context *bld,
  * See lp_state_fs_analysis for the "linear" conditions.
  */
 void
-llvmpipe_fs_variant_linear_llvm(struct llvmpipe_context *lp,
-                                struct lp_fragment_shader *shader,
+llvmpipe_fs_variant_linear_llvm(struct lp_fragment_shader *shader,
                                 struct lp_fragment_shader_variant *variant)
 {
    assert(shader->kind == LP_FS_KIND_BLIT_RGBA ||
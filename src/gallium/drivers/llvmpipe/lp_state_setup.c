@@ -657,6 +657,11 @@ generate_setup_variant(struct lp_setup_variant_key *key,
       goto fail;
    }
 
+   /* Setup functions are short straight-line code, which the full
+    * optimization pipeline barely improves.
+    */
+   gallivm->opt_tier = GALLIVM_OPT_TIER_FAST;
+
    LLVMBuilderRef builder = gallivm->builder;
 
    if (LP_DEBUG & DEBUG_COUNTERS) {
@@ -736,7 +741,8 @@ generate_setup_variant(struct lp_setup_variant_key *key,
 
    gallivm_verify_function(gallivm, variant->function);
 
-   gallivm_compile_module(gallivm);
+   if (!gallivm_compile_module(gallivm))
+      goto fail;
 
    variant->jit_function = (lp_jit_setup_triangle)
       gallivm_jit_function(gallivm, variant->function, variant->function_name);
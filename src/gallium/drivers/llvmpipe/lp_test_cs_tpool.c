@@ -0,0 +1,192 @@
+/*
+ * Copyright © 2026 The Mesa Authors
+ * SPDX-License-Identifier: MIT
+ */
+
+/**
+ * @file
+ * Unit tests and dispatch rate microbenchmark for the compute shader
+ * thread pool.
+ *
+ * Each test queues a stream of tasks, optionally several in flight at
+ * once, and checks that every iteration of every task ran exactly once.
+ */
+
+
+#include "util/u_atomic.h"
+#include "util/u_cpu_detect.h"
+#include "util/u_memory.h"
+#include "util/os_time.h"
+
+#include "lp_cs_tpool.h"
+#include "lp_test.h"
+
+
+#define NUM_DISPATCHES 2000
+
+
+struct tpool_test_data
+{
+   uint32_t *counts;
+   unsigned work;
+};
+
+
+void
+write_tsv_header(FILE *fp)
+{
+   fprintf(fp,
+           "result\t"
+           "usecs_per_dispatch\t"
+           "threads\t"
+           "iterations\t"
+           "in_flight\n");
+
+   fflush(fp);
+}
+
+
+static void
+write_tsv_row(FILE *fp,
+              unsigned num_threads,
+              unsigned num_iters,
+              unsigned in_flight,
+              double usecs,
+              bool success)
+{
+   fprintf(fp, "%s\t", success ? "pass" : "fail");
+   fprintf(fp, "%.2f\t", usecs);
+   fprintf(fp, "%u\t", num_threads);
+   fprintf(fp, "%u\t", num_iters);
+   fprintf(fp, "%u\n", in_flight);
+
+   fflush(fp);
+}
+
+
+static void
+tpool_test_work(void *data, int iter_idx, struct lp_cs_local_mem *lmem)
+{
+   struct tpool_test_data *td = data;
+   volatile unsigned x = 0;
+
+   /* A little busy work to make the iterations not entirely trivial. */
+   for (unsigned i = 0; i < td->work; i++)
+      x += i;
+
+   p_atomic_inc(&td->counts[iter_idx]);
+}
+
+
+static bool
+test_one(unsigned verbose,
+         FILE *fp,
+         unsigned num_threads,
+         unsigned num_iters,
+         unsigned in_flight)
+{
+   struct lp_cs_tpool *pool;
+   struct lp_cs_tpool_task *tasks[LP_CS_TPOOL_MAX_TASKS] = {0};
+   struct tpool_test_data td[LP_CS_TPOOL_MAX_TASKS];
+   unsigned expected[LP_CS_TPOOL_MAX_TASKS] = {0};
+   int64_t start, end;
+   bool success = true;
+   double usecs;
+
+   assert(in_flight <= LP_CS_TPOOL_MAX_TASKS);
+
+   if (verbose >= 1)
+      fprintf(stderr, "%u threads, %u iterations, %u in flight ...\n",
+              num_threads, num_iters, in_flight);
+
+   pool = lp_cs_tpool_create(num_threads, false);
+   if (!pool)
+      return false;
+
+   for (unsigned t = 0; t < in_flight; t++) {
+      td[t].counts = CALLOC(num_iters, sizeof(*td[t].counts));
+      td[t].work = 64;
+      if (!td[t].counts)
+         success = false;
+   }
+   if (!success)
+      goto out;
+
+   start = os_time_get_nano();
+   for (unsigned d = 0; d < NUM_DISPATCHES; d++) {
+      const unsigned t = d % in_flight;
+
+      lp_cs_tpool_wait_for_task(pool, &tasks[t]);
+      tasks[t] = lp_cs_tpool_queue_task(pool, tpool_test_work, &td[t],
+                                        num_iters);
+      expected[t]++;
+   }
+   for (unsigned t = 0; t < in_flight; t++)
+      lp_cs_tpool_wait_for_task(pool, &tasks[t]);
+   end = os_time_get_nano();
+
+   for (unsigned t = 0; t < in_flight && success; t++) {
+      for (unsigned i = 0; i < num_iters; i++) {
+         if (td[t].counts[i] != expected[t]) {
+            fprintf(stderr, "  MISMATCH: task %u iteration %u ran %u times, "
+                    "expected %u\n", t, i, td[t].counts[i], expected[t]);
+            success = false;
+            break;
+         }
+      }
+   }
+
+   usecs = (double)(end - start) / (1000.0 * NUM_DISPATCHES);
+
+   if (verbose >= 1)
+      fprintf(stderr, "  %.2f usecs per dispatch\n", usecs);
+
+   if (fp)
+      write_tsv_row(fp, num_threads, num_iters, in_flight, usecs, success);
+
+out:
+   for (unsigned t = 0; t < in_flight; t++)
+      FREE(td[t].counts);
+
+   lp_cs_tpool_destroy(pool);
+
+   return success;
+}
+
+
+bool
+test_all(unsigned verbose, FILE *fp)
+{
+   static const unsigned iters[] = { 1, 7, 64, 1000 };
+   static const unsigned in_flight[] = { 1, 4, LP_CS_TPOOL_MAX_TASKS };
+   const unsigned max_threads =
+      MIN2(util_get_cpu_caps()->nr_cpus, LP_MAX_THREADS);
+   bool success = true;
+
+   for (unsigned threads = 0; threads <= max_threads;
+        threads = threads ? threads * 2 : 1) {
+      for (unsigned i = 0; i < ARRAY_SIZE(iters); i++) {
+         for (unsigned f = 0; f < ARRAY_SIZE(in_flight); f++) {
+            if (!test_one(verbose, fp, threads, iters[i], in_flight[f]))
+               success = false;
+         }
+      }
+   }
+
+   return success;
+}
+
+
+bool
+test_some(unsigned verbose, FILE *fp,
+          unsigned long n)
+{
+   return test_all(verbose, fp);
+}
+
+
+bool
+test_single(unsigned verbose, FILE *fp)
+{
+   return test_one(verbose, fp, 4, 64, 4);
+}
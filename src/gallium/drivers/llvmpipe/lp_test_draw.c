@@ -0,0 +1,570 @@
+/*
+ * Copyright © 2026 The Mesa Authors
+ * SPDX-License-Identifier: MIT
+ */
+
+/**
+ * @file
+ * Unit tests and vertex throughput benchmark for the draw module's llvm
+ * middle end.
+ *
+ * Each test draws a large mesh into a vbuf_render which just hashes the
+ * emitted vertices, once on the calling thread and once with the vertex
+ * shading spread over worker threads, and checks that both emit the same
+ * primitives in the same order.  Indexed draws also have to get decent
+ * reuse out of the post-transform vertex cache.
+ */
+
+
+#include "util/u_cpu_detect.h"
+#include "util/u_memory.h"
+#include "util/os_time.h"
+#include "pipe/p_context.h"
+#include "pipe/p_screen.h"
+#include "tgsi/tgsi_text.h"
+#include "draw/draw_context.h"
+#include "draw/draw_vbuf.h"
+#include "draw/draw_vertex.h"
+
+#include "lp_test.h"
+
+
+#define GRID_SIZE 512
+#define NUM_ITERATIONS 8
+
+
+static const char vs_text[] =
+   "VERT\n"
+   "DCL IN[0]\n"
+   "DCL IN[1]\n"
+   "DCL OUT[0], POSITION\n"
+   "DCL OUT[1], GENERIC[0]\n"
+   "DCL TEMP[0]\n"
+   "IMM[0] FLT32 { 0.5, 0.5, 0.5, 1.0 }\n"
+   "  0: MUL OUT[0], IN[0], IMM[0]\n"
+   "  1: DP3 TEMP[0].x, IN[1], IN[1]\n"
+   "  2: RSQ TEMP[0].x, TEMP[0].xxxx\n"
+   "  3: MUL OUT[1], IN[1], TEMP[0].xxxx\n"
+   "  4: END\n";
+
+
+struct test_vertex
+{
+   float pos[4];
+   float normal[4];
+};
+
+
+struct test_render
+{
+   struct vbuf_render base;
+   struct vertex_info vinfo;
+
+   void *vertices;
+   unsigned vertex_size;
+   unsigned num_vertices;
+
+   bool hash_vertices;
+   uint32_t hash;
+   unsigned num_indices;
+
+   /* largest draw_elements call, which must not exceed base.max_indices */
+   unsigned max_draw_indices;
+};
+
+
+static inline struct test_render *
+test_render(struct vbuf_render *render)
+{
+   return (struct test_render *)render;
+}
+
+
+static const struct vertex_info *
+test_render_get_vertex_info(struct vbuf_render *render)
+{
+   return &test_render(render)->vinfo;
+}
+
+
+static bool
+test_render_allocate_vertices(struct vbuf_render *render,
+                              uint16_t vertex_size,
+                              uint16_t nr_vertices)
+{
+   struct test_render *r = test_render(render);
+   unsigned size = vertex_size * nr_vertices;
+
+   if (size > r->vertex_size * r->num_vertices) {
+      FREE(r->vertices);
+      r->vertices = MALLOC(size);
+      if (!r->vertices) {
+         r->num_vertices = 0;
+         return false;
+      }
+   }
+
+   r->vertex_size = vertex_size;
+   r->num_vertices = nr_vertices;
+
+   return true;
+}
+
+
+static void *
+test_render_map_vertices(struct vbuf_render *render)
+{
+   return test_render(render)->vertices;
+}
+
+
+static void
+test_render_unmap_vertices(struct vbuf_render *render,
+                           uint16_t min_index,
+                           uint16_t max_index)
+{
+}
+
+
+static void
+test_render_set_primitive(struct vbuf_render *render, enum mesa_prim prim)
+{
+}
+
+
+static void
+test_render_set_view_index(struct vbuf_render *render, unsigned view_index)
+{
+}
+
+
+static void
+test_render_hash_vertex(struct test_render *r, unsigned index)
+{
+   const uint8_t *data = (const uint8_t *)r->vertices + index * r->vertex_size;
+
+   /* FNV-1a */
+   for (unsigned i = 0; i < r->vertex_size; i++)
+      r->hash = (r->hash ^ data[i]) * 16777619u;
+}
+
+
+static void
+test_render_draw_elements(struct vbuf_render *render,
+                          const uint16_t *indices,
+                          unsigned nr_indices)
+{
+   struct test_render *r = test_render(render);
+
+   r->num_indices += nr_indices;
+   r->max_draw_indices = MAX2(r->max_draw_indices, nr_indices);
+
+   if (r->hash_vertices) {
+      for (unsigned i = 0; i < nr_indices; i++)
+         test_render_hash_vertex(r, indices[i]);
+   }
+}
+
+
+static void
+test_render_draw_arrays(struct vbuf_render *render,
+                        unsigned start,
+                        unsigned nr)
+{
+   struct test_render *r = test_render(render);
+
+   r->num_indices += nr;
+
+   if (r->hash_vertices) {
+      for (unsigned i = 0; i < nr; i++)
+         test_render_hash_vertex(r, start + i);
+   }
+}
+
+
+static void
+test_render_release_vertices(struct vbuf_render *render)
+{
+}
+
+
+static void
+test_render_destroy(struct vbuf_render *render)
+{
+}
+
+
+static void
+test_render_set_stream_output_info(struct vbuf_render *render,
+                                   unsigned stream,
+                                   unsigned primitive_count,
+                                   unsigned primitive_generated)
+{
+}
+
+
+static void
+test_render_pipeline_statistics(struct vbuf_render *render,
+                                const struct pipe_query_data_pipeline_statistics *stats)
+{
+}
+
+
+void
+write_tsv_header(FILE *fp)
+{
+   fprintf(fp,
+           "result\t"
+           "mverts_per_sec\t"
+           "invocations_per_element\t"
+           "threads\t"
+           "indexed\n");
+
+   fflush(fp);
+}
+
+
+static void
+write_tsv_row(FILE *fp,
+              unsigned num_threads,
+              bool indexed,
+              double mverts,
+              double reuse,
+              bool success)
+{
+   fprintf(fp, "%s\t", success ? "pass" : "fail");
+   fprintf(fp, "%.2f\t", mverts);
+   fprintf(fp, "%.3f\t", reuse);
+   fprintf(fp, "%u\t", num_threads);
+   fprintf(fp, "%u\n", indexed);
+
+   fflush(fp);
+}
+
+
+struct test_mesh
+{
+   struct test_vertex *vertices;
+   unsigned num_vertices;
+   uint32_t *indices;
+   unsigned num_indices;
+};
+
+
+/**
+ * A grid of GRID_SIZE^2 vertices inside the clip volume, whose first and
+ * last rows stick out of it so that the clipper runs too.  The segments in
+ * between take the emit path, which hands their elements to the render
+ * directly.
+ */
+static bool
+test_mesh_init(struct test_mesh *mesh, bool indexed)
+{
+   const unsigned num_quads = (GRID_SIZE - 1) * (GRID_SIZE - 1);
+
+   mesh->num_indices = num_quads * 6;
+   mesh->num_vertices = indexed ? GRID_SIZE * GRID_SIZE : mesh->num_indices;
+   mesh->vertices = CALLOC(mesh->num_vertices, sizeof(*mesh->vertices));
+   mesh->indices = CALLOC(mesh->num_indices, sizeof(*mesh->indices));
+   if (!mesh->vertices || !mesh->indices)
+      return false;
+
+   unsigned n = 0;
+   for (unsigned y = 0; y < GRID_SIZE - 1; y++) {
+      for (unsigned x = 0; x < GRID_SIZE - 1; x++) {
+         const unsigned v = y * GRID_SIZE + x;
+
+         mesh->indices[n++] = v;
+         mesh->indices[n++] = v + 1;
+         mesh->indices[n++] = v + GRID_SIZE;
+         mesh->indices[n++] = v + GRID_SIZE;
+         mesh->indices[n++] = v + 1;
+         mesh->indices[n++] = v + GRID_SIZE + 1;
+      }
+   }
+
+   for (unsigned i = 0; i < mesh->num_vertices; i++) {
+      const unsigned v = indexed ? i : mesh->indices[i];
+      const unsigned x = v % GRID_SIZE;
+      const unsigned y = v / GRID_SIZE;
+      struct test_vertex *vert = &mesh->vertices[i];
+
+      vert->pos[0] = 3.8f * x / (GRID_SIZE - 1) - 1.9f;
+      vert->pos[1] = 4.2f * y / (GRID_SIZE - 1) - 2.1f;
+      vert->pos[2] = (float)((x ^ y) & 15) / 16.0f;
+      vert->pos[3] = 1.0f;
+      vert->normal[0] = (float)x + 1.0f;
+      vert->normal[1] = (float)y;
+      vert->normal[2] = 1.0f;
+      vert->normal[3] = 0.0f;
+   }
+
+   return true;
+}
+
+
+static void
+test_mesh_fini(struct test_mesh *mesh)
+{
+   FREE(mesh->vertices);
+   FREE(mesh->indices);
+}
+
+
+/**
+ * Draw the mesh, either hashing the emitted vertices or timing the draws.
+ */
+static bool
+test_draw(unsigned verbose,
+          const struct test_mesh *mesh,
+          bool indexed,
+          unsigned num_threads,
+          bool hash_vertices,
+          uint32_t *hash,
+          double *mverts,
+          struct draw_vertex_cache_stats *stats)
+{
+   struct pipe_screen screen = {0};
+   struct pipe_context pipe = {0};
+   struct test_render render = {0};
+   struct tgsi_token tokens[256];
+   bool success = false;
+
+   pipe.screen = &screen;
+
+   struct draw_context *draw = draw_create(&pipe);
+   if (!draw)
+      return false;
+
+   draw_set_vertex_threads(draw, num_threads);
+
+   render.base.max_indices = 1020;
+   render.base.max_vertex_buffer_bytes = 4096 * 16;
+   render.base.get_vertex_info = test_render_get_vertex_info;
+   render.base.allocate_vertices = test_render_allocate_vertices;
+   render.base.map_vertices = test_render_map_vertices;
+   render.base.unmap_vertices = test_render_unmap_vertices;
+   render.base.set_primitive = test_render_set_primitive;
+   render.base.set_view_index = test_render_set_view_index;
+   render.base.draw_elements = test_render_draw_elements;
+   render.base.draw_arrays = test_render_draw_arrays;
+   render.base.release_vertices = test_render_release_vertices;
+   render.base.destroy = test_render_destroy;
+   render.base.set_stream_output_info = test_render_set_stream_output_info;
+   render.base.pipeline_statistics = test_render_pipeline_statistics;
+   render.hash_vertices = hash_vertices;
+   render.hash = 2166136261u;
+
+   struct draw_stage *stage = draw_vbuf_stage(draw, &render.base);
+   if (!stage)
+      goto out;
+
+   draw_set_rasterize_stage(draw, stage);
+   draw_set_render(draw, &render.base);
+
+   struct pipe_rasterizer_state rast = {0};
+   rast.half_pixel_center = 1;
+   rast.depth_clip_near = 1;
+   rast.depth_clip_far = 1;
+   rast.fill_front = PIPE_POLYGON_MODE_FILL;
+   rast.fill_back = PIPE_POLYGON_MODE_FILL;
+   draw_set_rasterizer_state(draw, &rast, &rast);
+
+   const struct pipe_viewport_state vp = {
+      .scale = { 512.0f, 512.0f, 1.0f },
+      .translate = { 512.0f, 512.0f, 0.0f },
+   };
+   draw_set_viewport_states(draw, 0, 1, &vp);
+
+   if (!tgsi_text_translate(vs_text, tokens, ARRAY_SIZE(tokens)))
+      goto out;
+
+   struct pipe_shader_state vs_state = {
+      .type = PIPE_SHADER_IR_TGSI,
+      .tokens = tokens,
+   };
+   struct draw_vertex_shader *vs = draw_create_vertex_shader(draw, &vs_state);
+   if (!vs)
+      goto out;
+   draw_bind_vertex_shader(draw, vs);
+
+   draw_emit_vertex_attr(&render.vinfo, EMIT_4F,
+                         draw_find_shader_output(draw, TGSI_SEMANTIC_POSITION, 0));
+   draw_emit_vertex_attr(&render.vinfo, EMIT_4F,
+                         draw_find_shader_output(draw, TGSI_SEMANTIC_GENERIC, 0));
+   draw_compute_vertex_size(&render.vinfo);
+
+   const struct pipe_vertex_element elems[2] = {
+      {
+         .src_offset = offsetof(struct test_vertex, pos),
+         .src_stride = sizeof(struct test_vertex),
+         .src_format = PIPE_FORMAT_R32G32B32A32_FLOAT,
+      },
+      {
+         .src_offset = offsetof(struct test_vertex, normal),
+         .src_stride = sizeof(struct test_vertex),
+         .src_format = PIPE_FORMAT_R32G32B32A32_FLOAT,
+      },
+   };
+   draw_set_vertex_elements(draw, 2, elems);
+
+   const struct pipe_vertex_buffer vb = {
+      .is_user_buffer = true,
+      .buffer.user = mesh->vertices,
+   };
+   draw_set_vertex_buffers(draw, 1, &vb);
+   draw_set_mapped_vertex_buffer(draw, 0, mesh->vertices,
+                                 mesh->num_vertices * sizeof(struct test_vertex));
+
+   struct pipe_draw_info info = {
+      .mode = MESA_PRIM_TRIANGLES,
+      .instance_count = 1,
+   };
+   struct pipe_draw_start_count_bias sc = {
+      .start = 0,
+      .count = mesh->num_indices,
+   };
+
+   if (indexed) {
+      info.index_size = 4;
+      info.index_bounds_valid = true;
+      info.min_index = 0;
+      info.max_index = mesh->num_vertices - 1;
+      draw_set_indexes(draw, mesh->indices, 4,
+                       mesh->num_indices * sizeof(uint32_t));
+   }
+
+   const unsigned iterations = hash_vertices ? 1 : NUM_ITERATIONS;
+
+   /* Warm up, compiling the shader variant. */
+   draw_vbo(draw, &info, 0, NULL, &sc, 1, 0);
+   draw_flush(draw);
+   render.num_indices = 0;
+   render.hash = 2166136261u;
+
+   int64_t start = os_time_get_nano();
+   for (unsigned i = 0; i < iterations; i++) {
+      draw_vbo(draw, &info, 0, NULL, &sc, 1, 0);
+      draw_flush(draw);
+   }
+   int64_t end = os_time_get_nano();
+
+   *hash = render.hash;
+   *mverts = (double)mesh->num_indices * iterations * 1000.0 / (end - start);
+   draw_get_vertex_cache_stats(draw, stats);
+   success = render.num_indices > 0;
+
+   if (render.max_draw_indices > render.base.max_indices) {
+      fprintf(stderr, "  %u threads: drew %u indices at once, the render "
+              "takes %u\n", num_threads, render.max_draw_indices,
+              render.base.max_indices);
+      success = false;
+   }
+
+   if (verbose >= 2)
+      fprintf(stderr, "  %u threads: %u indices emitted, at most %u at "
+              "once, hash %08x\n", num_threads, render.num_indices,
+              render.max_draw_indices, render.hash);
+
+   draw_bind_vertex_shader(draw, NULL);
+   draw_delete_vertex_shader(draw, vs);
+
+out:
+   draw_destroy(draw);
+   FREE(render.vertices);
+
+   return success;
+}
+
+
+static bool
+test_one(unsigned verbose,
+         FILE *fp,
+         unsigned num_threads,
+         bool indexed)
+{
+   struct test_mesh mesh = {0};
+   struct draw_vertex_cache_stats stats = {0};
+   uint32_t ref_hash, hash;
+   double mverts, reuse = 0.0;
+   bool success = true;
+
+   if (verbose >= 1)
+      fprintf(stderr, "%u threads, %s ...\n",
+              num_threads, indexed ? "indexed" : "non-indexed");
+
+   if (!test_mesh_init(&mesh, indexed)) {
+      test_mesh_fini(&mesh);
+      return false;
+   }
+
+   if (!test_draw(verbose, &mesh, indexed, 0, true, &ref_hash, &mverts,
+                  &stats) ||
+       !test_draw(verbose, &mesh, indexed, num_threads, true, &hash, &mverts,
+                  &stats)) {
+      success = false;
+   } else if (hash != ref_hash) {
+      fprintf(stderr, "  MISMATCH: %u threads emitted %08x, expected %08x\n",
+              num_threads, hash, ref_hash);
+      success = false;
+   }
+
+   if (!test_draw(verbose, &mesh, indexed, num_threads, false, &hash, &mverts,
+                  &stats))
+      success = false;
+
+   /* Every vertex of the grid is shared by up to six triangles, the
+    * vertex cache should at least halve the vertex shader invocations.
+    */
+   if (stats.elements)
+      reuse = (double)stats.fetches / stats.elements;
+   if (indexed && reuse > 0.5) {
+      fprintf(stderr, "  POOR REUSE: %.3f vertex shader invocations per "
+              "element\n", reuse);
+      success = false;
+   }
+
+   if (verbose >= 1)
+      fprintf(stderr, "  %.2f Mvertices/s, %.3f invocations per element\n",
+              mverts, reuse);
+
+   if (fp)
+      write_tsv_row(fp, num_threads, indexed, mverts, reuse, success);
+
+   test_mesh_fini(&mesh);
+
+   return success;
+}
+
+
+bool
+test_all(unsigned verbose, FILE *fp)
+{
+   const unsigned max_threads = MIN2(util_get_cpu_caps()->nr_cpus, 16);
+   bool success = true;
+
+   for (unsigned threads = 0; threads <= max_threads;
+        threads = threads ? threads * 2 : 1) {
+      for (unsigned indexed = 0; indexed < 2; indexed++) {
+         if (!test_one(verbose, fp, threads, indexed))
+            success = false;
+      }
+   }
+
+   return success;
+}
+
+
+bool
+test_some(unsigned verbose, FILE *fp,
+          unsigned long n)
+{
+   return test_all(verbose, fp);
+}
+
+
+bool
+test_single(unsigned verbose, FILE *fp)
+{
+   return test_one(verbose, fp, 4, true);
+}
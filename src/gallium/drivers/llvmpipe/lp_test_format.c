@@ -179,13 +179,17 @@ test_format_float(unsigned verbose, FILE *fp,
          /* To ensure it's 16-byte aligned */
          memcpy(packed, test->packed, sizeof packed);
 
+         /* Blocks are cached by address, and packed is reused. */
+         if (use_cache == 1)
+            lp_build_format_cache_reset(cache_ptr);
+
          for (i = 0; i < desc->block.height; ++i) {
             for (j = 0; j < desc->block.width; ++j) {
                bool match = true;
 
                memset(unpacked, 0, sizeof unpacked);
 
-               fetch_ptr(unpacked, packed, j, i, use_cache ? cache_ptr : NULL);
+               fetch_ptr(unpacked, packed, j, i, use_cache == 1 ? cache_ptr : NULL);
 
                for (k = 0; k < 4; ++k) {
                   if (util_double_inf_sign(test->unpacked[i][j][k]) != util_inf_sign(unpacked[k])) {
@@ -281,13 +285,16 @@ test_format_unorm8(unsigned verbose, FILE *fp,
          /* Could skip this and use unaligned lp_build_fetch_rgba_aos */
          memcpy(packed, test->packed, sizeof packed);
 
+         if (use_cache == 1)
+            lp_build_format_cache_reset(cache_ptr);
+
          for (i = 0; i < desc->block.height; ++i) {
             for (j = 0; j < desc->block.width; ++j) {
                bool match;
 
                memset(unpacked, 0, sizeof unpacked);
 
-               fetch_ptr(unpacked, packed, j, i, use_cache ? cache_ptr : NULL);
+               fetch_ptr(unpacked, packed, j, i, use_cache == 1 ? cache_ptr : NULL);
 
                match = true;
                for (k = 0; k < 4; ++k) {
@@ -366,9 +373,12 @@ test_all(unsigned verbose, FILE *fp)
    bool success = true;
    unsigned use_cache;
 
-   cache_ptr = align_malloc(sizeof(struct lp_build_format_cache), 16);
+   cache_ptr = lp_build_format_cache_create(LP_BUILD_FORMAT_CACHE_BLOCKS);
 
-   for (use_cache = 0; use_cache < 2; use_cache++) {
+   /* 0: no cache, 1: with the cache, 2: code using the cache is called
+    * without one, as for threads whose cache couldn't be allocated.
+    */
+   for (use_cache = 0; use_cache < 3; use_cache++) {
       for (format = 1; format < PIPE_FORMAT_COUNT; ++format) {
          const struct util_format_description *format_desc;
 
@@ -394,8 +404,8 @@ test_all(unsigned verbose, FILE *fp)
          if (!util_format_fetch_rgba_func(format))
             continue;
 
-         /* only test twice with formats which can use cache */
-         if (format_desc->layout != UTIL_FORMAT_LAYOUT_S3TC && use_cache) {
+         /* only test the cache with formats which can use it */
+         if (!lp_build_format_cache_supported(format_desc) && use_cache) {
             continue;
          }
 
@@ -404,7 +414,7 @@ test_all(unsigned verbose, FILE *fp)
          }
       }
    }
-   align_free(cache_ptr);
+   lp_build_format_cache_destroy(cache_ptr);
 
    return success;
 }
@@ -0,0 +1,310 @@
+/*
+ * Copyright © 2026 The Mesa Authors
+ * SPDX-License-Identifier: MIT
+ */
+
+/**
+ * @file
+ * Unit tests for the batched tessellation of the tessellator.
+ *
+ * A batch looks the topology of each patch up in the cache of its context
+ * and generates the missing ones on the worker tessellators of its pool,
+ * possibly on other threads.  Every patch of a batch has to get the same
+ * domain points and indices as the plain tessellator run on its factors,
+ * which checks the quantization of the factors as well.
+ */
+
+
+#include <math.h>
+
+#include "util/u_memory.h"
+#include "util/u_queue.h"
+
+#include "tessellator/p_tessellator.h"
+
+#include "lp_test.h"
+#include "lp_test_tess.h"
+
+
+#define NUM_PATCHES 512
+#define NUM_THREADS 4
+
+
+void
+write_tsv_header(FILE *fp)
+{
+   fprintf(fp,
+           "result\t"
+           "prim\t"
+           "spacing\t"
+           "cw\t"
+           "point_mode\t"
+           "threads\n");
+
+   fflush(fp);
+}
+
+
+static void
+write_tsv_row(FILE *fp,
+              enum mesa_prim prim,
+              enum pipe_tess_spacing spacing,
+              bool cw,
+              bool point_mode,
+              unsigned num_threads,
+              bool success)
+{
+   fprintf(fp, "%s\t", success ? "pass" : "fail");
+   fprintf(fp, "%u\t", prim);
+   fprintf(fp, "%u\t", spacing);
+   fprintf(fp, "%u\t", cw);
+   fprintf(fp, "%u\t", point_mode);
+   fprintf(fp, "%u\n", num_threads);
+
+   fflush(fp);
+}
+
+
+/**
+ * Pick a tessellation factor, mostly from a handful of values so that
+ * patches share their topology, with the odd out of range one.
+ */
+static float
+random_factor(void)
+{
+   static const float common[] = { 1.0f, 2.0f, 3.5f, 4.0f, 7.25f, 16.0f };
+
+   switch (rand() % 16) {
+   case 0:
+      return 0.0f;
+   case 1:
+      return -1.0f;
+   case 2:
+      return NAN;
+   case 3:
+      return 64.0f + (float)rand() / RAND_MAX * 100.0f;
+   case 4:
+   case 5:
+   case 6:
+   case 7:
+      return (float)rand() / RAND_MAX * 64.0f;
+   default:
+      return common[rand() % ARRAY_SIZE(common)];
+   }
+}
+
+
+static bool
+compare_patch(unsigned verbose,
+              unsigned i,
+              const struct pipe_tessellator_data *data,
+              const struct pipe_tessellator_data *ref)
+{
+   if (data->num_domain_points != ref->num_domain_points ||
+       data->num_indices != ref->num_indices) {
+      if (verbose)
+         printf("  patch %u: %u points, %u indices, expected %u points, "
+                "%u indices\n", i, data->num_domain_points,
+                data->num_indices, ref->num_domain_points, ref->num_indices);
+      return false;
+   }
+
+   if (!ref->num_domain_points)
+      return true;
+
+   if (memcmp(data->domain_points_u, ref->domain_points_u,
+              ref->num_domain_points * sizeof(float)) ||
+       memcmp(data->domain_points_v, ref->domain_points_v,
+              ref->num_domain_points * sizeof(float))) {
+      if (verbose)
+         printf("  patch %u: domain points differ\n", i);
+      return false;
+   }
+
+   if (ref->num_indices &&
+       memcmp(data->indices, ref->indices,
+              ref->num_indices * sizeof(uint32_t))) {
+      if (verbose)
+         printf("  patch %u: indices differ\n", i);
+      return false;
+   }
+
+   return true;
+}
+
+
+/**
+ * Tessellate a batch of random patches with a context of the shared pool,
+ * twice so that the second batch hits the cache, and compare each patch
+ * against the reference tessellation.
+ */
+static bool
+test_one(unsigned verbose,
+         FILE *fp,
+         struct pipe_tessellator_pool *pool,
+         struct util_queue *queue,
+         enum mesa_prim prim,
+         enum pipe_tess_spacing spacing,
+         bool cw,
+         bool point_mode)
+{
+   struct pipe_tessellation_factors *factors;
+   struct pipe_tessellator_data *data;
+   struct pipe_tessellator *tess;
+   struct lp_tess_ref *ref_tess;
+   unsigned num_threads = queue ? queue->max_threads : 0;
+   bool success = true;
+
+   if (verbose >= 1)
+      printf("prim %u, spacing %u, cw %u, point_mode %u, %u threads\n",
+             prim, spacing, cw, point_mode, num_threads);
+
+   factors = CALLOC(NUM_PATCHES, sizeof *factors);
+   data = CALLOC(NUM_PATCHES, sizeof *data);
+   tess = p_tess_init(prim, spacing, cw, point_mode, pool);
+   ref_tess = lp_tess_ref_create(prim, spacing, cw, point_mode);
+   if (!factors || !data || !tess || !ref_tess) {
+      success = false;
+      goto out;
+   }
+
+   for (unsigned i = 0; i < NUM_PATCHES; i++) {
+      if (i % 4 == 3) {
+         /* Repeat an earlier patch within the batch. */
+         factors[i] = factors[rand() % i];
+         continue;
+      }
+      for (unsigned j = 0; j < 4; j++)
+         factors[i].outer_tf[j] = random_factor();
+      for (unsigned j = 0; j < 2; j++)
+         factors[i].inner_tf[j] = random_factor();
+   }
+
+   for (unsigned pass = 0; pass < 2 && success; pass++) {
+      p_tessellate_batch(tess, queue, NUM_PATCHES, factors, data);
+
+      for (unsigned i = 0; i < NUM_PATCHES; i++) {
+         struct pipe_tessellator_data ref;
+
+         lp_tess_ref_tessellate(ref_tess, &factors[i], &ref);
+         if (!compare_patch(verbose, i, &data[i], &ref)) {
+            if (verbose)
+               printf("  mismatch in pass %u\n", pass);
+            success = false;
+            break;
+         }
+      }
+   }
+
+out:
+   if (ref_tess)
+      lp_tess_ref_destroy(ref_tess);
+   if (tess)
+      p_tess_destroy(tess);
+   FREE(data);
+   FREE(factors);
+
+   if (fp)
+      write_tsv_row(fp, prim, spacing, cw, point_mode, num_threads, success);
+
+   return success;
+}
+
+
+static bool
+test_threads(unsigned verbose, FILE *fp, unsigned num_threads)
+{
+   static const enum mesa_prim prims[] = {
+      MESA_PRIM_QUADS, MESA_PRIM_TRIANGLES, MESA_PRIM_LINES,
+   };
+   static const enum pipe_tess_spacing spacings[] = {
+      PIPE_TESS_SPACING_FRACTIONAL_ODD,
+      PIPE_TESS_SPACING_FRACTIONAL_EVEN,
+      PIPE_TESS_SPACING_EQUAL,
+   };
+   struct pipe_tessellator_pool *pool;
+   struct util_queue queue;
+   bool success = true;
+
+   if (num_threads &&
+       !util_queue_init(&queue, "lp_test_tess", NUM_PATCHES, num_threads,
+                        0, NULL))
+      return false;
+
+   /* All the contexts share one pool, and so its workers and cache budget,
+    * each test tessellating with a different mode than the previous one.
+    */
+   pool = p_tess_pool_create();
+   if (!pool) {
+      success = false;
+      goto out;
+   }
+
+   for (unsigned p = 0; p < ARRAY_SIZE(prims); p++) {
+      for (unsigned s = 0; s < ARRAY_SIZE(spacings); s++) {
+         for (unsigned mode = 0; mode < 4; mode++) {
+            if (!test_one(verbose, fp, pool, num_threads ? &queue : NULL,
+                          prims[p], spacings[s], mode & 1, mode & 2))
+               success = false;
+         }
+      }
+   }
+
+   p_tess_pool_release(pool);
+
+out:
+   if (num_threads)
+      util_queue_destroy(&queue);
+
+   return success;
+}
+
+
+bool
+test_all(unsigned verbose, FILE *fp)
+{
+   bool success = true;
+
+   srand(0);
+
+   if (!test_threads(verbose, fp, 0))
+      success = false;
+   if (!test_threads(verbose, fp, NUM_THREADS))
+      success = false;
+
+   return success;
+}
+
+
+bool
+test_some(unsigned verbose, FILE *fp,
+          unsigned long n)
+{
+   return test_all(verbose, fp);
+}
+
+
+bool
+test_single(unsigned verbose, FILE *fp)
+{
+   struct pipe_tessellator_pool *pool;
+   struct util_queue queue;
+   bool success;
+
+   srand(0);
+
+   if (!util_queue_init(&queue, "lp_test_tess", NUM_PATCHES, NUM_THREADS,
+                        0, NULL))
+      return false;
+
+   pool = p_tess_pool_create();
+   success = pool &&
+             test_one(verbose, fp, pool, &queue, MESA_PRIM_QUADS,
+                      PIPE_TESS_SPACING_FRACTIONAL_ODD, false, false);
+   if (pool)
+      p_tess_pool_release(pool);
+
+   util_queue_destroy(&queue);
+
+   return success;
+}
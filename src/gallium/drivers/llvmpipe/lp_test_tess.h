@@ -0,0 +1,51 @@
+/*
+ * Copyright © 2026 The Mesa Authors
+ * SPDX-License-Identifier: MIT
+ */
+
+/**
+ * @file
+ * Reference tessellator of lp_test_tess.
+ */
+
+
+#ifndef LP_TEST_TESS_H
+#define LP_TEST_TESS_H
+
+
+#include "tessellator/p_tessellator.h"
+
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+
+struct lp_tess_ref;
+
+
+struct lp_tess_ref *
+lp_tess_ref_create(enum mesa_prim prim,
+                   enum pipe_tess_spacing spacing,
+                   bool cw,
+                   bool point_mode);
+
+void
+lp_tess_ref_destroy(struct lp_tess_ref *ref);
+
+/**
+ * Tessellate a patch with the plain tessellator, the data stays valid until
+ * the next call.
+ */
+void
+lp_tess_ref_tessellate(struct lp_tess_ref *ref,
+                       const struct pipe_tessellation_factors *factors,
+                       struct pipe_tessellator_data *data);
+
+
+#ifdef __cplusplus
+}
+#endif
+
+
+#endif /* LP_TEST_TESS_H */
@@ -0,0 +1,121 @@
+/*
+ * Copyright © 2026 The Mesa Authors
+ * SPDX-License-Identifier: MIT
+ */
+
+/**
+ * @file
+ * Reference tessellation for lp_test_tess.
+ *
+ * This runs the CHWTessellator directly on the factors of the patch, as
+ * they were written by the shader, without the quantization and the cache
+ * of the tessellation contexts.
+ */
+
+
+#include <cstring>
+#include <new>
+#include <vector>
+
+#include "tessellator/tessellator.hpp"
+
+#include "lp_test_tess.h"
+
+
+struct lp_tess_ref
+{
+   CHWTessellator ts;
+   enum mesa_prim prim;
+   std::vector<float> u;
+   std::vector<float> v;
+};
+
+
+struct lp_tess_ref *
+lp_tess_ref_create(enum mesa_prim prim,
+                   enum pipe_tess_spacing spacing,
+                   bool cw,
+                   bool point_mode)
+{
+   PIPE_TESSELLATOR_PARTITIONING partitioning;
+   PIPE_TESSELLATOR_OUTPUT_PRIMITIVE out_prim;
+
+   switch (spacing) {
+   case PIPE_TESS_SPACING_FRACTIONAL_ODD:
+      partitioning = PIPE_TESSELLATOR_PARTITIONING_FRACTIONAL_ODD;
+      break;
+   case PIPE_TESS_SPACING_FRACTIONAL_EVEN:
+      partitioning = PIPE_TESSELLATOR_PARTITIONING_FRACTIONAL_EVEN;
+      break;
+   case PIPE_TESS_SPACING_EQUAL:
+   default:
+      partitioning = PIPE_TESSELLATOR_PARTITIONING_INTEGER;
+      break;
+   }
+
+   if (point_mode)
+      out_prim = PIPE_TESSELLATOR_OUTPUT_POINT;
+   else if (prim == MESA_PRIM_LINES)
+      out_prim = PIPE_TESSELLATOR_OUTPUT_LINE;
+   else if (cw)
+      out_prim = PIPE_TESSELLATOR_OUTPUT_TRIANGLE_CW;
+   else
+      out_prim = PIPE_TESSELLATOR_OUTPUT_TRIANGLE_CCW;
+
+   struct lp_tess_ref *ref = new (std::nothrow) lp_tess_ref();
+   if (!ref)
+      return NULL;
+
+   ref->ts.Init(partitioning, out_prim);
+   ref->prim = prim;
+   return ref;
+}
+
+
+void
+lp_tess_ref_destroy(struct lp_tess_ref *ref)
+{
+   delete ref;
+}
+
+
+void
+lp_tess_ref_tessellate(struct lp_tess_ref *ref,
+                       const struct pipe_tessellation_factors *factors,
+                       struct pipe_tessellator_data *data)
+{
+   const float *outer = factors->outer_tf;
+   const float *inner = factors->inner_tf;
+
+   switch (ref->prim) {
+   case MESA_PRIM_QUADS:
+      ref->ts.TessellateQuadDomain(outer[0], outer[1], outer[2], outer[3],
+                                   inner[0], inner[1]);
+      break;
+   case MESA_PRIM_TRIANGLES:
+      ref->ts.TessellateTriDomain(outer[0], outer[1], outer[2], inner[0]);
+      break;
+   case MESA_PRIM_LINES:
+      ref->ts.TessellateIsoLineDomain(outer[0], outer[1]);
+      break;
+   default:
+      memset(data, 0, sizeof(*data));
+      return;
+   }
+
+   unsigned num_points = ref->ts.GetPointCount();
+   DOMAIN_POINT *points = ref->ts.GetPoints();
+
+   ref->u.resize(num_points);
+   ref->v.resize(num_points);
+   for (unsigned i = 0; i < num_points; i++) {
+      ref->u[i] = points[i].u;
+      ref->v[i] = points[i].v;
+   }
+
+   data->num_domain_points = num_points;
+   data->domain_points_u = ref->u.data();
+   data->domain_points_v = ref->v.data();
+   data->num_indices = ref->ts.GetIndexCount();
+   data->indices = (uint32_t *)ref->ts.GetIndices();
+}
@@ -0,0 +1,572 @@
+/*
+ * Copyright © 2026 The Mesa Authors
+ * SPDX-License-Identifier: MIT
+ */
+
+/**
+ * @file
+ * Unit tests and microbenchmark for texel fetches from linear and micro
+ * tiled texture layouts.
+ *
+ * Each test fetches the 2x2 footprint of a bilinear filter for a stream of
+ * coordinates, walking the texture in rows, columns or at an angle, and
+ * checks the sums of the four texels against a reference.
+ *
+ * The transfer test writes and reads back a micro tiled texture through
+ * texture_map/texture_unmap, which retile through a linear staging copy, and
+ * checks the tiled storage itself against the layout the fetches assume.
+ */
+
+
+#include <math.h>
+
+#include "util/box.h"
+#include "util/u_inlines.h"
+#include "util/u_memory.h"
+#include "util/u_pointer.h"
+#include "util/format/u_format.h"
+#include "pipe/p_context.h"
+#include "pipe/p_screen.h"
+#include "frontend/sw_winsys.h"
+
+#include "gallivm/lp_bld_init.h"
+#include "gallivm/lp_bld_type.h"
+#include "gallivm/lp_bld_const.h"
+#include "gallivm/lp_bld_arit.h"
+#include "gallivm/lp_bld_flow.h"
+#include "gallivm/lp_bld_gather.h"
+#include "gallivm/lp_bld_sample.h"
+#include "gallivm/lp_bld_swizzle.h"
+
+#include "lp_public.h"
+#include "lp_screen.h"
+#include "lp_texture.h"
+#include "lp_test.h"
+
+
+#define TEX_SIZE 1024
+#define NUM_COORDS (512 * 512)
+#define NUM_RUNS 8
+
+/* Odd sizes, so that the levels end in partial tiles */
+#define TRANSFER_WIDTH 37
+#define TRANSFER_HEIGHT 29
+#define TRANSFER_LAYERS 3
+#define TRANSFER_LEVELS 3
+
+
+enum texfetch_pattern
+{
+   TEXFETCH_ROWS,
+   TEXFETCH_COLUMNS,
+   TEXFETCH_ROTATED,
+   TEXFETCH_NUM_PATTERNS
+};
+
+
+static const char *pattern_names[TEXFETCH_NUM_PATTERNS + 1] = {
+   "rows",
+   "columns",
+   "rotated",
+   "transfer",
+};
+
+
+typedef void
+(*texfetch_test_ptr_t)(const void *base, int32_t row_stride,
+                       const int32_t *xs, const int32_t *ys,
+                       uint32_t *dst, int32_t count);
+
+
+void
+write_tsv_header(FILE *fp)
+{
+   fprintf(fp,
+           "result\t"
+           "cycles_per_texel\t"
+           "layout\t"
+           "pattern\n");
+
+   fflush(fp);
+}
+
+
+static void
+write_tsv_row(FILE *fp,
+              bool micro_tiled,
+              enum texfetch_pattern pattern,
+              double cycles,
+              bool success)
+{
+   fprintf(fp, "%s\t", success ? "pass" : "fail");
+   fprintf(fp, "%.1f\t", cycles);
+   fprintf(fp, "%s\t", micro_tiled ? "micro_tiled" : "linear");
+   fprintf(fp, "%s\n", pattern_names[pattern]);
+
+   fflush(fp);
+}
+
+
+static unsigned
+texel_offset(bool micro_tiled, unsigned row_stride, unsigned x, unsigned y)
+{
+   const unsigned tile = LP_MICRO_TILE_SIZE;
+
+   if (!micro_tiled)
+      return y * row_stride + x * 4;
+
+   return (y / tile) * row_stride + (x / tile) * tile * tile * 4 +
+          (y % tile) * tile * 4 + (x % tile) * 4;
+}
+
+
+static LLVMValueRef
+add_texfetch_test(struct gallivm_state *gallivm, bool micro_tiled)
+{
+   LLVMModuleRef module = gallivm->module;
+   LLVMContextRef context = gallivm->context;
+   LLVMBuilderRef builder = gallivm->builder;
+   const struct util_format_description *format_desc =
+      util_format_description(PIPE_FORMAT_R8G8B8A8_UNORM);
+   struct lp_type type = lp_type_int_vec(32, lp_native_vector_width);
+   LLVMTypeRef i8_type = LLVMInt8TypeInContext(context);
+   LLVMTypeRef i32_type = LLVMInt32TypeInContext(context);
+   LLVMTypeRef vec_type = lp_build_vec_type(gallivm, type);
+   LLVMTypeRef vec_ptr_type = LLVMPointerType(vec_type, 0);
+   struct lp_build_context bld;
+   struct lp_build_loop_state loop;
+   LLVMTypeRef args[6];
+   LLVMValueRef func;
+
+   args[0] = LLVMPointerType(i8_type, 0);
+   args[1] = i32_type;
+   args[2] = LLVMPointerType(i32_type, 0);
+   args[3] = LLVMPointerType(i32_type, 0);
+   args[4] = LLVMPointerType(i32_type, 0);
+   args[5] = i32_type;
+
+   func = LLVMAddFunction(module, "test",
+                          LLVMFunctionType(LLVMVoidTypeInContext(context),
+                                           args, ARRAY_SIZE(args), 0));
+   LLVMSetFunctionCallConv(func, LLVMCCallConv);
+
+   LLVMValueRef base_ptr = LLVMGetParam(func, 0);
+   LLVMValueRef row_stride = LLVMGetParam(func, 1);
+   LLVMValueRef xs_ptr = LLVMGetParam(func, 2);
+   LLVMValueRef ys_ptr = LLVMGetParam(func, 3);
+   LLVMValueRef dst_ptr = LLVMGetParam(func, 4);
+   LLVMValueRef count = LLVMGetParam(func, 5);
+
+   LLVMBasicBlockRef block = LLVMAppendBasicBlockInContext(context, func, "entry");
+   LLVMPositionBuilderAtEnd(builder, block);
+
+   lp_build_context_init(&bld, gallivm, type);
+
+   LLVMValueRef y_stride = lp_build_broadcast_scalar(&bld, row_stride);
+
+   lp_build_loop_begin(&loop, gallivm, lp_build_const_int32(gallivm, 0));
+   {
+      LLVMValueRef index = loop.counter;
+      LLVMValueRef x_ptr = LLVMBuildGEP2(builder, i32_type, xs_ptr, &index, 1, "");
+      LLVMValueRef y_ptr = LLVMBuildGEP2(builder, i32_type, ys_ptr, &index, 1, "");
+      LLVMValueRef d_ptr = LLVMBuildGEP2(builder, i32_type, dst_ptr, &index, 1, "");
+      LLVMValueRef x[2], y[2];
+      LLVMValueRef sum = bld.zero;
+
+      /* Whole vectors are loaded and stored from the scalar arrays. */
+      x_ptr = LLVMBuildBitCast(builder, x_ptr, vec_ptr_type, "");
+      y_ptr = LLVMBuildBitCast(builder, y_ptr, vec_ptr_type, "");
+      d_ptr = LLVMBuildBitCast(builder, d_ptr, vec_ptr_type, "");
+
+      x[0] = LLVMBuildLoad2(builder, vec_type, x_ptr, "");
+      y[0] = LLVMBuildLoad2(builder, vec_type, y_ptr, "");
+      x[1] = lp_build_add(&bld, x[0], bld.one);
+      y[1] = lp_build_add(&bld, y[0], bld.one);
+
+      for (unsigned j = 0; j < 2; j++) {
+         for (unsigned i = 0; i < 2; i++) {
+            LLVMValueRef offset, sub_i, sub_j, texel;
+
+            if (micro_tiled) {
+               lp_build_micro_tiled_sample_offset(&bld, format_desc,
+                                                  x[i], y[j], NULL,
+                                                  y_stride, NULL,
+                                                  &offset, &sub_i, &sub_j);
+            } else {
+               lp_build_sample_offset(&bld, format_desc,
+                                      x[i], y[j], NULL,
+                                      y_stride, NULL,
+                                      &offset, &sub_i, &sub_j);
+            }
+
+            texel = lp_build_gather(gallivm, type.length, 32,
+                                    lp_type_uint(32), true,
+                                    base_ptr, offset, false);
+            sum = LLVMBuildAdd(builder, sum, texel, "");
+         }
+      }
+
+      LLVMBuildStore(builder, sum, d_ptr);
+   }
+   lp_build_loop_end_cond(&loop, count,
+                          lp_build_const_int32(gallivm, type.length),
+                          LLVMIntUGE);
+
+   LLVMBuildRetVoid(builder);
+
+   gallivm_verify_function(gallivm, func);
+
+   return func;
+}
+
+
+static void
+init_coords(enum texfetch_pattern pattern, int32_t *xs, int32_t *ys)
+{
+   const unsigned side = 512;
+   const float c = (float)M_SQRT1_2;
+
+   for (unsigned i = 0; i < NUM_COORDS; ++i) {
+      const unsigned u = i % side;
+      const unsigned v = i / side;
+      int x, y;
+
+      switch (pattern) {
+      case TEXFETCH_ROWS:
+         x = u;
+         y = v;
+         break;
+      case TEXFETCH_COLUMNS:
+         x = v;
+         y = u;
+         break;
+      case TEXFETCH_ROTATED:
+      default:
+         x = (int)(TEX_SIZE / 2 + ((float)u - (float)v) * c);
+         y = (int)(((float)u + (float)v) * c);
+         break;
+      }
+
+      xs[i] = CLAMP(x, 0, TEX_SIZE - 2);
+      ys[i] = CLAMP(y, 0, TEX_SIZE - 2);
+   }
+}
+
+
+UTIL_ALIGN_STACK
+static bool
+test_one(unsigned verbose,
+         FILE *fp,
+         bool micro_tiled,
+         enum texfetch_pattern pattern)
+{
+   lp_context_ref context;
+   struct gallivm_state *gallivm;
+   LLVMValueRef func;
+   texfetch_test_ptr_t texfetch_test_ptr;
+   const unsigned row_stride = micro_tiled ?
+      TEX_SIZE * 4 * LP_MICRO_TILE_SIZE : TEX_SIZE * 4;
+   uint32_t *linear, *tex, *dst, *ref;
+   int32_t *xs, *ys;
+   int64_t best_cycles = INT64_MAX;
+   bool success = true;
+
+   if (verbose >= 1)
+      fprintf(stderr, "%s %s ...\n",
+              micro_tiled ? "micro_tiled" : "linear", pattern_names[pattern]);
+
+   linear = align_malloc(TEX_SIZE * TEX_SIZE * 4, 64);
+   tex = align_malloc(TEX_SIZE * TEX_SIZE * 4, 64);
+   xs = align_malloc(NUM_COORDS * sizeof *xs, 64);
+   ys = align_malloc(NUM_COORDS * sizeof *ys, 64);
+   dst = align_malloc(NUM_COORDS * sizeof *dst, 64);
+   ref = align_malloc(NUM_COORDS * sizeof *ref, 64);
+   if (!linear || !tex || !xs || !ys || !dst || !ref) {
+      success = false;
+      goto out;
+   }
+
+   for (unsigned i = 0; i < TEX_SIZE * TEX_SIZE; ++i)
+      linear[i] = rand();
+
+   for (unsigned y = 0; y < TEX_SIZE; ++y) {
+      for (unsigned x = 0; x < TEX_SIZE; ++x) {
+         tex[texel_offset(micro_tiled, row_stride, x, y) / 4] =
+            linear[y * TEX_SIZE + x];
+      }
+   }
+
+   init_coords(pattern, xs, ys);
+
+   for (unsigned i = 0; i < NUM_COORDS; ++i) {
+      const unsigned x = xs[i], y = ys[i];
+      ref[i] = linear[y * TEX_SIZE + x] +
+               linear[y * TEX_SIZE + x + 1] +
+               linear[(y + 1) * TEX_SIZE + x] +
+               linear[(y + 1) * TEX_SIZE + x + 1];
+   }
+
+   lp_context_create(&context);
+   gallivm = gallivm_create("test_module", &context, NULL);
+
+   func = add_texfetch_test(gallivm, micro_tiled);
+
+   gallivm_compile_module(gallivm);
+
+   texfetch_test_ptr = (texfetch_test_ptr_t)gallivm_jit_function(gallivm, func, "test");
+
+   gallivm_free_ir(gallivm);
+
+   for (unsigned run = 0; run < NUM_RUNS; ++run) {
+      int64_t start_counter = rdtsc();
+      texfetch_test_ptr(tex, row_stride, xs, ys, dst, NUM_COORDS);
+      int64_t end_counter = rdtsc();
+
+      best_cycles = MIN2(best_cycles, end_counter - start_counter);
+   }
+
+   for (unsigned i = 0; i < NUM_COORDS; ++i) {
+      if (dst[i] != ref[i]) {
+         if (verbose >= 1 || success) {
+            fprintf(stderr, "  MISMATCH at (%d, %d): 0x%08x != 0x%08x\n",
+                    xs[i], ys[i], dst[i], ref[i]);
+         }
+         success = false;
+         break;
+      }
+   }
+
+   if (verbose >= 1) {
+      fprintf(stderr, "  %.1f cycles per texel\n",
+              (double)best_cycles / (NUM_COORDS * 4));
+   }
+
+   if (fp)
+      write_tsv_row(fp, micro_tiled, pattern,
+                    (double)best_cycles / (NUM_COORDS * 4), success);
+
+   gallivm_destroy(gallivm);
+   lp_context_destroy(&context);
+
+out:
+   align_free(linear);
+   align_free(tex);
+   align_free(xs);
+   align_free(ys);
+   align_free(dst);
+   align_free(ref);
+
+   return success;
+}
+
+
+static uint32_t
+transfer_texel(unsigned level, unsigned x, unsigned y, unsigned z,
+               unsigned generation)
+{
+   return (generation << 28) ^ (level << 24) ^ (z << 20) ^ (y << 10) ^ x;
+}
+
+
+static unsigned
+transfer_map_box(struct pipe_context *pipe,
+                 struct pipe_resource *tex,
+                 unsigned level,
+                 unsigned usage,
+                 const struct pipe_box *box,
+                 unsigned generation,
+                 unsigned verbose)
+{
+   struct pipe_transfer *transfer;
+   unsigned mismatches = 0;
+
+   uint8_t *map = pipe->texture_map(pipe, tex, level, usage, box, &transfer);
+   if (!map)
+      return 1;
+
+   for (int z = 0; z < box->depth; ++z) {
+      for (int y = 0; y < box->height; ++y) {
+         uint32_t *row = (uint32_t *)(map + z * transfer->layer_stride +
+                                      y * transfer->stride);
+         for (int x = 0; x < box->width; ++x) {
+            const uint32_t texel =
+               transfer_texel(level, box->x + x, box->y + y, box->z + z,
+                              generation);
+            if (usage & PIPE_MAP_WRITE) {
+               row[x] = texel;
+            } else if (row[x] != texel) {
+               if (verbose >= 1 || !mismatches)
+                  fprintf(stderr, "  MISMATCH at level %u (%d, %d, %d): "
+                          "0x%08x != 0x%08x\n", level, box->x + x,
+                          box->y + y, box->z + z, row[x], texel);
+               ++mismatches;
+            }
+         }
+      }
+   }
+
+   pipe->texture_unmap(pipe, transfer);
+
+   return mismatches;
+}
+
+
+/**
+ * Check the tiled storage of a level against texel_offset().
+ */
+static unsigned
+transfer_check_tiles(struct pipe_resource *tex,
+                     unsigned level,
+                     const struct pipe_box *updated,
+                     unsigned verbose)
+{
+   const struct llvmpipe_resource *lpr = llvmpipe_resource_const(tex);
+   const uint8_t *data = (const uint8_t *)lpr->tex_data +
+                         lpr->mip_offsets[level];
+   const unsigned width = u_minify(tex->width0, level);
+   const unsigned height = u_minify(tex->height0, level);
+   unsigned mismatches = 0;
+
+   for (unsigned z = 0; z < tex->array_size; ++z) {
+      for (unsigned y = 0; y < height; ++y) {
+         for (unsigned x = 0; x < width; ++x) {
+            const bool in_update = updated &&
+               x >= updated->x && x < updated->x + updated->width &&
+               y >= updated->y && y < updated->y + updated->height &&
+               z >= updated->z && z < updated->z + updated->depth;
+            const uint32_t texel =
+               transfer_texel(level, x, y, z, in_update ? 1 : 0);
+            uint32_t stored;
+
+            memcpy(&stored, data + z * lpr->img_stride[level] +
+                   texel_offset(true, lpr->row_stride[level], x, y), 4);
+            if (stored != texel) {
+               if (verbose >= 1 || !mismatches)
+                  fprintf(stderr, "  MISMATCH in tiles at level %u "
+                          "(%u, %u, %u): 0x%08x != 0x%08x\n",
+                          level, x, y, z, stored, texel);
+               ++mismatches;
+            }
+         }
+      }
+   }
+
+   return mismatches;
+}
+
+
+/**
+ * Round trip texels through the transfers of a micro tiled texture: upload
+ * every level, read back an unaligned box, overwrite another unaligned box
+ * without discarding, and check both the tiled storage and the readback.
+ */
+static bool
+test_transfer(unsigned verbose, FILE *fp)
+{
+   static struct sw_winsys winsys;
+   unsigned mismatches = 0;
+
+   if (verbose >= 1)
+      fprintf(stderr, "micro_tiled transfers ...\n");
+
+   struct pipe_screen *screen = llvmpipe_create_screen(&winsys);
+   if (!screen)
+      return false;
+
+   llvmpipe_screen(screen)->tiled_textures = true;
+
+   struct pipe_context *pipe = screen->context_create(screen, NULL, 0);
+   if (!pipe) {
+      screen->destroy(screen);
+      return false;
+   }
+
+   const struct pipe_resource templat = {
+      .target = PIPE_TEXTURE_2D_ARRAY,
+      .format = PIPE_FORMAT_R8G8B8A8_UNORM,
+      .width0 = TRANSFER_WIDTH,
+      .height0 = TRANSFER_HEIGHT,
+      .depth0 = 1,
+      .array_size = TRANSFER_LAYERS,
+      .last_level = TRANSFER_LEVELS - 1,
+      .bind = PIPE_BIND_SAMPLER_VIEW,
+   };
+   struct pipe_resource *tex = screen->resource_create(screen, &templat);
+   if (!tex || !(tex->flags & LP_RESOURCE_FLAG_MICRO_TILED)) {
+      fprintf(stderr, "  texture is not micro tiled\n");
+      mismatches++;
+      goto out;
+   }
+
+   for (unsigned level = 0; level < TRANSFER_LEVELS; ++level) {
+      const unsigned width = u_minify(TRANSFER_WIDTH, level);
+      const unsigned height = u_minify(TRANSFER_HEIGHT, level);
+      struct pipe_box whole, read, write;
+
+      u_box_3d(0, 0, 0, width, height, TRANSFER_LAYERS, &whole);
+      u_box_3d(width / 4 + 1, height / 3, 1,
+               width / 2, height / 2 + 1, 2, &read);
+      u_box_3d(width / 3, 1, 0,
+               width - width / 3, MAX2(height / 2, 1), 2, &write);
+
+      mismatches += transfer_map_box(pipe, tex, level,
+                                     PIPE_MAP_WRITE |
+                                     PIPE_MAP_DISCARD_WHOLE_RESOURCE,
+                                     &whole, 0, verbose);
+      mismatches += transfer_check_tiles(tex, level, NULL, verbose);
+      mismatches += transfer_map_box(pipe, tex, level, PIPE_MAP_READ,
+                                     &read, 0, verbose);
+
+      /* A write without discard has to preserve the rest of the tiles */
+      mismatches += transfer_map_box(pipe, tex, level, PIPE_MAP_WRITE,
+                                     &write, 1, verbose);
+      mismatches += transfer_check_tiles(tex, level, &write, verbose);
+      mismatches += transfer_map_box(pipe, tex, level, PIPE_MAP_READ,
+                                     &write, 1, verbose);
+   }
+
+out:
+   pipe_resource_reference(&tex, NULL);
+   pipe->destroy(pipe);
+   screen->destroy(screen);
+
+   if (fp)
+      write_tsv_row(fp, true, TEXFETCH_NUM_PATTERNS, 0.0, !mismatches);
+
+   return !mismatches;
+}
+
+
+bool
+test_all(unsigned verbose, FILE *fp)
+{
+   bool success = true;
+
+   for (unsigned pattern = 0; pattern < TEXFETCH_NUM_PATTERNS; ++pattern) {
+      for (unsigned micro_tiled = 0; micro_tiled < 2; ++micro_tiled) {
+         if (!test_one(verbose, fp, micro_tiled,
+                       (enum texfetch_pattern)pattern))
+            success = false;
+      }
+   }
+
+   if (!test_transfer(verbose, fp))
+      success = false;
+
+   return success;
+}
+
+
+bool
+test_some(unsigned verbose, FILE *fp,
+          unsigned long n)
+{
+   return test_all(verbose, fp);
+}
+
+
+bool
+test_single(unsigned verbose, FILE *fp)
+{
+   return test_one(verbose, fp, true, TEXFETCH_ROTATED);
+}
@@ -0,0 +1,462 @@
+/*
+ * Copyright © 2026 The Mesa Authors
+ * SPDX-License-Identifier: MIT
+ */
+
+/**
+ * @file
+ * Unit tests and throughput benchmark for the translate backends.
+ *
+ * Every key is run through translate_generic, which is the reference, and
+ * through the gallivm backend (and translate_sse on x86), with linear and
+ * indexed fetches of every index size, instanced elements and out of range
+ * indices.  The outputs have to match.
+ */
+
+
+#include "util/detect.h"
+#include "util/format/u_format.h"
+#include "util/u_math.h"
+#include "util/u_memory.h"
+#include "util/os_time.h"
+#include "translate/translate.h"
+
+#include "lp_test.h"
+
+
+#define NUM_VERTICES 4096
+#define NUM_INDICES 4096
+#define BENCH_TIME_NS (20 * 1000 * 1000)
+
+
+struct test_element
+{
+   enum pipe_format input_format;
+   enum pipe_format output_format;
+   unsigned instance_divisor;
+};
+
+struct test_case
+{
+   const char *name;
+   unsigned nr_elements;
+   struct test_element elements[4];
+};
+
+static const struct test_case test_cases[] = {
+   { "float4 copy", 1, {
+      { PIPE_FORMAT_R32G32B32A32_FLOAT, PIPE_FORMAT_R32G32B32A32_FLOAT },
+   } },
+   { "float3", 1, {
+      { PIPE_FORMAT_R32G32B32_FLOAT, PIPE_FORMAT_R32G32B32A32_FLOAT },
+   } },
+   { "float2", 1, {
+      { PIPE_FORMAT_R32G32_FLOAT, PIPE_FORMAT_R32G32B32A32_FLOAT },
+   } },
+   { "half4", 1, {
+      { PIPE_FORMAT_R16G16B16A16_FLOAT, PIPE_FORMAT_R32G32B32A32_FLOAT },
+   } },
+   { "double3", 1, {
+      { PIPE_FORMAT_R64G64B64_FLOAT, PIPE_FORMAT_R32G32B32_FLOAT },
+   } },
+   { "unorm8x4", 1, {
+      { PIPE_FORMAT_R8G8B8A8_UNORM, PIPE_FORMAT_R32G32B32A32_FLOAT },
+   } },
+   { "bgra8", 1, {
+      { PIPE_FORMAT_B8G8R8A8_UNORM, PIPE_FORMAT_R32G32B32A32_FLOAT },
+   } },
+   { "snorm8x3", 1, {
+      { PIPE_FORMAT_R8G8B8_SNORM, PIPE_FORMAT_R32G32B32_FLOAT },
+   } },
+   { "snorm16x2", 1, {
+      { PIPE_FORMAT_R16G16_SNORM, PIPE_FORMAT_R32G32_FLOAT },
+   } },
+   { "uscaled16x4", 1, {
+      { PIPE_FORMAT_R16G16B16A16_USCALED, PIPE_FORMAT_R32G32B32A32_FLOAT },
+   } },
+   { "unorm10_10_10_2", 1, {
+      { PIPE_FORMAT_R10G10B10A2_UNORM, PIPE_FORMAT_R32G32B32A32_FLOAT },
+   } },
+   { "uint8x4", 1, {
+      { PIPE_FORMAT_R8G8B8A8_UINT, PIPE_FORMAT_R32G32B32A32_UINT },
+   } },
+   { "sint16x2", 1, {
+      { PIPE_FORMAT_R16G16_SINT, PIPE_FORMAT_R32G32B32A32_SINT },
+   } },
+   { "vertex", 4, {
+      { PIPE_FORMAT_R32G32B32_FLOAT, PIPE_FORMAT_R32G32B32A32_FLOAT },
+      { PIPE_FORMAT_R16G16B16A16_SNORM, PIPE_FORMAT_R32G32B32_FLOAT },
+      { PIPE_FORMAT_R16G16_UNORM, PIPE_FORMAT_R32G32_FLOAT },
+      { PIPE_FORMAT_B8G8R8A8_UNORM, PIPE_FORMAT_R32G32B32A32_FLOAT, 3 },
+   } },
+};
+
+
+enum test_backend
+{
+   TEST_BACKEND_GENERIC,
+   TEST_BACKEND_LLVM,
+   TEST_BACKEND_SSE,
+   TEST_BACKEND_COUNT
+};
+
+static const char *backend_names[TEST_BACKEND_COUNT] = {
+   "generic", "llvm", "sse",
+};
+
+
+void
+write_tsv_header(FILE *fp)
+{
+   fprintf(fp,
+           "result\t"
+           "mverts_per_sec\t"
+           "backend\t"
+           "format\n");
+
+   fflush(fp);
+}
+
+
+static void
+write_tsv_row(FILE *fp,
+              const struct test_case *test,
+              enum test_backend backend,
+              double mverts,
+              bool success)
+{
+   fprintf(fp, "%s\t", success ? "pass" : "fail");
+   fprintf(fp, "%.2f\t", mverts);
+   fprintf(fp, "%s\t", backend_names[backend]);
+   fprintf(fp, "%s\n", test->name);
+
+   fflush(fp);
+}
+
+
+static struct translate *
+create_translate(enum test_backend backend, const struct translate_key *key)
+{
+   switch (backend) {
+   case TEST_BACKEND_GENERIC:
+      return translate_generic_create(key);
+   case TEST_BACKEND_LLVM:
+      return translate_llvm_create(key);
+   case TEST_BACKEND_SSE:
+#if DETECT_ARCH_X86 || DETECT_ARCH_X86_64
+      return translate_sse2_create(key);
+#else
+      return NULL;
+#endif
+   default:
+      return NULL;
+   }
+}
+
+
+/**
+ * Element i reads buffer i, and the instance id is appended as the last
+ * element, in the same raw format draw uses.
+ */
+static void
+build_key(const struct test_case *test, struct translate_key *key)
+{
+   unsigned offset = 0;
+
+   memset(key, 0, sizeof(*key));
+
+   for (unsigned i = 0; i < test->nr_elements; i++) {
+      struct translate_element *element = &key->element[i];
+
+      element->type = TRANSLATE_ELEMENT_NORMAL;
+      element->input_format = test->elements[i].input_format;
+      element->output_format = test->elements[i].output_format;
+      element->input_buffer = i;
+      element->input_offset = 4;
+      element->instance_divisor = test->elements[i].instance_divisor;
+      element->output_offset = offset;
+
+      offset += util_format_get_blocksize(element->output_format);
+   }
+
+   struct translate_element *element = &key->element[test->nr_elements];
+   element->type = TRANSLATE_ELEMENT_INSTANCE_ID;
+   element->input_format = PIPE_FORMAT_R32_USCALED;
+   element->output_format = PIPE_FORMAT_R32_USCALED;
+   element->output_offset = offset;
+   offset += 4;
+
+   key->nr_elements = test->nr_elements + 1;
+   key->output_stride = offset;
+}
+
+
+static unsigned
+input_stride(enum pipe_format format)
+{
+   /* Leave a gap between the vertices and misalign them. */
+   return align(util_format_get_blocksize(format) + 8, 4) + 4;
+}
+
+
+/**
+ * Random vertex data which packs exactly, so that all backends see the same
+ * values.
+ */
+static void *
+create_input(const struct test_element *element)
+{
+   const struct util_format_description *desc =
+      util_format_description(element->input_format);
+   unsigned stride = input_stride(element->input_format);
+   uint8_t *data = CALLOC(NUM_VERTICES + 1, stride);
+
+   if (!data)
+      return NULL;
+
+   for (unsigned v = 0; v < NUM_VERTICES; v++) {
+      uint8_t *dst = data + 4 + v * stride;
+
+      if (desc->channel[0].pure_integer) {
+         int32_t values[4];
+         for (unsigned c = 0; c < 4; c++)
+            values[c] = (rand() & 0xffff) - 0x8000;
+         util_format_pack_rgba(element->input_format, dst, values, 1);
+      } else {
+         float values[4];
+         for (unsigned c = 0; c < 4; c++) {
+            values[c] = (float)rand() / RAND_MAX * 4.0f - 2.0f;
+            /*
+             * The C half float fallback flushes denormals when DAZ is
+             * enabled, so keep the values away from them.
+             */
+            if (fabsf(values[c]) < 1.0f / 1024)
+               values[c] = 0.0f;
+         }
+         util_format_pack_rgba(element->input_format, dst, values, 1);
+      }
+   }
+
+   return data;
+}
+
+
+static bool
+compare_output(const struct translate_key *key,
+               const uint8_t *ref, const uint8_t *res,
+               unsigned count)
+{
+   for (unsigned v = 0; v < count; v++) {
+      for (unsigned i = 0; i < key->nr_elements; i++) {
+         const struct translate_element *element = &key->element[i];
+         const struct util_format_description *desc =
+            util_format_description(element->output_format);
+         unsigned offset = v * key->output_stride + element->output_offset;
+         unsigned size = desc->block.bits / 8;
+
+         if (!memcmp(ref + offset, res + offset, size))
+            continue;
+
+         /* Conversions to float may round differently in the last bit. */
+         if (desc->channel[0].type != UTIL_FORMAT_TYPE_FLOAT ||
+             desc->channel[0].size != 32)
+            return false;
+
+         for (unsigned c = 0; c < size / 4; c++) {
+            float a, b;
+            memcpy(&a, ref + offset + 4 * c, 4);
+            memcpy(&b, res + offset + 4 * c, 4);
+            if (fabsf(a - b) > 1e-6f * MAX2(1.0f, fabsf(a)))
+               return false;
+         }
+      }
+   }
+
+   return true;
+}
+
+
+static void
+set_buffers(struct translate *translate, const struct test_case *test,
+            void **inputs, unsigned max_index)
+{
+   for (unsigned i = 0; i < test->nr_elements; i++) {
+      translate->set_buffer(translate, i, inputs[i],
+                            input_stride(test->elements[i].input_format),
+                            max_index);
+   }
+}
+
+
+static void
+run_translate(struct translate *translate, unsigned mode,
+              const uint32_t *elts32, const uint16_t *elts16,
+              const uint8_t *elts8, void *output)
+{
+   switch (mode) {
+   case 0:
+      translate->run(translate, 7, NUM_INDICES / 2, 2, 5, output);
+      break;
+   case 1:
+      translate->run_elts(translate, elts32, NUM_INDICES, 1, 7, output);
+      break;
+   case 2:
+      translate->run_elts16(translate, elts16, NUM_INDICES, 0, 3, output);
+      break;
+   case 3:
+      translate->run_elts8(translate, elts8, NUM_INDICES, 4, 0, output);
+      break;
+   }
+}
+
+
+static double
+bench_translate(struct translate *translate, void *output)
+{
+   uint64_t verts = 0;
+   int64_t start = os_time_get_nano();
+   int64_t end;
+
+   do {
+      translate->run(translate, 0, NUM_VERTICES, 0, 0, output);
+      verts += NUM_VERTICES;
+      end = os_time_get_nano();
+   } while (end - start < BENCH_TIME_NS);
+
+   return verts / ((end - start) / 1e3);
+}
+
+
+static bool
+test_one(unsigned verbose, FILE *fp, const struct test_case *test)
+{
+   struct translate_key key;
+   struct translate *translates[TEST_BACKEND_COUNT] = {0};
+   void *inputs[4] = {0};
+   uint32_t *elts32 = MALLOC(NUM_INDICES * sizeof(uint32_t));
+   uint16_t *elts16 = MALLOC(NUM_INDICES * sizeof(uint16_t));
+   uint8_t *elts8 = MALLOC(NUM_INDICES * sizeof(uint8_t));
+   uint8_t *ref = NULL, *res = NULL;
+   bool success = true;
+
+   if (verbose >= 1)
+      fprintf(stderr, "%s ...\n", test->name);
+
+   build_key(test, &key);
+
+   unsigned output_size = NUM_VERTICES * key.output_stride;
+   ref = MALLOC(output_size);
+   res = MALLOC(output_size);
+   if (!elts32 || !elts16 || !elts8 || !ref || !res) {
+      success = false;
+      goto out;
+   }
+
+   for (unsigned i = 0; i < test->nr_elements; i++) {
+      inputs[i] = create_input(&test->elements[i]);
+      if (!inputs[i]) {
+         success = false;
+         goto out;
+      }
+   }
+
+   /* Some of the indices are past max_index and have to be clamped. */
+   unsigned max_index = NUM_VERTICES - 1 - 64;
+   for (unsigned i = 0; i < NUM_INDICES; i++) {
+      elts32[i] = (i & 63) == 5 ? 0xffffff00 + (i & 0xff) : rand() % NUM_VERTICES;
+      elts16[i] = rand() % NUM_VERTICES;
+      elts8[i] = rand() & 0xff;
+   }
+
+   for (unsigned b = 0; b < TEST_BACKEND_COUNT; b++) {
+      translates[b] = create_translate(b, &key);
+      if (translates[b])
+         set_buffers(translates[b], test, inputs, max_index);
+      else if (b == TEST_BACKEND_LLVM) {
+         fprintf(stderr, "  %s: no llvm translate\n", test->name);
+         success = false;
+      }
+   }
+
+   if (!translates[TEST_BACKEND_GENERIC]) {
+      success = false;
+      goto out;
+   }
+
+   for (unsigned mode = 0; mode < 4; mode++) {
+      memset(ref, 0xcd, output_size);
+      run_translate(translates[TEST_BACKEND_GENERIC], mode,
+                    elts32, elts16, elts8, ref);
+
+      for (unsigned b = TEST_BACKEND_GENERIC + 1; b < TEST_BACKEND_COUNT; b++) {
+         if (!translates[b])
+            continue;
+
+         memset(res, 0xcd, output_size);
+         run_translate(translates[b], mode, elts32, elts16, elts8, res);
+
+         if (!compare_output(&key, ref, res, NUM_INDICES)) {
+            fprintf(stderr, "  %s: %s MISMATCH in mode %u\n",
+                    test->name, backend_names[b], mode);
+            success = false;
+         }
+      }
+   }
+
+   for (unsigned b = 0; b < TEST_BACKEND_COUNT; b++) {
+      if (!translates[b])
+         continue;
+
+      double mverts = bench_translate(translates[b], res);
+
+      if (verbose >= 1)
+         fprintf(stderr, "  %s: %.2f Mvertices/s\n", backend_names[b], mverts);
+
+      if (fp)
+         write_tsv_row(fp, test, b, mverts, success);
+   }
+
+out:
+   for (unsigned b = 0; b < TEST_BACKEND_COUNT; b++) {
+      if (translates[b])
+         translates[b]->release(translates[b]);
+   }
+   for (unsigned i = 0; i < ARRAY_SIZE(inputs); i++)
+      FREE(inputs[i]);
+   FREE(elts32);
+   FREE(elts16);
+   FREE(elts8);
+   FREE(ref);
+   FREE(res);
+
+   return success;
+}
+
+
+bool
+test_all(unsigned verbose, FILE *fp)
+{
+   bool success = true;
+
+   for (unsigned i = 0; i < ARRAY_SIZE(test_cases); i++) {
+      if (!test_one(verbose, fp, &test_cases[i]))
+         success = false;
+   }
+
+   return success;
+}
+
+
+bool
+test_some(unsigned verbose, FILE *fp,
+          unsigned long n)
+{
+   return test_all(verbose, fp);
+}
+
+
+bool
+test_single(unsigned verbose, FILE *fp)
+{
+   return test_one(verbose, fp, &test_cases[ARRAY_SIZE(test_cases) - 1]);
+}
@@ -42,8 +42,11 @@
 
 #include "pipe/p_defines.h"
 #include "pipe/p_shader_tokens.h"
+#include "util/u_debug.h"
+#include "util/u_math.h"
 #include "gallivm/lp_bld_debug.h"
 #include "gallivm/lp_bld_const.h"
+#include "gallivm/lp_bld_format.h"
 #include "gallivm/lp_bld_type.h"
 #include "gallivm/lp_bld_sample.h"
 #include "gallivm/lp_bld_tgsi.h"
@@ -53,7 +56,22 @@
 #include "lp_debug.h"
 
 
-#if LP_USE_TEXTURE_CACHE
+/* The decoded block cache is an experiment, off by default: there are no
+ * hit rate or benchmark numbers yet which would justify enabling it.  See
+ * LP_DEBUG=counters for the former.
+ */
+DEBUG_GET_ONCE_NUM_OPTION(texture_cache_blocks, "LP_TEXTURE_CACHE_BLOCKS", 0)
+
+
+unsigned
+lp_texture_cache_blocks(void)
+{
+   int64_t blocks = debug_get_option_texture_cache_blocks();
+
+   return blocks > 0 ? util_next_power_of_two(MIN2(blocks, 1 << 16)) : 0;
+}
+
+
 static LLVMValueRef
 lp_llvm_texture_cache_ptr(struct gallivm_state *gallivm,
                           LLVMTypeRef thread_data_type,
@@ -65,7 +83,7 @@ lp_llvm_texture_cache_ptr(struct gallivm_state *gallivm,
 
    return lp_jit_thread_data_cache(gallivm, thread_data_type, thread_data_ptr);
 }
-#endif
+
 struct lp_build_sampler_soa *
 lp_llvm_sampler_soa_create(const struct lp_sampler_static_state *static_state,
                            unsigned nr_samplers)
@@ -74,10 +92,10 @@ lp_llvm_sampler_soa_create(const struct lp_sampler_static_state *static_state,
 
    sampler = lp_bld_llvm_sampler_soa_create(static_state, nr_samplers);
 
-#if LP_USE_TEXTURE_CACHE
-   struct lp_sampler_dynamic_state *dynamic_state = lp_build_sampler_soa_dynamic_state(sampler);
-   dynamic_state->cache_ptr = lp_llvm_texture_cache_ptr;
-#endif
+   if (lp_texture_cache_blocks()) {
+      struct lp_sampler_dynamic_state *dynamic_state = lp_build_sampler_soa_dynamic_state(sampler);
+      dynamic_state->cache_ptr = lp_llvm_texture_cache_ptr;
+   }
    return sampler;
 }
 
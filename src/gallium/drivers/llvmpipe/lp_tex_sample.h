@@ -33,10 +33,13 @@
 
 struct lp_build_sampler_soa;
 struct lp_sampler_static_state;
+
 /**
- * Whether texture cache is used for s3tc textures.
+ * Number of decoded blocks in each thread's texture block cache, used for
+ * fetches from block compressed textures.  Zero if the cache is disabled.
  */
-#define LP_USE_TEXTURE_CACHE 0
+unsigned
+lp_texture_cache_blocks(void);
 
 struct lp_build_sampler_soa *
 lp_llvm_sampler_soa_create(const struct lp_sampler_static_state *static_state,
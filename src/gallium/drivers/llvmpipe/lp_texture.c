@@ -56,6 +56,7 @@
 #include "lp_setup.h"
 #include "lp_state.h"
 #include "lp_rast.h"
+#include "gallivm/lp_bld_sample.h"
 
 #include "frontend/sw_winsys.h"
 #include "git_sha1.h"
@@ -85,6 +86,17 @@ static const char *driver_id = "llvmpipe" MESA_GIT_SHA1;
 
 #endif
 
+/**
+ * Is the resource stored in LP_MICRO_TILE_SIZE^2 texel tiles?  Such
+ * resources are only ever sampled; CPU access goes through a staging copy.
+ */
+static inline bool
+llvmpipe_resource_is_micro_tiled(const struct pipe_resource *resource)
+{
+   return !!(resource->flags & LP_RESOURCE_FLAG_MICRO_TILED);
+}
+
+
 /**
  * Conventional allocation path for non-display textures:
  * Compute strides and allocate data (unless asked not to).
@@ -183,11 +195,18 @@ llvmpipe_texture_layout(struct llvmpipe_screen *screen,
          align_z = MAX2(align_z, sparse_tile_size[2]);
       }
 
-      if (util_format_is_compressed(pt->format))
+      if (util_format_is_compressed(pt->format)) {
          lpr->row_stride[level] = nblocksx * block_size;
-      else
+      } else if (llvmpipe_resource_is_micro_tiled(pt)) {
+         /* The stride is between rows of tiles */
+         nblocksy = align(nblocksy, LP_MICRO_TILE_SIZE) / LP_MICRO_TILE_SIZE;
+         lpr->row_stride[level] = align(nblocksx * block_size *
+                                        LP_MICRO_TILE_SIZE,
+                                        util_get_cpu_caps()->cacheline);
+      } else {
          lpr->row_stride[level] = align(nblocksx * block_size,
                                         util_get_cpu_caps()->cacheline);
+      }
 
       lpr->img_stride[level] = (uint64_t)lpr->row_stride[level] * nblocksy;
 
@@ -263,6 +282,53 @@ llvmpipe_can_create_resource(struct pipe_screen *screen,
 }
 
 
+/**
+ * Can the texture be stored micro tiled?  Only textures which are never
+ * rendered to, written by shaders or mapped persistently qualify, as
+ * everything except the sampler and transfers assumes a linear layout.
+ */
+static bool
+llvmpipe_can_micro_tile(const struct llvmpipe_screen *screen,
+                        const struct pipe_resource *templat)
+{
+   const struct util_format_description *desc =
+      util_format_description(templat->format);
+
+   if (!screen->tiled_textures)
+      return false;
+
+   if (templat->bind & ~PIPE_BIND_SAMPLER_VIEW)
+      return false;
+
+   if (templat->flags & (PIPE_RESOURCE_FLAG_SPARSE |
+                         PIPE_RESOURCE_FLAG_MAP_PERSISTENT |
+                         PIPE_RESOURCE_FLAG_MAP_COHERENT))
+      return false;
+
+   if (templat->nr_samples > 1)
+      return false;
+
+   switch (templat->target) {
+   case PIPE_TEXTURE_2D:
+   case PIPE_TEXTURE_2D_ARRAY:
+   case PIPE_TEXTURE_RECT:
+   case PIPE_TEXTURE_3D:
+   case PIPE_TEXTURE_CUBE:
+   case PIPE_TEXTURE_CUBE_ARRAY:
+      break;
+   default:
+      return false;
+   }
+
+   return desc &&
+          desc->layout == UTIL_FORMAT_LAYOUT_PLAIN &&
+          desc->block.width == 1 &&
+          desc->block.height == 1 &&
+          desc->block.depth == 1 &&
+          desc->block.bits % 8 == 0;
+}
+
+
 static bool
 llvmpipe_displaytarget_layout(struct llvmpipe_screen *screen,
                               struct llvmpipe_resource *lpr,
@@ -288,6 +354,27 @@ llvmpipe_displaytarget_layout(struct llvmpipe_screen *screen,
 }
 
 
+/**
+ * Initialize the threaded_context part of a new resource.  The storage of
+ * shared resources and user memory can't be replaced.
+ */
+static void
+llvmpipe_resource_init_threaded(struct llvmpipe_screen *screen,
+                                struct llvmpipe_resource *lpr,
+                                bool shared)
+{
+   /* Buffers live in CPU memory already, so there's no point in also
+    * letting threaded_context keep a copy.
+    */
+   threaded_resource_init(&lpr->base, false);
+   lpr->tres.is_shared = shared;
+   lpr->tres.is_user_ptr = lpr->user_ptr;
+
+   if (lpr->base.target == PIPE_BUFFER)
+      lpr->tres.buffer_id_unique = util_idalloc_mt_alloc(&screen->buffer_ids);
+}
+
+
 static struct pipe_resource *
 llvmpipe_resource_create_all(struct pipe_screen *_screen,
                              const struct pipe_resource *templat,
@@ -319,6 +406,9 @@ llvmpipe_resource_create_all(struct pipe_screen *_screen,
             goto fail;
       } else {
          /* texture map */
+         if (alloc_backing && llvmpipe_can_micro_tile(screen, templat))
+            lpr->base.flags |= LP_RESOURCE_FLAG_MICRO_TILED;
+
          if (!llvmpipe_texture_layout(screen, lpr, alloc_backing))
             goto fail;
 
@@ -380,6 +470,10 @@ llvmpipe_resource_create_all(struct pipe_screen *_screen,
 
    lpr->id = id_counter++;
 
+   llvmpipe_resource_init_threaded(screen, lpr,
+                                   !alloc_backing ||
+                                   (templat->bind & PIPE_BIND_SHARED));
+
 #if MESA_DEBUG
    simple_mtx_lock(&resource_list_mutex);
    list_addtail(&lpr->list, &resource_list.list);
@@ -547,6 +641,8 @@ llvmpipe_resource_from_memobj(struct pipe_screen *pscreen,
    lpr->imported_memory = &lpmo->b;
    pipe_reference(NULL, &lpmo->reference);
 
+   llvmpipe_resource_init_threaded(screen, lpr, true);
+
 #if MESA_DEBUG
    simple_mtx_lock(&resource_list_mutex);
    list_addtail(&lpr->list, &resource_list.list);
@@ -567,7 +663,12 @@ llvmpipe_resource_destroy(struct pipe_screen *pscreen,
    struct llvmpipe_screen *screen = llvmpipe_screen(pscreen);
    struct llvmpipe_resource *lpr = llvmpipe_resource(pt);
 
-   if (!lpr->backable && !lpr->user_ptr) {
+   threaded_resource_deinit(pt);
+
+   if (pt->target == PIPE_BUFFER)
+      util_idalloc_mt_free(&screen->buffer_ids, lpr->tres.buffer_id_unique);
+
+   if (!lpr->backable && !lpr->user_ptr && !lpr->storage_user) {
       if (lpr->dt) {
          /* display target */
          struct sw_winsys *winsys = screen->winsys;
@@ -607,6 +708,10 @@ llvmpipe_resource_destroy(struct pipe_screen *pscreen,
 #endif
    }
 
+   util_dynarray_foreach(&lpr->retired_data, void *, data)
+      align_free(*data);
+   util_dynarray_fini(&lpr->retired_data);
+
    free(lpr->residency);
 
 #if MESA_DEBUG
@@ -795,6 +900,8 @@ llvmpipe_resource_from_handle(struct pipe_screen *_screen,
 
    lpr->id = id_counter++;
 
+   llvmpipe_resource_init_threaded(screen, lpr, true);
+
 #if MESA_DEBUG
    simple_mtx_lock(&resource_list_mutex);
    list_addtail(&lpr->list, &resource_list.list);
@@ -845,6 +952,7 @@ llvmpipe_resource_get_handle(struct pipe_screen *_screen,
             lpr->data = lpr->dmabuf_alloc->cpu_addr;
          /* reuse lavapipe codepath to handle destruction */
          lpr->backable = true;
+         lpr->tres.is_shared = true;
       } else {
          whandle->handle = os_dupfd_cloexec(lpr->dmabuf_alloc->dmabuf_fd);
       }
@@ -893,6 +1001,7 @@ llvmpipe_resource_from_user_memory(struct pipe_screen *_screen,
    } else
       lpr->data = user_memory;
    lpr->user_ptr = true;
+   llvmpipe_resource_init_threaded(screen, lpr, false);
 #if MESA_DEBUG
    simple_mtx_lock(&resource_list_mutex);
    list_addtail(&lpr->list, &resource_list.list);
@@ -905,6 +1014,79 @@ fail:
 }
 
 
+/**
+ * Copy a box of texels between a micro tiled texture level and a linear
+ * staging buffer, in whichever direction.
+ */
+static void
+llvmpipe_micro_tile_copy(struct llvmpipe_resource *lpr,
+                         unsigned level,
+                         const struct pipe_box *box,
+                         uint8_t *linear,
+                         unsigned stride,
+                         uint64_t layer_stride,
+                         bool to_tiled)
+{
+   const unsigned tile = LP_MICRO_TILE_SIZE;
+   const unsigned cpp = util_format_get_blocksize(lpr->base.format);
+   uint8_t *tiled = (uint8_t *)lpr->tex_data + lpr->mip_offsets[level];
+
+   for (unsigned z = 0; z < box->depth; z++) {
+      uint8_t *tiled_img = tiled + (box->z + z) * lpr->img_stride[level];
+
+      for (unsigned y = 0; y < box->height; y++) {
+         const unsigned ty = box->y + y;
+         uint8_t *tiled_row = tiled_img + (ty / tile) * lpr->row_stride[level] +
+                              (ty % tile) * tile * cpp;
+         uint8_t *linear_row = linear + z * layer_stride + y * stride;
+         const unsigned x_end = box->x + box->width;
+
+         /* Copy runs of texels up to the next tile boundary */
+         for (unsigned x = box->x; x < x_end; ) {
+            const unsigned n = MIN2(tile - x % tile, x_end - x);
+            uint8_t *t = tiled_row + (x / tile) * tile * tile * cpp +
+                         (x % tile) * cpp;
+            uint8_t *l = linear_row + (x - box->x) * cpp;
+
+            if (to_tiled)
+               memcpy(t, l, n * cpp);
+            else
+               memcpy(l, t, n * cpp);
+            x += n;
+         }
+      }
+   }
+}
+
+
+/**
+ * Mark the fragment shader constants dirty when a bound constant buffer is
+ * written.  The storage is compared as threaded_context maps the latest
+ * storage of a buffer through the buffer which provided it.
+ */
+static void
+llvmpipe_check_constant_buffer_write(struct llvmpipe_context *llvmpipe,
+                                     struct pipe_resource *resource)
+{
+   if (!(resource->bind & PIPE_BIND_CONSTANT_BUFFER))
+      return;
+
+   const void *data = llvmpipe_resource(resource)->data;
+
+   for (unsigned i = 0; i < ARRAY_SIZE(llvmpipe->constants[PIPE_SHADER_FRAGMENT]); ++i) {
+      struct pipe_resource *buffer =
+         llvmpipe->constants[PIPE_SHADER_FRAGMENT][i].buffer;
+
+      if (buffer == resource ||
+          (buffer && data && llvmpipe_resource(buffer)->data == data)) {
+         /* constants may have changed */
+         llvmpipe->dirty |= LP_NEW_FS_CONSTANTS;
+         break;
+      }
+   }
+}
+
+
 void *
 llvmpipe_transfer_map_ms(struct pipe_context *pipe,
                          struct pipe_resource *resource,
@@ -946,18 +1128,13 @@ llvmpipe_transfer_map_ms(struct pipe_context *pipe,
       }
    }
 
-   /* Check if we're mapping a current constant buffer */
+   /* Check if we're mapping a current constant buffer.  Unsynchronized
+    * maps from threaded_context don't run on the driver thread, those are
+    * checked on unmap instead.
+    */
    if ((usage & PIPE_MAP_WRITE) &&
-       (resource->bind & PIPE_BIND_CONSTANT_BUFFER)) {
-      unsigned i;
-      for (i = 0; i < ARRAY_SIZE(llvmpipe->constants[PIPE_SHADER_FRAGMENT]); ++i) {
-         if (resource == llvmpipe->constants[PIPE_SHADER_FRAGMENT][i].buffer) {
-            /* constants may have changed */
-            llvmpipe->dirty |= LP_NEW_FS_CONSTANTS;
-            break;
-         }
-      }
-   }
+       !(usage & TC_TRANSFER_MAP_THREADED_UNSYNC))
+      llvmpipe_check_constant_buffer_write(llvmpipe, resource);
 
    lpt = CALLOC_STRUCT(llvmpipe_transfer);
    if (!lpt)
@@ -1041,6 +1218,36 @@ llvmpipe_transfer_map_ms(struct pipe_context *pipe,
       return lpt->map;
    }
 
+   if (llvmpipe_resource_is_micro_tiled(resource)) {
+      /* Hand out a linear staging copy, retiled on unmap */
+      map = llvmpipe_resource_map(resource, 0, 0, tex_usage);
+      if (!map)
+         return NULL;
+
+      pt->stride = box->width * util_format_get_blocksize(format);
+      pt->layer_stride = (uint64_t)pt->stride * box->height;
+
+      lpt->map = malloc(pt->layer_stride * box->depth);
+      if (!lpt->map) {
+         pipe_resource_reference(&pt->resource, NULL);
+         FREE(lpt);
+         *transfer = NULL;
+         return NULL;
+      }
+
+      if ((usage & PIPE_MAP_READ) ||
+          !(usage & (PIPE_MAP_DISCARD_RANGE |
+                     PIPE_MAP_DISCARD_WHOLE_RESOURCE))) {
+         llvmpipe_micro_tile_copy(lpr, level, box, lpt->map,
+                                  pt->stride, pt->layer_stride, false);
+      }
+
+      if (usage & PIPE_MAP_WRITE)
+         screen->timestamp++;
+
+      return lpt->map;
+   }
+
    map = llvmpipe_resource_map(resource, level, box->z, tex_usage);
    if (!map)
       return NULL;
@@ -1161,6 +1368,17 @@ llvmpipe_transfer_unmap(struct pipe_context *pipe,
       }
    }
 
+   if (llvmpipe_resource_is_micro_tiled(resource) &&
+       (transfer->usage & PIPE_MAP_WRITE)) {
+      llvmpipe_micro_tile_copy(lpr, transfer->level, &transfer->box,
+                               lpt->map, transfer->stride,
+                               transfer->layer_stride, true);
+   }
+
+   if ((transfer->usage & PIPE_MAP_WRITE) &&
+       (transfer->usage & TC_TRANSFER_MAP_THREADED_UNSYNC))
+      llvmpipe_check_constant_buffer_write(llvmpipe_context(pipe), resource);
+
    llvmpipe_resource_unmap(resource,
                            transfer->level,
                            transfer->box.z);
@@ -1189,6 +1407,87 @@ llvmpipe_is_resource_referenced(struct pipe_context *pipe,
 }
 
 
+static inline bool
+llvmpipe_resource_busy_in_scenes(struct llvmpipe_resource *lpr,
+                                 unsigned usage)
+{
+   /* Reads only have to wait for scenes writing the resource. */
+   if (!(usage & PIPE_MAP_WRITE))
+      return p_atomic_read(&lpr->scene_writes) != 0;
+
+   return p_atomic_read(&lpr->scene_refs) != 0;
+}
+
+
+/**
+ * threaded_context callback, may be called from any thread.  Work which
+ * hasn't been flushed yet is tracked by threaded_context itself, so this
+ * only has to look at the scenes.
+ */
+bool
+llvmpipe_is_resource_busy(struct pipe_screen *screen,
+                          struct pipe_resource *resource,
+                          unsigned usage)
+{
+   struct llvmpipe_resource *lpr = llvmpipe_resource(resource);
+   struct llvmpipe_resource *user = p_atomic_read(&lpr->storage_user);
+
+   /* Scenes reference the buffer the storage was moved to. */
+   if (user && llvmpipe_resource_busy_in_scenes(user, usage))
+      return true;
+
+   return llvmpipe_resource_busy_in_scenes(lpr, usage);
+}
+
+
+/**
+ * threaded_context buffer invalidation: move the storage of src, which is
+ * a new buffer, into dst.  src keeps pointing at the storage since
+ * threaded_context maps it through src.  The previous storage of dst is
+ * freed once the scenes binned so far are done with it.
+ *
+ * Only this context is rebound, other contexts may have the previous
+ * storage in their bound state until they bind dst again.  If there are
+ * any, keep it as long as dst lives and make threaded_context treat dst as
+ * shared, so that it isn't invalidated again.
+ */
+void
+llvmpipe_replace_buffer_storage(struct pipe_context *pipe,
+                                struct pipe_resource *dst,
+                                struct pipe_resource *src,
+                                unsigned num_rebinds,
+                                uint32_t rebind_mask,
+                                uint32_t delete_buffer_id)
+{
+   struct llvmpipe_context *llvmpipe = llvmpipe_context(pipe);
+   struct llvmpipe_screen *screen = llvmpipe_screen(pipe->screen);
+   struct llvmpipe_resource *lp_dst = llvmpipe_resource(dst);
+   struct llvmpipe_resource *lp_src = llvmpipe_resource(src);
+
+   assert(dst->target == PIPE_BUFFER && src->target == PIPE_BUFFER);
+   assert(!lp_dst->backable && !lp_dst->user_ptr && !lp_dst->imported_memory);
+   assert(!lp_src->storage_user);
+
+   util_idalloc_mt_free(&screen->buffer_ids, delete_buffer_id);
+
+   void *old_data = lp_dst->data;
+
+   lp_dst->data = lp_src->data;
+   p_atomic_set(&lp_src->storage_user, lp_dst);
+
+   mtx_lock(&screen->ctx_mutex);
+   if (list_is_singular(&screen->ctx_list)) {
+      lp_setup_free_after_scenes(llvmpipe->setup, old_data);
+   } else {
+      util_dynarray_append(&lp_dst->retired_data, void *, old_data);
+      lp_dst->tres.is_shared = true;
+   }
+   mtx_unlock(&screen->ctx_mutex);
+
+   llvmpipe_rebind_buffer(llvmpipe, dst);
+}
+
+
 /**
  * Returns the largest possible alignment for a format in llvmpipe
  */
@@ -1245,6 +1544,7 @@ llvmpipe_user_buffer_create(struct pipe_screen *screen,
    buffer->base.array_size = 1;
    buffer->user_ptr = true;
    buffer->data = ptr;
+   llvmpipe_resource_init_threaded(buffer->screen, buffer, false);
 
    return &buffer->base;
 }
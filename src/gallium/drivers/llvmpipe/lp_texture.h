@@ -31,6 +31,8 @@
 
 #include "pipe/p_state.h"
 #include "util/u_debug.h"
+#include "util/u_dynarray.h"
+#include "util/u_threaded_context.h"
 #include "lp_limits.h"
 #include "util/bitset.h"
 #if MESA_DEBUG
@@ -68,7 +70,10 @@ struct sw_displaytarget;
  */
 struct llvmpipe_resource
 {
-   struct pipe_resource base;
+   union {
+      struct pipe_resource base;
+      struct threaded_resource tres;
+   };
 
    /** an extra screen pointer to avoid crashing in driver trace */
    struct llvmpipe_screen *screen;
@@ -102,6 +107,26 @@ struct llvmpipe_resource
    void *data;
 
    bool user_ptr;  /** Is this a user-space buffer? */
+
+   /**
+    * The buffer threaded_context moved this buffer's storage to, which
+    * owns data from then on.
+    */
+   struct llvmpipe_resource *storage_user;
+
+   /**
+    * Storage replaced while other contexts existed, which may still point
+    * at it.  Freed with the resource.
+    */
+   struct util_dynarray retired_data;
+
+   /**
+    * Number of scenes referencing the resource which haven't finished
+    * rasterization yet, and how many of them may write it.
+    */
+   unsigned scene_refs;
+   unsigned scene_writes;
+
    unsigned timestamp;
 
    unsigned id;  /**< temporary, for debugging */
@@ -124,7 +149,10 @@ struct llvmpipe_resource
 
 struct llvmpipe_transfer
 {
-   struct pipe_transfer base;
+   union {
+      struct pipe_transfer base;
+      struct threaded_transfer ttrans;
+   };
    void *map;
    struct pipe_box block_box;
 };
@@ -293,6 +321,19 @@ llvmpipe_is_resource_referenced(struct pipe_context *pipe,
                                 struct pipe_resource *presource,
                                 unsigned level);
 
+bool
+llvmpipe_is_resource_busy(struct pipe_screen *screen,
+                          struct pipe_resource *resource,
+                          unsigned usage);
+
+void
+llvmpipe_replace_buffer_storage(struct pipe_context *pipe,
+                                struct pipe_resource *dst,
+                                struct pipe_resource *src,
+                                unsigned num_rebinds,
+                                uint32_t rebind_mask,
+                                uint32_t delete_buffer_id);
+
 unsigned
 llvmpipe_get_format_alignment(enum pipe_format format);
 
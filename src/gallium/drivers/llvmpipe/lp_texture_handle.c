@@ -296,7 +296,10 @@ compile_function(struct llvmpipe_context *ctx, struct gallivm_state *gallivm, LL
                  uint8_t cache_key[SHA1_DIGEST_LENGTH])
 {
    gallivm_verify_function(gallivm, function);
-   gallivm_compile_module(gallivm);
+   if (!gallivm_compile_module(gallivm)) {
+      gallivm_destroy(gallivm);
+      return NULL;
+   }
 
    void *function_ptr = func_to_pointer(gallivm_jit_function(gallivm, function, func_name));
 
@@ -6,8 +6,10 @@
 #include "lvp_acceleration_structure.h"
 #include "lvp_entrypoints.h"
 
+#include "radix_sort/radix_sort_host.h"
 #include "radix_sort/radix_sort_u64.h"
 #include "bvh/vk_bvh.h"
+#include "util/format/u_format.h"
 
 struct radix_sort_vk_target_config lvp_radix_sort_config = {
    .keyval_dwords = 2,
@@ -35,6 +37,34 @@ struct radix_sort_vk_target_config lvp_radix_sort_config = {
    .nonsequential_dispatch = true,
 };
 
+static void
+lvp_cmd_sort_host(VkCommandBuffer cmdbuf, const struct radix_sort_host_info *info)
+{
+   VK_FROM_HANDLE(lvp_cmd_buffer, cmd_buffer, cmdbuf);
+
+   struct vk_cmd_queue_entry *entry =
+      vk_zalloc(cmd_buffer->vk.cmd_queue.alloc, sizeof(struct vk_cmd_queue_entry),
+                8, VK_SYSTEM_ALLOCATION_SCOPE_OBJECT);
+   if (!entry)
+      return;
+
+   entry->type = LVP_CMD_RADIX_SORT;
+
+   struct radix_sort_host_info *cmd =
+      vk_zalloc(cmd_buffer->vk.cmd_queue.alloc, sizeof(struct radix_sort_host_info),
+                8, VK_SYSTEM_ALLOCATION_SCOPE_OBJECT);
+   if (!cmd) {
+      vk_free(cmd_buffer->vk.cmd_queue.alloc, entry);
+      return;
+   }
+
+   *cmd = *info;
+
+   entry->driver_data = cmd;
+
+   list_addtail(&entry->cmd_link, &cmd_buffer->vk.cmd_queue.cmds);
+}
+
 static void
 lvp_init_radix_sort(struct lvp_device *device)
 {
@@ -44,10 +74,8 @@ lvp_init_radix_sort(struct lvp_device *device)
       return;
    }
 
-   device->radix_sort =
-      vk_create_radix_sort_u64(lvp_device_to_handle(device),
-                               &device->vk.alloc, VK_NULL_HANDLE,
-                               lvp_radix_sort_config);
+   /* Sorting on the host is much faster than emulating the sort shaders. */
+   device->radix_sort = vk_create_radix_sort_u64_host(lvp_cmd_sort_host, lvp_radix_sort_config);
 
    device->accel_struct_args.radix_sort = device->radix_sort;
 
@@ -180,6 +208,17 @@ lvp_enqueue_encode_as(VkCommandBuffer commandBuffer, const struct vk_acceleratio
    list_addtail(&entry->cmd_link, &cmd_buffer->vk.cmd_queue.cmds);
 }
 
+/* The binary tree built from the IR before it is collapsed into
+ * lvp_bvh_box_node, with the same size so that node offsets match.
+ */
+struct lvp_bvh_binary_node {
+   vk_aabb bounds[2];
+   uint32_t children[2];
+};
+
+static_assert(sizeof(struct lvp_bvh_binary_node) == sizeof(struct lvp_bvh_box_node),
+              "binary and wide BVH nodes must have the same size");
+
 static uint32_t
 ir_id_to_offset(uint32_t id)
 {
@@ -207,7 +246,7 @@ lvp_select_subtrees_to_flatten(const struct vk_ir_header *header, const struct v
                                uint32_t index, struct util_dynarray *subtrees, uint32_t *max_subtree_size)
 {
    uint32_t depth = node_depth[header->ir_internal_node_count - index - 1];
-   uint32_t available_depth = 23 - depth;
+   uint32_t available_depth = LVP_BVH_MAX_DEPTH - 1 - depth;
    uint32_t allowed_child_count = 1 << available_depth;
    uint32_t child_count = child_counts[index];
    bool flatten = child_count > allowed_child_count;
@@ -244,7 +283,7 @@ lvp_gather_subtree(const uint8_t *output, uint32_t offset, uint32_t *leaf_nodes,
                    vk_aabb *leaf_bounds, uint32_t *leaf_node_count, uint32_t *internal_nodes,
                    uint32_t *internal_node_count)
 {
-   const struct lvp_bvh_box_node *node = (void *)(output + offset);
+   const struct lvp_bvh_binary_node *node = (void *)(output + offset);
 
    for (uint32_t child_index = 0; child_index < 2; child_index++) {
       if (node->children[child_index] == VK_BVH_INVALID_NODE)
@@ -289,14 +328,14 @@ lvp_rebuild_subtree(const uint8_t *output, uint32_t *leaf_nodes, vk_aabb *leaf_b
    child_nodes[1] = lvp_rebuild_subtree(output, leaf_nodes + split_index, leaf_bounds + split_index, internal_nodes,
                                         leaf_node_count - split_index, internal_node_index);
 
-   struct lvp_bvh_box_node *node = (void *)(output + ir_id_to_offset(node_id));
+   struct lvp_bvh_binary_node *node = (void *)(output + ir_id_to_offset(node_id));
 
    for (uint32_t i = 0; i < 2; i++) {
       node->children[i] = child_nodes[i];
 
       uint32_t type = child_nodes[i] & 3;
       if (type == lvp_bvh_node_internal) {
-         const struct lvp_bvh_box_node *child_node =
+         const struct lvp_bvh_binary_node *child_node =
             (void *)(output + ir_id_to_offset(child_nodes[i]));
          node->bounds[i].min.x = MIN2(child_node->bounds[0].min.x, child_node->bounds[1].min.x);
          node->bounds[i].min.y = MIN2(child_node->bounds[0].min.y, child_node->bounds[1].min.y);
@@ -362,7 +401,7 @@ lvp_flatten_as(const struct vk_ir_header *header, const struct vk_ir_box_node *i
 
    util_dynarray_foreach(&subtrees, uint32_t, root_index) {
       uint32_t offset = sizeof(struct lvp_bvh_header) +
-         (header->ir_internal_node_count - 1 - *root_index) * sizeof(struct lvp_bvh_box_node);
+         (header->ir_internal_node_count - 1 - *root_index) * sizeof(struct lvp_bvh_binary_node);
 
       internal_nodes[0] = offset | lvp_bvh_node_internal;
 
@@ -404,6 +443,188 @@ lvp_get_leaf_node_size(VkGeometryTypeKHR geometry_type, uint32_t *ir_leaf_node_s
    }
 }
 
+static void
+lvp_init_wto_matrix(struct lvp_bvh_instance_node *instance)
+{
+   float transform[16], inv_transform[16];
+   memcpy(transform, &instance->otw_matrix.values, sizeof(instance->otw_matrix.values));
+   transform[12] = transform[13] = transform[14] = 0.0f;
+   transform[15] = 1.0f;
+
+   util_invert_mat4x4(inv_transform, transform);
+   memcpy(instance->wto_matrix.values, inv_transform, sizeof(instance->wto_matrix.values));
+}
+
+static float
+vec3_component(const vec3 *v, uint32_t axis)
+{
+   return axis == 0 ? v->x : (axis == 1 ? v->y : v->z);
+}
+
+static float
+lvp_dequantize(float origin, uint32_t exponent, uint32_t q)
+{
+   return origin + (float)q * uif(exponent << 23);
+}
+
+/* Pick the smallest power of two cell size for which 255 cells cover
+ * [lo, hi] from lo.
+ */
+static uint32_t
+lvp_quantization_exponent(float lo, float hi)
+{
+   int e;
+   frexpf((hi - lo) / 255.0f, &e);
+
+   uint32_t exponent = CLAMP(e + 127, 1, 254);
+   while (exponent < 254 && lvp_dequantize(lo, exponent, 255) < hi)
+      exponent++;
+
+   return exponent;
+}
+
+static void
+lvp_encode_box_node(struct lvp_bvh_box_node *node, const uint32_t *children,
+                    const vk_aabb *bounds, uint32_t child_count)
+{
+   memset(node, 0, sizeof(*node));
+
+   for (uint32_t axis = 0; axis < 3; axis++) {
+      float origin = 0.0f, end = 0.0f;
+      for (uint32_t i = 0; i < child_count; i++) {
+         float lo = vec3_component(&bounds[i].min, axis);
+         float hi = vec3_component(&bounds[i].max, axis);
+         origin = i ? MIN2(origin, lo) : lo;
+         end = i ? MAX2(end, hi) : hi;
+      }
+
+      uint32_t exponent = lvp_quantization_exponent(origin, end);
+
+      node->origin[axis] = origin;
+      node->exponents[axis] = exponent;
+
+      for (uint32_t i = 0; i < child_count; i++) {
+         float scale = uif(exponent << 23);
+         float lo = vec3_component(&bounds[i].min, axis);
+         float hi = vec3_component(&bounds[i].max, axis);
+
+         /* Round outwards, also accounting for the rounding of the
+          * dequantization itself.
+          */
+         uint32_t qmin = CLAMP(floorf((lo - origin) / scale), 0.0f, 255.0f);
+         while (qmin > 0 && lvp_dequantize(origin, exponent, qmin) > lo)
+            qmin--;
+
+         uint32_t qmax = CLAMP(ceilf((hi - origin) / scale), 0.0f, 255.0f);
+         while (qmax < 255 && lvp_dequantize(origin, exponent, qmax) < hi)
+            qmax++;
+
+         node->min[axis][i] = qmin;
+         node->max[axis][i] = qmax;
+      }
+   }
+
+   for (uint32_t i = 0; i < LVP_BVH_NODE_WIDTH; i++)
+      node->children[i] = i < child_count ? children[i] : LVP_BVH_INVALID_NODE;
+}
+
+static float
+lvp_aabb_surface_area(const vk_aabb *aabb)
+{
+   float x = aabb->max.x - aabb->min.x;
+   float y = aabb->max.y - aabb->min.y;
+   float z = aabb->max.z - aabb->min.z;
+   return x * y + y * z + z * x;
+}
+
+/* Convert the binary tree to LVP_BVH_NODE_WIDTH wide nodes.  Every wide
+ * node starts out with the children of a binary node and then repeatedly
+ * pulls up the children of its largest internal child until it is full.
+ * Nodes are allocated in breadth first order starting with the root, so
+ * there are at most as many of them as binary nodes.
+ */
+static void
+lvp_collapse_as(const uint8_t *binary, uint32_t internal_node_count, uint8_t *output)
+{
+   uint32_t *sources = malloc(internal_node_count * sizeof(uint32_t));
+   if (!sources)
+      return;
+
+   sources[0] = LVP_BVH_ROOT_NODE;
+   uint32_t node_count = 1;
+
+   for (uint32_t index = 0; index < node_count; index++) {
+      uint32_t children[LVP_BVH_NODE_WIDTH];
+      vk_aabb bounds[LVP_BVH_NODE_WIDTH];
+      uint32_t child_count = 0;
+
+      const struct lvp_bvh_binary_node *src = (void *)(binary + ir_id_to_offset(sources[index]));
+      for (uint32_t i = 0; i < 2; i++) {
+         /* Leave out invalid children and inactive primitives, which have
+          * NaN bounds.
+          */
+         if (src->children[i] == LVP_BVH_INVALID_NODE ||
+             !(src->bounds[i].min.x <= src->bounds[i].max.x))
+            continue;
+
+         children[child_count] = src->children[i];
+         bounds[child_count] = src->bounds[i];
+         child_count++;
+      }
+
+      while (child_count < LVP_BVH_NODE_WIDTH) {
+         int largest = -1;
+         float largest_area = -1.0f;
+         for (uint32_t i = 0; i < child_count; i++) {
+            if ((children[i] & 3) != lvp_bvh_node_internal)
+               continue;
+
+            float area = lvp_aabb_surface_area(&bounds[i]);
+            if (area > largest_area) {
+               largest = i;
+               largest_area = area;
+            }
+         }
+
+         if (largest < 0)
+            break;
+
+         const struct lvp_bvh_binary_node *child =
+            (void *)(binary + ir_id_to_offset(children[largest]));
+
+         children[largest] = children[--child_count];
+         bounds[largest] = bounds[child_count];
+
+         for (uint32_t i = 0; i < 2; i++) {
+            if (child->children[i] == LVP_BVH_INVALID_NODE ||
+                !(child->bounds[i].min.x <= child->bounds[i].max.x))
+               continue;
+
+            children[child_count] = child->children[i];
+            bounds[child_count] = child->bounds[i];
+            child_count++;
+         }
+      }
+
+      for (uint32_t i = 0; i < child_count; i++) {
+         if ((children[i] & 3) != lvp_bvh_node_internal)
+            continue;
+
+         assert(node_count < internal_node_count);
+         sources[node_count] = children[i];
+         children[i] = (sizeof(struct lvp_bvh_header) +
+                        node_count * sizeof(struct lvp_bvh_box_node)) | lvp_bvh_node_internal;
+         node_count++;
+      }
+
+      struct lvp_bvh_box_node *node =
+         (void *)(output + sizeof(struct lvp_bvh_header) + index * sizeof(struct lvp_bvh_box_node));
+      lvp_encode_box_node(node, children, bounds, child_count);
+   }
+
+   free(sources);
+}
+
 void
 lvp_encode_as(struct vk_acceleration_structure *dst, VkDeviceAddress intermediate_as_addr,
               VkDeviceAddress intermediate_header_addr, uint32_t leaf_count,
@@ -464,15 +685,7 @@ lvp_encode_as(struct vk_acceleration_structure *dst, VkDeviceAddress intermediat
                                           ir_instance->sbt_offset_and_flags >> 24);
          output_instance->instance_id = ir_instance->instance_id;
          output_instance->otw_matrix = ir_instance->otw_matrix;
-
-         float transform[16], inv_transform[16];
-         memcpy(transform, &ir_instance->otw_matrix.values, sizeof(ir_instance->otw_matrix.values));
-         transform[12] = transform[13] = transform[14] = 0.0f;
-         transform[15] = 1.0f;
-
-         util_invert_mat4x4(inv_transform, transform);
-         memcpy(output_instance->wto_matrix.values, inv_transform, sizeof(output_instance->wto_matrix.values));
-
+         lvp_init_wto_matrix(output_instance);
          break;
       }
       default:
@@ -480,16 +693,21 @@ lvp_encode_as(struct vk_acceleration_structure *dst, VkDeviceAddress intermediat
       }
    }
 
+   /* Internal nodes are laid out at the same offsets as in the output. */
+   uint8_t *binary = malloc(output_header->leaf_nodes_offset);
    uint32_t *node_depth = calloc(header->ir_internal_node_count, sizeof(uint32_t));
-   if (!node_depth)
+   if (!binary || !node_depth) {
+      free(binary);
+      free(node_depth);
       return;
+   }
 
    uint32_t max_node_depth = 0;
 
    for (uint32_t i = 0; i < header->ir_internal_node_count; i++) {
       const struct vk_ir_box_node *ir_box = ir_box_nodes + (header->ir_internal_node_count - i - 1);
-      struct lvp_bvh_box_node *output_box =
-         (void *)(output + sizeof(struct lvp_bvh_header) + i * sizeof(struct lvp_bvh_box_node));
+      struct lvp_bvh_binary_node *output_box =
+         (void *)(binary + sizeof(struct lvp_bvh_header) + i * sizeof(struct lvp_bvh_binary_node));
 
       for (uint32_t child_index = 0; child_index < 2; child_index++) {
          if (ir_box->children[child_index] == VK_BVH_INVALID_NODE) {
@@ -530,7 +748,7 @@ lvp_encode_as(struct vk_acceleration_structure *dst, VkDeviceAddress intermediat
             uint32_t src_index = (ir_child_offset - root_offset) / sizeof(struct vk_ir_box_node);
             uint32_t dst_index = header->ir_internal_node_count - src_index - 1;
             output_box->children[child_index] =
-               sizeof(struct lvp_bvh_header) + dst_index * sizeof(struct lvp_bvh_box_node);
+               sizeof(struct lvp_bvh_header) + dst_index * sizeof(struct lvp_bvh_binary_node);
             output_box->children[child_index] |= lvp_bvh_node_internal;
 
             node_depth[dst_index] = node_depth[i] + 1;
@@ -542,10 +760,888 @@ lvp_encode_as(struct vk_acceleration_structure *dst, VkDeviceAddress intermediat
    /* The BVH exceeds the maximum depth supported by the traversal stack, 
     * flatten the offending parts of the tree.
     */
-   if (max_node_depth >= 24)
-      lvp_flatten_as(header, ir_box_nodes, root_offset, node_depth, output);
+   if (max_node_depth >= LVP_BVH_MAX_DEPTH)
+      lvp_flatten_as(header, ir_box_nodes, root_offset, node_depth, binary);
 
    free(node_depth);
+
+   lvp_collapse_as(binary, header->ir_internal_node_count, output);
+
+   free(binary);
+}
+
+/* The native builder reads the geometry directly and builds the binary tree
+ * with a binned SAH sweep, instead of running the runtime's compute shaders
+ * through the emulated compute pipeline.  Leaves are stored in primitive
+ * order, so an update only has to rewrite them and refit the box nodes.
+ */
+
+#define LVP_BVH_BIN_COUNT 16
+
+/* Nodes with at least this many primitives are binned by all threads. */
+#define LVP_BVH_PARALLEL_BIN_SIZE (64 * 1024)
+
+#define LVP_BVH_LEAF_JOB_SIZE (16 * 1024)
+#define LVP_BVH_MIN_SUBTREE_SIZE 1024
+
+struct lvp_build_prim {
+   vk_aabb bounds;
+   uint32_t id;
+};
+
+struct lvp_build_bin {
+   vk_aabb bounds;
+   vk_aabb centroid_bounds;
+   uint32_t count;
+};
+
+struct lvp_build_range {
+   uint32_t begin;
+   uint32_t end;
+   /* A subtree with n primitives uses the n - 1 binary nodes starting
+    * at this one.
+    */
+   uint32_t node;
+   uint32_t depth;
+   vk_aabb bounds;
+   vk_aabb centroid_bounds;
+};
+
+struct lvp_as_builder {
+   const struct lvp_cmd_build_as *build;
+   struct util_queue *queue;
+
+   uint8_t *output;
+   uint8_t *binary;
+   uint32_t leaf_nodes_offset;
+   uint32_t leaf_node_size;
+   uint32_t leaf_node_type;
+
+   /* Inactive triangles and AABBs stay in updatable trees. */
+   bool keep_inactive;
+
+   /* One per leaf node, in primitive order. */
+   struct lvp_build_prim *leaves;
+   /* The active leaves, reordered while building. */
+   struct lvp_build_prim *prims;
+
+   /* Subtrees which are built by the worker threads. */
+   struct util_dynarray subtrees;
+   uint32_t subtree_size;
+};
+
+struct lvp_as_build_job {
+   struct util_queue_fence fence;
+   struct lvp_as_builder *builder;
+   struct lvp_build_range range;
+   uint32_t geometry;
+   uint32_t bin_count;
+   struct lvp_build_bin bins[3][LVP_BVH_BIN_COUNT];
+};
+
+static void
+lvp_aabb_init_empty(vk_aabb *aabb)
+{
+   aabb->min.x = aabb->min.y = aabb->min.z = INFINITY;
+   aabb->max.x = aabb->max.y = aabb->max.z = -INFINITY;
+}
+
+static void
+lvp_aabb_extend(vk_aabb *aabb, const vk_aabb *other)
+{
+   aabb->min.x = MIN2(aabb->min.x, other->min.x);
+   aabb->min.y = MIN2(aabb->min.y, other->min.y);
+   aabb->min.z = MIN2(aabb->min.z, other->min.z);
+   aabb->max.x = MAX2(aabb->max.x, other->max.x);
+   aabb->max.y = MAX2(aabb->max.y, other->max.y);
+   aabb->max.z = MAX2(aabb->max.z, other->max.z);
+}
+
+static vk_aabb
+lvp_aabb_centroid(const vk_aabb *aabb)
+{
+   vec3 centroid = {
+      .x = (aabb->min.x + aabb->max.x) * 0.5f,
+      .y = (aabb->min.y + aabb->max.y) * 0.5f,
+      .z = (aabb->min.z + aabb->max.z) * 0.5f,
+   };
+   return (vk_aabb){ .min = centroid, .max = centroid };
+}
+
+static uint32_t
+lvp_load_index(const struct vk_bvh_geometry_data *geom, uint32_t index)
+{
+   const void *indices = (const void *)(uintptr_t)geom->indices;
+
+   switch (geom->index_format) {
+   case VK_INDEX_TYPE_UINT8_KHR:
+      return ((const uint8_t *)indices)[index];
+   case VK_INDEX_TYPE_UINT16:
+      return ((const uint16_t *)indices)[index];
+   case VK_INDEX_TYPE_UINT32:
+      return ((const uint32_t *)indices)[index];
+   default:
+      return index;
+   }
+}
+
+static void
+lvp_load_vertex(const struct vk_bvh_geometry_data *geom, uint32_t index, float *vertex)
+{
+   const void *src = (const void *)(uintptr_t)(geom->data + (uint64_t)index * geom->stride);
+
+   if (geom->vertex_format == VK_FORMAT_R32G32B32_SFLOAT) {
+      memcpy(vertex, src, 3 * sizeof(float));
+      return;
+   }
+
+   float rgba[4];
+   util_format_unpack_rgba(lvp_vk_format_to_pipe_format(geom->vertex_format), rgba, src, 1);
+   memcpy(vertex, rgba, 3 * sizeof(float));
+}
+
+static bool
+lvp_write_triangle_leaf(const struct vk_bvh_geometry_data *geom, uint32_t primitive_id,
+                        struct lvp_bvh_triangle_node *node, vk_aabb *bounds)
+{
+   float coords[3][3];
+   for (uint32_t i = 0; i < 3; i++)
+      lvp_load_vertex(geom, lvp_load_index(geom, primitive_id * 3 + i), coords[i]);
+
+   /* An inactive triangle is one for which the first (X) component of any
+    * vertex is NaN.
+    */
+   bool active = !isnan(coords[0][0]) && !isnan(coords[1][0]) && !isnan(coords[2][0]);
+
+   if (geom->transform) {
+      const float *transform = (const void *)(uintptr_t)geom->transform;
+      for (uint32_t i = 0; i < 3; i++) {
+         for (uint32_t row = 0; row < 3; row++) {
+            node->coords[i][row] = transform[row * 4 + 0] * coords[i][0] +
+                                   transform[row * 4 + 1] * coords[i][1] +
+                                   transform[row * 4 + 2] * coords[i][2] +
+                                   transform[row * 4 + 3];
+         }
+      }
+   } else {
+      memcpy(node->coords, coords, sizeof(node->coords));
+   }
+
+   node->primitive_id = primitive_id;
+   node->geometry_id_and_flags = geom->geometry_id;
+
+   bounds->min.x = MIN3(node->coords[0][0], node->coords[1][0], node->coords[2][0]);
+   bounds->min.y = MIN3(node->coords[0][1], node->coords[1][1], node->coords[2][1]);
+   bounds->min.z = MIN3(node->coords[0][2], node->coords[1][2], node->coords[2][2]);
+   bounds->max.x = MAX3(node->coords[0][0], node->coords[1][0], node->coords[2][0]);
+   bounds->max.y = MAX3(node->coords[0][1], node->coords[1][1], node->coords[2][1]);
+   bounds->max.z = MAX3(node->coords[0][2], node->coords[1][2], node->coords[2][2]);
+
+   return active;
+}
+
+static bool
+lvp_write_aabb_leaf(const struct vk_bvh_geometry_data *geom, uint32_t primitive_id,
+                    struct lvp_bvh_aabb_node *node, vk_aabb *bounds)
+{
+   const float *src = (const void *)(uintptr_t)(geom->data + (uint64_t)primitive_id * geom->stride);
+
+   bounds->min = (vec3){ src[0], src[1], src[2] };
+   bounds->max = (vec3){ src[3], src[4], src[5] };
+
+   node->bounds = *bounds;
+   node->primitive_id = primitive_id;
+   node->geometry_id_and_flags = geom->geometry_id;
+
+   /* An inactive AABB is one for which the minimum X coordinate is NaN. */
+   return !isnan(bounds->min.x);
+}
+
+static bool
+lvp_write_instance_leaf(const struct vk_bvh_geometry_data *geom, uint32_t primitive_id,
+                        struct lvp_bvh_instance_node *node, vk_aabb *bounds)
+{
+   const void *src = (const void *)(uintptr_t)(geom->data + (uint64_t)primitive_id * geom->stride);
+   /* arrayOfPointers */
+   if (geom->stride == 8)
+      src = (const void *)(uintptr_t)*(const uint64_t *)src;
+
+   const VkAccelerationStructureInstanceKHR *instance = src;
+
+   node->bvh_ptr = instance->accelerationStructureReference;
+   node->custom_instance_and_mask = instance->instanceCustomIndex | (instance->mask << 24);
+   node->sbt_offset_and_flags =
+      lvp_pack_sbt_offset_and_flags(instance->instanceShaderBindingTableRecordOffset, instance->flags);
+   node->instance_id = primitive_id;
+
+   memcpy(node->otw_matrix.values, instance->transform.matrix, sizeof(node->otw_matrix.values));
+   lvp_init_wto_matrix(node);
+
+   /* An inactive instance is one whose acceleration structure handle is
+    * VK_NULL_HANDLE, instances which are masked out are left out as well.
+    */
+   if (!node->bvh_ptr || !instance->mask) {
+      node->custom_instance_and_mask &= 0xFFFFFF;
+      *bounds = (vk_aabb){ 0 };
+      return false;
+   }
+
+   const struct lvp_bvh_header *blas = (const void *)(uintptr_t)node->bvh_ptr;
+   const mat3x4 *m = &node->otw_matrix;
+
+   for (uint32_t row = 0; row < 3; row++) {
+      float lo = m->values[row][3], hi = m->values[row][3];
+      for (uint32_t col = 0; col < 3; col++) {
+         float a = m->values[row][col] * vec3_component(&blas->bounds.min, col);
+         float b = m->values[row][col] * vec3_component(&blas->bounds.max, col);
+         lo += MIN2(a, b);
+         hi += MAX2(a, b);
+      }
+
+      float *min = row == 0 ? &bounds->min.x : (row == 1 ? &bounds->min.y : &bounds->min.z);
+      float *max = row == 0 ? &bounds->max.x : (row == 1 ? &bounds->max.y : &bounds->max.z);
+      *min = lo;
+      *max = hi;
+   }
+
+   return true;
+}
+
+static void
+lvp_write_leaves_job(void *data, void *gdata, int thread_index)
+{
+   struct lvp_as_build_job *job = data;
+   struct lvp_as_builder *builder = job->builder;
+   const struct lvp_as_build_geometry *geometry = &builder->build->geometries[job->geometry];
+
+   for (uint32_t i = job->range.begin; i < job->range.end; i++) {
+      uint32_t primitive_id = i - geometry->data.first_id;
+      uint32_t offset = builder->leaf_nodes_offset + i * builder->leaf_node_size;
+      void *leaf = builder->output + offset;
+      struct lvp_build_prim *prim = &builder->leaves[i];
+
+      bool active = false;
+      switch (geometry->data.geometry_type) {
+      case VK_GEOMETRY_TYPE_TRIANGLES_KHR:
+         active = lvp_write_triangle_leaf(&geometry->data, primitive_id, leaf, &prim->bounds);
+         break;
+      case VK_GEOMETRY_TYPE_AABBS_KHR:
+         active = lvp_write_aabb_leaf(&geometry->data, primitive_id, leaf, &prim->bounds);
+         break;
+      case VK_GEOMETRY_TYPE_INSTANCES_KHR:
+         active = lvp_write_instance_leaf(&geometry->data, primitive_id, leaf, &prim->bounds);
+         break;
+      default:
+         break;
+      }
+
+      if (!active && builder->keep_inactive &&
+          geometry->data.geometry_type != VK_GEOMETRY_TYPE_INSTANCES_KHR) {
+         prim->bounds = (vk_aabb){ 0 };
+         active = true;
+      }
+
+      prim->id = active ? (offset | builder->leaf_node_type) : LVP_BVH_INVALID_NODE;
+   }
+}
+
+/* Run the jobs on the worker threads, with the first one on the calling
+ * thread.
+ */
+static void
+lvp_run_build_jobs(struct lvp_as_builder *builder, struct lvp_as_build_job *jobs,
+                   uint32_t job_count, util_queue_execute_func execute)
+{
+   if (!builder->queue) {
+      for (uint32_t i = 0; i < job_count; i++)
+         execute(&jobs[i], NULL, 0);
+      return;
+   }
+
+   for (uint32_t i = 1; i < job_count; i++) {
+      util_queue_fence_init(&jobs[i].fence);
+      util_queue_add_job(builder->queue, &jobs[i], &jobs[i].fence, execute, NULL, 0);
+   }
+
+   if (job_count)
+      execute(&jobs[0], NULL, 0);
+
+   for (uint32_t i = 1; i < job_count; i++) {
+      util_queue_fence_wait(&jobs[i].fence);
+      util_queue_fence_destroy(&jobs[i].fence);
+   }
+}
+
+static bool
+lvp_write_leaves(struct lvp_as_builder *builder)
+{
+   const struct lvp_cmd_build_as *build = builder->build;
+
+   uint32_t job_count = 0;
+   for (uint32_t i = 0; i < build->geometry_count; i++)
+      job_count += DIV_ROUND_UP(build->geometries[i].primitive_count, LVP_BVH_LEAF_JOB_SIZE);
+
+   struct lvp_as_build_job *jobs = calloc(job_count, sizeof(*jobs));
+   if (job_count && !jobs)
+      return false;
+
+   uint32_t job = 0;
+   for (uint32_t i = 0; i < build->geometry_count; i++) {
+      const struct lvp_as_build_geometry *geometry = &build->geometries[i];
+      uint32_t end = geometry->data.first_id + geometry->primitive_count;
+
+      for (uint32_t begin = geometry->data.first_id; begin < end; begin += LVP_BVH_LEAF_JOB_SIZE) {
+         jobs[job].builder = builder;
+         jobs[job].geometry = i;
+         jobs[job].range.begin = begin;
+         jobs[job].range.end = MIN2(begin + LVP_BVH_LEAF_JOB_SIZE, end);
+         job++;
+      }
+   }
+
+   lvp_run_build_jobs(builder, jobs, job_count, lvp_write_leaves_job);
+
+   free(jobs);
+   return true;
+}
+
+static float
+lvp_bin_scale(const struct lvp_build_range *range, uint32_t axis, uint32_t bin_count)
+{
+   float extent = vec3_component(&range->centroid_bounds.max, axis) -
+                  vec3_component(&range->centroid_bounds.min, axis);
+   return extent > 0.0f ? bin_count / extent : 0.0f;
+}
+
+static uint32_t
+lvp_bin_index(const struct lvp_build_range *range, uint32_t axis, float scale,
+              uint32_t bin_count, const vk_aabb *centroid)
+{
+   float offset = (vec3_component(&centroid->min, axis) -
+                   vec3_component(&range->centroid_bounds.min, axis)) * scale;
+   return MIN2((uint32_t)MAX2(offset, 0.0f), bin_count - 1);
+}
+
+static void
+lvp_bin_init(struct lvp_build_bin *bin)
+{
+   lvp_aabb_init_empty(&bin->bounds);
+   lvp_aabb_init_empty(&bin->centroid_bounds);
+   bin->count = 0;
+}
+
+static void
+lvp_bin_merge(struct lvp_build_bin *bin, const struct lvp_build_bin *other)
+{
+   lvp_aabb_extend(&bin->bounds, &other->bounds);
+   lvp_aabb_extend(&bin->centroid_bounds, &other->centroid_bounds);
+   bin->count += other->count;
+}
+
+static void
+lvp_bin_prims(const struct lvp_build_prim *prims, const struct lvp_build_range *range,
+              uint32_t bin_count, struct lvp_build_bin bins[3][LVP_BVH_BIN_COUNT])
+{
+   float scale[3];
+   for (uint32_t axis = 0; axis < 3; axis++) {
+      scale[axis] = lvp_bin_scale(range, axis, bin_count);
+      for (uint32_t i = 0; i < bin_count; i++)
+         lvp_bin_init(&bins[axis][i]);
+   }
+
+   for (uint32_t i = range->begin; i < range->end; i++) {
+      vk_aabb centroid = lvp_aabb_centroid(&prims[i].bounds);
+      for (uint32_t axis = 0; axis < 3; axis++) {
+         struct lvp_build_bin *bin =
+            &bins[axis][lvp_bin_index(range, axis, scale[axis], bin_count, &centroid)];
+         lvp_aabb_extend(&bin->bounds, &prims[i].bounds);
+         lvp_aabb_extend(&bin->centroid_bounds, &centroid);
+         bin->count++;
+      }
+   }
+}
+
+static void
+lvp_bin_prims_job(void *data, void *gdata, int thread_index)
+{
+   struct lvp_as_build_job *job = data;
+   lvp_bin_prims(job->builder->prims, &job->range, job->bin_count, job->bins);
+}
+
+static void
+lvp_bin_prims_parallel(struct lvp_as_builder *builder, const struct lvp_build_range *range,
+                       uint32_t bin_count, struct lvp_build_bin bins[3][LVP_BVH_BIN_COUNT])
+{
+   uint32_t count = range->end - range->begin;
+   uint32_t job_count = builder->queue->num_threads + 1;
+   uint32_t job_size = DIV_ROUND_UP(count, job_count);
+
+   struct lvp_as_build_job *jobs = calloc(job_count, sizeof(*jobs));
+   if (!jobs) {
+      lvp_bin_prims(builder->prims, range, bin_count, bins);
+      return;
+   }
+
+   for (uint32_t i = 0; i < job_count; i++) {
+      jobs[i].builder = builder;
+      jobs[i].bin_count = bin_count;
+      jobs[i].range = *range;
+      jobs[i].range.begin = range->begin + MIN2(i * job_size, count);
+      jobs[i].range.end = range->begin + MIN2((i + 1) * job_size, count);
+   }
+
+   lvp_run_build_jobs(builder, jobs, job_count, lvp_bin_prims_job);
+
+   memcpy(bins, jobs[0].bins, sizeof(jobs[0].bins));
+   for (uint32_t i = 1; i < job_count; i++) {
+      for (uint32_t axis = 0; axis < 3; axis++) {
+         for (uint32_t bin = 0; bin < bin_count; bin++)
+            lvp_bin_merge(&bins[axis][bin], &jobs[i].bins[axis][bin]);
+      }
+   }
+
+   free(jobs);
+}
+
+/* Find the split between two bins with the lowest surface area heuristic
+ * cost, returns the last bin on the left side.
+ */
+static bool
+lvp_find_split(struct lvp_build_bin bins[3][LVP_BVH_BIN_COUNT], uint32_t bin_count,
+               uint32_t *split_axis, uint32_t *split_bin,
+               struct lvp_build_bin *left, struct lvp_build_bin *right)
+{
+   float best_cost = INFINITY;
+   bool found = false;
+
+   for (uint32_t axis = 0; axis < 3; axis++) {
+      struct lvp_build_bin right_bins[LVP_BVH_BIN_COUNT];
+      right_bins[bin_count - 1] = bins[axis][bin_count - 1];
+      for (int i = bin_count - 2; i >= 0; i--) {
+         right_bins[i] = right_bins[i + 1];
+         lvp_bin_merge(&right_bins[i], &bins[axis][i]);
+      }
+
+      struct lvp_build_bin left_bin;
+      lvp_bin_init(&left_bin);
+
+      for (uint32_t i = 0; i < bin_count - 1; i++) {
+         lvp_bin_merge(&left_bin, &bins[axis][i]);
+         if (!left_bin.count || !right_bins[i + 1].count)
+            continue;
+
+         float cost = lvp_aabb_surface_area(&left_bin.bounds) * left_bin.count +
+                      lvp_aabb_surface_area(&right_bins[i + 1].bounds) * right_bins[i + 1].count;
+         if (cost < best_cost) {
+            best_cost = cost;
+            *split_axis = axis;
+            *split_bin = i;
+            *left = left_bin;
+            *right = right_bins[i + 1];
+            found = true;
+         }
+      }
+   }
+
+   return found;
+}
+
+static void
+lvp_range_bounds(const struct lvp_build_prim *prims, struct lvp_build_range *range)
+{
+   lvp_aabb_init_empty(&range->bounds);
+   lvp_aabb_init_empty(&range->centroid_bounds);
+
+   for (uint32_t i = range->begin; i < range->end; i++) {
+      vk_aabb centroid = lvp_aabb_centroid(&prims[i].bounds);
+      lvp_aabb_extend(&range->bounds, &prims[i].bounds);
+      lvp_aabb_extend(&range->centroid_bounds, &centroid);
+   }
+}
+
+static float
+lvp_prim_centroid(const struct lvp_build_prim *prim, uint32_t axis)
+{
+   return (vec3_component(&prim->bounds.min, axis) + vec3_component(&prim->bounds.max, axis)) * 0.5f;
+}
+
+/* Partially sort the primitives so that the one at nth has its centroid in
+ * place along the axis.
+ */
+static void
+lvp_select_prims(struct lvp_build_prim *prims, uint32_t begin, uint32_t end,
+                 uint32_t nth, uint32_t axis)
+{
+   int64_t lo = begin, hi = (int64_t)end - 1;
+
+   while (lo < hi) {
+      float pivot = lvp_prim_centroid(&prims[lo + (hi - lo) / 2], axis);
+      int64_t i = lo, j = hi;
+
+      while (i <= j) {
+         while (lvp_prim_centroid(&prims[i], axis) < pivot)
+            i++;
+         while (lvp_prim_centroid(&prims[j], axis) > pivot)
+            j--;
+         if (i <= j) {
+            struct lvp_build_prim tmp = prims[i];
+            prims[i++] = prims[j];
+            prims[j--] = tmp;
+         }
+      }
+
+      if (nth <= j)
+         hi = j;
+      else if (nth >= i)
+         lo = i;
+      else
+         break;
+   }
+}
+
+static void
+lvp_build_node(struct lvp_as_builder *builder, const struct lvp_build_range *range, bool parallel)
+{
+   struct lvp_build_prim *prims = builder->prims;
+   uint32_t count = range->end - range->begin;
+   struct lvp_build_range children[2];
+   uint32_t mid = 0;
+
+   /* Small nodes don't need more bins than primitives. */
+   uint32_t bin_count = MIN2(count, LVP_BVH_BIN_COUNT);
+
+   struct lvp_build_bin bins[3][LVP_BVH_BIN_COUNT];
+   if (parallel && builder->queue && count >= LVP_BVH_PARALLEL_BIN_SIZE)
+      lvp_bin_prims_parallel(builder, range, bin_count, bins);
+   else
+      lvp_bin_prims(prims, range, bin_count, bins);
+
+   uint32_t axis, split_bin;
+   struct lvp_build_bin left, right;
+   bool sah_split = lvp_find_split(bins, bin_count, &axis, &split_bin, &left, &right);
+
+   /* Split at the median instead where the SAH split would make the tree
+    * deeper than the traversal stack supports.
+    */
+   if (sah_split && range->depth + util_logbase2_ceil(MAX2(left.count, right.count)) >= LVP_BVH_MAX_DEPTH)
+      sah_split = false;
+
+   if (sah_split) {
+      float scale = lvp_bin_scale(range, axis, bin_count);
+      uint32_t i = range->begin, j = range->end;
+      while (i < j) {
+         vk_aabb centroid = lvp_aabb_centroid(&prims[i].bounds);
+         if (lvp_bin_index(range, axis, scale, bin_count, &centroid) <= split_bin) {
+            i++;
+         } else {
+            struct lvp_build_prim tmp = prims[i];
+            prims[i] = prims[--j];
+            prims[j] = tmp;
+         }
+      }
+
+      mid = i;
+      assert(mid - range->begin == left.count);
+
+      children[0].bounds = left.bounds;
+      children[0].centroid_bounds = left.centroid_bounds;
+      children[1].bounds = right.bounds;
+      children[1].centroid_bounds = right.centroid_bounds;
+   } else {
+      float extent[3];
+      for (uint32_t i = 0; i < 3; i++) {
+         extent[i] = vec3_component(&range->centroid_bounds.max, i) -
+                     vec3_component(&range->centroid_bounds.min, i);
+      }
+      axis = extent[0] >= extent[1] ? (extent[0] >= extent[2] ? 0 : 2) : (extent[1] >= extent[2] ? 1 : 2);
+
+      mid = range->begin + count / 2;
+      lvp_select_prims(prims, range->begin, range->end, mid, axis);
+   }
+
+   children[0].begin = range->begin;
+   children[0].end = mid;
+   children[1].begin = mid;
+   children[1].end = range->end;
+
+   if (!sah_split) {
+      lvp_range_bounds(prims, &children[0]);
+      lvp_range_bounds(prims, &children[1]);
+   }
+
+   children[0].node = range->node + 1;
+   children[1].node = range->node + (mid - range->begin);
+
+   struct lvp_bvh_binary_node *node =
+      (void *)(builder->binary + sizeof(struct lvp_bvh_header) +
+               range->node * sizeof(struct lvp_bvh_binary_node));
+
+   for (uint32_t i = 0; i < 2; i++) {
+      children[i].depth = range->depth + 1;
+
+      node->bounds[i] = children[i].bounds;
+      if (children[i].end - children[i].begin == 1) {
+         node->children[i] = prims[children[i].begin].id;
+      } else {
+         node->children[i] = (sizeof(struct lvp_bvh_header) +
+                              children[i].node * sizeof(struct lvp_bvh_binary_node)) |
+                             lvp_bvh_node_internal;
+      }
+   }
+
+   for (uint32_t i = 0; i < 2; i++) {
+      uint32_t child_count = children[i].end - children[i].begin;
+      if (child_count == 1)
+         continue;
+
+      if (parallel && child_count <= builder->subtree_size) {
+         struct lvp_build_range *subtree =
+            util_dynarray_grow(&builder->subtrees, struct lvp_build_range, 1);
+         if (subtree) {
+            *subtree = children[i];
+            continue;
+         }
+      }
+
+      lvp_build_node(builder, &children[i], parallel);
+   }
+}
+
+static void
+lvp_build_subtree_job(void *data, void *gdata, int thread_index)
+{
+   struct lvp_as_build_job *job = data;
+   lvp_build_node(job->builder, &job->range, false);
+}
+
+static void
+lvp_build_tree(struct lvp_as_builder *builder, uint32_t prim_count)
+{
+   struct lvp_bvh_binary_node *root =
+      (void *)(builder->binary + sizeof(struct lvp_bvh_header));
+
+   if (prim_count < 2) {
+      for (uint32_t i = 0; i < 2; i++) {
+         if (i < prim_count) {
+            root->bounds[i] = builder->prims[i].bounds;
+            root->children[i] = builder->prims[i].id;
+         } else {
+            root->bounds[i] = (vk_aabb){
+               .min = { NAN, NAN, NAN },
+               .max = { NAN, NAN, NAN },
+            };
+            root->children[i] = LVP_BVH_INVALID_NODE;
+         }
+      }
+      return;
+   }
+
+   struct lvp_build_range range = {
+      .begin = 0,
+      .end = prim_count,
+   };
+   lvp_range_bounds(builder->prims, &range);
+
+   if (!builder->queue) {
+      lvp_build_node(builder, &range, false);
+      return;
+   }
+
+   /* Build the top of the tree on this thread and leave the subtrees below
+    * it to the workers.
+    */
+   builder->subtree_size = MAX2(prim_count / ((builder->queue->num_threads + 1) * 8),
+                                LVP_BVH_MIN_SUBTREE_SIZE);
+   lvp_build_node(builder, &range, true);
+
+   uint32_t job_count = util_dynarray_num_elements(&builder->subtrees, struct lvp_build_range);
+   struct lvp_as_build_job *jobs = calloc(job_count, sizeof(*jobs));
+   if (!jobs) {
+      util_dynarray_foreach(&builder->subtrees, struct lvp_build_range, subtree)
+         lvp_build_node(builder, subtree, false);
+      return;
+   }
+
+   uint32_t job = 0;
+   util_dynarray_foreach(&builder->subtrees, struct lvp_build_range, subtree) {
+      jobs[job].builder = builder;
+      jobs[job].range = *subtree;
+      job++;
+   }
+
+   lvp_run_build_jobs(builder, jobs, job_count, lvp_build_subtree_job);
+
+   free(jobs);
+}
+
+/* Recompute the bounds of all box nodes from the rewritten leaves.  Children
+ * are always stored after their parents, so walking the nodes top down and
+ * refitting them in reverse order visits children first.
+ */
+static void
+lvp_refit_as(struct lvp_as_builder *builder)
+{
+   struct lvp_bvh_header *header = (void *)builder->output;
+   uint32_t max_node_count = (builder->leaf_nodes_offset - sizeof(struct lvp_bvh_header)) /
+                             sizeof(struct lvp_bvh_box_node);
+
+   uint32_t *nodes = malloc(max_node_count * sizeof(uint32_t));
+   vk_aabb *node_bounds = malloc(max_node_count * sizeof(vk_aabb));
+   if (!nodes || !node_bounds) {
+      free(nodes);
+      free(node_bounds);
+      return;
+   }
+
+   nodes[0] = 0;
+   uint32_t node_count = 1;
+
+   for (uint32_t i = 0; i < node_count; i++) {
+      const struct lvp_bvh_box_node *node =
+         (void *)(builder->output + sizeof(struct lvp_bvh_header) +
+                  nodes[i] * sizeof(struct lvp_bvh_box_node));
+
+      for (uint32_t child = 0; child < LVP_BVH_NODE_WIDTH; child++) {
+         if (node->children[child] == LVP_BVH_INVALID_NODE ||
+             (node->children[child] & 3) != lvp_bvh_node_internal)
+            continue;
+
+         assert(node_count < max_node_count);
+         nodes[node_count++] = (ir_id_to_offset(node->children[child]) - sizeof(struct lvp_bvh_header)) /
+                               sizeof(struct lvp_bvh_box_node);
+      }
+   }
+
+   for (uint32_t i = node_count; i-- > 0;) {
+      struct lvp_bvh_box_node *node =
+         (void *)(builder->output + sizeof(struct lvp_bvh_header) +
+                  nodes[i] * sizeof(struct lvp_bvh_box_node));
+
+      uint32_t children[LVP_BVH_NODE_WIDTH];
+      vk_aabb bounds[LVP_BVH_NODE_WIDTH];
+      uint32_t child_count = 0;
+
+      lvp_aabb_init_empty(&node_bounds[nodes[i]]);
+
+      for (uint32_t child = 0; child < LVP_BVH_NODE_WIDTH; child++) {
+         uint32_t id = node->children[child];
+         if (id == LVP_BVH_INVALID_NODE)
+            continue;
+
+         uint32_t offset = ir_id_to_offset(id);
+         if ((id & 3) == lvp_bvh_node_internal) {
+            bounds[child_count] = node_bounds[(offset - sizeof(struct lvp_bvh_header)) /
+                                              sizeof(struct lvp_bvh_box_node)];
+         } else {
+            bounds[child_count] = builder->leaves[(offset - builder->leaf_nodes_offset) /
+                                                  builder->leaf_node_size].bounds;
+         }
+
+         children[child_count] = id;
+         lvp_aabb_extend(&node_bounds[nodes[i]], &bounds[child_count]);
+         child_count++;
+      }
+
+      lvp_encode_box_node(node, children, bounds, child_count);
+   }
+
+   header->bounds = node_bounds[0];
+
+   free(nodes);
+   free(node_bounds);
+}
+
+void
+lvp_build_as(struct lvp_device *device, const struct lvp_cmd_build_as *build)
+{
+   uint8_t *output = (void *)(uintptr_t)vk_acceleration_structure_get_va(build->dst);
+   struct lvp_bvh_header *header = (void *)output;
+
+   uint32_t ir_leaf_node_size = 0;
+   uint32_t leaf_node_size = 0;
+   lvp_get_leaf_node_size(build->geometry_type, &ir_leaf_node_size, &leaf_node_size);
+
+   struct lvp_as_builder builder = {
+      .build = build,
+      .queue = util_queue_is_initialized(&device->as_build_queue) ? &device->as_build_queue : NULL,
+      .output = output,
+      .leaf_node_size = leaf_node_size,
+      .keep_inactive = build->flags & VK_BUILD_ACCELERATION_STRUCTURE_ALLOW_UPDATE_BIT_KHR,
+   };
+
+   switch (build->geometry_type) {
+   case VK_GEOMETRY_TYPE_TRIANGLES_KHR:
+      builder.leaf_node_type = lvp_bvh_node_triangle;
+      break;
+   case VK_GEOMETRY_TYPE_AABBS_KHR:
+      builder.leaf_node_type = lvp_bvh_node_aabb;
+      break;
+   default:
+      builder.leaf_node_type = lvp_bvh_node_instance;
+      break;
+   }
+
+   builder.leaves = malloc(MAX2(build->leaf_count, 1) * sizeof(struct lvp_build_prim));
+   if (!builder.leaves)
+      return;
+
+   if (build->mode == VK_BUILD_ACCELERATION_STRUCTURE_MODE_UPDATE_KHR) {
+      const uint8_t *src = (const void *)(uintptr_t)vk_acceleration_structure_get_va(build->src);
+      const struct lvp_bvh_header *src_header = (const void *)src;
+
+      builder.leaf_nodes_offset = src_header->leaf_nodes_offset;
+      if (src != output)
+         memcpy(output, src, builder.leaf_nodes_offset + build->leaf_count * leaf_node_size);
+
+      if (lvp_write_leaves(&builder))
+         lvp_refit_as(&builder);
+
+      free(builder.leaves);
+      return;
+   }
+
+   uint32_t internal_node_count = MAX2(build->leaf_count, 2) - 1;
+   builder.leaf_nodes_offset = sizeof(struct lvp_bvh_header) +
+                               internal_node_count * sizeof(struct lvp_bvh_box_node);
+
+   /* Internal nodes are laid out at the same offsets as in the output. */
+   builder.binary = malloc(builder.leaf_nodes_offset);
+   builder.prims = malloc(MAX2(build->leaf_count, 1) * sizeof(struct lvp_build_prim));
+   if (!builder.binary || !builder.prims || !lvp_write_leaves(&builder)) {
+      free(builder.binary);
+      free(builder.prims);
+      free(builder.leaves);
+      return;
+   }
+
+   uint32_t prim_count = 0;
+   for (uint32_t i = 0; i < build->leaf_count; i++) {
+      if (builder.leaves[i].id != LVP_BVH_INVALID_NODE)
+         builder.prims[prim_count++] = builder.leaves[i];
+   }
+
+   util_dynarray_init(&builder.subtrees, NULL);
+   lvp_build_tree(&builder, prim_count);
+   util_dynarray_fini(&builder.subtrees);
+
+   lvp_aabb_init_empty(&header->bounds);
+   for (uint32_t i = 0; i < prim_count; i++)
+      lvp_aabb_extend(&header->bounds, &builder.prims[i].bounds);
+
+   if (build->geometry_type == VK_GEOMETRY_TYPE_INSTANCES_KHR)
+      header->instance_count = build->leaf_count;
+   else
+      header->instance_count = 0;
+
+   header->leaf_nodes_offset = builder.leaf_nodes_offset;
+   header->serialization_size = sizeof(struct lvp_accel_struct_serialization_header) +
+                                sizeof(uint64_t) * header->instance_count + build->dst->size;
+
+   lvp_collapse_as(builder.binary, internal_node_count, output);
+
+   free(builder.binary);
+   free(builder.prims);
+   free(builder.leaves);
 }
 
 static_assert(sizeof(struct lvp_bvh_triangle_node) % 8 == 0, "lvp_bvh_triangle_node is not padded");
@@ -664,6 +1760,7 @@ lvp_device_init_accel_struct_state(struct lvp_device *device)
    device->vk.cmd_fill_buffer_addr = lvp_cmd_fill_buffer_addr;
 
    simple_mtx_init(&device->radix_sort_lock, mtx_plain);
+   simple_mtx_init(&device->as_build_lock, mtx_plain);
 
    return VK_SUCCESS;
 }
@@ -672,6 +1769,10 @@ void
 lvp_device_finish_accel_struct_state(struct lvp_device *device)
 {
    simple_mtx_destroy(&device->radix_sort_lock);
+   simple_mtx_destroy(&device->as_build_lock);
+
+   if (util_queue_is_initialized(&device->as_build_queue))
+      util_queue_destroy(&device->as_build_queue);
 
    if (device->radix_sort)
       radix_sort_vk_destroy(device->radix_sort, lvp_device_to_handle(device), &device->vk.alloc);
@@ -709,6 +1810,67 @@ lvp_enqueue_restore_state(VkCommandBuffer cmdbuf)
    list_addtail(&entry->cmd_link, &cmd_buffer->vk.cmd_queue.cmds);
 }
 
+static void
+lvp_init_as_build_queue(struct lvp_device *device)
+{
+   unsigned num_threads = util_get_cpu_caps()->nr_cpus;
+   if (num_threads <= 1)
+      return;
+
+   simple_mtx_lock(&device->as_build_lock);
+   if (!util_queue_is_initialized(&device->as_build_queue)) {
+      /* The building thread runs jobs as well. */
+      util_queue_init(&device->as_build_queue, "lvp_as_build", 64, num_threads - 1,
+                      UTIL_QUEUE_INIT_RESIZE_IF_FULL, NULL);
+   }
+   simple_mtx_unlock(&device->as_build_lock);
+}
+
+static void
+lvp_enqueue_build_as(struct lvp_cmd_buffer *cmd_buffer,
+                     const VkAccelerationStructureBuildGeometryInfoKHR *info,
+                     const VkAccelerationStructureBuildRangeInfoKHR *ranges)
+{
+   struct vk_cmd_queue_entry *entry =
+      vk_zalloc(cmd_buffer->vk.cmd_queue.alloc, sizeof(struct vk_cmd_queue_entry),
+                8, VK_SYSTEM_ALLOCATION_SCOPE_OBJECT);
+   if (!entry)
+      return;
+
+   entry->type = LVP_CMD_BUILD_AS;
+
+   /* The geometry is captured now since the build info is not retained. */
+   struct lvp_cmd_build_as *cmd =
+      vk_zalloc(cmd_buffer->vk.cmd_queue.alloc,
+                sizeof(struct lvp_cmd_build_as) + info->geometryCount * sizeof(struct lvp_as_build_geometry),
+                8, VK_SYSTEM_ALLOCATION_SCOPE_OBJECT);
+   if (!cmd) {
+      vk_free(cmd_buffer->vk.cmd_queue.alloc, entry);
+      return;
+   }
+
+   cmd->dst = vk_acceleration_structure_from_handle(info->dstAccelerationStructure);
+   cmd->src = vk_acceleration_structure_from_handle(info->srcAccelerationStructure);
+   cmd->flags = info->flags;
+   cmd->mode = info->mode;
+   cmd->geometry_type = vk_get_as_geometry_type(info);
+   cmd->geometry_count = info->geometryCount;
+   cmd->geometries = (void *)(cmd + 1);
+
+   for (uint32_t i = 0; i < info->geometryCount; i++) {
+      const VkAccelerationStructureGeometryKHR *geometry =
+         info->pGeometries ? &info->pGeometries[i] : info->ppGeometries[i];
+
+      cmd->geometries[i].data = vk_fill_geometry_data(info->type, cmd->leaf_count, i, geometry, &ranges[i]);
+      cmd->geometries[i].primitive_count = ranges[i].primitiveCount;
+      cmd->leaf_count += ranges[i].primitiveCount;
+   }
+
+   entry->driver_data = cmd;
+
+   list_addtail(&entry->cmd_link, &cmd_buffer->vk.cmd_queue.cmds);
+}
+
 VKAPI_ATTR void VKAPI_CALL
 lvp_CmdBuildAccelerationStructuresKHR(VkCommandBuffer commandBuffer, uint32_t infoCount,
                                       const VkAccelerationStructureBuildGeometryInfoKHR *pInfos,
@@ -716,6 +1878,15 @@ lvp_CmdBuildAccelerationStructuresKHR(VkCommandBuffer commandBuffer, uint32_t in
 {
    VK_FROM_HANDLE(lvp_cmd_buffer, cmd_buffer, commandBuffer);
 
+   if (!cmd_buffer->device->compute_as_build) {
+      lvp_init_as_build_queue(cmd_buffer->device);
+
+      for (uint32_t i = 0; i < infoCount; i++)
+         lvp_enqueue_build_as(cmd_buffer, &pInfos[i], ppBuildRangeInfos[i]);
+      return;
+   }
+
+   lvp_init_as_build_queue(cmd_buffer->device);
    lvp_init_radix_sort(cmd_buffer->device);
 
    lvp_enqueue_save_state(commandBuffer);
@@ -61,14 +61,34 @@ struct lvp_bvh_instance_node {
    mat3x4 otw_matrix;
 };
 
-/* 56 bytes */
+#define LVP_BVH_NODE_WIDTH 4
+
+/* 56 bytes
+ *
+ * The child bounds are quantized to 8 bits on a grid which starts at origin
+ * and has a power of two cell size per axis, rounded outwards so that the
+ * decoded boxes always contain the real ones.  The cell size of each axis
+ * is stored as a float exponent: scale = uif(exponents[axis] << 23).
+ */
 struct lvp_bvh_box_node {
-   vk_aabb bounds[2];
-   uint32_t children[2];
+   float origin[3];
+   uint8_t exponents[4];
+   /* One byte per child, indexed [axis][child]. */
+   uint8_t min[3][LVP_BVH_NODE_WIDTH];
+   uint8_t max[3][LVP_BVH_NODE_WIDTH];
+   uint32_t children[LVP_BVH_NODE_WIDTH];
 };
 
 #define LVP_BVH_NODE_PREFETCH_SIZE 56
 
+/* Deeper parts of the tree are flattened when encoding. */
+#define LVP_BVH_MAX_DEPTH 24
+
+/* Traversal stack entries for a top and a bottom level tree, each level
+ * can push all but the nearest child.
+ */
+#define LVP_BVH_STACK_SIZE (2 * LVP_BVH_MAX_DEPTH * (LVP_BVH_NODE_WIDTH - 1))
+
 struct lvp_bvh_header {
    vk_aabb bounds;
 
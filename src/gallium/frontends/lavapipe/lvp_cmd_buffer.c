@@ -28,10 +28,14 @@
 #include "vk_common_entrypoints.h"
 
 static void
-lvp_cmd_buffer_destroy(struct vk_command_buffer *cmd_buffer)
+lvp_cmd_buffer_destroy(struct vk_command_buffer *vk_cmd_buffer)
 {
-   vk_command_buffer_finish(cmd_buffer);
-   vk_free(&cmd_buffer->pool->alloc, cmd_buffer);
+   struct lvp_cmd_buffer *cmd_buffer =
+      container_of(vk_cmd_buffer, struct lvp_cmd_buffer, vk);
+
+   util_dynarray_fini(&cmd_buffer->baked_cmds);
+   vk_command_buffer_finish(vk_cmd_buffer);
+   vk_free(&vk_cmd_buffer->pool->alloc, cmd_buffer);
 }
 
 static VkResult
@@ -56,6 +60,8 @@ lvp_create_cmd_buffer(struct vk_command_pool *pool,
    }
 
    cmd_buffer->device = device;
+   util_dynarray_init(&cmd_buffer->baked_cmds, NULL);
+   cmd_buffer->baked = false;
 
    *cmd_buffer_out = &cmd_buffer->vk;
 
@@ -66,6 +72,11 @@ static void
 lvp_reset_cmd_buffer(struct vk_command_buffer *vk_cmd_buffer,
                      UNUSED VkCommandBufferResetFlags flags)
 {
+   struct lvp_cmd_buffer *cmd_buffer =
+      container_of(vk_cmd_buffer, struct lvp_cmd_buffer, vk);
+
+   util_dynarray_clear(&cmd_buffer->baked_cmds);
+   cmd_buffer->baked = false;
    vk_command_buffer_reset(vk_cmd_buffer);
 }
 
@@ -91,5 +102,9 @@ VKAPI_ATTR VkResult VKAPI_CALL lvp_EndCommandBuffer(
 {
    LVP_FROM_HANDLE(lvp_cmd_buffer, cmd_buffer, commandBuffer);
 
-   return vk_command_buffer_end(&cmd_buffer->vk);
+   VkResult result = vk_command_buffer_end(&cmd_buffer->vk);
+   if (result == VK_SUCCESS)
+      lvp_cmd_buffer_bake(cmd_buffer);
+
+   return result;
 }
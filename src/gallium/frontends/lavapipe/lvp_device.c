@@ -1518,7 +1518,7 @@ VKAPI_ATTR void VKAPI_CALL lvp_GetPhysicalDeviceQueueFamilyProperties2(
          VK_QUEUE_COMPUTE_BIT |
          VK_QUEUE_TRANSFER_BIT |
          (DETECT_OS_LINUX ? VK_QUEUE_SPARSE_BINDING_BIT : 0),
-         .queueCount = 1,
+         .queueCount = LVP_MAX_QUEUES,
          .timestampValidBits = 64,
          .minImageTransferGranularity = (VkExtent3D) { 1, 1, 1 },
       };
@@ -1614,13 +1614,22 @@ VKAPI_ATTR PFN_vkVoidFunction VKAPI_CALL vk_icdGetInstanceProcAddr(
 }
 
 static void
-destroy_pipelines(struct lvp_queue *queue)
+destroy_pipelines(struct lvp_device *device)
 {
+   struct lvp_queue *queue = &device->queue;
+   struct util_dynarray destroys;
+
+   /* Take the list and destroy outside of the lock, destroying the
+    * shader states of the other queues takes their locks.
+    */
    simple_mtx_lock(&queue->lock);
-   while (util_dynarray_contains(&queue->pipeline_destroys, struct lvp_pipeline*)) {
-      lvp_pipeline_destroy(queue->device, util_dynarray_pop(&queue->pipeline_destroys, struct lvp_pipeline*), true);
-   }
+   destroys = queue->pipeline_destroys;
+   util_dynarray_init(&queue->pipeline_destroys, NULL);
    simple_mtx_unlock(&queue->lock);
+
+   util_dynarray_foreach(&destroys, struct lvp_pipeline *, pipeline)
+      lvp_pipeline_destroy(device, *pipeline, false);
+   util_dynarray_fini(&destroys);
 }
 
 static VkResult
@@ -1672,7 +1681,7 @@ lvp_queue_submit(struct vk_queue *vk_queue,
          vk_sync_as_lvp_pipe_sync(submit->signals[i].sync);
       lvp_pipe_sync_signal_with_fence(queue->device, sync, queue->last_fence);
    }
-   destroy_pipelines(queue);
+   destroy_pipelines(queue->device);
 
    return VK_SUCCESS;
 }
@@ -1701,21 +1710,28 @@ lvp_queue_init(struct lvp_device *device, struct lvp_queue *queue,
 
    queue->vk.driver_submit = lvp_queue_submit;
 
+   nir_builder b = nir_builder_init_simple_shader(MESA_SHADER_FRAGMENT, device->physical_device->drv_options[MESA_SHADER_FRAGMENT], "dummy_frag");
+   struct pipe_shader_state shstate = {0};
+   shstate.type = PIPE_SHADER_IR_NIR;
+   shstate.ir.nir = b.shader;
+   queue->noop_fs = queue->ctx->create_fs_state(queue->ctx, &shstate);
+
    simple_mtx_init(&queue->lock, mtx_plain);
    util_dynarray_init(&queue->pipeline_destroys, NULL);
 
    return VK_SUCCESS;
 }
 
+/* The queue must have been stopped with vk_queue_finish() already. */
 static void
 lvp_queue_finish(struct lvp_queue *queue)
 {
-   vk_queue_finish(&queue->vk);
-
-   destroy_pipelines(queue);
    simple_mtx_destroy(&queue->lock);
    util_dynarray_fini(&queue->pipeline_destroys);
 
+   if (queue->last_fence)
+      queue->device->pscreen->fence_reference(queue->device->pscreen, &queue->last_fence, NULL);
+   queue->ctx->delete_fs_state(queue->ctx, queue->noop_fs);
    u_upload_destroy(queue->uploader);
    cso_destroy_context(queue->cso);
    queue->ctx->destroy(queue->ctx);
@@ -1743,6 +1759,7 @@ VKAPI_ATTR VkResult VKAPI_CALL lvp_CreateDevice(
    device->queue.state = device + 1;
    device->poison_mem = debug_get_bool_option("LVP_POISON_MEMORY", false);
    device->print_cmds = debug_get_bool_option("LVP_CMD_DEBUG", false);
+   device->compute_as_build = debug_get_bool_option("LVP_COMPUTE_AS_BUILD", false);
 
    struct vk_device_dispatch_table dispatch_table;
    vk_device_dispatch_table_from_entrypoints(&dispatch_table,
@@ -1769,18 +1786,43 @@ VKAPI_ATTR VkResult VKAPI_CALL lvp_CreateDevice(
 
    assert(pCreateInfo->queueCreateInfoCount == 1);
    assert(pCreateInfo->pQueueCreateInfos[0].queueFamilyIndex == 0);
-   assert(pCreateInfo->pQueueCreateInfos[0].queueCount == 1);
+   assert(pCreateInfo->pQueueCreateInfos[0].queueCount <= LVP_MAX_QUEUES);
    result = lvp_queue_init(device, &device->queue, pCreateInfo->pQueueCreateInfos, 0);
    if (result != VK_SUCCESS) {
       vk_free(&device->vk.alloc, device);
       return result;
    }
+   device->queues[0] = &device->queue;
+   device->queue_count = 1;
+
+   for (uint32_t i = 1; i < pCreateInfo->pQueueCreateInfos[0].queueCount; i++) {
+      struct lvp_queue *queue = vk_zalloc(&device->vk.alloc, sizeof(*queue) + state_size, 8,
+                                          VK_SYSTEM_ALLOCATION_SCOPE_DEVICE);
+      if (!queue) {
+         result = vk_error(device, VK_ERROR_OUT_OF_HOST_MEMORY);
+         break;
+      }
+
+      queue->state = queue + 1;
+      result = lvp_queue_init(device, queue, pCreateInfo->pQueueCreateInfos, i);
+      if (result != VK_SUCCESS) {
+         vk_free(&device->vk.alloc, queue);
+         break;
+      }
+      device->queues[device->queue_count++] = queue;
+   }
+   if (result != VK_SUCCESS) {
+      for (uint32_t i = device->queue_count; i-- > 0;) {
+         vk_queue_finish(&device->queues[i]->vk);
+         lvp_queue_finish(device->queues[i]);
+         if (i)
+            vk_free(&device->vk.alloc, device->queues[i]);
+      }
+      vk_device_finish(&device->vk);
+      vk_free(&device->vk.alloc, device);
+      return result;
+   }
 
-   nir_builder b = nir_builder_init_simple_shader(MESA_SHADER_FRAGMENT, physical_device->drv_options[MESA_SHADER_FRAGMENT], "dummy_frag");
-   struct pipe_shader_state shstate = {0};
-   shstate.type = PIPE_SHADER_IR_NIR;
-   shstate.ir.nir = b.shader;
-   device->noop_fs = device->queue.ctx->create_fs_state(device->queue.ctx, &shstate);
    _mesa_hash_table_init(&device->bda, NULL, _mesa_hash_pointer, _mesa_key_pointer_equal);
    simple_mtx_init(&device->bda_lock, mtx_plain);
 
@@ -1834,15 +1876,20 @@ VKAPI_ATTR void VKAPI_CALL lvp_DestroyDevice(
    device->queue.ctx->delete_texture_handle(device->queue.ctx, (uint64_t)(uintptr_t)device->null_texture_handle);
    device->queue.ctx->delete_image_handle(device->queue.ctx, (uint64_t)(uintptr_t)device->null_image_handle);
 
-   device->queue.ctx->delete_fs_state(device->queue.ctx, device->noop_fs);
-
-   if (device->queue.last_fence)
-      device->pscreen->fence_reference(device->pscreen, &device->queue.last_fence, NULL);
    ralloc_free(device->bda.table);
    simple_mtx_destroy(&device->bda_lock);
    pipe_resource_reference(&device->zero_buffer, NULL);
 
-   lvp_queue_finish(&device->queue);
+   /* The pending pipelines may have states on any of the queues. */
+   for (uint32_t i = 0; i < device->queue_count; i++)
+      vk_queue_finish(&device->queues[i]->vk);
+   destroy_pipelines(device);
+
+   for (uint32_t i = device->queue_count; i-- > 0;) {
+      lvp_queue_finish(device->queues[i]);
+      if (i)
+         vk_free(&device->vk.alloc, device->queues[i]);
+   }
    vk_device_finish(&device->vk);
    vk_free(&device->vk.alloc, device);
 }
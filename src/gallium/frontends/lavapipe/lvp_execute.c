@@ -46,6 +46,7 @@
 #include "util/ptralloc.h"
 #include "tgsi/tgsi_from_mesa.h"
 
+#include "radix_sort/radix_sort_host.h"
 #include "vk_blend.h"
 #include "vk_cmd_enqueue_entrypoints.h"
 #include "vk_descriptor_update_template.h"
@@ -90,6 +91,7 @@ struct lvp_conditional_rendering_state {
 struct rendering_state {
    struct pipe_context *pctx;
    struct lvp_device *device;
+   struct lvp_queue *queue;
    struct u_upload_mgr *uploader;
    struct cso_context *cso;
 
@@ -321,7 +323,7 @@ static void emit_compute_state(struct rendering_state *state)
    }
 
    if (state->compute_shader_dirty)
-      state->pctx->bind_compute_state(state->pctx, state->shaders[MESA_SHADER_COMPUTE]->shader_cso);
+      state->pctx->bind_compute_state(state->pctx, lvp_shader_get_cso(state->queue, state->shaders[MESA_SHADER_COMPUTE], false));
 
    state->compute_shader_dirty = false;
 
@@ -373,7 +375,7 @@ static void update_vertex_elements_buffer_index(struct rendering_state *state)
 static void emit_state(struct rendering_state *state)
 {
    if (!state->shaders[MESA_SHADER_FRAGMENT] && !state->noop_fs_bound) {
-      state->pctx->bind_fs_state(state->pctx, state->device->noop_fs);
+      state->pctx->bind_fs_state(state->pctx, state->queue->noop_fs);
       state->noop_fs_bound = true;
    }
    if (state->blend_dirty) {
@@ -608,37 +610,37 @@ handle_graphics_stages(struct rendering_state *state, VkShaderStageFlagBits shad
 
       switch (vk_stage) {
       case VK_SHADER_STAGE_FRAGMENT_BIT:
-         state->pctx->bind_fs_state(state->pctx, state->shaders[MESA_SHADER_FRAGMENT]->shader_cso);
+         state->pctx->bind_fs_state(state->pctx, lvp_shader_get_cso(state->queue, state->shaders[MESA_SHADER_FRAGMENT], false));
          state->noop_fs_bound = false;
          break;
       case VK_SHADER_STAGE_VERTEX_BIT:
-         state->pctx->bind_vs_state(state->pctx, state->shaders[MESA_SHADER_VERTEX]->shader_cso);
+         state->pctx->bind_vs_state(state->pctx, lvp_shader_get_cso(state->queue, state->shaders[MESA_SHADER_VERTEX], false));
          break;
       case VK_SHADER_STAGE_GEOMETRY_BIT:
-         state->pctx->bind_gs_state(state->pctx, state->shaders[MESA_SHADER_GEOMETRY]->shader_cso);
+         state->pctx->bind_gs_state(state->pctx, lvp_shader_get_cso(state->queue, state->shaders[MESA_SHADER_GEOMETRY], false));
          state->gs_output_lines = state->shaders[MESA_SHADER_GEOMETRY]->pipeline_nir->nir->info.gs.output_primitive == MESA_PRIM_LINES ? GS_OUTPUT_LINES : GS_OUTPUT_NOT_LINES;
          break;
       case VK_SHADER_STAGE_TESSELLATION_CONTROL_BIT:
-         state->pctx->bind_tcs_state(state->pctx, state->shaders[MESA_SHADER_TESS_CTRL]->shader_cso);
+         state->pctx->bind_tcs_state(state->pctx, lvp_shader_get_cso(state->queue, state->shaders[MESA_SHADER_TESS_CTRL], false));
          break;
       case VK_SHADER_STAGE_TESSELLATION_EVALUATION_BIT:
          state->tess_states[0] = NULL;
          state->tess_states[1] = NULL;
          if (dynamic_tess_origin) {
-            state->tess_states[0] = state->shaders[MESA_SHADER_TESS_EVAL]->shader_cso;
-            state->tess_states[1] = state->shaders[MESA_SHADER_TESS_EVAL]->tess_ccw_cso;
+            state->tess_states[0] = lvp_shader_get_cso(state->queue, state->shaders[MESA_SHADER_TESS_EVAL], false);
+            state->tess_states[1] = lvp_shader_get_cso(state->queue, state->shaders[MESA_SHADER_TESS_EVAL], true);
             state->pctx->bind_tes_state(state->pctx, state->tess_states[state->tess_ccw]);
          } else {
-            state->pctx->bind_tes_state(state->pctx, state->shaders[MESA_SHADER_TESS_EVAL]->shader_cso);
+            state->pctx->bind_tes_state(state->pctx, lvp_shader_get_cso(state->queue, state->shaders[MESA_SHADER_TESS_EVAL], false));
          }
          if (!dynamic_tess_origin)
             state->tess_ccw = false;
          break;
       case VK_SHADER_STAGE_TASK_BIT_EXT:
-         state->pctx->bind_ts_state(state->pctx, state->shaders[MESA_SHADER_TASK]->shader_cso);
+         state->pctx->bind_ts_state(state->pctx, lvp_shader_get_cso(state->queue, state->shaders[MESA_SHADER_TASK], false));
          break;
       case VK_SHADER_STAGE_MESH_BIT_EXT:
-         state->pctx->bind_ms_state(state->pctx, state->shaders[MESA_SHADER_MESH]->shader_cso);
+         state->pctx->bind_ms_state(state->pctx, lvp_shader_get_cso(state->queue, state->shaders[MESA_SHADER_MESH], false));
          break;
       default:
          assert(0);
@@ -702,7 +704,7 @@ static void handle_graphics_pipeline(struct lvp_pipeline *pipeline,
                                      struct rendering_state *state)
 {
    const struct vk_graphics_pipeline_state *ps = &pipeline->graphics_state;
-   lvp_pipeline_shaders_compile(pipeline, true);
+   lvp_pipeline_shaders_compile(pipeline, state->queue == &state->device->queue);
    bool dynamic_tess_origin = BITSET_TEST(ps->dynamic, MESA_VK_DYNAMIC_TS_DOMAIN_ORIGIN);
    unbind_graphics_stages(state,
                           (~pipeline->graphics_state.shader_stages) &
@@ -2770,7 +2772,9 @@ static void handle_push_constants(struct vk_cmd_queue_entry *cmd,
    state->pcbuf_dirty[MESA_SHADER_RAYGEN] |= (stage_flags & LVP_RAY_TRACING_STAGES) > 0;
 }
 
-static void lvp_execute_cmd_buffer(struct list_head *cmds,
+static void lvp_execute_cmd_list(struct list_head *cmds,
+                                 struct rendering_state *state, bool print_cmds);
+static void lvp_execute_cmd_buffer(struct lvp_cmd_buffer *cmd_buffer,
                                    struct rendering_state *state, bool print_cmds);
 
 static void handle_execute_commands(struct vk_cmd_queue_entry *cmd,
@@ -2778,7 +2782,7 @@ static void handle_execute_commands(struct vk_cmd_queue_entry *cmd,
 {
    for (unsigned i = 0; i < cmd->u.execute_commands.command_buffer_count; i++) {
       LVP_FROM_HANDLE(lvp_cmd_buffer, secondary_buf, cmd->u.execute_commands.command_buffers[i]);
-      lvp_execute_cmd_buffer(&secondary_buf->vk.cmd_queue.cmds, state, print_cmds);
+      lvp_execute_cmd_buffer(secondary_buf, state, print_cmds);
    }
 }
 
@@ -4175,7 +4179,7 @@ handle_execute_generated_commands_ext(struct vk_cmd_queue_entry *cmd, struct ren
 
    struct vk_cmd_queue_entry *exec_cmd = list_first_entry(list, struct vk_cmd_queue_entry, cmd_link);
    if (exec_cmd)
-      lvp_execute_cmd_buffer(list, state, print_cmds);
+      lvp_execute_cmd_list(list, state, print_cmds);
 }
 
 static void
@@ -4560,7 +4564,7 @@ lvp_trace_rays(struct rendering_state *state, VkTraceRaysIndirectCommand2KHR *co
       state->constbuf_dirty[MESA_SHADER_RAYGEN] = false;
    }
 
-   state->pctx->bind_compute_state(state->pctx, state->shaders[MESA_SHADER_RAYGEN]->shader_cso);
+   state->pctx->bind_compute_state(state->pctx, lvp_shader_get_cso(state->queue, state->shaders[MESA_SHADER_RAYGEN], false));
 
    state->pcbuf_dirty[MESA_SHADER_COMPUTE] = true;
    state->constbuf_dirty[MESA_SHADER_COMPUTE] = true;
@@ -4738,6 +4742,28 @@ handle_encode_as(struct vk_cmd_queue_entry *cmd, struct rendering_state *state)
                  encode->geometry_type);
 }
 
+static void
+handle_build_as(struct vk_cmd_queue_entry *cmd, struct rendering_state *state)
+{
+   struct lvp_cmd_build_as *build = cmd->driver_data;
+
+   finish_fence(state);
+
+   lvp_build_as(state->device, build);
+}
+
+static void
+handle_radix_sort(struct vk_cmd_queue_entry *cmd, struct rendering_state *state)
+{
+   struct lvp_device *device = state->device;
+   const struct radix_sort_host_info *info = cmd->driver_data;
+
+   finish_fence(state);
+
+   radix_sort_host_sort(info, util_queue_is_initialized(&device->as_build_queue) ?
+                              &device->as_build_queue : NULL);
+}
+
 static void
 handle_save_state(struct vk_cmd_queue_entry *cmd, struct rendering_state *state)
 {
@@ -4765,7 +4791,7 @@ void lvp_add_enqueue_cmd_entrypoints(struct vk_device_dispatch_table *disp)
    assert(cmd_enqueue_dispatch.CmdName != NULL); \
    disp->CmdName = cmd_enqueue_dispatch.CmdName;
 
-   /* This list needs to match what's in lvp_execute_cmd_buffer exactly */
+   /* This list needs to match what's in lvp_execute_cmd exactly */
    ENQUEUE_CMD(CmdBindPipeline)
    ENQUEUE_CMD(CmdSetViewport)
    ENQUEUE_CMD(CmdSetViewportWithCount)
@@ -4914,419 +4940,668 @@ void lvp_add_enqueue_cmd_entrypoints(struct vk_device_dispatch_table *disp)
 #undef ENQUEUE_CMD
 }
 
-static void lvp_execute_cmd_buffer(struct list_head *cmds,
-                                   struct rendering_state *state, bool print_cmds)
+static void lvp_execute_cmd(struct vk_cmd_queue_entry *cmd,
+                            struct rendering_state *state, bool print_cmds,
+                            bool *did_flush)
+{
+   if (cmd->type >= VK_CMD_TYPE_COUNT) {
+      uint32_t type = cmd->type;
+      if (type == LVP_CMD_WRITE_BUFFER_CP) {
+         handle_write_buffer_cp(cmd, state);
+      } else if (type == LVP_CMD_DISPATCH_UNALIGNED) {
+         emit_compute_state(state);
+         handle_dispatch_unaligned(cmd, state);
+      } else if (type == LVP_CMD_FILL_BUFFER_ADDR) {
+         handle_fill_buffer_addr(cmd, state);
+      } else if (type == LVP_CMD_ENCODE_AS) {
+         handle_encode_as(cmd, state);
+      } else if (type == LVP_CMD_BUILD_AS) {
+         handle_build_as(cmd, state);
+      } else if (type == LVP_CMD_RADIX_SORT) {
+         handle_radix_sort(cmd, state);
+      } else if (type == LVP_CMD_SAVE_STATE) {
+         handle_save_state(cmd, state);
+      } else if (type == LVP_CMD_RESTORE_STATE) {
+         handle_restore_state(cmd, state);
+      }
+      return;
+   }
+
+   if (print_cmds)
+      fprintf(stderr, "%s\n", vk_cmd_queue_type_names[cmd->type]);
+   switch ((unsigned)cmd->type) {
+   case VK_CMD_BIND_PIPELINE:
+      handle_pipeline(cmd, state);
+      break;
+   case VK_CMD_SET_VIEWPORT:
+      handle_set_viewport(cmd, state);
+      break;
+   case VK_CMD_SET_VIEWPORT_WITH_COUNT:
+      handle_set_viewport_with_count(cmd, state);
+      break;
+   case VK_CMD_SET_SCISSOR:
+      handle_set_scissor(cmd, state);
+      break;
+   case VK_CMD_SET_SCISSOR_WITH_COUNT:
+      handle_set_scissor_with_count(cmd, state);
+      break;
+   case VK_CMD_SET_LINE_WIDTH:
+      handle_set_line_width(cmd, state);
+      break;
+   case VK_CMD_SET_DEPTH_BIAS:
+      handle_set_depth_bias(cmd, state);
+      break;
+   case VK_CMD_SET_BLEND_CONSTANTS:
+      handle_set_blend_constants(cmd, state);
+      break;
+   case VK_CMD_SET_DEPTH_BOUNDS:
+      handle_set_depth_bounds(cmd, state);
+      break;
+   case VK_CMD_SET_STENCIL_COMPARE_MASK:
+      handle_set_stencil_compare_mask(cmd, state);
+      break;
+   case VK_CMD_SET_STENCIL_WRITE_MASK:
+      handle_set_stencil_write_mask(cmd, state);
+      break;
+   case VK_CMD_SET_STENCIL_REFERENCE:
+      handle_set_stencil_reference(cmd, state);
+      break;
+   case VK_CMD_BIND_DESCRIPTOR_SETS2:
+      handle_descriptor_sets_cmd(cmd, state);
+      break;
+   case VK_CMD_BIND_INDEX_BUFFER:
+      handle_index_buffer(cmd, state);
+      break;
+   case VK_CMD_BIND_INDEX_BUFFER2:
+      handle_index_buffer2(cmd, state);
+      break;
+   case VK_CMD_BIND_VERTEX_BUFFERS2:
+      handle_vertex_buffers2(cmd, state);
+      break;
+   case VK_CMD_DRAW:
+      emit_state(state);
+      handle_draw(cmd, state);
+      break;
+   case VK_CMD_DRAW_MULTI_EXT:
+      emit_state(state);
+      handle_draw_multi(cmd, state);
+      break;
+   case VK_CMD_DRAW_INDEXED:
+      emit_state(state);
+      handle_draw_indexed(cmd, state);
+      break;
+   case VK_CMD_DRAW_INDIRECT:
+      emit_state(state);
+      handle_draw_indirect(cmd, state, false);
+      break;
+   case VK_CMD_DRAW_INDEXED_INDIRECT:
+      emit_state(state);
+      handle_draw_indirect(cmd, state, true);
+      break;
+   case VK_CMD_DRAW_MULTI_INDEXED_EXT:
+      emit_state(state);
+      handle_draw_multi_indexed(cmd, state);
+      break;
+   case VK_CMD_DISPATCH:
+      emit_compute_state(state);
+      handle_dispatch(cmd, state);
+      break;
+   case VK_CMD_DISPATCH_BASE:
+      emit_compute_state(state);
+      handle_dispatch_base(cmd, state);
+      break;
+   case VK_CMD_DISPATCH_INDIRECT:
+      emit_compute_state(state);
+      handle_dispatch_indirect(cmd, state);
+      break;
+   case VK_CMD_COPY_BUFFER2:
+      handle_copy_buffer(cmd, state);
+      break;
+   case VK_CMD_COPY_IMAGE2:
+      handle_copy_image(cmd, state);
+      break;
+   case VK_CMD_BLIT_IMAGE2:
+      handle_blit_image(cmd, state);
+      break;
+   case VK_CMD_COPY_BUFFER_TO_IMAGE2:
+      handle_copy_buffer_to_image(cmd, state);
+      break;
+   case VK_CMD_COPY_IMAGE_TO_BUFFER2:
+      handle_copy_image_to_buffer2(cmd, state);
+      break;
+   case VK_CMD_UPDATE_BUFFER:
+      handle_update_buffer(cmd, state);
+      break;
+   case VK_CMD_FILL_BUFFER:
+      handle_fill_buffer(cmd, state);
+      break;
+   case VK_CMD_CLEAR_COLOR_IMAGE:
+      handle_clear_color_image(cmd, state);
+      break;
+   case VK_CMD_CLEAR_DEPTH_STENCIL_IMAGE:
+      handle_clear_ds_image(cmd, state);
+      break;
+   case VK_CMD_CLEAR_ATTACHMENTS:
+      handle_clear_attachments(cmd, state);
+      break;
+   case VK_CMD_RESOLVE_IMAGE2:
+      handle_resolve_image(cmd, state);
+      break;
+   case VK_CMD_PIPELINE_BARRIER2:
+      /* flushes are actually stalls, so multiple flushes are redundant */
+      if (*did_flush)
+         return;
+      handle_pipeline_barrier(cmd, state);
+      *did_flush = true;
+      return;
+   case VK_CMD_BEGIN_QUERY_INDEXED_EXT:
+      handle_begin_query_indexed_ext(cmd, state);
+      break;
+   case VK_CMD_END_QUERY_INDEXED_EXT:
+      handle_end_query_indexed_ext(cmd, state);
+      break;
+   case VK_CMD_BEGIN_QUERY:
+      handle_begin_query(cmd, state);
+      break;
+   case VK_CMD_END_QUERY:
+      handle_end_query(cmd, state);
+      break;
+   case VK_CMD_RESET_QUERY_POOL:
+      handle_reset_query_pool(cmd, state);
+      break;
+   case VK_CMD_COPY_QUERY_POOL_RESULTS:
+      handle_copy_query_pool_results(cmd, state);
+      break;
+   case VK_CMD_PUSH_CONSTANTS2:
+      handle_push_constants(cmd, state);
+      break;
+   case VK_CMD_EXECUTE_COMMANDS:
+      handle_execute_commands(cmd, state, print_cmds);
+      break;
+   case VK_CMD_DRAW_INDIRECT_COUNT:
+      emit_state(state);
+      handle_draw_indirect_count(cmd, state, false);
+      break;
+   case VK_CMD_DRAW_INDEXED_INDIRECT_COUNT:
+      emit_state(state);
+      handle_draw_indirect_count(cmd, state, true);
+      break;
+   case VK_CMD_PUSH_DESCRIPTOR_SET2:
+      handle_push_descriptor_set(cmd, state);
+      break;
+   case VK_CMD_PUSH_DESCRIPTOR_SET_WITH_TEMPLATE2:
+      handle_push_descriptor_set_with_template(cmd, state);
+      break;
+   case VK_CMD_BIND_TRANSFORM_FEEDBACK_BUFFERS_EXT:
+      handle_bind_transform_feedback_buffers(cmd, state);
+      break;
+   case VK_CMD_BEGIN_TRANSFORM_FEEDBACK_EXT:
+      handle_begin_transform_feedback(cmd, state);
+      break;
+   case VK_CMD_END_TRANSFORM_FEEDBACK_EXT:
+      handle_end_transform_feedback(cmd, state);
+      break;
+   case VK_CMD_DRAW_INDIRECT_BYTE_COUNT_EXT:
+      emit_state(state);
+      handle_draw_indirect_byte_count(cmd, state);
+      break;
+   case VK_CMD_BEGIN_CONDITIONAL_RENDERING_EXT:
+      handle_begin_conditional_rendering(cmd, state);
+      break;
+   case VK_CMD_END_CONDITIONAL_RENDERING_EXT:
+      handle_end_conditional_rendering(state);
+      break;
+   case VK_CMD_SET_VERTEX_INPUT_EXT:
+      handle_set_vertex_input(cmd, state);
+      break;
+   case VK_CMD_SET_CULL_MODE:
+      handle_set_cull_mode(cmd, state);
+      break;
+   case VK_CMD_SET_FRONT_FACE:
+      handle_set_front_face(cmd, state);
+      break;
+   case VK_CMD_SET_PRIMITIVE_TOPOLOGY:
+      handle_set_primitive_topology(cmd, state);
+      break;
+   case VK_CMD_SET_DEPTH_TEST_ENABLE:
+      handle_set_depth_test_enable(cmd, state);
+      break;
+   case VK_CMD_SET_DEPTH_WRITE_ENABLE:
+      handle_set_depth_write_enable(cmd, state);
+      break;
+   case VK_CMD_SET_DEPTH_COMPARE_OP:
+      handle_set_depth_compare_op(cmd, state);
+      break;
+   case VK_CMD_SET_DEPTH_BOUNDS_TEST_ENABLE:
+      handle_set_depth_bounds_test_enable(cmd, state);
+      break;
+   case VK_CMD_SET_STENCIL_TEST_ENABLE:
+      handle_set_stencil_test_enable(cmd, state);
+      break;
+   case VK_CMD_SET_STENCIL_OP:
+      handle_set_stencil_op(cmd, state);
+      break;
+   case VK_CMD_SET_LINE_STIPPLE:
+      handle_set_line_stipple(cmd, state);
+      break;
+   case VK_CMD_SET_DEPTH_BIAS_ENABLE:
+      handle_set_depth_bias_enable(cmd, state);
+      break;
+   case VK_CMD_SET_LOGIC_OP_EXT:
+      handle_set_logic_op(cmd, state);
+      break;
+   case VK_CMD_SET_PATCH_CONTROL_POINTS_EXT:
+      handle_set_patch_control_points(cmd, state);
+      break;
+   case VK_CMD_SET_PRIMITIVE_RESTART_ENABLE:
+      handle_set_primitive_restart_enable(cmd, state);
+      break;
+   case VK_CMD_SET_RASTERIZER_DISCARD_ENABLE:
+      handle_set_rasterizer_discard_enable(cmd, state);
+      break;
+   case VK_CMD_SET_COLOR_WRITE_ENABLE_EXT:
+      handle_set_color_write_enable(cmd, state);
+      break;
+   case VK_CMD_BEGIN_RENDERING:
+      handle_begin_rendering(cmd, state);
+      break;
+   case VK_CMD_END_RENDERING:
+      handle_end_rendering(cmd, state);
+      break;
+   case VK_CMD_SET_DEVICE_MASK:
+      /* no-op */
+      break;
+   case VK_CMD_RESET_EVENT2:
+      handle_event_reset2(cmd, state);
+      break;
+   case VK_CMD_SET_EVENT2:
+      handle_event_set2(cmd, state);
+      break;
+   case VK_CMD_WAIT_EVENTS2:
+      handle_wait_events2(cmd, state);
+      break;
+   case VK_CMD_WRITE_TIMESTAMP2:
+      handle_write_timestamp2(cmd, state);
+      break;
+   case VK_CMD_SET_POLYGON_MODE_EXT:
+      handle_set_polygon_mode(cmd, state);
+      break;
+   case VK_CMD_SET_TESSELLATION_DOMAIN_ORIGIN_EXT:
+      handle_set_tessellation_domain_origin(cmd, state);
+      break;
+   case VK_CMD_SET_DEPTH_CLAMP_ENABLE_EXT:
+      handle_set_depth_clamp_enable(cmd, state);
+      break;
+   case VK_CMD_SET_DEPTH_CLIP_ENABLE_EXT:
+      handle_set_depth_clip_enable(cmd, state);
+      break;
+   case VK_CMD_SET_LOGIC_OP_ENABLE_EXT:
+      handle_set_logic_op_enable(cmd, state);
+      break;
+   case VK_CMD_SET_SAMPLE_MASK_EXT:
+      handle_set_sample_mask(cmd, state);
+      break;
+   case VK_CMD_SET_RASTERIZATION_SAMPLES_EXT:
+      handle_set_samples(cmd, state);
+      break;
+   case VK_CMD_SET_ALPHA_TO_COVERAGE_ENABLE_EXT:
+      handle_set_alpha_to_coverage(cmd, state);
+      break;
+   case VK_CMD_SET_ALPHA_TO_ONE_ENABLE_EXT:
+      handle_set_alpha_to_one(cmd, state);
+      break;
+   case VK_CMD_SET_DEPTH_CLIP_NEGATIVE_ONE_TO_ONE_EXT:
+      handle_set_halfz(cmd, state);
+      break;
+   case VK_CMD_SET_LINE_RASTERIZATION_MODE_EXT:
+      handle_set_line_rasterization_mode(cmd, state);
+      break;
+   case VK_CMD_SET_LINE_STIPPLE_ENABLE_EXT:
+      handle_set_line_stipple_enable(cmd, state);
+      break;
+   case VK_CMD_SET_PROVOKING_VERTEX_MODE_EXT:
+      handle_set_provoking_vertex_mode(cmd, state);
+      break;
+   case VK_CMD_SET_COLOR_BLEND_ENABLE_EXT:
+      handle_set_color_blend_enable(cmd, state);
+      break;
+   case VK_CMD_SET_COLOR_WRITE_MASK_EXT:
+      handle_set_color_write_mask(cmd, state);
+      break;
+   case VK_CMD_SET_COLOR_BLEND_EQUATION_EXT:
+      handle_set_color_blend_equation(cmd, state);
+      break;
+   case VK_CMD_BIND_SHADERS_EXT:
+      handle_shaders(cmd, state);
+      break;
+   case VK_CMD_SET_ATTACHMENT_FEEDBACK_LOOP_ENABLE_EXT:
+      break;
+   case VK_CMD_DRAW_MESH_TASKS_EXT:
+      emit_state(state);
+      handle_draw_mesh_tasks(cmd, state);
+      break;
+   case VK_CMD_DRAW_MESH_TASKS_INDIRECT_EXT:
+      emit_state(state);
+      handle_draw_mesh_tasks_indirect(cmd, state);
+      break;
+   case VK_CMD_DRAW_MESH_TASKS_INDIRECT_COUNT_EXT:
+      emit_state(state);
+      handle_draw_mesh_tasks_indirect_count(cmd, state);
+      break;
+   case VK_CMD_PREPROCESS_GENERATED_COMMANDS_EXT:
+      handle_preprocess_generated_commands_ext(cmd, state, print_cmds);
+      break;
+   case VK_CMD_EXECUTE_GENERATED_COMMANDS_EXT:
+      handle_execute_generated_commands_ext(cmd, state, print_cmds);
+      break;
+   case VK_CMD_BIND_DESCRIPTOR_BUFFERS_EXT:
+      handle_descriptor_buffers(cmd, state);
+      break;
+   case VK_CMD_SET_DESCRIPTOR_BUFFER_OFFSETS2_EXT:
+      handle_descriptor_buffer_offsets(cmd, state);
+      break;
+   case VK_CMD_BIND_DESCRIPTOR_BUFFER_EMBEDDED_SAMPLERS2_EXT:
+      handle_descriptor_buffer_embedded_samplers(cmd, state);
+      break;
+#ifdef VK_ENABLE_BETA_EXTENSIONS
+   case VK_CMD_INITIALIZE_GRAPH_SCRATCH_MEMORY_AMDX:
+      break;
+   case VK_CMD_DISPATCH_GRAPH_INDIRECT_COUNT_AMDX:
+      break;
+   case VK_CMD_DISPATCH_GRAPH_INDIRECT_AMDX:
+      break;
+   case VK_CMD_DISPATCH_GRAPH_AMDX:
+      handle_dispatch_graph(cmd, state);
+      break;
+#endif
+   case VK_CMD_SET_RENDERING_ATTACHMENT_LOCATIONS:
+      handle_rendering_attachment_locations(cmd, state);
+      break;
+   case VK_CMD_SET_RENDERING_INPUT_ATTACHMENT_INDICES:
+      handle_rendering_input_attachment_indices(cmd, state);
+      break;
+   case VK_CMD_COPY_ACCELERATION_STRUCTURE_KHR:
+      handle_copy_acceleration_structure(cmd, state);
+      break;
+   case VK_CMD_COPY_MEMORY_TO_ACCELERATION_STRUCTURE_KHR:
+      handle_copy_memory_to_acceleration_structure(cmd, state);
+      break;
+   case VK_CMD_COPY_ACCELERATION_STRUCTURE_TO_MEMORY_KHR:
+      handle_copy_acceleration_structure_to_memory(cmd, state);
+      break;
+   case VK_CMD_BUILD_ACCELERATION_STRUCTURES_INDIRECT_KHR:
+      break;
+   case VK_CMD_WRITE_ACCELERATION_STRUCTURES_PROPERTIES_KHR:
+      handle_write_acceleration_structures_properties(cmd, state);
+      break;
+   case VK_CMD_SET_RAY_TRACING_PIPELINE_STACK_SIZE_KHR:
+      break;
+   case VK_CMD_TRACE_RAYS_INDIRECT2_KHR:
+      handle_trace_rays_indirect2(cmd, state);
+      break;
+   case VK_CMD_TRACE_RAYS_INDIRECT_KHR:
+      handle_trace_rays_indirect(cmd, state);
+      break;
+   case VK_CMD_TRACE_RAYS_KHR:
+      handle_trace_rays(cmd, state);
+      break;
+   default:
+      fprintf(stderr, "Unsupported command %s\n", vk_cmd_queue_type_names[cmd->type]);
+      unreachable("Unsupported command");
+      break;
+   }
+   *did_flush = false;
+}
+
+static void lvp_execute_cmd_list(struct list_head *cmds,
+                                 struct rendering_state *state, bool print_cmds)
 {
    struct vk_cmd_queue_entry *cmd;
    bool did_flush = false;
 
    LIST_FOR_EACH_ENTRY(cmd, cmds, cmd_link) {
+      lvp_execute_cmd(cmd, state, print_cmds, &did_flush);
+      if (!cmd->cmd_link.next)
+         break;
+   }
+}
+
+static void lvp_execute_cmd_buffer(struct lvp_cmd_buffer *cmd_buffer,
+                                   struct rendering_state *state, bool print_cmds)
+{
+   bool did_flush = false;
+
+   if (!cmd_buffer->baked) {
+      lvp_execute_cmd_list(&cmd_buffer->vk.cmd_queue.cmds, state, print_cmds);
+      return;
+   }
+
+   util_dynarray_foreach(&cmd_buffer->baked_cmds, struct vk_cmd_queue_entry *, cmd)
+      lvp_execute_cmd(*cmd, state, print_cmds, &did_flush);
+}
+
+/* Dynamic state commands whose arguments can be compared by value. */
+static bool
+cmd_is_dynamic_state(enum vk_cmd_type type)
+{
+   switch (type) {
+   case VK_CMD_SET_VIEWPORT:
+   case VK_CMD_SET_VIEWPORT_WITH_COUNT:
+   case VK_CMD_SET_SCISSOR:
+   case VK_CMD_SET_SCISSOR_WITH_COUNT:
+   case VK_CMD_SET_LINE_WIDTH:
+   case VK_CMD_SET_DEPTH_BIAS:
+   case VK_CMD_SET_BLEND_CONSTANTS:
+   case VK_CMD_SET_DEPTH_BOUNDS:
+   case VK_CMD_SET_STENCIL_COMPARE_MASK:
+   case VK_CMD_SET_STENCIL_WRITE_MASK:
+   case VK_CMD_SET_STENCIL_REFERENCE:
+   case VK_CMD_SET_CULL_MODE:
+   case VK_CMD_SET_FRONT_FACE:
+   case VK_CMD_SET_PRIMITIVE_TOPOLOGY:
+   case VK_CMD_SET_DEPTH_TEST_ENABLE:
+   case VK_CMD_SET_DEPTH_WRITE_ENABLE:
+   case VK_CMD_SET_DEPTH_COMPARE_OP:
+   case VK_CMD_SET_DEPTH_BOUNDS_TEST_ENABLE:
+   case VK_CMD_SET_STENCIL_TEST_ENABLE:
+   case VK_CMD_SET_STENCIL_OP:
+   case VK_CMD_SET_LINE_STIPPLE:
+   case VK_CMD_SET_DEPTH_BIAS_ENABLE:
+   case VK_CMD_SET_LOGIC_OP_EXT:
+   case VK_CMD_SET_PATCH_CONTROL_POINTS_EXT:
+   case VK_CMD_SET_PRIMITIVE_RESTART_ENABLE:
+   case VK_CMD_SET_RASTERIZER_DISCARD_ENABLE:
+   case VK_CMD_SET_POLYGON_MODE_EXT:
+   case VK_CMD_SET_TESSELLATION_DOMAIN_ORIGIN_EXT:
+   case VK_CMD_SET_DEPTH_CLAMP_ENABLE_EXT:
+   case VK_CMD_SET_DEPTH_CLIP_ENABLE_EXT:
+   case VK_CMD_SET_LOGIC_OP_ENABLE_EXT:
+   case VK_CMD_SET_RASTERIZATION_SAMPLES_EXT:
+   case VK_CMD_SET_ALPHA_TO_COVERAGE_ENABLE_EXT:
+   case VK_CMD_SET_ALPHA_TO_ONE_ENABLE_EXT:
+   case VK_CMD_SET_DEPTH_CLIP_NEGATIVE_ONE_TO_ONE_EXT:
+   case VK_CMD_SET_LINE_RASTERIZATION_MODE_EXT:
+   case VK_CMD_SET_LINE_STIPPLE_ENABLE_EXT:
+   case VK_CMD_SET_PROVOKING_VERTEX_MODE_EXT:
+      return true;
+   default:
+      return false;
+   }
+}
+
+/* Commands which set overlapping state share the slot of their group. */
+static enum vk_cmd_type
+dynamic_state_group(enum vk_cmd_type type)
+{
+   switch (type) {
+   case VK_CMD_SET_VIEWPORT_WITH_COUNT:
+   case VK_CMD_SET_DEPTH_CLIP_NEGATIVE_ONE_TO_ONE_EXT:
+      return VK_CMD_SET_VIEWPORT;
+   case VK_CMD_SET_SCISSOR_WITH_COUNT:
+      return VK_CMD_SET_SCISSOR;
+   case VK_CMD_SET_DEPTH_CLIP_ENABLE_EXT:
+      return VK_CMD_SET_DEPTH_CLAMP_ENABLE_EXT;
+   case VK_CMD_SET_ALPHA_TO_ONE_ENABLE_EXT:
+      return VK_CMD_SET_RASTERIZATION_SAMPLES_EXT;
+   default:
+      return type;
+   }
+}
+
+static bool
+dynamic_state_equal(const struct vk_cmd_queue_entry *a,
+                    const struct vk_cmd_queue_entry *b)
+{
+   if (a->type != b->type)
+      return false;
+
+   switch (a->type) {
+   case VK_CMD_SET_VIEWPORT:
+      return a->u.set_viewport.first_viewport == b->u.set_viewport.first_viewport &&
+             a->u.set_viewport.viewport_count == b->u.set_viewport.viewport_count &&
+             !memcmp(a->u.set_viewport.viewports, b->u.set_viewport.viewports,
+                     a->u.set_viewport.viewport_count * sizeof(VkViewport));
+   case VK_CMD_SET_VIEWPORT_WITH_COUNT:
+      return a->u.set_viewport_with_count.viewport_count == b->u.set_viewport_with_count.viewport_count &&
+             !memcmp(a->u.set_viewport_with_count.viewports, b->u.set_viewport_with_count.viewports,
+                     a->u.set_viewport_with_count.viewport_count * sizeof(VkViewport));
+   case VK_CMD_SET_SCISSOR:
+      return a->u.set_scissor.first_scissor == b->u.set_scissor.first_scissor &&
+             a->u.set_scissor.scissor_count == b->u.set_scissor.scissor_count &&
+             !memcmp(a->u.set_scissor.scissors, b->u.set_scissor.scissors,
+                     a->u.set_scissor.scissor_count * sizeof(VkRect2D));
+   case VK_CMD_SET_SCISSOR_WITH_COUNT:
+      return a->u.set_scissor_with_count.scissor_count == b->u.set_scissor_with_count.scissor_count &&
+             !memcmp(a->u.set_scissor_with_count.scissors, b->u.set_scissor_with_count.scissors,
+                     a->u.set_scissor_with_count.scissor_count * sizeof(VkRect2D));
+   default:
+      /* The other arguments are plain values and the entries are zero
+       * allocated, so the padding compares equal too.
+       */
+      return !memcmp(&a->u, &b->u, vk_cmd_queue_type_sizes[a->type] -
+                     offsetof(struct vk_cmd_queue_entry, u));
+   }
+}
+
+/* Commands which don't touch the state set by pipeline binds and dynamic
+ * state commands, so binding or setting the same values again across them
+ * is redundant.
+ */
+static bool
+cmd_keeps_bound_state(const struct vk_cmd_queue_entry *cmd)
+{
+   switch (cmd->type) {
+   case VK_CMD_DRAW:
+   case VK_CMD_DRAW_MULTI_EXT:
+   case VK_CMD_DRAW_INDEXED:
+   case VK_CMD_DRAW_MULTI_INDEXED_EXT:
+   case VK_CMD_DRAW_INDIRECT:
+   case VK_CMD_DRAW_INDEXED_INDIRECT:
+   case VK_CMD_DRAW_INDIRECT_COUNT:
+   case VK_CMD_DRAW_INDEXED_INDIRECT_COUNT:
+   case VK_CMD_DRAW_MESH_TASKS_EXT:
+   case VK_CMD_DRAW_MESH_TASKS_INDIRECT_EXT:
+   case VK_CMD_DRAW_MESH_TASKS_INDIRECT_COUNT_EXT:
+   case VK_CMD_DISPATCH:
+   case VK_CMD_DISPATCH_BASE:
+   case VK_CMD_DISPATCH_INDIRECT:
+   case VK_CMD_BIND_INDEX_BUFFER:
+   case VK_CMD_BIND_INDEX_BUFFER2:
+   case VK_CMD_BIND_DESCRIPTOR_SETS2:
+   case VK_CMD_PUSH_CONSTANTS2:
+   case VK_CMD_PUSH_DESCRIPTOR_SET2:
+   case VK_CMD_PUSH_DESCRIPTOR_SET_WITH_TEMPLATE2:
+      return true;
+   case VK_CMD_BIND_VERTEX_BUFFERS2:
+      /* Strides are pipeline state unless they are dynamic. */
+      return !cmd->u.bind_vertex_buffers2.strides;
+   default:
+      return false;
+   }
+}
+
+static int
+pipeline_bind_point_index(VkPipelineBindPoint bind_point)
+{
+   switch (bind_point) {
+   case VK_PIPELINE_BIND_POINT_GRAPHICS:
+      return 0;
+   case VK_PIPELINE_BIND_POINT_COMPUTE:
+      return 1;
+   case VK_PIPELINE_BIND_POINT_RAY_TRACING_KHR:
+      return 2;
+   default:
+      return -1;
+   }
+}
+
+/* Flatten the recorded commands into an array for replay at submit time,
+ * leaving out the ones which can't have any effect: rebinding the pipeline
+ * which is already bound, setting dynamic state to the value it already
+ * has and barriers directly following another barrier.  Command buffers
+ * which are submitted many times only pay for this once.
+ */
+void
+lvp_cmd_buffer_bake(struct lvp_cmd_buffer *cmd_buffer)
+{
+   struct vk_cmd_queue_entry *last_state[VK_CMD_TYPE_COUNT] = {0};
+   struct lvp_pipeline *last_pipeline[3] = {0};
+   struct vk_cmd_queue_entry *cmd;
+   bool after_barrier = false;
+
+   util_dynarray_clear(&cmd_buffer->baked_cmds);
+   cmd_buffer->baked = false;
+
+   LIST_FOR_EACH_ENTRY(cmd, &cmd_buffer->vk.cmd_queue.cmds, cmd_link) {
       if (cmd->type >= VK_CMD_TYPE_COUNT) {
-         uint32_t type = cmd->type;
-         if (type == LVP_CMD_WRITE_BUFFER_CP) {
-            handle_write_buffer_cp(cmd, state);
-         } else if (type == LVP_CMD_DISPATCH_UNALIGNED) {
-            emit_compute_state(state);
-            handle_dispatch_unaligned(cmd, state);
-         } else if (type == LVP_CMD_FILL_BUFFER_ADDR) {
-            handle_fill_buffer_addr(cmd, state);
-         } else if (type == LVP_CMD_ENCODE_AS) {
-            handle_encode_as(cmd, state);
-         } else if (type == LVP_CMD_SAVE_STATE) {
-            handle_save_state(cmd, state);
-         } else if (type == LVP_CMD_RESTORE_STATE) {
-            handle_restore_state(cmd, state);
+         /* Internal commands save and restore arbitrary state. */
+         memset(last_state, 0, sizeof(last_state));
+         memset(last_pipeline, 0, sizeof(last_pipeline));
+         after_barrier = false;
+      } else if (cmd->type == VK_CMD_PIPELINE_BARRIER2) {
+         /* flushes are actually stalls, so multiple flushes are redundant */
+         if (after_barrier)
+            continue;
+         after_barrier = true;
+      } else if (cmd->type == VK_CMD_BIND_PIPELINE) {
+         LVP_FROM_HANDLE(lvp_pipeline, pipeline, cmd->u.bind_pipeline.pipeline);
+         int index = pipeline_bind_point_index(cmd->u.bind_pipeline.pipeline_bind_point);
+
+         if (index >= 0 && last_pipeline[index] == pipeline)
+            continue;
+         if (index >= 0)
+            last_pipeline[index] = pipeline;
+         /* Static pipeline state overrides the dynamic state. */
+         memset(last_state, 0, sizeof(last_state));
+         after_barrier = false;
+      } else if (cmd_is_dynamic_state(cmd->type)) {
+         enum vk_cmd_type group = dynamic_state_group(cmd->type);
+
+         if (last_state[group] && dynamic_state_equal(last_state[group], cmd))
+            continue;
+         last_state[group] = cmd;
+         /* Rebinding a pipeline restores its static state. */
+         memset(last_pipeline, 0, sizeof(last_pipeline));
+         after_barrier = false;
+      } else {
+         if (!cmd_keeps_bound_state(cmd)) {
+            memset(last_state, 0, sizeof(last_state));
+            memset(last_pipeline, 0, sizeof(last_pipeline));
          }
-         continue;
+         after_barrier = false;
       }
 
-      if (print_cmds)
-         fprintf(stderr, "%s\n", vk_cmd_queue_type_names[cmd->type]);
-      switch ((unsigned)cmd->type) {
-      case VK_CMD_BIND_PIPELINE:
-         handle_pipeline(cmd, state);
-         break;
-      case VK_CMD_SET_VIEWPORT:
-         handle_set_viewport(cmd, state);
-         break;
-      case VK_CMD_SET_VIEWPORT_WITH_COUNT:
-         handle_set_viewport_with_count(cmd, state);
-         break;
-      case VK_CMD_SET_SCISSOR:
-         handle_set_scissor(cmd, state);
-         break;
-      case VK_CMD_SET_SCISSOR_WITH_COUNT:
-         handle_set_scissor_with_count(cmd, state);
-         break;
-      case VK_CMD_SET_LINE_WIDTH:
-         handle_set_line_width(cmd, state);
-         break;
-      case VK_CMD_SET_DEPTH_BIAS:
-         handle_set_depth_bias(cmd, state);
-         break;
-      case VK_CMD_SET_BLEND_CONSTANTS:
-         handle_set_blend_constants(cmd, state);
-         break;
-      case VK_CMD_SET_DEPTH_BOUNDS:
-         handle_set_depth_bounds(cmd, state);
-         break;
-      case VK_CMD_SET_STENCIL_COMPARE_MASK:
-         handle_set_stencil_compare_mask(cmd, state);
-         break;
-      case VK_CMD_SET_STENCIL_WRITE_MASK:
-         handle_set_stencil_write_mask(cmd, state);
-         break;
-      case VK_CMD_SET_STENCIL_REFERENCE:
-         handle_set_stencil_reference(cmd, state);
-         break;
-      case VK_CMD_BIND_DESCRIPTOR_SETS2:
-         handle_descriptor_sets_cmd(cmd, state);
-         break;
-      case VK_CMD_BIND_INDEX_BUFFER:
-         handle_index_buffer(cmd, state);
-         break;
-      case VK_CMD_BIND_INDEX_BUFFER2:
-         handle_index_buffer2(cmd, state);
-         break;
-      case VK_CMD_BIND_VERTEX_BUFFERS2:
-         handle_vertex_buffers2(cmd, state);
-         break;
-      case VK_CMD_DRAW:
-         emit_state(state);
-         handle_draw(cmd, state);
-         break;
-      case VK_CMD_DRAW_MULTI_EXT:
-         emit_state(state);
-         handle_draw_multi(cmd, state);
-         break;
-      case VK_CMD_DRAW_INDEXED:
-         emit_state(state);
-         handle_draw_indexed(cmd, state);
-         break;
-      case VK_CMD_DRAW_INDIRECT:
-         emit_state(state);
-         handle_draw_indirect(cmd, state, false);
-         break;
-      case VK_CMD_DRAW_INDEXED_INDIRECT:
-         emit_state(state);
-         handle_draw_indirect(cmd, state, true);
-         break;
-      case VK_CMD_DRAW_MULTI_INDEXED_EXT:
-         emit_state(state);
-         handle_draw_multi_indexed(cmd, state);
-         break;
-      case VK_CMD_DISPATCH:
-         emit_compute_state(state);
-         handle_dispatch(cmd, state);
-         break;
-      case VK_CMD_DISPATCH_BASE:
-         emit_compute_state(state);
-         handle_dispatch_base(cmd, state);
-         break;
-      case VK_CMD_DISPATCH_INDIRECT:
-         emit_compute_state(state);
-         handle_dispatch_indirect(cmd, state);
-         break;
-      case VK_CMD_COPY_BUFFER2:
-         handle_copy_buffer(cmd, state);
-         break;
-      case VK_CMD_COPY_IMAGE2:
-         handle_copy_image(cmd, state);
-         break;
-      case VK_CMD_BLIT_IMAGE2:
-         handle_blit_image(cmd, state);
-         break;
-      case VK_CMD_COPY_BUFFER_TO_IMAGE2:
-         handle_copy_buffer_to_image(cmd, state);
-         break;
-      case VK_CMD_COPY_IMAGE_TO_BUFFER2:
-         handle_copy_image_to_buffer2(cmd, state);
-         break;
-      case VK_CMD_UPDATE_BUFFER:
-         handle_update_buffer(cmd, state);
-         break;
-      case VK_CMD_FILL_BUFFER:
-         handle_fill_buffer(cmd, state);
-         break;
-      case VK_CMD_CLEAR_COLOR_IMAGE:
-         handle_clear_color_image(cmd, state);
-         break;
-      case VK_CMD_CLEAR_DEPTH_STENCIL_IMAGE:
-         handle_clear_ds_image(cmd, state);
-         break;
-      case VK_CMD_CLEAR_ATTACHMENTS:
-         handle_clear_attachments(cmd, state);
-         break;
-      case VK_CMD_RESOLVE_IMAGE2:
-         handle_resolve_image(cmd, state);
-         break;
-      case VK_CMD_PIPELINE_BARRIER2:
-         /* flushes are actually stalls, so multiple flushes are redundant */
-         if (did_flush)
-            continue;
-         handle_pipeline_barrier(cmd, state);
-         did_flush = true;
-         continue;
-      case VK_CMD_BEGIN_QUERY_INDEXED_EXT:
-         handle_begin_query_indexed_ext(cmd, state);
-         break;
-      case VK_CMD_END_QUERY_INDEXED_EXT:
-         handle_end_query_indexed_ext(cmd, state);
-         break;
-      case VK_CMD_BEGIN_QUERY:
-         handle_begin_query(cmd, state);
-         break;
-      case VK_CMD_END_QUERY:
-         handle_end_query(cmd, state);
-         break;
-      case VK_CMD_RESET_QUERY_POOL:
-         handle_reset_query_pool(cmd, state);
-         break;
-      case VK_CMD_COPY_QUERY_POOL_RESULTS:
-         handle_copy_query_pool_results(cmd, state);
-         break;
-      case VK_CMD_PUSH_CONSTANTS2:
-         handle_push_constants(cmd, state);
-         break;
-      case VK_CMD_EXECUTE_COMMANDS:
-         handle_execute_commands(cmd, state, print_cmds);
-         break;
-      case VK_CMD_DRAW_INDIRECT_COUNT:
-         emit_state(state);
-         handle_draw_indirect_count(cmd, state, false);
-         break;
-      case VK_CMD_DRAW_INDEXED_INDIRECT_COUNT:
-         emit_state(state);
-         handle_draw_indirect_count(cmd, state, true);
-         break;
-      case VK_CMD_PUSH_DESCRIPTOR_SET2:
-         handle_push_descriptor_set(cmd, state);
-         break;
-      case VK_CMD_PUSH_DESCRIPTOR_SET_WITH_TEMPLATE2:
-         handle_push_descriptor_set_with_template(cmd, state);
-         break;
-      case VK_CMD_BIND_TRANSFORM_FEEDBACK_BUFFERS_EXT:
-         handle_bind_transform_feedback_buffers(cmd, state);
-         break;
-      case VK_CMD_BEGIN_TRANSFORM_FEEDBACK_EXT:
-         handle_begin_transform_feedback(cmd, state);
-         break;
-      case VK_CMD_END_TRANSFORM_FEEDBACK_EXT:
-         handle_end_transform_feedback(cmd, state);
-         break;
-      case VK_CMD_DRAW_INDIRECT_BYTE_COUNT_EXT:
-         emit_state(state);
-         handle_draw_indirect_byte_count(cmd, state);
-         break;
-      case VK_CMD_BEGIN_CONDITIONAL_RENDERING_EXT:
-         handle_begin_conditional_rendering(cmd, state);
-         break;
-      case VK_CMD_END_CONDITIONAL_RENDERING_EXT:
-         handle_end_conditional_rendering(state);
-         break;
-      case VK_CMD_SET_VERTEX_INPUT_EXT:
-         handle_set_vertex_input(cmd, state);
-         break;
-      case VK_CMD_SET_CULL_MODE:
-         handle_set_cull_mode(cmd, state);
-         break;
-      case VK_CMD_SET_FRONT_FACE:
-         handle_set_front_face(cmd, state);
-         break;
-      case VK_CMD_SET_PRIMITIVE_TOPOLOGY:
-         handle_set_primitive_topology(cmd, state);
-         break;
-      case VK_CMD_SET_DEPTH_TEST_ENABLE:
-         handle_set_depth_test_enable(cmd, state);
-         break;
-      case VK_CMD_SET_DEPTH_WRITE_ENABLE:
-         handle_set_depth_write_enable(cmd, state);
-         break;
-      case VK_CMD_SET_DEPTH_COMPARE_OP:
-         handle_set_depth_compare_op(cmd, state);
-         break;
-      case VK_CMD_SET_DEPTH_BOUNDS_TEST_ENABLE:
-         handle_set_depth_bounds_test_enable(cmd, state);
-         break;
-      case VK_CMD_SET_STENCIL_TEST_ENABLE:
-         handle_set_stencil_test_enable(cmd, state);
-         break;
-      case VK_CMD_SET_STENCIL_OP:
-         handle_set_stencil_op(cmd, state);
-         break;
-      case VK_CMD_SET_LINE_STIPPLE:
-         handle_set_line_stipple(cmd, state);
-         break;
-      case VK_CMD_SET_DEPTH_BIAS_ENABLE:
-         handle_set_depth_bias_enable(cmd, state);
-         break;
-      case VK_CMD_SET_LOGIC_OP_EXT:
-         handle_set_logic_op(cmd, state);
-         break;
-      case VK_CMD_SET_PATCH_CONTROL_POINTS_EXT:
-         handle_set_patch_control_points(cmd, state);
-         break;
-      case VK_CMD_SET_PRIMITIVE_RESTART_ENABLE:
-         handle_set_primitive_restart_enable(cmd, state);
-         break;
-      case VK_CMD_SET_RASTERIZER_DISCARD_ENABLE:
-         handle_set_rasterizer_discard_enable(cmd, state);
-         break;
-      case VK_CMD_SET_COLOR_WRITE_ENABLE_EXT:
-         handle_set_color_write_enable(cmd, state);
-         break;
-      case VK_CMD_BEGIN_RENDERING:
-         handle_begin_rendering(cmd, state);
-         break;
-      case VK_CMD_END_RENDERING:
-         handle_end_rendering(cmd, state);
-         break;
-      case VK_CMD_SET_DEVICE_MASK:
-         /* no-op */
-         break;
-      case VK_CMD_RESET_EVENT2:
-         handle_event_reset2(cmd, state);
-         break;
-      case VK_CMD_SET_EVENT2:
-         handle_event_set2(cmd, state);
-         break;
-      case VK_CMD_WAIT_EVENTS2:
-         handle_wait_events2(cmd, state);
-         break;
-      case VK_CMD_WRITE_TIMESTAMP2:
-         handle_write_timestamp2(cmd, state);
-         break;
-      case VK_CMD_SET_POLYGON_MODE_EXT:
-         handle_set_polygon_mode(cmd, state);
-         break;
-      case VK_CMD_SET_TESSELLATION_DOMAIN_ORIGIN_EXT:
-         handle_set_tessellation_domain_origin(cmd, state);
-         break;
-      case VK_CMD_SET_DEPTH_CLAMP_ENABLE_EXT:
-         handle_set_depth_clamp_enable(cmd, state);
-         break;
-      case VK_CMD_SET_DEPTH_CLIP_ENABLE_EXT:
-         handle_set_depth_clip_enable(cmd, state);
-         break;
-      case VK_CMD_SET_LOGIC_OP_ENABLE_EXT:
-         handle_set_logic_op_enable(cmd, state);
-         break;
-      case VK_CMD_SET_SAMPLE_MASK_EXT:
-         handle_set_sample_mask(cmd, state);
-         break;
-      case VK_CMD_SET_RASTERIZATION_SAMPLES_EXT:
-         handle_set_samples(cmd, state);
-         break;
-      case VK_CMD_SET_ALPHA_TO_COVERAGE_ENABLE_EXT:
-         handle_set_alpha_to_coverage(cmd, state);
-         break;
-      case VK_CMD_SET_ALPHA_TO_ONE_ENABLE_EXT:
-         handle_set_alpha_to_one(cmd, state);
-         break;
-      case VK_CMD_SET_DEPTH_CLIP_NEGATIVE_ONE_TO_ONE_EXT:
-         handle_set_halfz(cmd, state);
-         break;
-      case VK_CMD_SET_LINE_RASTERIZATION_MODE_EXT:
-         handle_set_line_rasterization_mode(cmd, state);
-         break;
-      case VK_CMD_SET_LINE_STIPPLE_ENABLE_EXT:
-         handle_set_line_stipple_enable(cmd, state);
-         break;
-      case VK_CMD_SET_PROVOKING_VERTEX_MODE_EXT:
-         handle_set_provoking_vertex_mode(cmd, state);
-         break;
-      case VK_CMD_SET_COLOR_BLEND_ENABLE_EXT:
-         handle_set_color_blend_enable(cmd, state);
-         break;
-      case VK_CMD_SET_COLOR_WRITE_MASK_EXT:
-         handle_set_color_write_mask(cmd, state);
-         break;
-      case VK_CMD_SET_COLOR_BLEND_EQUATION_EXT:
-         handle_set_color_blend_equation(cmd, state);
-         break;
-      case VK_CMD_BIND_SHADERS_EXT:
-         handle_shaders(cmd, state);
-         break;
-      case VK_CMD_SET_ATTACHMENT_FEEDBACK_LOOP_ENABLE_EXT:
-         break;
-      case VK_CMD_DRAW_MESH_TASKS_EXT:
-         emit_state(state);
-         handle_draw_mesh_tasks(cmd, state);
-         break;
-      case VK_CMD_DRAW_MESH_TASKS_INDIRECT_EXT:
-         emit_state(state);
-         handle_draw_mesh_tasks_indirect(cmd, state);
-         break;
-      case VK_CMD_DRAW_MESH_TASKS_INDIRECT_COUNT_EXT:
-         emit_state(state);
-         handle_draw_mesh_tasks_indirect_count(cmd, state);
-         break;
-      case VK_CMD_PREPROCESS_GENERATED_COMMANDS_EXT:
-         handle_preprocess_generated_commands_ext(cmd, state, print_cmds);
-         break;
-      case VK_CMD_EXECUTE_GENERATED_COMMANDS_EXT:
-         handle_execute_generated_commands_ext(cmd, state, print_cmds);
-         break;
-      case VK_CMD_BIND_DESCRIPTOR_BUFFERS_EXT:
-         handle_descriptor_buffers(cmd, state);
-         break;
-      case VK_CMD_SET_DESCRIPTOR_BUFFER_OFFSETS2_EXT:
-         handle_descriptor_buffer_offsets(cmd, state);
-         break;
-      case VK_CMD_BIND_DESCRIPTOR_BUFFER_EMBEDDED_SAMPLERS2_EXT:
-         handle_descriptor_buffer_embedded_samplers(cmd, state);
-         break;
-#ifdef VK_ENABLE_BETA_EXTENSIONS
-      case VK_CMD_INITIALIZE_GRAPH_SCRATCH_MEMORY_AMDX:
-         break;
-      case VK_CMD_DISPATCH_GRAPH_INDIRECT_COUNT_AMDX:
-         break;
-      case VK_CMD_DISPATCH_GRAPH_INDIRECT_AMDX:
-         break;
-      case VK_CMD_DISPATCH_GRAPH_AMDX:
-         handle_dispatch_graph(cmd, state);
-         break;
-#endif
-      case VK_CMD_SET_RENDERING_ATTACHMENT_LOCATIONS:
-         handle_rendering_attachment_locations(cmd, state);
-         break;
-      case VK_CMD_SET_RENDERING_INPUT_ATTACHMENT_INDICES:
-         handle_rendering_input_attachment_indices(cmd, state);
-         break;
-      case VK_CMD_COPY_ACCELERATION_STRUCTURE_KHR:
-         handle_copy_acceleration_structure(cmd, state);
-         break;
-      case VK_CMD_COPY_MEMORY_TO_ACCELERATION_STRUCTURE_KHR:
-         handle_copy_memory_to_acceleration_structure(cmd, state);
-         break;
-      case VK_CMD_COPY_ACCELERATION_STRUCTURE_TO_MEMORY_KHR:
-         handle_copy_acceleration_structure_to_memory(cmd, state);
-         break;
-      case VK_CMD_BUILD_ACCELERATION_STRUCTURES_INDIRECT_KHR:
-         break;
-      case VK_CMD_WRITE_ACCELERATION_STRUCTURES_PROPERTIES_KHR:
-         handle_write_acceleration_structures_properties(cmd, state);
-         break;
-      case VK_CMD_SET_RAY_TRACING_PIPELINE_STACK_SIZE_KHR:
-         break;
-      case VK_CMD_TRACE_RAYS_INDIRECT2_KHR:
-         handle_trace_rays_indirect2(cmd, state);
-         break;
-      case VK_CMD_TRACE_RAYS_INDIRECT_KHR:
-         handle_trace_rays_indirect(cmd, state);
-         break;
-      case VK_CMD_TRACE_RAYS_KHR:
-         handle_trace_rays(cmd, state);
-         break;
-      default:
-         fprintf(stderr, "Unsupported command %s\n", vk_cmd_queue_type_names[cmd->type]);
-         unreachable("Unsupported command");
-         break;
+      struct vk_cmd_queue_entry **slot =
+         util_dynarray_grow(&cmd_buffer->baked_cmds, struct vk_cmd_queue_entry *, 1);
+      if (!slot) {
+         /* Keep executing from the list. */
+         util_dynarray_clear(&cmd_buffer->baked_cmds);
+         return;
       }
-      did_flush = false;
-      if (!cmd->cmd_link.next)
-         break;
+      *slot = cmd;
    }
+
+   cmd_buffer->baked = true;
 }
 
 VkResult lvp_execute_cmds(struct lvp_device *device,
@@ -5337,6 +5612,7 @@ VkResult lvp_execute_cmds(struct lvp_device *device,
    memset(state, 0, sizeof(*state));
    state->pctx = queue->ctx;
    state->device = device;
+   state->queue = queue;
    state->uploader = queue->uploader;
    state->cso = queue->cso;
    state->blend_dirty = true;
@@ -5372,7 +5648,7 @@ VkResult lvp_execute_cmds(struct lvp_device *device,
    state->index_buffer = state->device->zero_buffer;
 
    /* create a gallium context */
-   lvp_execute_cmd_buffer(&cmd_buffer->vk.cmd_queue.cmds, state, device->print_cmds);
+   lvp_execute_cmd_buffer(cmd_buffer, state, device->print_cmds);
 
    state->start_vb = -1;
    state->num_vb = 0;
@@ -44,30 +44,58 @@
 
 typedef void (*cso_destroy_func)(struct pipe_context*, void*);
 
+static cso_destroy_func
+shader_destroy_func(struct pipe_context *ctx, gl_shader_stage stage)
+{
+   cso_destroy_func destroy[] = {
+      ctx->delete_vs_state,
+      ctx->delete_tcs_state,
+      ctx->delete_tes_state,
+      ctx->delete_gs_state,
+      ctx->delete_fs_state,
+      ctx->delete_compute_state,
+      ctx->delete_ts_state,
+      ctx->delete_ms_state,
+   };
+
+   return destroy[stage];
+}
+
 static void
 shader_destroy(struct lvp_device *device, struct lvp_shader *shader, bool locked)
 {
    if (!shader->pipeline_nir)
       return;
    gl_shader_stage stage = shader->pipeline_nir->nir->info.stage;
-   cso_destroy_func destroy[] = {
-      device->queue.ctx->delete_vs_state,
-      device->queue.ctx->delete_tcs_state,
-      device->queue.ctx->delete_tes_state,
-      device->queue.ctx->delete_gs_state,
-      device->queue.ctx->delete_fs_state,
-      device->queue.ctx->delete_compute_state,
-      device->queue.ctx->delete_ts_state,
-      device->queue.ctx->delete_ms_state,
-   };
+   cso_destroy_func destroy = shader_destroy_func(device->queue.ctx, stage);
+
+   /* The other queues take the first queue's lock while executing, so
+    * this must not be called with it held when they have states.
+    */
+   for (uint32_t q = 1; q < device->queue_count; q++) {
+      struct lvp_queue *queue = device->queues[q];
+      void **csos = shader->queue_csos[q - 1];
+
+      if (!csos[0] && !csos[1])
+         continue;
+
+      assert(!locked);
+      simple_mtx_lock(&queue->lock);
+      for (unsigned i = 0; i < 2; i++) {
+         if (csos[i])
+            shader_destroy_func(queue->ctx, stage)(queue->ctx, csos[i]);
+         csos[i] = NULL;
+      }
+      simple_mtx_unlock(&queue->lock);
+   }
 
    if (!locked)
       simple_mtx_lock(&device->queue.lock);
 
    if (shader->shader_cso)
-      destroy[stage](device->queue.ctx, shader->shader_cso);
+      destroy(device->queue.ctx, shader->shader_cso);
    if (shader->tess_ccw_cso)
-      destroy[stage](device->queue.ctx, shader->tess_ccw_cso);
+      destroy(device->queue.ctx, shader->tess_ccw_cso);
 
    if (!locked)
       simple_mtx_unlock(&device->queue.lock);
@@ -573,14 +601,14 @@ lvp_pipeline_xfb_init(struct lvp_pipeline *pipeline)
 }
 
 static void *
-lvp_shader_compile_stage(struct lvp_device *device, struct lvp_shader *shader, nir_shader *nir)
+lvp_shader_compile_stage(struct pipe_context *ctx, struct lvp_shader *shader, nir_shader *nir)
 {
    if (nir->info.stage == MESA_SHADER_COMPUTE) {
       struct pipe_compute_state shstate = {0};
       shstate.prog = nir;
       shstate.ir_type = PIPE_SHADER_IR_NIR;
       shstate.static_shared_mem = nir->info.shared_size;
-      return device->queue.ctx->create_compute_state(device->queue.ctx, &shstate);
+      return ctx->create_compute_state(ctx, &shstate);
    } else {
       struct pipe_shader_state shstate = {0};
       shstate.type = PIPE_SHADER_IR_NIR;
@@ -589,19 +617,19 @@ lvp_shader_compile_stage(struct lvp_device *device, struct lvp_shader *shader, n
 
       switch (nir->info.stage) {
       case MESA_SHADER_FRAGMENT:
-         return device->queue.ctx->create_fs_state(device->queue.ctx, &shstate);
+         return ctx->create_fs_state(ctx, &shstate);
       case MESA_SHADER_VERTEX:
-         return device->queue.ctx->create_vs_state(device->queue.ctx, &shstate);
+         return ctx->create_vs_state(ctx, &shstate);
       case MESA_SHADER_GEOMETRY:
-         return device->queue.ctx->create_gs_state(device->queue.ctx, &shstate);
+         return ctx->create_gs_state(ctx, &shstate);
       case MESA_SHADER_TESS_CTRL:
-         return device->queue.ctx->create_tcs_state(device->queue.ctx, &shstate);
+         return ctx->create_tcs_state(ctx, &shstate);
       case MESA_SHADER_TESS_EVAL:
-         return device->queue.ctx->create_tes_state(device->queue.ctx, &shstate);
+         return ctx->create_tes_state(ctx, &shstate);
       case MESA_SHADER_TASK:
-         return device->queue.ctx->create_ts_state(device->queue.ctx, &shstate);
+         return ctx->create_ts_state(ctx, &shstate);
       case MESA_SHADER_MESH:
-         return device->queue.ctx->create_ms_state(device->queue.ctx, &shstate);
+         return ctx->create_ms_state(ctx, &shstate);
       default:
          unreachable("illegal shader");
          break;
@@ -618,7 +646,7 @@ lvp_shader_compile(struct lvp_device *device, struct lvp_shader *shader, nir_sha
    if (!locked)
       simple_mtx_lock(&device->queue.lock);
 
-   void *state = lvp_shader_compile_stage(device, shader, nir);
+   void *state = lvp_shader_compile_stage(device->queue.ctx, shader, nir);
 
    if (!locked)
       simple_mtx_unlock(&device->queue.lock);
@@ -626,6 +654,32 @@ lvp_shader_compile(struct lvp_device *device, struct lvp_shader *shader, nir_sha
    return state;
 }
 
+/* Return the shader state to bind on the given queue, which must be
+ * executing.  Queues other than the first compile their own copy on
+ * first use, since shader states can't be shared between contexts.
+ */
+void *
+lvp_shader_get_cso(struct lvp_queue *queue, struct lvp_shader *shader, bool tess_ccw)
+{
+   uint32_t index = queue->vk.index_in_family;
+
+   if (index == 0)
+      return tess_ccw ? shader->tess_ccw_cso : shader->shader_cso;
+
+   void **cso = &shader->queue_csos[index - 1][tess_ccw];
+   if (!*cso) {
+      struct lvp_pipeline_nir *pipeline_nir = tess_ccw ? shader->tess_ccw : shader->pipeline_nir;
+      if (!pipeline_nir)
+         return NULL;
+
+      struct pipe_screen *pscreen = queue->device->pscreen;
+      nir_shader *nir = nir_shader_clone(NULL, pipeline_nir->nir);
+      pscreen->finalize_nir(pscreen, nir);
+      *cso = lvp_shader_compile_stage(queue->ctx, shader, nir);
+   }
+   return *cso;
+}
+
 #ifndef NDEBUG
 static bool
 layouts_equal(const struct lvp_descriptor_set_layout *a, const struct lvp_descriptor_set_layout *b)
@@ -912,8 +966,18 @@ fail:
 void
 lvp_pipeline_shaders_compile(struct lvp_pipeline *pipeline, bool locked)
 {
-   if (pipeline->compiled)
+   if (p_atomic_read(&pipeline->compiled))
       return;
+
+   /* Several queues may execute the pipeline for the first time at once. */
+   if (!locked) {
+      simple_mtx_lock(&pipeline->device->queue.lock);
+      if (pipeline->compiled) {
+         simple_mtx_unlock(&pipeline->device->queue.lock);
+         return;
+      }
+   }
+
    for (uint32_t i = 0; i < ARRAY_SIZE(pipeline->shaders); i++) {
       if (!pipeline->shaders[i].pipeline_nir)
          continue;
@@ -922,12 +986,15 @@ lvp_pipeline_shaders_compile(struct lvp_pipeline *pipeline, bool locked)
       assert(stage == pipeline->shaders[i].pipeline_nir->nir->info.stage);
 
       pipeline->shaders[stage].shader_cso = lvp_shader_compile(pipeline->device, &pipeline->shaders[stage],
-         nir_shader_clone(NULL, pipeline->shaders[stage].pipeline_nir->nir), locked);
+         nir_shader_clone(NULL, pipeline->shaders[stage].pipeline_nir->nir), true);
       if (pipeline->shaders[MESA_SHADER_TESS_EVAL].tess_ccw)
          pipeline->shaders[MESA_SHADER_TESS_EVAL].tess_ccw_cso = lvp_shader_compile(pipeline->device, &pipeline->shaders[stage],
-            nir_shader_clone(NULL, pipeline->shaders[MESA_SHADER_TESS_EVAL].tess_ccw->nir), locked);
+            nir_shader_clone(NULL, pipeline->shaders[MESA_SHADER_TESS_EVAL].tess_ccw->nir), true);
    }
-   pipeline->compiled = true;
+   p_atomic_set(&pipeline->compiled, true);
+
+   if (!locked)
+      simple_mtx_unlock(&pipeline->device->queue.lock);
 }
 
 static VkResult
@@ -106,6 +106,7 @@ extern "C" {
 #define MAX_PER_STAGE_DESCRIPTOR_UNIFORM_BLOCKS 8
 #define MAX_DGC_STREAMS 16
 #define MAX_DGC_TOKENS 16
+#define LVP_MAX_QUEUES 4
 /* Currently lavapipe does not support more than 1 image plane */
 #define LVP_MAX_PLANE_COUNT 1
 
@@ -194,6 +195,7 @@ struct lvp_queue {
    struct u_upload_mgr *uploader;
    struct pipe_fence_handle *last_fence;
    void *state;
+   void *noop_fs;
    struct util_dynarray pipeline_destroys;
    simple_mtx_t lock;
 };
@@ -207,11 +209,16 @@ struct lvp_pipeline_cache {
 struct lvp_device {
    struct vk_device vk;
 
+   /* The first queue's context also creates the device's objects, under
+    * its lock.  Every queue has its own context and executes on its own
+    * thread.
+    */
    struct lvp_queue queue;
+   struct lvp_queue *queues[LVP_MAX_QUEUES];
+   uint32_t queue_count;
    struct lvp_instance *                       instance;
    struct lvp_physical_device *physical_device;
    struct pipe_screen *pscreen;
-   void *noop_fs;
    simple_mtx_t bda_lock;
    struct hash_table bda;
    struct pipe_resource *zero_buffer; /* for zeroed bda */
@@ -229,6 +236,14 @@ struct lvp_device {
    radix_sort_vk_t *radix_sort;
    simple_mtx_t radix_sort_lock;
    struct vk_acceleration_structure_build_args accel_struct_args;
+
+   /* Acceleration structures are built on the CPU by lvp_build_as(), the
+    * runtime's compute shader builder is only used with LVP_COMPUTE_AS_BUILD.
+    * The worker threads are created on the first build.
+    */
+   bool compute_as_build;
+   simple_mtx_t as_build_lock;
+   struct util_queue as_build_queue;
 };
 
 void lvp_device_get_cache_uuid(void *uuid);
@@ -446,6 +461,8 @@ struct lvp_shader {
    struct lvp_pipeline_nir *tess_ccw;
    void *shader_cso;
    void *tess_ccw_cso;
+   /* shader_cso and tess_ccw_cso for the other queues, created on first use */
+   void *queue_csos[LVP_MAX_QUEUES - 1][2];
    struct pipe_stream_output_info stream_output;
    struct blob blob; //preserved for GetShaderBinaryDataEXT
    uint32_t push_constant_size;
@@ -614,6 +631,12 @@ struct lvp_cmd_buffer {
    struct lvp_device *                          device;
 
    uint8_t push_constants[MAX_PUSH_CONSTANTS_SIZE];
+
+   /* The commands to execute, built from vk.cmd_queue at the end of
+    * recording.
+    */
+   struct util_dynarray baked_cmds;
+   bool baked;
 };
 
 struct lvp_indirect_command_layout_nv {
@@ -723,6 +746,7 @@ VkResult lvp_image_bind_sparse(struct lvp_device *device,
                                struct lvp_queue *queue,
                                VkSparseImageMemoryBindInfo *bind);
 
+void lvp_cmd_buffer_bake(struct lvp_cmd_buffer *cmd_buffer);
 VkResult lvp_execute_cmds(struct lvp_device *device,
                           struct lvp_queue *queue,
                           struct lvp_cmd_buffer *cmd_buffer);
@@ -803,6 +827,9 @@ lvp_shader_optimize(nir_shader *nir);
 void *
 lvp_shader_compile(struct lvp_device *device, struct lvp_shader *shader, nir_shader *nir, bool locked);
 
+void *
+lvp_shader_get_cso(struct lvp_queue *queue, struct lvp_shader *shader, bool tess_ccw);
+
 enum vk_cmd_type
 lvp_nv_dgc_token_to_cmd_type(const VkIndirectCommandsLayoutTokenNV *token);
 
@@ -845,11 +872,33 @@ struct lvp_cmd_encode_as {
    VkGeometryTypeKHR geometry_type;
 };
 
+struct lvp_as_build_geometry {
+   struct vk_bvh_geometry_data data;
+   uint32_t primitive_count;
+};
+
+struct lvp_cmd_build_as {
+   struct vk_acceleration_structure *dst;
+   /* Only used for updates. */
+   struct vk_acceleration_structure *src;
+   VkBuildAccelerationStructureFlagsKHR flags;
+   VkBuildAccelerationStructureModeKHR mode;
+   VkGeometryTypeKHR geometry_type;
+   uint32_t leaf_count;
+   uint32_t geometry_count;
+   struct lvp_as_build_geometry *geometries;
+};
+
+void
+lvp_build_as(struct lvp_device *device, const struct lvp_cmd_build_as *build);
+
 enum {
    LVP_CMD_WRITE_BUFFER_CP = VK_CMD_TYPE_COUNT,
    LVP_CMD_DISPATCH_UNALIGNED,
    LVP_CMD_FILL_BUFFER_ADDR,
    LVP_CMD_ENCODE_AS,
+   LVP_CMD_BUILD_AS,
+   LVP_CMD_RADIX_SORT,
    LVP_CMD_SAVE_STATE,
    LVP_CMD_RESTORE_STATE,
 };
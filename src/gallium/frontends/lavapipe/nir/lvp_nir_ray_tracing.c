@@ -61,93 +61,101 @@ lvp_load_vertex_position(nir_builder *b, nir_def *primitive_addr, uint32_t index
    return nir_build_load_global(b, 3, 32, nir_iadd_imm(b, primitive_addr, index * 3 * sizeof(float)));
 }
 
+static nir_def *
+lvp_build_dequantize(nir_builder *b, nir_def *origin, nir_def *scale, nir_def *packed)
+{
+   nir_def *q[LVP_BVH_NODE_WIDTH];
+   for (uint32_t i = 0; i < LVP_BVH_NODE_WIDTH; i++)
+      q[i] = nir_extract_u8_imm(b, packed, i);
+
+   return nir_fadd(b, origin, nir_fmul(b, nir_u2f32(b, nir_vec(b, q, LVP_BVH_NODE_WIDTH)), scale));
+}
+
+static void
+lvp_build_sort_children(nir_builder *b, nir_def **distances, nir_def **indices,
+                        uint32_t i, uint32_t j)
+{
+   nir_def *swap = nir_flt(b, distances[j], distances[i]);
+
+   nir_def *distance = distances[i];
+   distances[i] = nir_bcsel(b, swap, distances[j], distance);
+   distances[j] = nir_bcsel(b, swap, distance, distances[j]);
+
+   nir_def *index = indices[i];
+   indices[i] = nir_bcsel(b, swap, indices[j], index);
+   indices[j] = nir_bcsel(b, swap, index, indices[j]);
+}
+
+/* Test the ray against the bounds of all children of a box node at once,
+ * with one vector channel per child, and return the indices of the
+ * children which are hit sorted by distance, with LVP_BVH_INVALID_NODE
+ * for the remaining channels.
+ */
 static nir_def *
 lvp_build_intersect_ray_box(nir_builder *b, nir_def **node_data, nir_def *ray_tmax,
                             nir_def *origin, nir_def *dir, nir_def *inv_dir)
 {
-   const struct glsl_type *vec2_type = glsl_vector_type(GLSL_TYPE_FLOAT, 2);
-   const struct glsl_type *uvec2_type = glsl_vector_type(GLSL_TYPE_UINT, 2);
+   const uint32_t width = LVP_BVH_NODE_WIDTH;
 
-   nir_variable *distances =
-      nir_variable_create(b->shader, nir_var_shader_temp, vec2_type, "distances");
-   nir_store_var(b, distances, nir_imm_vec2(b, INFINITY, INFINITY), 0xf);
+   inv_dir = nir_bcsel(b, nir_feq_imm(b, dir, 0), nir_imm_float(b, FLT_MAX), inv_dir);
 
-   nir_variable *child_indices =
-      nir_variable_create(b->shader, nir_var_shader_temp, uvec2_type, "child_indices");
-   nir_store_var(b, child_indices, nir_imm_ivec2(b, 0xffffffffu, 0xffffffffu), 0xf);
+   nir_def *exponents =
+      lvp_load_node_data(b, NULL, node_data, offsetof(struct lvp_bvh_box_node, exponents));
 
-   inv_dir = nir_bcsel(b, nir_feq_imm(b, dir, 0), nir_imm_float(b, FLT_MAX), inv_dir);
+   nir_def *tmin = NULL;
+   nir_def *tmax = NULL;
+   for (uint32_t axis = 0; axis < 3; axis++) {
+      nir_def *grid_origin =
+         lvp_load_node_data(b, NULL, node_data, offsetof(struct lvp_bvh_box_node, origin[axis]));
+      nir_def *scale = nir_ishl_imm(b, nir_extract_u8_imm(b, exponents, axis), 23);
 
-   for (int i = 0; i < 2; i++) {
-      const uint32_t child_offset = offsetof(struct lvp_bvh_box_node, children[i]);
-      const uint32_t coord_offsets[2] = {
-         offsetof(struct lvp_bvh_box_node, bounds[i].min.x),
-         offsetof(struct lvp_bvh_box_node, bounds[i].max.x),
-      };
-
-      nir_def *child_index = lvp_load_node_data(b, NULL, node_data, child_offset);
-
-      nir_def *node_coords[2] = {
-         nir_vec3(b,
-            lvp_load_node_data(b, NULL, node_data, coord_offsets[0] + 0),
-            lvp_load_node_data(b, NULL, node_data, coord_offsets[0] + 4),
-            lvp_load_node_data(b, NULL, node_data, coord_offsets[0] + 8)
-         ),
-         nir_vec3(b,
-            lvp_load_node_data(b, NULL, node_data, coord_offsets[1] + 0),
-            lvp_load_node_data(b, NULL, node_data, coord_offsets[1] + 4),
-            lvp_load_node_data(b, NULL, node_data, coord_offsets[1] + 8)
-         ),
-      };
-
-      /* If x of the aabb min is NaN, then this is an inactive aabb.
-       * We don't need to care about any other components being NaN as that is UB.
-       * https://registry.khronos.org/vulkan/specs/latest/html/vkspec.html#acceleration-structure-inactive-prims
-       */
-      nir_def *min_x = nir_channel(b, node_coords[0], 0);
-      nir_def *min_x_is_not_nan =
-         nir_inot(b, nir_fneu(b, min_x, min_x)); /* NaN != NaN -> true */
-
-      nir_def *bound0 = nir_fmul(b, nir_fsub(b, node_coords[0], origin), inv_dir);
-      nir_def *bound1 = nir_fmul(b, nir_fsub(b, node_coords[1], origin), inv_dir);
-
-      nir_def *tmin =
-         nir_fmax(b,
-                  nir_fmax(b, nir_fmin(b, nir_channel(b, bound0, 0), nir_channel(b, bound1, 0)),
-                           nir_fmin(b, nir_channel(b, bound0, 1), nir_channel(b, bound1, 1))),
-                  nir_fmin(b, nir_channel(b, bound0, 2), nir_channel(b, bound1, 2)));
-
-      nir_def *tmax =
-         nir_fmin(b,
-                  nir_fmin(b, nir_fmax(b, nir_channel(b, bound0, 0), nir_channel(b, bound1, 0)),
-                           nir_fmax(b, nir_channel(b, bound0, 1), nir_channel(b, bound1, 1))),
-                  nir_fmax(b, nir_channel(b, bound0, 2), nir_channel(b, bound1, 2)));
-
-      nir_push_if(b,
-                  nir_iand(b, min_x_is_not_nan,
-                           nir_iand(b, nir_fge(b, tmax, nir_fmax(b, nir_imm_float(b, 0.0f), tmin)),
-                                    nir_flt(b, tmin, ray_tmax))));
-      {
-         nir_def *new_child_indices[2] = {child_index, child_index};
-         nir_store_var(b, child_indices, nir_vec(b, new_child_indices, 2), 1u << i);
+      nir_def *bound_min = lvp_build_dequantize(b, grid_origin, scale,
+         lvp_load_node_data(b, NULL, node_data, offsetof(struct lvp_bvh_box_node, min[axis])));
+      nir_def *bound_max = lvp_build_dequantize(b, grid_origin, scale,
+         lvp_load_node_data(b, NULL, node_data, offsetof(struct lvp_bvh_box_node, max[axis])));
 
-         nir_def *new_distances[2] = {tmin, tmin};
-         nir_store_var(b, distances, nir_vec(b, new_distances, 2), 1u << i);
-      }
-      nir_pop_if(b, NULL);
+      nir_def *ray_origin = nir_channel(b, origin, axis);
+      nir_def *ray_inv_dir = nir_channel(b, inv_dir, axis);
+
+      nir_def *bound0 = nir_fmul(b, nir_fsub(b, bound_min, ray_origin), ray_inv_dir);
+      nir_def *bound1 = nir_fmul(b, nir_fsub(b, bound_max, ray_origin), ray_inv_dir);
+
+      nir_def *axis_tmin = nir_fmin(b, bound0, bound1);
+      nir_def *axis_tmax = nir_fmax(b, bound0, bound1);
+
+      tmin = tmin ? nir_fmax(b, tmin, axis_tmin) : axis_tmin;
+      tmax = tmax ? nir_fmin(b, tmax, axis_tmax) : axis_tmax;
    }
 
-   nir_def *ssa_distances = nir_load_var(b, distances);
-   nir_def *ssa_indices = nir_load_var(b, child_indices);
-   nir_push_if(b, nir_flt(b, nir_channel(b, ssa_distances, 1), nir_channel(b, ssa_distances, 0)));
-   {
-      nir_store_var(b, child_indices,
-                    nir_vec2(b, nir_channel(b, ssa_indices, 1), nir_channel(b, ssa_indices, 0)),
-                    0b11);
+   nir_def *children[LVP_BVH_NODE_WIDTH];
+   for (uint32_t i = 0; i < width; i++)
+      children[i] = lvp_load_node_data(b, NULL, node_data, offsetof(struct lvp_bvh_box_node, children[i]));
+   nir_def *child_indices = nir_vec(b, children, width);
+
+   /* Unused children are invalid, their quantized bounds are meaningless. */
+   nir_def *hit = nir_iand(b, nir_ine_imm(b, child_indices, LVP_BVH_INVALID_NODE),
+                           nir_iand(b, nir_fge(b, tmax, nir_fmax(b, nir_imm_float(b, 0.0f), tmin)),
+                                    nir_flt(b, tmin, ray_tmax)));
+
+   nir_def *distances_vec = nir_bcsel(b, hit, tmin, nir_imm_float(b, INFINITY));
+   nir_def *indices_vec = nir_bcsel(b, hit, child_indices, nir_imm_int(b, LVP_BVH_INVALID_NODE));
+
+   nir_def *distances[LVP_BVH_NODE_WIDTH];
+   nir_def *indices[LVP_BVH_NODE_WIDTH];
+   for (uint32_t i = 0; i < width; i++) {
+      distances[i] = nir_channel(b, distances_vec, i);
+      indices[i] = nir_channel(b, indices_vec, i);
    }
-   nir_pop_if(b, NULL);
 
-   return nir_load_var(b, child_indices);
+   /* Sorting network for four children. */
+   static_assert(LVP_BVH_NODE_WIDTH == 4, "sorting network expects 4 children");
+   lvp_build_sort_children(b, distances, indices, 0, 1);
+   lvp_build_sort_children(b, distances, indices, 2, 3);
+   lvp_build_sort_children(b, distances, indices, 0, 2);
+   lvp_build_sort_children(b, distances, indices, 1, 3);
+   lvp_build_sort_children(b, distances, indices, 1, 2);
+
+   return nir_vec(b, indices, width);
 }
 
 static nir_def *
@@ -520,11 +528,16 @@ lvp_build_ray_traversal(nir_builder *b, const struct lvp_ray_traversal_args *arg
 
             nir_store_deref(b, args->vars.current_node, nir_channel(b, result, 0), 0x1);
 
-            nir_push_if(b, nir_ine_imm(b, nir_channel(b, result, 1), LVP_BVH_INVALID_NODE));
-            {
-               lvp_build_push_stack(b, args, nir_channel(b, result, 1));
+            /* Push the farther children first so that the nearer ones are
+             * popped first.
+             */
+            for (uint32_t i = LVP_BVH_NODE_WIDTH - 1; i > 0; i--) {
+               nir_push_if(b, nir_ine_imm(b, nir_channel(b, result, i), LVP_BVH_INVALID_NODE));
+               {
+                  lvp_build_push_stack(b, args, nir_channel(b, result, i));
+               }
+               nir_pop_if(b, NULL);
             }
-            nir_pop_if(b, NULL);
          }
          nir_pop_if(b, NULL);
       }
@@ -89,3 +89,32 @@ util_thread_sched_apply_policy(thrd_t thread, enum util_thread_name name,
    return false;
 #endif
 }
+
+/**
+ * Spread a pool of identical worker threads (e.g. software rasterizer
+ * threads) over the L3 core complexes.
+ *
+ * Worker "index" out of "num_workers" is restricted to the CPUs sharing one
+ * L3 cache, with consecutive workers placed on the same L3, so that each
+ * core complex gets an equal share of the pool. The thread may still
+ * migrate between the cores of its complex.
+ */
+bool
+util_thread_sched_pin_worker(thrd_t thread, unsigned index,
+                             unsigned num_workers)
+{
+#if DETECT_ARCH_X86 || DETECT_ARCH_X86_64
+   const struct util_cpu_caps_t *caps = util_get_cpu_caps();
+
+   if (caps->num_L3_caches <= 1 || !caps->L3_affinity_mask ||
+       index >= num_workers)
+      return false;
+
+   unsigned L3_cache = (uint64_t)index * caps->num_L3_caches / num_workers;
+
+   return util_set_thread_affinity(thread, caps->L3_affinity_mask[L3_cache],
+                                   NULL, caps->num_cpu_mask_bits);
+#else
+   return false;
+#endif
+}
@@ -0,0 +1,230 @@
+/*
+ * Copyright © 2026 The Mesa Authors
+ * SPDX-License-Identifier: MIT
+ */
+
+#include "radix_sort_host.h"
+#include "shaders/push.h"
+
+#include <assert.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "util/macros.h"
+#include "util/u_math.h"
+#include "util/u_queue.h"
+
+/* Blocks are never split below this many keyvals. */
+#define RS_HOST_MIN_BLOCK_SIZE (64 * 1024)
+
+#define RS_HOST_MAX_PASSES 8
+
+struct rs_host_sort;
+
+struct rs_host_block {
+   struct util_queue_fence fence;
+   struct rs_host_sort *sort;
+   uint32_t begin;
+   uint32_t end;
+
+   /* Digit counts of the block for every pass, before the first scatter.
+    * Afterwards only the current pass is recounted.
+    */
+   uint32_t histograms[RS_HOST_MAX_PASSES][RS_RADIX_SIZE];
+   /* Where the block scatters each digit of the current pass. */
+   uint32_t offsets[RS_RADIX_SIZE];
+};
+
+struct rs_host_sort {
+   const uint64_t *src;
+   uint64_t *dst;
+   uint32_t first_shift;
+   uint32_t passes;
+   uint32_t pass;
+};
+
+radix_sort_vk_t *
+vk_create_radix_sort_u64_host(radix_sort_vk_cmd_sort_host_pfn cmd_sort,
+                              struct radix_sort_vk_target_config config)
+{
+   assert(config.keyval_dwords == 2);
+
+   radix_sort_vk_t *rs = calloc(1, sizeof(*rs));
+   if (!rs)
+      return NULL;
+
+   rs->config = config;
+   rs->cmd_sort_host = cmd_sort;
+
+   return rs;
+}
+
+static inline uint32_t
+rs_host_digit(uint64_t keyval, uint32_t shift)
+{
+   return (keyval >> shift) & (RS_RADIX_SIZE - 1);
+}
+
+static void
+rs_host_histogram_all(void *data, void *gdata, int thread_index)
+{
+   struct rs_host_block *block = data;
+   const struct rs_host_sort *sort = block->sort;
+   const uint64_t *keyvals = sort->src;
+
+   memset(block->histograms, 0, sizeof(block->histograms));
+
+   /* Count the digits of all passes with a single read of the keyvals, the
+    * passes go to separate tables so that the increments don't depend on
+    * each other.
+    */
+   for (uint32_t i = block->begin; i < block->end; i++) {
+      uint64_t keyval = keyvals[i];
+      for (uint32_t pass = 0; pass < sort->passes; pass++)
+         block->histograms[pass][rs_host_digit(keyval, sort->first_shift + pass * RS_RADIX_LOG2)]++;
+   }
+}
+
+static void
+rs_host_histogram(void *data, void *gdata, int thread_index)
+{
+   struct rs_host_block *block = data;
+   const struct rs_host_sort *sort = block->sort;
+   const uint64_t *keyvals = sort->src;
+   uint32_t shift = sort->first_shift + sort->pass * RS_RADIX_LOG2;
+   uint32_t *histogram = block->histograms[sort->pass];
+
+   memset(histogram, 0, RS_RADIX_SIZE * sizeof(uint32_t));
+
+   for (uint32_t i = block->begin; i < block->end; i++)
+      histogram[rs_host_digit(keyvals[i], shift)]++;
+}
+
+static void
+rs_host_scatter(void *data, void *gdata, int thread_index)
+{
+   struct rs_host_block *block = data;
+   const struct rs_host_sort *sort = block->sort;
+   const uint64_t *src = sort->src;
+   uint64_t *dst = sort->dst;
+   uint32_t shift = sort->first_shift + sort->pass * RS_RADIX_LOG2;
+
+   for (uint32_t i = block->begin; i < block->end; i++) {
+      uint64_t keyval = src[i];
+      dst[block->offsets[rs_host_digit(keyval, shift)]++] = keyval;
+   }
+}
+
+/* Run the function for all blocks, the first one on the calling thread. */
+static void
+rs_host_run(struct util_queue *queue, struct rs_host_block *blocks, uint32_t block_count,
+            util_queue_execute_func execute)
+{
+   for (uint32_t i = 1; i < block_count; i++) {
+      util_queue_fence_init(&blocks[i].fence);
+      util_queue_add_job(queue, &blocks[i], &blocks[i].fence, execute, NULL, 0);
+   }
+
+   execute(&blocks[0], NULL, 0);
+
+   for (uint32_t i = 1; i < block_count; i++) {
+      util_queue_fence_wait(&blocks[i].fence);
+      util_queue_fence_destroy(&blocks[i].fence);
+   }
+}
+
+void
+radix_sort_host_sort(const struct radix_sort_host_info *info,
+                     struct util_queue *queue)
+{
+   uint64_t *keyvals_even = (uint64_t *)(uintptr_t)info->keyvals_even;
+   uint64_t *keyvals_odd = (uint64_t *)(uintptr_t)info->keyvals_odd;
+   uint32_t count = info->count_addr ? *(const uint32_t *)(uintptr_t)info->count_addr : info->count;
+
+   uint32_t key_bits = MIN2(info->key_bits, 64);
+   uint32_t passes = DIV_ROUND_UP(key_bits, RS_RADIX_LOG2);
+
+   /* The shaders leave the keyvals in the odd buffer after an odd number of
+    * passes.
+    */
+   uint64_t *result = (passes & 1) ? keyvals_odd : keyvals_even;
+
+   if (count <= 1 || !passes) {
+      if (result != keyvals_even)
+         memcpy(result, keyvals_even, count * sizeof(uint64_t));
+      return;
+   }
+
+   uint32_t block_count = 1;
+   if (queue && util_queue_is_initialized(queue))
+      block_count = CLAMP(count / RS_HOST_MIN_BLOCK_SIZE, 1, queue->num_threads + 1);
+
+   struct rs_host_block *blocks = calloc(block_count, sizeof(*blocks));
+   if (!blocks)
+      return;
+
+   /* Like the shaders, sort by the most significant bytes of the keyvals. */
+   struct rs_host_sort sort = {
+      .src = keyvals_even,
+      .dst = keyvals_odd,
+      .first_shift = 64 - passes * RS_RADIX_LOG2,
+      .passes = passes,
+   };
+
+   uint32_t block_size = DIV_ROUND_UP(count, block_count);
+   for (uint32_t i = 0; i < block_count; i++) {
+      blocks[i].sort = &sort;
+      blocks[i].begin = MIN2(i * block_size, count);
+      blocks[i].end = MIN2((i + 1) * block_size, count);
+   }
+
+   rs_host_run(queue, blocks, block_count, rs_host_histogram_all);
+
+   bool first_scatter = true;
+
+   for (sort.pass = 0; sort.pass < passes; sort.pass++) {
+      /* The totals of the initial histograms stay valid, skip passes which
+       * would not move anything.
+       */
+      bool trivial = false;
+      for (uint32_t digit = 0; digit < RS_RADIX_SIZE; digit++) {
+         uint32_t total = 0;
+         for (uint32_t i = 0; i < block_count; i++)
+            total += blocks[i].histograms[sort.pass][digit];
+
+         if (total) {
+            trivial = total == count;
+            break;
+         }
+      }
+
+      if (trivial)
+         continue;
+
+      if (!first_scatter)
+         rs_host_run(queue, blocks, block_count, rs_host_histogram);
+      first_scatter = false;
+
+      /* Each block scatters a digit after the same digit of the blocks
+       * before it, which keeps the sort stable.
+       */
+      uint32_t offset = 0;
+      for (uint32_t digit = 0; digit < RS_RADIX_SIZE; digit++) {
+         for (uint32_t i = 0; i < block_count; i++) {
+            blocks[i].offsets[digit] = offset;
+            offset += blocks[i].histograms[sort.pass][digit];
+         }
+      }
+
+      rs_host_run(queue, blocks, block_count, rs_host_scatter);
+
+      uint64_t *tmp = (uint64_t *)sort.src;
+      sort.src = sort.dst;
+      sort.dst = tmp;
+   }
+
+   if (sort.src != result)
+      memcpy(result, sort.src, count * sizeof(uint64_t));
+
+   free(blocks);
+}
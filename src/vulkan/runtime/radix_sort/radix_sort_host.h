@@ -0,0 +1,54 @@
+/*
+ * Copyright © 2026 The Mesa Authors
+ * SPDX-License-Identifier: MIT
+ */
+
+#ifndef VK_RADIX_SORT_HOST
+#define VK_RADIX_SORT_HOST
+
+#include "radix_sort_vk.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+struct util_queue;
+
+/* A sort recorded by a host radix sort instance.  Device addresses are host
+ * pointers on the devices which use it.
+ */
+struct radix_sort_host_info {
+   VkDeviceAddress keyvals_even;
+   VkDeviceAddress keyvals_odd;
+   uint32_t key_bits;
+   uint32_t count;
+   /* If not zero, the count is read from here when sorting. */
+   VkDeviceAddress count_addr;
+};
+
+/* Records a sort into the command buffer, the driver calls
+ * radix_sort_host_sort() when the command executes.
+ */
+typedef void (*radix_sort_vk_cmd_sort_host_pfn)(VkCommandBuffer cb,
+                                                const struct radix_sort_host_info *info);
+
+/* Create a radix sort instance which sorts on the host instead of
+ * dispatching the shaders.  The config is only used for the memory
+ * requirements, so that the scratch layout matches the shader version.
+ */
+radix_sort_vk_t *
+vk_create_radix_sort_u64_host(radix_sort_vk_cmd_sort_host_pfn cmd_sort,
+                              struct radix_sort_vk_target_config config);
+
+/* Parallel LSD radix sort of the keyvals, leaving them in the same buffer as
+ * the shaders would.  The queue is optional.
+ */
+void
+radix_sort_host_sort(const struct radix_sort_host_info *info,
+                     struct util_queue *queue);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
@@ -9,6 +9,7 @@
 #include "common/macros.h"
 #include "common/util.h"
 #include "common/vk/barrier.h"
+#include "radix_sort_host.h"
 #include "radix_sort_vk_devaddr.h"
 #include "shaders/push.h"
 #include "shaders/config.h"
@@ -491,7 +492,10 @@ radix_sort_vk_destroy(struct radix_sort_vk * rs, VkDevice d, VkAllocationCallbac
 
   const struct vk_device_dispatch_table *disp = &device->dispatch_table;
 
-  uint32_t const pipeline_count = rs_pipeline_count(rs);
+  //
+  // Host sorting instances have no pipelines
+  //
+  uint32_t const pipeline_count = (rs->cmd_sort_host == NULL) ? rs_pipeline_count(rs) : 0;
 
   // destroy pipelines
   for (uint32_t ii = 0; ii < pipeline_count; ii++)
@@ -570,6 +574,21 @@ struct radix_sort_vk_ext_base
 
 #endif
 
+//
+// The host sort leaves the keyvals in the same buffer as the shaders.
+//
+static VkDeviceAddress
+rs_host_keyvals_sorted(radix_sort_vk_t const * rs,
+                       uint32_t                key_bits,
+                       VkDeviceAddress         keyvals_even,
+                       VkDeviceAddress         keyvals_odd)
+{
+  uint32_t const keyval_bits = rs->config.keyval_dwords * (uint32_t)sizeof(uint32_t) * 8;
+  uint32_t const passes      = (MIN_MACRO(uint32_t, key_bits, keyval_bits) + RS_RADIX_LOG2 - 1) / RS_RADIX_LOG2;
+
+  return ((passes & 1) != 0) ? keyvals_odd : keyvals_even;
+}
+
 //
 //
 //
@@ -594,6 +613,27 @@ radix_sort_vk_sort_devaddr(radix_sort_vk_t const *                   rs,
       return;
     }
 
+  //
+  // Sorting on the host?
+  //
+  if (rs->cmd_sort_host != NULL)
+    {
+      struct radix_sort_host_info const host_info = {
+        .keyvals_even = info->keyvals_even.devaddr,
+        .keyvals_odd  = info->keyvals_odd,
+        .key_bits     = info->key_bits,
+        .count        = info->count,
+      };
+
+      *keyvals_sorted = rs_host_keyvals_sorted(rs, info->key_bits,  //
+                                               info->keyvals_even.devaddr,
+                                               info->keyvals_odd);
+
+      rs->cmd_sort_host(cb, &host_info);
+
+      return;
+    }
+
 #ifdef RS_VK_ENABLE_EXTENSIONS
   //
   // Any extensions?
@@ -919,6 +959,27 @@ radix_sort_vk_sort_indirect_devaddr(radix_sort_vk_t const *
       return;
     }
 
+  //
+  // Sorting on the host?
+  //
+  if (rs->cmd_sort_host != NULL)
+    {
+      struct radix_sort_host_info const host_info = {
+        .keyvals_even = info->keyvals_even,
+        .keyvals_odd  = info->keyvals_odd,
+        .key_bits     = info->key_bits,
+        .count_addr   = info->count,
+      };
+
+      *keyvals_sorted = rs_host_keyvals_sorted(rs, info->key_bits,  //
+                                               info->keyvals_even,
+                                               info->keyvals_odd);
+
+      rs->cmd_sort_host(cb, &host_info);
+
+      return;
+    }
+
 #ifdef RS_VK_ENABLE_EXTENSIONS
   //
   // Any extensions?
@@ -120,10 +120,18 @@ struct rs_pipelines_named
 //
 //
 
+struct radix_sort_host_info;
+
 struct radix_sort_vk
 {
   struct radix_sort_vk_target_config config;
 
+  //
+  // Set by vk_create_radix_sort_u64_host() to record host sorts instead of
+  // dispatching the pipelines, which are not created.
+  //
+  void (*cmd_sort_host)(VkCommandBuffer cb, struct radix_sort_host_info const * info);
+
   union
   {
     struct rs_pipeline_layouts_named named;
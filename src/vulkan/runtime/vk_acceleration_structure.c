@@ -35,6 +35,7 @@
 #include "bvh/vk_bvh.h"
 
 #include "radix_sort/common/vk/barrier.h"
+#include "radix_sort/radix_sort_host.h"
 #include "radix_sort/shaders/push.h"
 
 #include "util/u_string.h"
@@ -645,6 +646,30 @@ morton_sort(VkCommandBuffer commandBuffer, struct vk_device *device,
          bvh_states[i].scratch_offset = bvh_states[i].vk.scratch.sort_buffer_offset[0];
    }
 
+   /* CPU devices sort on the host instead, which leaves the keyvals in the
+    * same buffer.
+    */
+   if (rs->cmd_sort_host) {
+      for (uint32_t i = 0; i < infoCount; ++i) {
+         if (!bvh_states[i].vk.leaf_node_count)
+            continue;
+         if (bvh_states[i].vk.config.internal_type == VK_INTERNAL_BUILD_TYPE_UPDATE)
+            continue;
+
+         const struct radix_sort_host_info info = {
+            .keyvals_even = pInfos[i].scratchData.deviceAddress + bvh_states[i].vk.scratch.sort_buffer_offset[0],
+            .keyvals_odd = pInfos[i].scratchData.deviceAddress + bvh_states[i].vk.scratch.sort_buffer_offset[1],
+            .key_bits = key_bits,
+            .count = bvh_states[i].vk.leaf_node_count,
+         };
+         rs->cmd_sort_host(commandBuffer, &info);
+      }
+
+      if (args->emit_markers)
+         device->as_build_ops->end_debug_marker(commandBuffer);
+      return;
+   }
+
    /*
     * PAD KEYVALS AND ZERO HISTOGRAM/PARTITIONS
     *